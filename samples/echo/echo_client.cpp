@@ -2,6 +2,7 @@
 #include <cy_event.h>
 #include <cy_network.h>
 #include <utility/cyu_simple_opt.h>
+#include <utility/cyu_histogram.h>
 
 #include <iostream>
 
@@ -83,28 +84,42 @@ private:
 		char temp[MAX_ECHO_LENGTH +1] = { 0 };
 		buf.memcpy_out(temp, MAX_ECHO_LENGTH);
 
-		CY_LOG(L_INFO, "%s", temp);
+		//round trip time
+		int64_t rtt = sys_api::performance_time_now() - m_send_time.load();
+		m_rtt_histogram.record(rtt);
+
+		CY_LOG(L_INFO, "%s (rtt=%" PRId64 "us, p50=%" PRId64 "us, p99=%" PRId64 "us)", temp, 
+			rtt, m_rtt_histogram.value_at_percentile(50.0), m_rtt_histogram.value_at_percentile(99.0));
 	}
 
 	//-------------------------------------------------------------------------------------
 	[[noreturn]] void onClose(void)
 	{
-		CY_LOG(L_INFO, "socket close");
+		CY_LOG(L_INFO, "socket close, rtt(us): %s", m_rtt_histogram.summary().c_str());
 		exit(0);
 	}
 
 public:
 	TcpClientPtr get_client(void) { return m_client; }
 
+	void send(const char* line)
+	{
+		m_send_time = sys_api::performance_time_now();
+		m_client->send(line, strlen(line));
+	}
+
 private:
 	TcpClientPtr m_client;
 	std::string m_server_ip;
 	uint16_t m_server_port;
 	sys_api::signal_t m_connected_signal;
+	atomic_int64_t m_send_time;
+	LatencyHistogram m_rtt_histogram;
 
 public:
 	EchoClient()
 		: m_client(nullptr)
+		, m_send_time(0)
 	{
 		m_connected_signal = sys_api::signal_create();
 	}
@@ -157,7 +172,7 @@ int main(int argc, char* argv[])
 	while (std::cin.getline(line, MAX_ECHO_LENGTH + 1))
 	{
 		if (line[0] == 0) continue;
-		echoClient.get_client()->send(line, strlen(line));
+		echoClient.send(line);
 	}
 
 	return 0;
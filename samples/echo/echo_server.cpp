@@ -19,7 +19,7 @@ static CSimpleOptA::SOption g_rgOptions[] = {
 };
 
 //-------------------------------------------------------------------------------------
-void onPeerConnected(TcpServer* server, int32_t thread_index, TcpConnectionPtr conn)
+void onPeerConnected(TcpServer* server, int32_t thread_index, const TcpConnectionLocalPtr& conn)
 {
 	(void)server;
 
@@ -29,10 +29,12 @@ void onPeerConnected(TcpServer* server, int32_t thread_index, TcpConnectionPtr c
 		conn->get_peer_addr().get_port(),
 		conn->get_local_addr().get_ip(),
 		conn->get_local_addr().get_port());
+
+	conn->start_message_statistics();
 }
 
 //-------------------------------------------------------------------------------------
-void onPeerMessage(TcpServer* server, int32_t thread_index, TcpConnectionPtr conn)
+void onPeerMessage(TcpServer* server, int32_t thread_index, const TcpConnectionLocalPtr& conn)
 {
 	RingBuf& buf = conn->get_input_buf();
 
@@ -60,14 +62,16 @@ void onPeerMessage(TcpServer* server, int32_t thread_index, TcpConnectionPtr con
 }
 
 //-------------------------------------------------------------------------------------
-void onPeerClose(TcpServer* server, int32_t thread_index, TcpConnectionPtr conn)
+void onPeerClose(TcpServer* server, int32_t thread_index, const TcpConnectionLocalPtr& conn)
 {
 	(void)server;
 
-	CY_LOG(L_INFO, "[T=%d]connection %s:%d closed",
+	const LatencyHistogram* histogram = conn->get_message_statistics();
+	CY_LOG(L_INFO, "[T=%d]connection %s:%d closed, on_message(us): %s",
 		thread_index,
 		conn->get_peer_addr().get_ip(),
-		conn->get_peer_addr().get_port());
+		conn->get_peer_addr().get_port(),
+		histogram ? histogram->summary().c_str() : "none");
 }
 
 //-------------------------------------------------------------------------------------
@@ -122,8 +122,7 @@ private:
 		ThreadContext& ctx = *(m_threadContext[(size_t)index]);
 
 		if (ctx.status == TS_Sending && ctx.conn) {
-			const auto& writeStatistics = ctx.conn->get_write_statistics();
-			ctx.sendSpeed = (float)writeStatistics.first / (float)SEND_STATISTICS_TIME;
+			ctx.sendSpeed = (float)ctx.conn->get_write_speed();
 		}
 	}
 
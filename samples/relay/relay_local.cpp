@@ -12,13 +12,14 @@ using namespace cyclone;
 using namespace std::placeholders;
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-enum { OPT_PORT, OPT_UP_HOST, OPT_UP_PORT, OPT_VERBOSE_MODE, OPT_ENCRYPT_MODE, OPT_THREADS, OPT_STATISTICS, OPT_HELP };
+enum { OPT_PORT, OPT_UP_HOST, OPT_UP_PORT, OPT_VERBOSE_MODE, OPT_ENCRYPT_MODE, OPT_CIPHER, OPT_THREADS, OPT_STATISTICS, OPT_HELP };
 
 static CSimpleOptA::SOption g_rgOptions[] = {
 	{ OPT_PORT, "-p",     SO_REQ_SEP },  // "-p LISTEN_PORT"
 	{ OPT_UP_HOST, "-uh",  SO_REQ_SEP }, // "-uh UP_SERVER_HOST"
 	{ OPT_UP_PORT, "-up",  SO_REQ_SEP }, // "-up UP_SERVER_PORT"
 	{ OPT_ENCRYPT_MODE, "-e",  SO_NONE }, // "-e"
+	{ OPT_CIPHER, "-c",  SO_REQ_SEP }, // "-c CIPHER"
 	{ OPT_THREADS, "-t",  SO_REQ_SEP }, // "-t THREAD_COUNTS"
 	{ OPT_STATISTICS, "-s",  SO_NONE },	// "-s"
 	{ OPT_VERBOSE_MODE, "-v",  SO_NONE },	// "-v"
@@ -59,6 +60,7 @@ private:
 	enum UpState {
 		kConnecting = 0,
 		kHandshaking,
+		kResuming,
 		kHandshaked,
 		kDisConnected
 	};
@@ -67,6 +69,7 @@ private:
 	Address m_upAddress;
 	TcpServer* m_downServer;
 	bool m_encryptMode;
+	int32_t m_cipher;
 
 	struct RelayPipe
 	{
@@ -75,33 +78,41 @@ private:
 		dhkey_t m_publicKey;
 		dhkey_t m_privateKey;
 		dhkey_t m_secretKey;
-		Rijndael* m_encrypt;
-		Rijndael* m_decrypt;
+		RelayCipher* m_cipher;
 		RelaySessionMap m_sessionMap;
+		int64_t m_connectTime;
 
-		RelayPipe(bool encryptMode) : m_upClient(nullptr), m_upState(kConnecting), m_encrypt(nullptr), m_decrypt(nullptr)
+		//resumption ticket issued by relay_server
+		bool m_hasTicket;
+		int64_t m_ticketExpireTime;
+		dhkey_t m_ticketSecret;
+		uint8_t m_ticket[RELAY_TICKET_SIZE];
+		uint8_t m_localRandom[RELAY_RANDOM_SIZE];
+
+		RelayPipe() : m_upClient(nullptr), m_upState(kConnecting), m_cipher(nullptr), m_connectTime(0), m_hasTicket(false), m_ticketExpireTime(0)
 		{
-			if (encryptMode)
-				DH_generate_key_pair(m_publicKey, m_privateKey);
-			else
-				m_publicKey.dq.low = m_publicKey.dq.high = 0;
+			m_publicKey.dq.low = m_publicKey.dq.high = 0;
 		}
 
 		~RelayPipe()
 		{
-			if (m_encrypt) {
-				delete m_encrypt; m_encrypt = nullptr;
+			if (m_cipher) {
+				delete m_cipher; m_cipher = nullptr;
 			}
+			dropTicket();
+		}
 
-			if (m_decrypt) {
-				delete m_decrypt; m_decrypt = nullptr;
-			}
+		void dropTicket(void)
+		{
+			m_hasTicket = false;
+			memset(m_ticketSecret.bytes, 0, DH_KEY_LENGTH);
 		}
 	};
 	typedef std::vector<RelayPipe*> RelayPipeVector;
 	RelayPipeVector m_relayPipes;
 
 	enum { kSpeedTimePeriod = 5 * 1000 }; //(2 seconds)
+	enum { kReconnectDelay = 1000 }; //(1 second)
 
 	bool m_enable_statistics;
 
@@ -144,14 +155,21 @@ private:
 	//-------------------------------------------------------------------------------------
 	void onWorkthreadStart(TcpServer* /*server*/, int32_t index, Looper* looper)
 	{
-		RelayPipe* newPipe = new  RelayPipe(m_encryptMode);
+		RelayPipe* newPipe = new  RelayPipe();
 		m_relayPipes[(size_t)index] = newPipe;
 
-		newPipe->m_upClient = std::make_shared<TcpClient>(looper, this, index);
-		newPipe->m_upClient->m_listener.on_connected = std::bind(&RelayLocal::onUpConnected, this, _2, _3);
-		newPipe->m_upClient->m_listener.on_message = std::bind(&RelayLocal::onUpMessage, this, _1, _2);
-		newPipe->m_upClient->m_listener.on_close = std::bind(&RelayLocal::onUpClose, this, _1, _2);
-		newPipe->m_upClient->connect(m_upAddress);
+		_connectUp(newPipe, index, looper);
+	}
+
+	//-------------------------------------------------------------------------------------
+	void _connectUp(RelayPipe* pipe, int32_t index, Looper* looper)
+	{
+		pipe->m_upState = kConnecting;
+		pipe->m_upClient = std::make_shared<TcpClient>(looper, this, index);
+		pipe->m_upClient->m_listener.on_connected = std::bind(&RelayLocal::onUpConnected, this, _2, _3);
+		pipe->m_upClient->m_listener.on_message = std::bind(&RelayLocal::onUpMessage, this, _1, _2);
+		pipe->m_upClient->m_listener.on_close = std::bind(&RelayLocal::onUpClose, this, _1, _2);
+		pipe->m_upClient->connect(m_upAddress);
 	}
 	//-------------------------------------------------------------------------------------
 	void onLocalConnected(TcpServer* server, int32_t index, TcpConnectionPtr conn)
@@ -192,7 +210,7 @@ private:
 			forwardMsg.id = conn->get_id();
 			forwardMsg.size = (int32_t)msgSize;
 
-			size_t buf_round_size = m_encryptMode ? _round16(msgSize) : msgSize;
+			size_t buf_round_size = m_encryptMode ? pipe->m_cipher->get_wire_size(msgSize) : msgSize;
 			Packet packet;
 			packet.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayForwardMsg::ID, (uint16_t)(sizeof(RelayForwardMsg) + buf_round_size), nullptr);
 
@@ -203,7 +221,7 @@ private:
 			if (m_encryptMode)
 			{
 				uint8_t* buf = (uint8_t*)packet.get_packet_content() + sizeof(forwardMsg);
-				pipe->m_encrypt->encrypt(buf, buf, buf_round_size);
+				pipe->m_cipher->encrypt(buf, buf_round_size);
 			}
 
 			//Statistics
@@ -260,17 +278,26 @@ private:
 		if (success) {
 			RelayPipe* pipe = m_relayPipes[(size_t)(conn->get_id())];
 			assert(pipe->m_upState == kConnecting);
+			pipe->m_connectTime = sys_api::performance_time_now();
+
+			//skip the DH key exchange if the ticket is still valid
+			if (m_encryptMode && pipe->m_hasTicket && sys_api::utc_time_now() < pipe->m_ticketExpireTime) {
+				RelayResumeMsg resume;
+				resume.cipher = m_cipher;
+				relay_random(pipe->m_localRandom, RELAY_RANDOM_SIZE);
+				memcpy(resume.random, pipe->m_localRandom, RELAY_RANDOM_SIZE);
+				memcpy(resume.ticket, pipe->m_ticket, RELAY_TICKET_SIZE);
+
+				Packet packet;
+				packet.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayResumeMsg::ID, sizeof(resume), (const char*)&resume);
+				pipe->m_upClient->send(packet.get_memory_buf(), packet.get_memory_size());
+
+				pipe->m_upState = kResuming;
+				CY_LOG(L_DEBUG, "Up Server Connected, send resume message.");
+				return 0;
+			}
 
-			//send handshake message
-			RelayHandshakeMsg handshake;
-			handshake.dh_key = pipe->m_publicKey;
-
-			Packet packet;
-			packet.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayHandshakeMsg::ID, sizeof(handshake), (const char*)&handshake);
-			pipe->m_upClient->send(packet.get_memory_buf(), packet.get_memory_size());
-
-			//update state
-			pipe->m_upState = kHandshaking;
+			_sendHandshake(pipe);
 			CY_LOG(L_DEBUG, "Up Server Connected, send handshake message.");
 			return 0;
 		}else {
@@ -278,6 +305,25 @@ private:
 		}
 	}
 
+	//-------------------------------------------------------------------------------------
+	void _sendHandshake(RelayPipe* pipe)
+	{
+		//new key pair for every full handshake
+		if (m_encryptMode)
+			DH_generate_key_pair(pipe->m_publicKey, pipe->m_privateKey);
+
+		RelayHandshakeMsg handshake;
+		handshake.dh_key = pipe->m_publicKey;
+		handshake.cipher = m_cipher;
+
+		Packet packet;
+		packet.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayHandshakeMsg::ID, sizeof(handshake), (const char*)&handshake);
+		pipe->m_upClient->send(packet.get_memory_buf(), packet.get_memory_size());
+
+		//update state
+		pipe->m_upState = kHandshaking;
+	}
+
 	//-------------------------------------------------------------------------------------
 	void onUpMessage(TcpClientPtr client, TcpConnectionPtr conn)
 	{
@@ -323,24 +369,65 @@ private:
 				//handshake
 				if (m_encryptMode)
 				{
+					if (handshake.cipher != m_cipher) {
+						CY_LOG(L_ERROR, "Cipher not accepted, relay_server:%s, relay_local:%s", relay_cipher_name(handshake.cipher), relay_cipher_name(m_cipher));
+						client->disconnect();
+						pipe->m_upState = kDisConnected;
+						return;
+					}
 					DH_generate_key_secret(pipe->m_secretKey, pipe->m_privateKey, handshake.dh_key);
 
-					//create encrypter
-					pipe->m_encrypt = new Rijndael(pipe->m_secretKey.bytes);
+					//create encrypter and decrypter
+					pipe->m_cipher = new RelayCipher(m_cipher, pipe->m_secretKey, true);
 
-					//create decrypter
-					for (size_t i = 0; i < Rijndael::BLOCK_SIZE; i++)
-						pipe->m_privateKey.bytes[i] = (uint8_t)(~(pipe->m_privateKey.bytes[i]));
-					pipe->m_decrypt = new Rijndael(pipe->m_secretKey.bytes);
+					//keep the secret key until the ticket arrived
+					pipe->dropTicket();
+					pipe->m_ticketSecret = pipe->m_secretKey;
 				}
 
 				//update state
 				pipe->m_upState = kHandshaked;
 
-				CY_LOG(L_DEBUG, "Connect to up server(%s:%d)", conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port());
+				CY_LOG(L_DEBUG, "Connect to up server(%s:%d), handshake cost %.2f ms", conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port(),
+					(double)(sys_api::performance_time_now() - pipe->m_connectTime) / 1000.0);
 
 				//clean secret key memory(for safe)
 				memset(pipe->m_secretKey.bytes, 0, Rijndael::BLOCK_SIZE);
+				memset(pipe->m_privateKey.bytes, 0, DH_KEY_LENGTH);
+			}
+			else if (pipe->m_upState == kResuming) {
+				//peed message id
+				uint16_t packetID;
+				if (sizeof(packetID) != conn->get_input_buf().peek(2, &packetID, sizeof(packetID))) return;
+				packetID = socket_api::ntoh_16(packetID);
+
+				Packet replyPacket;
+				if (!replyPacket.build_from_ringbuf(RELAY_PACKET_HEADSIZE, conn->get_input_buf())) return;
+
+				if (packetID != (uint16_t)RELAY_RESUME_REPLY || replyPacket.get_packet_size() != sizeof(RelayResumeReplyMsg)) {
+					client->disconnect();
+					pipe->m_upState = kDisConnected;
+					return;
+				}
+
+				RelayResumeReplyMsg reply;
+				memcpy(&reply, replyPacket.get_packet_content(), sizeof(reply));
+
+				if (!reply.accepted) {
+					//fall back to the full handshake
+					CY_LOG(L_DEBUG, "Resumption ticket rejected, send handshake message.");
+					pipe->dropTicket();
+					_sendHandshake(pipe);
+					continue;
+				}
+
+				relay_resume_key(pipe->m_secretKey, pipe->m_ticketSecret, pipe->m_localRandom, reply.random);
+				pipe->m_cipher = new RelayCipher(m_cipher, pipe->m_secretKey, true);
+				memset(pipe->m_secretKey.bytes, 0, DH_KEY_LENGTH);
+
+				pipe->m_upState = kHandshaked;
+				CY_LOG(L_DEBUG, "Resume to up server(%s:%d), handshake cost %.2f ms", conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port(),
+					(double)(sys_api::performance_time_now() - pipe->m_connectTime) / 1000.0);
 			}
 			else if (pipe->m_upState == kHandshaked) {
 				//peed message id
@@ -362,7 +449,7 @@ private:
 					if (m_encryptMode)
 					{
 						uint8_t* buf = (uint8_t*)packet.get_packet_content() + sizeof(RelayForwardMsg);
-						pipe->m_decrypt->decrypt(buf, buf, packet.get_packet_size() - sizeof(RelayForwardMsg));
+						pipe->m_cipher->decrypt(buf, packet.get_packet_size() - sizeof(RelayForwardMsg));
 					}
 
 					auto it = pipe->m_sessionMap.find(forwardMsg.id);
@@ -411,30 +498,76 @@ private:
 				}
 				break;
 
+				case RELAY_TICKET:
+				{
+					//get packet
+					Packet packet;
+					if (!packet.build_from_ringbuf(RELAY_PACKET_HEADSIZE, conn->get_input_buf())) return;
+					if (packet.get_packet_size() != sizeof(RelayTicketMsg) || !m_encryptMode) break;
+
+					RelayTicketMsg ticketMsg;
+					memcpy(&ticketMsg, packet.get_packet_content(), sizeof(ticketMsg));
+
+					memcpy(pipe->m_ticket, ticketMsg.ticket, RELAY_TICKET_SIZE);
+					pipe->m_ticketExpireTime = sys_api::utc_time_now() + (int64_t)ticketMsg.lifetime * 1000 * 1000;
+					pipe->m_hasTicket = true;
+					CY_LOG(L_DEBUG, "Receive resumption ticket, lifetime %d seconds", ticketMsg.lifetime);
+				}
+				break;
+
+				default:
+					CY_LOG(L_ERROR, "receive invalid packet(%d)", packetID);
+					client->disconnect();
+					pipe->m_upState = kDisConnected;
+					return;
 				}
 			}
 		}
 	}
 
 	//-------------------------------------------------------------------------------------
-	void onUpClose(TcpClientPtr client, TcpConnectionPtr conn)
+	void onUpClose(TcpClientPtr /*client*/, TcpConnectionPtr conn)
 	{
-		RelayPipe* pipe = m_relayPipes[(size_t)(conn->get_id())];
+		int32_t index = conn->get_id();
+		RelayPipe* pipe = m_relayPipes[(size_t)index];
+		bool handshaked = (pipe->m_upState == kHandshaked);
 		
 		pipe->m_upClient = nullptr;
 		pipe->m_upState = kDisConnected;
-	}
+		delete pipe->m_cipher; pipe->m_cipher = nullptr;
 
-private:
-	//-------------------------------------------------------------------------------------
-	size_t _round16(size_t size) {
-		return ((size & 0xF) == 0) ? size : ((size & (size_t)(~0xF))+0x10);
+		//the sessions belong to the closed tunnel
+		for (auto& it : pipe->m_sessionMap) {
+			m_downServer->shutdown_connection(it.second.m_downConnection);
+		}
+		pipe->m_sessionMap.clear();
+
+		//reconnect, the ticket is presented if it is still valid
+		CY_LOG(L_DEBUG, "Up server closed, reconnect to %s:%d", m_upAddress.get_ip(), m_upAddress.get_port());
+		Looper* looper = conn->get_looper();
+		if (handshaked) {
+			_connectUp(pipe, index, looper);
+			return;
+		}
+
+		//closed in handshaking, wait a while to avoid busy reconnecting
+		looper->register_timer_event(kReconnectDelay, nullptr, [this, pipe, index, looper](Looper::event_id_t id, void*) {
+			//the lambda is released with the timer, copy the captures first
+			RelayLocal* self = this;
+			RelayPipe* reconnectPipe = pipe;
+			int32_t reconnectIndex = index;
+			Looper* reconnectLooper = looper;
+
+			reconnectLooper->delete_event(id);
+			self->_connectUp(reconnectPipe, reconnectIndex, reconnectLooper);
+		});
 	}
 
 public:
-	RelayLocal(bool encryptMode, bool enableStatistics)
+	RelayLocal(bool encryptMode, int32_t cipher, bool enableStatistics)
 		: m_downServer(nullptr)
 		, m_encryptMode(encryptMode)
+		, m_cipher(cipher)
 		, m_enable_statistics(enableStatistics)
 		, m_up_total(0)
 		, m_up_statistics(kSpeedTimePeriod)
@@ -457,6 +590,7 @@ static void printUsage(const char* moduleName)
 	printf("\t -up UP_PORT\tUp Server(Relay Server) Port, Default 3000\n");
 	printf("\t -t THREAD_COUNTS\tWork thread counts(must be 1 when relay_pipe used)\n");
 	printf("\t -e\t\tEncrypt Message\n");
+	printf("\t -c CIPHER\tCipher of encrypt mode(aes|chacha20), Default aes if the cpu has AES instructions, otherwise chacha20\n");
 	printf("\t -s\t\tPrint speed statistics\n");
 	printf("\t -v\t\tVerbose Mode\n");
 	printf("\t --help -?\tShow this help\n");
@@ -472,6 +606,8 @@ int main(int argc, char* argv[])
 	uint16_t up_port = 3000;
 	bool verbose_mode = false;
 	bool encrypt_mode = false;
+	//aes is fast only when it is accelerated by hardware
+	int32_t cipher = (Rijndael::is_supported(Rijndael::IMPL_AESNI) || Rijndael::is_supported(Rijndael::IMPL_ARMV8)) ? RELAY_CIPHER_AES_CBC : RELAY_CIPHER_CHACHA20;
 	int32_t work_thread_counts = sys_api::get_cpu_counts();
 	bool enable_statistics = false;
 
@@ -496,6 +632,15 @@ int main(int argc, char* argv[])
 			else if (args.OptionId() == OPT_ENCRYPT_MODE) {
 				encrypt_mode = true;
 			}
+			else if (args.OptionId() == OPT_CIPHER) {
+				for (cipher = 0; cipher < RELAY_CIPHER_COUNTS; cipher++) {
+					if (strcmp(args.OptionArg(), relay_cipher_name(cipher)) == 0) break;
+				}
+				if (cipher == RELAY_CIPHER_COUNTS) {
+					printf("Unknown cipher: %s\n", args.OptionArg());
+					return 1;
+				}
+			}
 			else if (args.OptionId() == OPT_VERBOSE_MODE) {
 				verbose_mode = true;
 			}
@@ -515,10 +660,11 @@ int main(int argc, char* argv[])
 	CY_LOG(L_DEBUG, "listen port %d", local_port);
 	CY_LOG(L_DEBUG, "up address %s:%d", up_ip.c_str(), up_port);
 	CY_LOG(L_DEBUG, "encrypt mode %s", encrypt_mode ? "true" : "false");
+	if (encrypt_mode) CY_LOG(L_DEBUG, "cipher %s", relay_cipher_name(cipher));
 	CY_LOG(L_DEBUG, "work thread counts %d", work_thread_counts);
 	CY_LOG(L_DEBUG, "speed statistics: %s", enable_statistics ? "true" : "false");
 
-	RelayLocal relayLocal(encrypt_mode, enable_statistics);
+	RelayLocal relayLocal(encrypt_mode, cipher, enable_statistics);
 	relayLocal.startAndJoin(local_port, Address(up_ip.c_str(), up_port), work_thread_counts);
 	return 0;
 }
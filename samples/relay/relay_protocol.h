@@ -2,6 +2,18 @@
 
 #include <cy_crypt.h>
 
+#ifdef CY_SYS_WINDOWS
+#include <bcrypt.h>
+#else
+#include <fcntl.h>
+#if defined(CY_SYS_LINUX) && defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 25)
+#include <sys/random.h>
+#define RELAY_HAVE_GETRANDOM 1
+#endif
+#endif
+#endif
+
 enum {
 	RELAY_PACKET_HEADSIZE = 4
 };
@@ -10,7 +22,18 @@ enum {
 	RELAY_HANDSHAKE_ID = 100,
 	RELAY_NEW_SESSION,
 	RELAY_CLOSE_SESSION,
-	RELAY_FORWARD
+	RELAY_FORWARD,
+	RELAY_TICKET,
+	RELAY_RESUME,
+	RELAY_RESUME_REPLY
+};
+
+//cipher of forward data, relay_local proposes one in handshake message and relay_server
+//replies the one it accepted
+enum {
+	RELAY_CIPHER_AES_CBC = 0,	//data is padded to 16 bytes
+	RELAY_CIPHER_CHACHA20,		//stream cipher, fast on the cpu without AES instructions
+	RELAY_CIPHER_COUNTS
 };
 
 struct RelayHandshakeMsg
@@ -18,6 +41,40 @@ struct RelayHandshakeMsg
 	enum { ID = RELAY_HANDSHAKE_ID };
 
 	cyclone::dhkey_t dh_key;
+	int32_t cipher;
+};
+
+enum {
+	RELAY_RANDOM_SIZE = 16,
+	//key id(4), nonce(12), sealed secret key(16)+cipher(4)+issue time(8), tag(16)
+	RELAY_TICKET_SIZE = 60
+};
+
+//relay_server issues a resumption ticket after the full handshake, relay_local presents it
+//when reconnecting to skip the DH key exchange. The ticket is opaque to relay_local.
+struct RelayTicketMsg
+{
+	enum { ID = RELAY_TICKET };
+
+	int32_t lifetime;	//seconds
+	uint8_t ticket[RELAY_TICKET_SIZE];
+};
+
+struct RelayResumeMsg
+{
+	enum { ID = RELAY_RESUME };
+
+	int32_t cipher;
+	uint8_t random[RELAY_RANDOM_SIZE];
+	uint8_t ticket[RELAY_TICKET_SIZE];
+};
+
+struct RelayResumeReplyMsg
+{
+	enum { ID = RELAY_RESUME_REPLY };
+
+	int32_t accepted;	//0 means the ticket is expired or unknown, relay_local should do the full handshake
+	uint8_t random[RELAY_RANDOM_SIZE];
 };
 
 struct RelayNewSessionMsg
@@ -40,3 +97,169 @@ struct RelayForwardMsg
 	int32_t id;
 	int32_t size;
 };
+
+inline const char* relay_cipher_name(int32_t cipher)
+{
+	switch (cipher) {
+	case RELAY_CIPHER_AES_CBC: return "aes";
+	case RELAY_CIPHER_CHACHA20: return "chacha20";
+	default: return "unknown";
+	}
+}
+
+//fill from the OS CSPRNG, the randoms become ticket keys and nonces so they must never repeat
+//or be predictable, abort if the system can't give any
+inline void relay_random(uint8_t* random, size_t size)
+{
+#ifdef CY_SYS_WINDOWS
+	if (BCryptGenRandom(nullptr, random, (ULONG)size, BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0) return;
+#else
+#ifdef RELAY_HAVE_GETRANDOM
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = getrandom(random + done, size - done, 0);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		done += (size_t)n;
+	}
+	if (done == size) return;
+#endif
+	int fd = ::open("/dev/urandom", O_RDONLY);
+	if (fd >= 0) {
+		size_t got = 0;
+		while (got < size) {
+			ssize_t n = ::read(fd, random + got, size - got);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) break;
+			got += (size_t)n;
+		}
+		::close(fd);
+		if (got == size) return;
+	}
+#endif
+	fprintf(stderr, "relay: no system random source\n");
+	abort();
+}
+
+//the key of a resumed tunnel, CBC-MAC of both randoms with the secret key in ticket. The randoms
+//are fresh in every resumption, so the keystream of the stream cipher is never reused
+inline void relay_resume_key(cyclone::dhkey_t& key, const cyclone::dhkey_t& ticket_secret, const uint8_t* local_random, const uint8_t* server_random)
+{
+	cyclone::Rijndael aes(ticket_secret.bytes);
+
+	uint8_t block[cyclone::Rijndael::BLOCK_SIZE];
+	aes.encrypt_block(local_random, block);
+	for (size_t i = 0; i < cyclone::Rijndael::BLOCK_SIZE; i++) block[i] ^= server_random[i];
+	aes.encrypt_block(block, key.bytes);
+}
+
+//encrypt/decrypt the data of forward message. All messages of a pipe are processed in order on
+//its work thread, so the keystream of stream cipher continues between messages, and each direction
+//has its own keystream. The 32 bits block counter of ChaCha20 wraps after 256GB, so both sides
+//restart the keystream of a direction with the next nonce every `rekey_bytes`
+class RelayCipher
+{
+public:
+	//half of the block counter
+	static const uint64_t REKEY_BYTES = (uint64_t)cyclone::ChaCha20::BLOCK_SIZE << 31;
+
+	//size of the data on wire
+	size_t get_wire_size(size_t size) const {
+		return (m_cipher == RELAY_CIPHER_AES_CBC) ? ((size + 15) & ~(size_t)15) : size;
+	}
+
+	void encrypt(uint8_t* buf, size_t wire_size) {
+		if (m_aes) m_aes->encrypt(buf, buf, wire_size);
+		else _update(m_encrypt, buf, wire_size);
+	}
+
+	void decrypt(uint8_t* buf, size_t wire_size) {
+		if (m_aes) m_aes->decrypt(buf, buf, wire_size);
+		else _update(m_decrypt, buf, wire_size);
+	}
+
+	int32_t get_cipher(void) const { return m_cipher; }
+
+	//nonce of the keystream, direction(0: relay_local to relay_server, 1: reverse) in first byte
+	//and the times of rekey in last 8 bytes
+	static void make_nonce(uint8_t* nonce, uint8_t direction, uint64_t epoch) {
+		memset(nonce, 0, cyclone::ChaCha20::NONCE_SIZE);
+		nonce[0] = direction;
+		for (size_t i = 0; i < 8; i++) nonce[4 + i] = (uint8_t)(epoch >> (i * 8));
+	}
+
+public:
+	RelayCipher(int32_t cipher, const cyclone::dhkey_t& secret_key, bool is_local, uint64_t rekey_bytes = REKEY_BYTES)
+		: m_cipher(cipher)
+		, m_aes(nullptr)
+		, m_rekey_bytes(rekey_bytes)
+	{
+		if (cipher == RELAY_CIPHER_CHACHA20) {
+			assert(rekey_bytes > 0 && rekey_bytes <= REKEY_BYTES);
+
+			//256 bits key from 128 bits secret
+			uint8_t key[cyclone::ChaCha20::KEY_SIZE];
+			for (size_t i = 0; i < DH_KEY_LENGTH; i++) {
+				key[i] = secret_key.bytes[i];
+				key[i + DH_KEY_LENGTH] = (uint8_t)(~secret_key.bytes[i]);
+			}
+			_init_stream(m_encrypt, key, is_local ? 0 : 1);
+			_init_stream(m_decrypt, key, is_local ? 1 : 0);
+			memset(key, 0, sizeof(key));
+		}
+		else {
+			m_aes = new cyclone::Rijndael(secret_key.bytes);
+		}
+	}
+
+	~RelayCipher() {
+		delete m_aes;
+		delete m_encrypt.stream;
+		delete m_decrypt.stream;
+	}
+
+private:
+	struct Stream
+	{
+		cyclone::ChaCha20* stream;
+		uint8_t direction;
+		uint64_t epoch;
+		uint64_t used;	//bytes of current keystream
+	};
+
+	void _init_stream(Stream& s, const uint8_t* key, uint8_t direction) {
+		uint8_t nonce[cyclone::ChaCha20::NONCE_SIZE];
+		make_nonce(nonce, direction, 0);
+		s.stream = new cyclone::ChaCha20(key, nonce);
+		s.direction = direction;
+		s.epoch = 0;
+		s.used = 0;
+	}
+
+	void _update(Stream& s, uint8_t* buf, size_t size) {
+		while (size > 0) {
+			size_t n = (size_t)std::min((uint64_t)size, m_rekey_bytes - s.used);
+			s.stream->update(buf, buf, n);
+			buf += n;
+			size -= n;
+			s.used += n;
+
+			//the other side restarts at the same position
+			if (s.used == m_rekey_bytes) {
+				uint8_t nonce[cyclone::ChaCha20::NONCE_SIZE];
+				make_nonce(nonce, s.direction, ++s.epoch);
+				s.stream->reset(nonce);
+				s.used = 0;
+			}
+		}
+	}
+
+private:
+	int32_t m_cipher;
+	cyclone::Rijndael* m_aes;
+	Stream m_encrypt;
+	Stream m_decrypt;
+	uint64_t m_rekey_bytes;
+};
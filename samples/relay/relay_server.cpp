@@ -12,13 +12,14 @@ using namespace cyclone;
 using namespace std::placeholders;
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-enum { OPT_PORT, OPT_UP_HOST, OPT_UP_PORT, OPT_VERBOSE_MODE, OPT_ENCRYPT_MODE, OPT_THREADS, OPT_STATISTICS, OPT_HELP };
+enum { OPT_PORT, OPT_UP_HOST, OPT_UP_PORT, OPT_VERBOSE_MODE, OPT_ENCRYPT_MODE, OPT_TICKET_LIFETIME, OPT_THREADS, OPT_STATISTICS, OPT_HELP };
 
 static CSimpleOptA::SOption g_rgOptions[] = {
 	{ OPT_PORT, "-p",     SO_REQ_SEP },  // "-p LISTEN_PORT"
 	{ OPT_UP_HOST, "-uh",  SO_REQ_SEP }, // "-uh UP_SERVER_HOST"
 	{ OPT_UP_PORT, "-up",  SO_REQ_SEP }, // "-up UP_SERVER_PORT"
 	{ OPT_ENCRYPT_MODE, "-e",  SO_NONE }, // "-e"
+	{ OPT_TICKET_LIFETIME, "-tl",  SO_REQ_SEP }, // "-tl TICKET_LIFETIME"
 	{ OPT_THREADS, "-t",  SO_REQ_SEP }, // "-t THREAD_COUNTS"
 	{ OPT_STATISTICS, "-s",  SO_NONE },	// "-s"
 	{ OPT_VERBOSE_MODE, "-v",  SO_NONE },	// "-v"
@@ -61,6 +62,130 @@ public:
 };
 typedef std::shared_ptr<RelaySession> RelaySessionPtr;
 
+////////////////////////////////////////////////////////////////////////////////////////////
+//Keys to seal the resumption tickets. The key is rotated every ticket lifetime, and the previous
+//one is kept, so the ticket issued just before rotation is accepted until it expires.
+class RelayTicketKeys
+{
+public:
+	int32_t get_lifetime(void) const { return m_lifetime; }
+
+	//seal the secret key and cipher of a tunnel into ticket
+	void seal(uint8_t* ticket, const dhkey_t& secret_key, int32_t cipher)
+	{
+		int64_t now = _now();
+		TicketKey key;
+		{
+			sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
+			_rotate(now);
+			key = m_current;
+		}
+
+		uint8_t plain[DH_KEY_LENGTH + 4 + 8];
+		memcpy(plain, secret_key.bytes, DH_KEY_LENGTH);
+		_store_le(plain + DH_KEY_LENGTH, (uint64_t)(uint32_t)cipher, 4);
+		_store_le(plain + DH_KEY_LENGTH + 4, (uint64_t)now, 8);
+
+		_store_le(ticket, key.id, 4);
+		relay_random(ticket + 4, ChaCha20Poly1305::NONCE_SIZE);
+
+		ChaCha20Poly1305 aead(key.key);
+		aead.start(ticket + 4);
+		aead.update_aad(ticket, 4);
+		aead.encrypt(plain, ticket + 16, sizeof(plain));
+		aead.finish(ticket + 16 + sizeof(plain));
+
+		memset(plain, 0, sizeof(plain));
+		memset(&key, 0, sizeof(key));
+	}
+
+	//open the ticket, return false if the ticket is forged, expired or its key has been rotated out
+	bool open(const uint8_t* ticket, dhkey_t& secret_key, int32_t& cipher)
+	{
+		int64_t now = _now();
+		uint32_t id = (uint32_t)_load_le(ticket, 4);
+		TicketKey key;
+		{
+			sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
+			_rotate(now);
+			if (id == m_current.id) key = m_current;
+			else if (id == m_previous.id) key = m_previous;
+			else return false;
+		}
+
+		uint8_t plain[DH_KEY_LENGTH + 4 + 8];
+		ChaCha20Poly1305 aead(key.key);
+		aead.start(ticket + 4);
+		aead.update_aad(ticket, 4);
+		aead.decrypt(ticket + 16, plain, sizeof(plain));
+		bool valid = aead.verify(ticket + 16 + sizeof(plain));
+		memset(&key, 0, sizeof(key));
+
+		int64_t issue_time = (int64_t)_load_le(plain + DH_KEY_LENGTH + 4, 8);
+		if (valid && issue_time <= now && now - issue_time < m_lifetime) {
+			memcpy(secret_key.bytes, plain, DH_KEY_LENGTH);
+			cipher = (int32_t)(uint32_t)_load_le(plain + DH_KEY_LENGTH, 4);
+		}
+		else {
+			valid = false;
+		}
+		memset(plain, 0, sizeof(plain));
+		return valid;
+	}
+
+private:
+	struct TicketKey
+	{
+		uint32_t id;
+		int64_t create_time;
+		uint8_t key[ChaCha20Poly1305::KEY_SIZE];
+	};
+
+	static int64_t _now(void) { return sys_api::utc_time_now() / (1000 * 1000); }
+
+	static void _store_le(uint8_t* p, uint64_t v, size_t size) {
+		for (size_t i = 0; i < size; i++, v >>= 8) p[i] = (uint8_t)v;
+	}
+	static uint64_t _load_le(const uint8_t* p, size_t size) {
+		uint64_t v = 0;
+		for (size_t i = size; i > 0; i--) v = (v << 8) | p[i - 1];
+		return v;
+	}
+
+	void _rotate(int64_t now)
+	{
+		if (now - m_current.create_time < m_lifetime) return;
+
+		m_previous = m_current;
+		m_current.id = m_previous.id + 1;
+		m_current.create_time = now;
+		relay_random(m_current.key, sizeof(m_current.key));
+	}
+
+private:
+	int32_t m_lifetime;
+	TicketKey m_current;
+	TicketKey m_previous;
+	sys_api::spin_mutex m_lock;
+
+public:
+	RelayTicketKeys(int32_t lifetime) : m_lifetime(lifetime)
+	{
+		relay_random((uint8_t*)&m_current.id, sizeof(m_current.id));
+		m_current.create_time = _now();
+		relay_random(m_current.key, sizeof(m_current.key));
+		//no valid previous key
+		m_previous.id = m_current.id - 1;
+		m_previous.create_time = 0;
+		relay_random(m_previous.key, sizeof(m_previous.key));
+	}
+	~RelayTicketKeys()
+	{
+		memset(&m_current, 0, sizeof(m_current));
+		memset(&m_previous, 0, sizeof(m_previous));
+	}
+};
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 class RelayServer
 {
@@ -75,6 +200,8 @@ private:
 	TcpServer* m_downServer;
 	Address m_upAddress;
 	bool m_encryptMode;
+	DHKeyPairPool* m_dhPool;
+	RelayTicketKeys* m_ticketKeys;	//null if session resumption is disabled
 
 	typedef std::map< int32_t, RelaySessionPtr > RelaySessionMap;
 
@@ -87,27 +214,18 @@ private:
 		dhkey_t m_publicKey;
 		dhkey_t m_privateKey;
 		dhkey_t m_secretKey;
-		Rijndael* m_encrypt;
-		Rijndael* m_decrypt;
+		RelayCipher* m_cipher;
 		RelaySessionMap m_relaySessionMap;
 
-		RelayPipe(bool encryptMode) : m_workthread_index(0), m_looper(nullptr), m_downState(kWaitConnecting), m_encrypt(nullptr), m_decrypt(nullptr)
+		RelayPipe() : m_workthread_index(0), m_looper(nullptr), m_downState(kWaitConnecting), m_cipher(nullptr)
 		{
-			if (encryptMode)
-				DH_generate_key_pair(m_publicKey, m_privateKey);
-			else
-				m_publicKey.dq.high = m_publicKey.dq.low = 0;
+			m_publicKey.dq.high = m_publicKey.dq.low = 0;
 		}
 		~RelayPipe() 
 		{
-			if (m_encrypt)
-			{
-				delete m_encrypt; m_encrypt = nullptr;
-			}
-
-			if (m_decrypt)
+			if (m_cipher)
 			{
-				delete m_decrypt; m_decrypt = nullptr;
+				delete m_cipher; m_cipher = nullptr;
 			}
 		}
 	};
@@ -164,7 +282,7 @@ private:
 	//-------------------------------------------------------------------------------------
 	void onDownConnected(TcpServer* /*server*/, int32_t index, TcpConnectionPtr conn)
 	{
-		RelayPipe* pipe = new RelayPipe(m_encryptMode);
+		RelayPipe* pipe = new RelayPipe();
 
 		pipe->m_workthread_index = index;
 		pipe->m_downState = kWaitHandshaking;
@@ -185,6 +303,12 @@ private:
 			if (sizeof(packetID) != conn->get_input_buf().peek(2, &packetID, sizeof(packetID))) return;
 			packetID = socket_api::ntoh_16(packetID);
 
+			//relay_local presents the ticket of last tunnel
+			if (packetID == (uint16_t)RELAY_RESUME) {
+				if (!_onResume(server, pipe, conn)) return;
+				continue;
+			}
+
 			//must be handshake message
 			if (packetID != (uint16_t)RELAY_HANDSHAKE_ID) {
 				server->shutdown_connection(conn);
@@ -217,16 +341,21 @@ private:
 
 			if (bRemoteEncrypt)
 			{
-				//handshake
-				DH_generate_key_secret(pipe->m_secretKey, pipe->m_privateKey, handshake.dh_key);
+				//accept the cipher which relay_local proposed
+				if (handshake.cipher < 0 || handshake.cipher >= RELAY_CIPHER_COUNTS) {
+					CY_LOG(L_ERROR, "Unknown cipher(%d) from relay_local", handshake.cipher);
+					server->shutdown_connection(conn);
+					pipe->m_downState = kWaitConnecting;
+					return;
+				}
 
-				//create encrypt
-				pipe->m_decrypt = new Rijndael(pipe->m_secretKey.bytes);
+				//handshake, the key pair is precomputed in background
+				m_dhPool->take(pipe->m_publicKey, pipe->m_privateKey);
+				DH_generate_key_secret(pipe->m_secretKey, pipe->m_privateKey, handshake.dh_key);
 
-				//create decrypt
-				for (size_t i = 0; i < Rijndael::BLOCK_SIZE; i++)
-					pipe->m_privateKey.bytes[i] = (uint8_t)(~(pipe->m_privateKey.bytes[i]));
-				pipe->m_encrypt = new Rijndael(pipe->m_secretKey.bytes);
+				//create encrypt and decrypt
+				pipe->m_cipher = new RelayCipher(handshake.cipher, pipe->m_secretKey, false);
+				CY_LOG(L_DEBUG, "Down client use cipher %s", relay_cipher_name(handshake.cipher));
 			}
 
 			//reply my public key
@@ -234,10 +363,22 @@ private:
 			handshakePacket.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayHandshakeMsg::ID, sizeof(handshake), (const char*)&handshake);
 			conn->send(handshakePacket.get_memory_buf(), handshakePacket.get_memory_size());
 
+			//issue the resumption ticket
+			if (bRemoteEncrypt && m_ticketKeys) {
+				RelayTicketMsg ticketMsg;
+				ticketMsg.lifetime = m_ticketKeys->get_lifetime();
+				m_ticketKeys->seal(ticketMsg.ticket, pipe->m_secretKey, pipe->m_cipher->get_cipher());
+
+				Packet ticketPacket;
+				ticketPacket.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayTicketMsg::ID, sizeof(ticketMsg), (const char*)&ticketMsg);
+				conn->send(ticketPacket.get_memory_buf(), ticketPacket.get_memory_size());
+			}
+
 			//update state
 			pipe->m_downState = kHandshaked;
-			//clean secret key memory(for safe)
+			//clean key memory(for safe)
 			memset(pipe->m_secretKey.bytes, 0, Rijndael::BLOCK_SIZE);
+			memset(pipe->m_privateKey.bytes, 0, DH_KEY_LENGTH);
 
 			CY_LOG(L_DEBUG, "Down client handshaked(%s:%d)", conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port());
 		}
@@ -326,7 +467,7 @@ private:
 				uint8_t* buf = (uint8_t*)packet.get_packet_content() + sizeof(RelayForwardMsg);
 				if (m_encryptMode)
 				{
-					pipe->m_decrypt->decrypt(buf, buf, packet.get_packet_size() - sizeof(RelayForwardMsg));
+					pipe->m_cipher->decrypt(buf, packet.get_packet_size() - sizeof(RelayForwardMsg));
 				}
 
 				if (m_enable_statistics) {
@@ -369,9 +510,7 @@ private:
 
 		if (m_encryptMode)
 		{
-			DH_generate_key_pair(pipe->m_publicKey, pipe->m_privateKey);
-			delete pipe->m_encrypt; pipe->m_encrypt = nullptr;
-			delete pipe->m_decrypt; pipe->m_decrypt = nullptr;
+			delete pipe->m_cipher; pipe->m_cipher = nullptr;
 		}
 
 		//reset down state 
@@ -457,7 +596,7 @@ private:
 			msg.id = session->m_id;
 			msg.size = (int32_t)msgSize;
 
-			size_t buf_round_size = m_encryptMode ? _round16(msgSize) : msgSize;
+			size_t buf_round_size = m_encryptMode ? pipe->m_cipher->get_wire_size(msgSize) : msgSize;
 			CY_LOG(L_TRACE, "[%d]receive from UP(%zd/%zd), send to DOWN after encrypt", msg.id, (size_t)msg.size, buf_round_size);
 
 			Packet packet;
@@ -469,7 +608,7 @@ private:
 			uint8_t* buf = (uint8_t*)packet.get_packet_content() + sizeof(RelayForwardMsg);
 			if (m_encryptMode)
 			{
-				pipe->m_encrypt->encrypt(buf, buf, buf_round_size);
+				pipe->m_cipher->encrypt(buf, buf_round_size);
 			}
 
 			if (m_enable_statistics) {
@@ -503,10 +642,50 @@ private:
 
 private:
 	//-------------------------------------------------------------------------------------
-	size_t _round16(size_t size) {
-		return ((size & 0xF) == 0) ? size : ((size & (size_t)(~0xF)) + 0x10);
+	//return false if the message is not complete or the connection is shutdown
+	bool _onResume(TcpServer* server, RelayPipe* pipe, TcpConnectionPtr conn)
+	{
+		Packet resumePacket;
+		if (!resumePacket.build_from_ringbuf(RELAY_PACKET_HEADSIZE, conn->get_input_buf())) return false;
+
+		if (resumePacket.get_packet_size() != sizeof(RelayResumeMsg)) {
+			server->shutdown_connection(conn);
+			pipe->m_downState = kWaitConnecting;
+			return false;
+		}
+
+		RelayResumeMsg resume;
+		memcpy(&resume, resumePacket.get_packet_content(), sizeof(resume));
+
+		RelayResumeReplyMsg reply;
+		reply.accepted = 0;
+		relay_random(reply.random, RELAY_RANDOM_SIZE);
+
+		dhkey_t ticketSecret;
+		int32_t cipher = 0;
+		if (m_ticketKeys && m_ticketKeys->open(resume.ticket, ticketSecret, cipher) && cipher == resume.cipher) {
+			relay_resume_key(pipe->m_secretKey, ticketSecret, resume.random, reply.random);
+			pipe->m_cipher = new RelayCipher(cipher, pipe->m_secretKey, false);
+			reply.accepted = 1;
+
+			memset(ticketSecret.bytes, 0, DH_KEY_LENGTH);
+			memset(pipe->m_secretKey.bytes, 0, DH_KEY_LENGTH);
+		}
+
+		resumePacket.build_from_memory((size_t)RELAY_PACKET_HEADSIZE, (uint16_t)RelayResumeReplyMsg::ID, sizeof(reply), (const char*)&reply);
+		conn->send(resumePacket.get_memory_buf(), resumePacket.get_memory_size());
+
+		if (reply.accepted) {
+			pipe->m_downState = kHandshaked;
+			CY_LOG(L_DEBUG, "Down client resumed(%s:%d), cipher %s", conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port(), relay_cipher_name(cipher));
+		}
+		else {
+			//wait the full handshake
+			CY_LOG(L_DEBUG, "Down client ticket rejected(%s:%d)", conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port());
+		}
+		return true;
 	}
-	
+
 	//-------------------------------------------------------------------------------------
 	void _kickDownSession(RelayPipe* pipe, int32_t session_id, RelaySessionPtr session) {
 		if (pipe->m_downState != kHandshaked) return;
@@ -526,17 +705,24 @@ private:
 	}
 
 public:
-	RelayServer(bool encryptMode, bool enableStatistics)
+	RelayServer(bool encryptMode, int32_t ticketLifetime, bool enableStatistics)
 		: m_encryptMode(encryptMode)
+		, m_dhPool(nullptr)
+		, m_ticketKeys(nullptr)
 		, m_enable_statistics(enableStatistics)
 		, m_up_total(0)
 		, m_up_statistics(kSpeedTimePeriod)
 		, m_down_total(0)
 		, m_down_statistics(kSpeedTimePeriod)
 	{
+		//key pairs are generated in background, the handshake only takes one
+		if (m_encryptMode) m_dhPool = new DHKeyPairPool();
+		if (m_encryptMode && ticketLifetime > 0) m_ticketKeys = new RelayTicketKeys(ticketLifetime);
 	}
 	~RelayServer() 
 	{
+		delete m_dhPool; m_dhPool = nullptr;
+		delete m_ticketKeys; m_ticketKeys = nullptr;
 	}
 };
 
@@ -550,6 +736,7 @@ static void printUsage(const char* moduleName)
 	printf("\t -up UP_PORT\tUp Server(Target Server) Port\n");
 	printf("\t -t THREAD_COUNTS\tWork thread counts(must be 1 when relay_pipe used)\n");
 	printf("\t -e\t\tEncrypt Message\n");
+	printf("\t -tl TICKET_LIFETIME\tLifetime of session resumption ticket in seconds, 0 to disable, Default 3600\n");
 	printf("\t -s\t\tPrint speed statistics\n");
 	printf("\t -v\t\tVerbose Mode\n");
 	printf("\t --help -?\tShow this help\n");
@@ -565,6 +752,7 @@ int main(int argc, char* argv[])
 	uint16_t up_port = 0;
 	bool verbose_mode = false;
 	bool encrypt_mode = false;
+	int32_t ticket_lifetime = 3600;
 	int32_t work_thread_counts = sys_api::get_cpu_counts();
 	bool enable_statistics = false;
 
@@ -589,6 +777,9 @@ int main(int argc, char* argv[])
 			else if (args.OptionId() == OPT_ENCRYPT_MODE) {
 				encrypt_mode = true;
 			}
+			else if (args.OptionId() == OPT_TICKET_LIFETIME) {
+				ticket_lifetime = (int32_t)atoi(args.OptionArg());
+			}
 			else if (args.OptionId() == OPT_VERBOSE_MODE) {
 				verbose_mode = true;
 			}
@@ -611,10 +802,11 @@ int main(int argc, char* argv[])
 	CY_LOG(L_DEBUG, "listen port %d", local_port);
 	CY_LOG(L_DEBUG, "final up address %s:%d", up_ip.c_str(), up_port);
 	CY_LOG(L_DEBUG, "encrypt mode %s", encrypt_mode?"true":"false");
+	if (encrypt_mode) CY_LOG(L_DEBUG, "ticket lifetime %d seconds", ticket_lifetime);
 	CY_LOG(L_DEBUG, "work thread counts %d", work_thread_counts);
 	CY_LOG(L_DEBUG, "speed statistics: %s", enable_statistics?"true":"false");
 
-	RelayServer server(encrypt_mode, enable_statistics);
+	RelayServer server(encrypt_mode, ticket_lifetime, enable_statistics);
 	server.startAndJoin(local_port, Address(up_ip.c_str(), up_port), work_thread_counts);
 	return 0;
 }
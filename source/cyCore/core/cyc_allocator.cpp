@@ -0,0 +1,534 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include "cyc_allocator.h"
+
+#ifdef CY_SYS_LINUX
+#include <sys/mman.h>
+#endif
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+namespace {
+
+//threads share the slots, a slot is reused after its thread exit.
+//the thread without slot(too many threads, or in thread exit progress) uses the shared slot
+enum { kMaxThreadSlots = 256, kSharedSlot = kMaxThreadSlots };
+
+//-------------------------------------------------------------------------------------
+struct ThreadSlotTable
+{
+	sys_api::mutex_t lock;
+	bool used[kMaxThreadSlots];
+
+	ThreadSlotTable()
+	{
+		lock = sys_api::mutex_create();
+		for (int32_t i = 0; i < kMaxThreadSlots; i++) used[i] = false;
+	}
+
+	int32_t acquire(void)
+	{
+		sys_api::auto_mutex guard(lock);
+		for (int32_t i = 0; i < kMaxThreadSlots; i++) {
+			if (!used[i]) {
+				used[i] = true;
+				return i;
+			}
+		}
+		return kSharedSlot;
+	}
+
+	void release(int32_t index)
+	{
+		if (index == kSharedSlot) return;
+
+		sys_api::auto_mutex guard(lock);
+		used[index] = false;
+	}
+};
+
+//-------------------------------------------------------------------------------------
+ThreadSlotTable& _get_slot_table(void)
+{
+	static ThreadSlotTable table;
+	return table;
+}
+
+//-------------------------------------------------------------------------------------
+struct ThreadSlot
+{
+	int32_t index;
+
+	ThreadSlot() : index(_get_slot_table().acquire()) {}
+	~ThreadSlot();
+};
+
+static thread_local bool s_slot_released = false;
+static thread_local ThreadSlot s_thread_slot;
+
+//-------------------------------------------------------------------------------------
+ThreadSlot::~ThreadSlot()
+{
+	s_slot_released = true;
+	_get_slot_table().release(index);
+	index = kSharedSlot;
+}
+
+//-------------------------------------------------------------------------------------
+static int32_t _get_thread_slot(void)
+{
+	return s_slot_released ? (int32_t)kSharedSlot : s_thread_slot.index;
+}
+
+}
+
+namespace memory
+{
+
+//-------------------------------------------------------------------------------------
+namespace {
+
+enum { kHeaderMagic = 0x43594D48 };	//"CYMH"
+
+struct alignas(16) BlockHeader
+{
+	size_t size;
+	int32_t tag;
+	uint32_t magic;
+};
+
+//-------------------------------------------------------------------------------------
+// counters of one thread slot, only written by the thread which owns the slot
+struct alignas(64) SlotStats
+{
+	std::atomic<int64_t> alloc_counts[kTagCounts];
+	std::atomic<int64_t> free_counts[kTagCounts];
+	std::atomic<int64_t> bytes[kTagCounts];
+};
+
+struct MemoryDomain
+{
+	SystemAllocator system_allocator;
+	std::atomic<Allocator*> allocator;
+	atomic_bool_t allocated;
+
+	SlotStats stats[kMaxThreadSlots + 1];
+
+	MemoryDomain() : allocator(&system_allocator), allocated(false)
+	{
+		for (int32_t i = 0; i <= kMaxThreadSlots; i++) {
+			for (int32_t t = 0; t < kTagCounts; t++) {
+				stats[i].alloc_counts[t].store(0, std::memory_order_relaxed);
+				stats[i].free_counts[t].store(0, std::memory_order_relaxed);
+				stats[i].bytes[t].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+//-------------------------------------------------------------------------------------
+MemoryDomain& _get_domain(void)
+{
+	static MemoryDomain domain;
+	return domain;
+}
+
+//-------------------------------------------------------------------------------------
+inline void _add_counter(std::atomic<int64_t>& counter, int64_t value, bool shared)
+{
+	if (shared) {
+		counter.fetch_add(value, std::memory_order_relaxed);
+	}
+	else {
+		//only the owner thread write it, no need atomic add
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+void* allocate(size_t size, int32_t tag)
+{
+	if (tag < 0 || tag >= kTagCounts) tag = kTagDefault;
+
+	MemoryDomain& domain = _get_domain();
+	if (!domain.allocated.load(std::memory_order_relaxed)) domain.allocated = true;
+
+	BlockHeader* header = (BlockHeader*)domain.allocator.load(std::memory_order_acquire)->allocate(sizeof(BlockHeader) + size);
+	if (header == nullptr) return nullptr;
+
+	header->size = size;
+	header->tag = tag;
+	header->magic = kHeaderMagic;
+
+	int32_t slot = _get_thread_slot();
+	SlotStats& stats = domain.stats[slot];
+	_add_counter(stats.alloc_counts[tag], 1, slot == kSharedSlot);
+	_add_counter(stats.bytes[tag], (int64_t)size, slot == kSharedSlot);
+
+	return header + 1;
+}
+
+//-------------------------------------------------------------------------------------
+void deallocate(void* p)
+{
+	if (p == nullptr) return;
+
+	BlockHeader* header = (BlockHeader*)p - 1;
+	assert(header->magic == kHeaderMagic);
+	header->magic = 0;
+
+	MemoryDomain& domain = _get_domain();
+	int32_t slot = _get_thread_slot();
+	SlotStats& stats = domain.stats[slot];
+	_add_counter(stats.free_counts[header->tag], 1, slot == kSharedSlot);
+	_add_counter(stats.bytes[header->tag], -(int64_t)header->size, slot == kSharedSlot);
+
+	domain.allocator.load(std::memory_order_acquire)->deallocate(header, sizeof(BlockHeader) + header->size);
+}
+
+//-------------------------------------------------------------------------------------
+void set_tag(void* p, int32_t tag)
+{
+	if (p == nullptr) return;
+	if (tag < 0 || tag >= kTagCounts) tag = kTagDefault;
+
+	BlockHeader* header = (BlockHeader*)p - 1;
+	assert(header->magic == kHeaderMagic);
+	if (header->tag == tag) return;
+
+	MemoryDomain& domain = _get_domain();
+	int32_t slot = _get_thread_slot();
+	SlotStats& stats = domain.stats[slot];
+	_add_counter(stats.free_counts[header->tag], 1, slot == kSharedSlot);
+	_add_counter(stats.bytes[header->tag], -(int64_t)header->size, slot == kSharedSlot);
+	_add_counter(stats.alloc_counts[tag], 1, slot == kSharedSlot);
+	_add_counter(stats.bytes[tag], (int64_t)header->size, slot == kSharedSlot);
+	header->tag = tag;
+}
+
+//-------------------------------------------------------------------------------------
+bool set_allocator(Allocator* allocator)
+{
+	MemoryDomain& domain = _get_domain();
+	if (domain.allocated.load()) return false;
+
+	domain.allocator = (allocator != nullptr) ? allocator : &(domain.system_allocator);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+Allocator* get_allocator(void)
+{
+	return _get_domain().allocator.load();
+}
+
+//-------------------------------------------------------------------------------------
+TagStats get_tag_stats(int32_t tag)
+{
+	TagStats tag_stats = { 0, 0, 0 };
+	if (tag < 0 || tag >= kTagCounts) return tag_stats;
+
+	MemoryDomain& domain = _get_domain();
+	for (int32_t i = 0; i <= kMaxThreadSlots; i++) {
+		tag_stats.alloc_counts += domain.stats[i].alloc_counts[tag].load(std::memory_order_relaxed);
+		tag_stats.free_counts += domain.stats[i].free_counts[tag].load(std::memory_order_relaxed);
+		tag_stats.bytes += domain.stats[i].bytes[tag].load(std::memory_order_relaxed);
+	}
+	return tag_stats;
+}
+
+//-------------------------------------------------------------------------------------
+const char* get_tag_name(int32_t tag)
+{
+	static const char* kTagNames[kTagCounts] = { "default", "ringbuf", "packet", "connection", "logger", "datagram" };
+	return (tag >= 0 && tag < kTagCounts) ? kTagNames[tag] : "unknown";
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+namespace {
+
+enum { kMinClassShift = 4, kMaxClassShift = 16, kClassCounts = kMaxClassShift - kMinClassShift + 1 };
+static_assert((1 << kMinClassShift) == ArenaAllocator::kMinSmallSize, "min small size error");
+static_assert((1 << kMaxClassShift) == ArenaAllocator::kMaxSmallSize, "max small size error");
+
+struct Arena;
+
+//-------------------------------------------------------------------------------------
+struct FreeNode
+{
+	FreeNode* next;
+	int32_t class_index;
+};
+
+//-------------------------------------------------------------------------------------
+// at the beginning of every chunk
+struct alignas(64) ChunkHeader
+{
+	Arena* owner;
+};
+
+//-------------------------------------------------------------------------------------
+struct Arena
+{
+	FreeNode* free_lists[kClassCounts];
+	uint8_t* bump_cur;
+	uint8_t* bump_end;
+
+	//blocks freed by other threads, keep it away from the fields of owner thread
+	char _pad[64];
+	std::atomic<FreeNode*> remote_free;
+
+	Arena() : bump_cur(nullptr), bump_end(nullptr), remote_free(nullptr)
+	{
+		for (int32_t i = 0; i < kClassCounts; i++) free_lists[i] = nullptr;
+	}
+
+	void push_remote(FreeNode* node)
+	{
+		FreeNode* head = remote_free.load(std::memory_order_relaxed);
+		do {
+			node->next = head;
+		} while (!remote_free.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void collect_remote(void)
+	{
+		FreeNode* node = remote_free.exchange(nullptr, std::memory_order_acquire);
+		while (node) {
+			FreeNode* next = node->next;
+			node->next = free_lists[node->class_index];
+			free_lists[node->class_index] = node;
+			node = next;
+		}
+	}
+};
+
+//-------------------------------------------------------------------------------------
+static int32_t _get_class_index(size_t size)
+{
+	int32_t index = 0;
+	while (((size_t)ArenaAllocator::kMinSmallSize << index) < size) index++;
+	return index;
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+struct ArenaAllocator::Impl
+{
+	//the arena of every thread slot, created by the thread on first allocation
+	std::atomic<Arena*> arenas[kMaxThreadSlots + 1];
+	sys_api::mutex_t shared_lock;	//for shared slot
+
+	sys_api::mutex_t chunk_lock;
+	std::vector<std::pair<uint8_t*, bool>> chunks;	//<chunk, mapped by mmap>
+	std::atomic<size_t> arena_counts;
+	std::atomic<size_t> huge_page_chunks;
+	bool huge_page;
+
+	explicit Impl(bool _huge_page) : arena_counts(0), huge_page_chunks(0), huge_page(_huge_page)
+	{
+		for (int32_t i = 0; i <= kMaxThreadSlots; i++) arenas[i].store(nullptr, std::memory_order_relaxed);
+		shared_lock = sys_api::mutex_create();
+		chunk_lock = sys_api::mutex_create();
+	}
+
+	~Impl()
+	{
+		for (auto& c : chunks) _free_chunk(c.first, c.second);
+		for (int32_t i = 0; i <= kMaxThreadSlots; i++) delete arenas[i].load();
+		sys_api::mutex_destroy(chunk_lock);
+		sys_api::mutex_destroy(shared_lock);
+	}
+
+	Arena* get_arena(int32_t slot)
+	{
+		Arena* arena = arenas[slot].load(std::memory_order_acquire);
+		if (arena) return arena;
+
+		//only the thread owns the slot can create it(shared slot is created with shared_lock held)
+		arena = new Arena();
+		arenas[slot].store(arena, std::memory_order_release);
+		arena_counts++;
+		return arena;
+	}
+
+	uint8_t* alloc_chunk(void)
+	{
+		bool mapped = false;
+		uint8_t* chunk = nullptr;
+#ifdef CY_SYS_LINUX
+#ifdef MAP_HUGETLB
+		if (huge_page) {
+			//huge page mapping is aligned to huge page size
+			void* p = ::mmap(nullptr, kChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED && ((uintptr_t)p & (kChunkSize - 1)) == 0) {
+				chunk = (uint8_t*)p;
+				huge_page_chunks++;
+			}
+			else if (p != MAP_FAILED) {
+				::munmap(p, kChunkSize);
+			}
+		}
+#endif
+		if (chunk == nullptr) {
+			//map double size and trim to alignment
+			uint8_t* p = (uint8_t*)::mmap(nullptr, kChunkSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == (uint8_t*)MAP_FAILED) return nullptr;
+
+			chunk = (uint8_t*)(((uintptr_t)p + kChunkSize - 1) & ~((uintptr_t)kChunkSize - 1));
+			if (chunk > p) ::munmap(p, (size_t)(chunk - p));
+			if (chunk + kChunkSize < p + kChunkSize * 2) ::munmap(chunk + kChunkSize, (size_t)(p + kChunkSize * 2 - (chunk + kChunkSize)));
+#ifdef MADV_HUGEPAGE
+			if (huge_page) ::madvise(chunk, kChunkSize, MADV_HUGEPAGE);
+#endif
+		}
+		mapped = true;
+#elif defined(CY_SYS_WINDOWS)
+		chunk = (uint8_t*)::_aligned_malloc(kChunkSize, kChunkSize);
+#else
+		void* p = nullptr;
+		if (::posix_memalign(&p, kChunkSize, kChunkSize) == 0) chunk = (uint8_t*)p;
+#endif
+		if (chunk == nullptr) return nullptr;
+
+		sys_api::auto_mutex guard(chunk_lock);
+		chunks.push_back(std::make_pair(chunk, mapped));
+		return chunk;
+	}
+
+	static void _free_chunk(uint8_t* chunk, bool mapped)
+	{
+#ifdef CY_SYS_LINUX
+		if (mapped) {
+			::munmap(chunk, kChunkSize);
+			return;
+		}
+#else
+		(void)mapped;
+#endif
+#ifdef CY_SYS_WINDOWS
+		::_aligned_free(chunk);
+#else
+		::free(chunk);
+#endif
+	}
+
+	void* alloc_small(Arena* arena, int32_t class_index)
+	{
+		FreeNode*& head = arena->free_lists[class_index];
+		if (head == nullptr) arena->collect_remote();
+		if (head) {
+			FreeNode* node = head;
+			head = node->next;
+			return node;
+		}
+
+		size_t block_size = (size_t)kMinSmallSize << class_index;
+		if (arena->bump_cur == nullptr || (size_t)(arena->bump_end - arena->bump_cur) < block_size) {
+			//the rest of old chunk is abandoned
+			uint8_t* chunk = alloc_chunk();
+			if (chunk == nullptr) return nullptr;
+
+			((ChunkHeader*)chunk)->owner = arena;
+			arena->bump_cur = chunk + sizeof(ChunkHeader);
+			arena->bump_end = chunk + kChunkSize;
+		}
+
+		//keep block aligned with its size, up to 64 bytes
+		size_t align = std::min(block_size, (size_t)64);
+		arena->bump_cur = (uint8_t*)(((uintptr_t)arena->bump_cur + align - 1) & ~((uintptr_t)align - 1));
+		if ((size_t)(arena->bump_end - arena->bump_cur) < block_size) {
+			arena->bump_cur = nullptr;
+			return alloc_small(arena, class_index);
+		}
+
+		void* p = arena->bump_cur;
+		arena->bump_cur += block_size;
+		return p;
+	}
+};
+
+//-------------------------------------------------------------------------------------
+ArenaAllocator::ArenaAllocator(bool huge_page)
+	: m_impl(new Impl(huge_page))
+	, m_huge_page(huge_page)
+{
+}
+
+//-------------------------------------------------------------------------------------
+ArenaAllocator::~ArenaAllocator()
+{
+	delete m_impl;
+	m_impl = nullptr;
+}
+
+//-------------------------------------------------------------------------------------
+void* ArenaAllocator::allocate(size_t size)
+{
+	if (size > kMaxSmallSize) return ::malloc(size);
+
+	int32_t class_index = _get_class_index(size);
+	int32_t slot = _get_thread_slot();
+	if (slot != kSharedSlot) {
+		return m_impl->alloc_small(m_impl->get_arena(slot), class_index);
+	}
+
+	sys_api::auto_mutex guard(m_impl->shared_lock);
+	return m_impl->alloc_small(m_impl->get_arena(slot), class_index);
+}
+
+//-------------------------------------------------------------------------------------
+void ArenaAllocator::deallocate(void* p, size_t size)
+{
+	if (p == nullptr) return;
+	if (size > kMaxSmallSize) {
+		::free(p);
+		return;
+	}
+
+	ChunkHeader* chunk = (ChunkHeader*)((uintptr_t)p & ~((uintptr_t)kChunkSize - 1));
+	Arena* owner = chunk->owner;
+
+	FreeNode* node = (FreeNode*)p;
+	node->class_index = _get_class_index(size);
+
+	int32_t slot = _get_thread_slot();
+	if (slot != kSharedSlot && owner == m_impl->arenas[slot].load(std::memory_order_relaxed)) {
+		//free in owner thread
+		node->next = owner->free_lists[node->class_index];
+		owner->free_lists[node->class_index] = node;
+		return;
+	}
+
+	owner->push_remote(node);
+}
+
+//-------------------------------------------------------------------------------------
+size_t ArenaAllocator::get_arena_counts(void) const
+{
+	return m_impl->arena_counts.load();
+}
+
+//-------------------------------------------------------------------------------------
+size_t ArenaAllocator::get_chunk_bytes(void) const
+{
+	sys_api::auto_mutex guard(m_impl->chunk_lock);
+	return m_impl->chunks.size() * kChunkSize;
+}
+
+//-------------------------------------------------------------------------------------
+size_t ArenaAllocator::get_huge_page_chunks(void) const
+{
+	return m_impl->huge_page_chunks.load();
+}
+
+}
@@ -0,0 +1,133 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+
+namespace cyclone
+{
+
+// memory
+// ----------------
+// The allocator layer behind CY_MALLOC/CY_FREE.
+//
+// - Every block carries a small header with its size and a subsystem tag, the
+//   allocation counts and bytes of every tag are counted per thread and summed
+//   by get_tag_stats(), so memory can be attributed to RingBuf, Packet, etc.
+// - The backend is pluggable, call set_allocator() at init before the first
+//   allocation. The default backend is the system allocator(malloc/free).
+//
+namespace memory
+{
+
+enum Tag
+{
+	kTagDefault = 0,
+	kTagRingBuf,
+	kTagPacket,
+	kTagConnection,
+	kTagLogger,
+	kTagDatagram,
+
+	kTagCounts
+};
+
+struct TagStats
+{
+	int64_t alloc_counts;
+	int64_t free_counts;
+	int64_t bytes;			//bytes in use(header is not counted)
+};
+
+//backend interface, all functions must be thread safe
+class Allocator
+{
+public:
+	virtual const char* get_name(void) const = 0;
+	virtual void* allocate(size_t size) = 0;
+	/// `size` is the same value passed to allocate(), can be called in any thread
+	virtual void deallocate(void* p, size_t size) = 0;
+
+	virtual ~Allocator() {}
+};
+
+/// alloc memory with the tag (thread safe)
+void* allocate(size_t size, int32_t tag = kTagDefault);
+
+/// free memory allocated by allocate(), can be called in any thread (thread safe)
+void deallocate(void* p);
+
+/// move a block allocated by allocate() to another tag, it is counted as freed from the
+/// old tag and allocated by the new one, e.g. a pooled object waiting to be reused (thread safe)
+void set_tag(void* p, int32_t tag);
+
+/// set the backend, it must be called before any memory has been allocated,
+/// the allocator object must be valid until the process exit. return false if it's too late
+bool set_allocator(Allocator* allocator);
+
+/// get current backend (thread safe)
+Allocator* get_allocator(void);
+
+/// get the statistics of one tag (thread safe)
+TagStats get_tag_stats(int32_t tag);
+
+/// get the name of tag
+const char* get_tag_name(int32_t tag);
+
+}
+
+// SystemAllocator
+// ----------------
+// malloc/free of C runtime
+//
+class SystemAllocator : public memory::Allocator
+{
+public:
+	virtual const char* get_name(void) const { return "system"; }
+	virtual void* allocate(size_t size) { return ::malloc(size); }
+	virtual void deallocate(void* p, size_t) { ::free(p); }
+};
+
+// ArenaAllocator
+// ----------------
+// Per-thread arena allocator.
+//
+// - Small blocks(<= kMaxSmallSize) are carved from kChunkSize aligned chunks owned by
+//   one arena, every thread takes its own arena so allocation and same thread free
+//   take no lock.
+// - A block freed by another thread is pushed to the remote free list(lock-free) of
+//   the owner arena, and is collected by the owner on its next allocation.
+// - The arena of an exited thread is taken over by the next new thread.
+// - Chunks are kept by the arena and never returned to system. With huge_page=true
+//   chunks are mapped with MAP_HUGETLB, if the system has no reserved huge pages it
+//   falls back to transparent huge pages(madvise). linux only, ignored on other platforms.
+// - Bigger blocks go to malloc/free directly.
+//
+class ArenaAllocator : public memory::Allocator
+{
+public:
+	enum { kMinSmallSize = 16, kMaxSmallSize = 64 * 1024, kChunkSize = 2 * 1024 * 1024 };
+
+	virtual const char* get_name(void) const { return m_huge_page ? "arena(huge page)" : "arena"; }
+	virtual void* allocate(size_t size);
+	virtual void deallocate(void* p, size_t size);
+
+	/// counts of arenas and bytes of chunks (thread safe)
+	size_t get_arena_counts(void) const;
+	size_t get_chunk_bytes(void) const;
+
+	/// counts of chunks mapped with huge page (thread safe)
+	size_t get_huge_page_chunks(void) const;
+
+private:
+	struct Impl;
+	Impl* m_impl;
+	bool m_huge_page;
+
+public:
+	explicit ArenaAllocator(bool huge_page = false);
+	virtual ~ArenaAllocator();
+};
+
+}
@@ -0,0 +1,326 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include "cyc_buf_pool.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+namespace {
+
+enum { kMinClassShift = 6, kMaxClassShift = 20, kClassCounts = kMaxClassShift - kMinClassShift + 1 };
+static_assert((1 << kMinClassShift) == BufPool::kMinBlockSize, "min block size error");
+static_assert((1 << kMaxClassShift) == BufPool::kMaxBlockSize, "max block size error");
+
+//-------------------------------------------------------------------------------------
+struct FreeNode
+{
+	FreeNode* next;
+};
+
+//-------------------------------------------------------------------------------------
+struct ThreadStats
+{
+	std::atomic<size_t> pooled;
+	std::atomic<size_t> in_use;
+	std::atomic<size_t> high_water;
+	atomic_bool_t alive;
+
+	//blocks freed by other threads, collected by the owner thread when its free list is empty
+	std::atomic<FreeNode*> remote_head;
+	std::atomic<size_t> remote_bytes;
+
+	ThreadStats() : pooled(0), in_use(0), high_water(0), alive(true), remote_head(nullptr), remote_bytes(0) {}
+
+	bool push_remote(FreeNode* node, size_t block_size)
+	{
+		//the owner doesn't allocate any more
+		if (remote_bytes.fetch_add(block_size, std::memory_order_relaxed) + block_size > BufPool::kMaxPooledBytes) {
+			remote_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+			return false;
+		}
+
+		FreeNode* head = remote_head.load(std::memory_order_relaxed);
+		do {
+			node->next = head;
+		} while (!remote_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+		return true;
+	}
+
+	FreeNode* pop_all_remote(void)
+	{
+		return remote_head.exchange(nullptr, std::memory_order_acquire);
+	}
+};
+
+//-------------------------------------------------------------------------------------
+struct alignas(16) BlockHeader
+{
+	ThreadStats* owner;
+	uint32_t block_size;
+	int32_t tag;
+};
+
+//-------------------------------------------------------------------------------------
+// the stats object of every thread, it is never deleted because the blocks of an
+// exited thread may still be in use
+struct StatsRegistry
+{
+	sys_api::mutex_t lock;
+	std::vector<ThreadStats*> all_stats;
+
+	StatsRegistry() { lock = sys_api::mutex_create(); }
+
+	ThreadStats* acquire(void)
+	{
+		sys_api::auto_mutex guard(lock);
+		//reuse the slot of an exited thread if all of its blocks have been freed
+		for (auto stats : all_stats) {
+			if (!stats->alive.load() && stats->in_use.load() == 0) {
+				stats->high_water = 0;
+				stats->alive = true;
+				return stats;
+			}
+		}
+		ThreadStats* stats = new ThreadStats();
+		all_stats.push_back(stats);
+		return stats;
+	}
+
+	BufPool::Stats sum(void)
+	{
+		BufPool::Stats total = { 0, 0, 0 };
+
+		sys_api::auto_mutex guard(lock);
+		for (auto stats : all_stats) {
+			total.pooled += stats->pooled.load(std::memory_order_relaxed) + stats->remote_bytes.load(std::memory_order_relaxed);
+			total.in_use += stats->in_use.load(std::memory_order_relaxed);
+			total.high_water += stats->high_water.load(std::memory_order_relaxed);
+		}
+		return total;
+	}
+};
+
+//-------------------------------------------------------------------------------------
+StatsRegistry& _get_registry(void)
+{
+	static StatsRegistry registry;
+	return registry;
+}
+
+//-------------------------------------------------------------------------------------
+static int32_t _get_class_index(size_t block_size)
+{
+	int32_t index = 0;
+	while (((size_t)BufPool::kMinBlockSize << index) < block_size) index++;
+	return index;
+}
+
+//-------------------------------------------------------------------------------------
+struct ThreadCache
+{
+	FreeNode* free_lists[memory::kTagCounts][kClassCounts];
+	size_t pooled_bytes;
+	ThreadStats* stats;
+
+	ThreadCache() : pooled_bytes(0)
+	{
+		for (int32_t t = 0; t < memory::kTagCounts; t++) {
+			for (int32_t i = 0; i < kClassCounts; i++) free_lists[t][i] = nullptr;
+		}
+		stats = _get_registry().acquire();
+	}
+
+	~ThreadCache();
+
+	//move the blocks freed by other threads into the free lists
+	void collect_remote(void)
+	{
+		FreeNode* node = stats->pop_all_remote();
+		while (node) {
+			FreeNode* next = node->next;
+			BlockHeader* header = (BlockHeader*)node - 1;
+			size_t block_size = header->block_size;
+			stats->remote_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+
+			if (pooled_bytes + block_size <= BufPool::kMaxPooledBytes) {
+				FreeNode*& head = free_lists[header->tag][_get_class_index(block_size)];
+				node->next = head;
+				head = node;
+				pooled_bytes += block_size;
+			}
+			else {
+				CY_FREE(header);
+			}
+			node = next;
+		}
+		stats->pooled.store(pooled_bytes, std::memory_order_relaxed);
+	}
+
+	void trim(void)
+	{
+		//the blocks pushed after this are collected by next allocate
+		FreeNode* remote = stats->pop_all_remote();
+		while (remote) {
+			FreeNode* next = remote->next;
+			BlockHeader* header = (BlockHeader*)remote - 1;
+			stats->remote_bytes.fetch_sub(header->block_size, std::memory_order_relaxed);
+			CY_FREE(header);
+			remote = next;
+		}
+
+		for (int32_t t = 0; t < memory::kTagCounts; t++) {
+			for (int32_t i = 0; i < kClassCounts; i++) {
+				FreeNode* node = free_lists[t][i];
+				while (node) {
+					FreeNode* next = node->next;
+					CY_FREE((BlockHeader*)node - 1);
+					node = next;
+				}
+				free_lists[t][i] = nullptr;
+			}
+		}
+		pooled_bytes = 0;
+		stats->pooled.store(0, std::memory_order_relaxed);
+	}
+};
+
+//the cache object can't be touched after it is destroyed(thread exit)
+static thread_local bool s_cache_destroyed = false;
+static thread_local ThreadCache s_cache;
+
+//-------------------------------------------------------------------------------------
+ThreadCache::~ThreadCache()
+{
+	//the blocks freed by other threads after this go to their own free lists, the ones
+	//pushed in the meantime are collected by the next thread which reuses the stats
+	stats->alive = false;
+	trim();
+	s_cache_destroyed = true;
+}
+
+//-------------------------------------------------------------------------------------
+static ThreadCache* _get_cache(void)
+{
+	return s_cache_destroyed ? nullptr : &s_cache;
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+void* BufPool::allocate(size_t size, size_t* block_size, int32_t tag)
+{
+	assert(size <= std::numeric_limits<uint32_t>::max());
+	if (tag < 0 || tag >= memory::kTagCounts) tag = memory::kTagDefault;
+
+	size_t real_size = kMinBlockSize;
+	while (real_size < size) real_size *= 2;
+
+	ThreadCache* cache = _get_cache();
+
+	BlockHeader* header = nullptr;
+	if (cache && real_size <= kMaxBlockSize) {
+		FreeNode*& head = cache->free_lists[tag][_get_class_index(real_size)];
+		if (head == nullptr && cache->stats->remote_head.load(std::memory_order_relaxed)) {
+			cache->collect_remote();
+		}
+		if (head) {
+			header = (BlockHeader*)head - 1;
+			head = head->next;
+			cache->pooled_bytes -= real_size;
+			cache->stats->pooled.store(cache->pooled_bytes, std::memory_order_relaxed);
+		}
+	}
+
+	if (header == nullptr) {
+		//big block keep the request size
+		if (real_size > kMaxBlockSize) real_size = size;
+		header = (BlockHeader*)CY_MALLOC_TAG(sizeof(BlockHeader) + real_size, tag);
+	}
+
+	//the stats of exited thread is not counted
+	header->owner = cache ? cache->stats : nullptr;
+	header->block_size = (uint32_t)real_size;
+	header->tag = tag;
+
+	if (cache) {
+		ThreadStats* stats = cache->stats;
+		size_t in_use = stats->in_use.fetch_add(real_size, std::memory_order_relaxed) + real_size;
+		if (in_use > stats->high_water.load(std::memory_order_relaxed)) {
+			stats->high_water.store(in_use, std::memory_order_relaxed);
+		}
+	}
+
+	if (block_size) *block_size = real_size;
+	return header + 1;
+}
+
+//-------------------------------------------------------------------------------------
+void BufPool::deallocate(void* p)
+{
+	if (p == nullptr) return;
+
+	BlockHeader* header = (BlockHeader*)p - 1;
+	size_t block_size = header->block_size;
+	if (header->owner) {
+		header->owner->in_use.fetch_sub(block_size, std::memory_order_relaxed);
+	}
+
+	ThreadCache* cache = _get_cache();
+	if (block_size > kMaxBlockSize) {
+		CY_FREE(header);
+		return;
+	}
+
+	//return it to the thread which allocated it, so the thread only frees blocks(for example
+	//the worker of packets built in master thread) doesn't keep them
+	ThreadStats* owner = header->owner;
+	if (owner && (cache == nullptr || owner != cache->stats) && owner->alive.load()) {
+		if (!owner->push_remote((FreeNode*)p, block_size)) CY_FREE(header);
+		return;
+	}
+
+	//keep it in the free list of current thread
+	if (cache && cache->pooled_bytes + block_size <= kMaxPooledBytes) {
+		FreeNode*& head = cache->free_lists[header->tag][_get_class_index(block_size)];
+		FreeNode* node = (FreeNode*)p;
+		node->next = head;
+		head = node;
+		cache->pooled_bytes += block_size;
+		cache->stats->pooled.store(cache->pooled_bytes, std::memory_order_relaxed);
+		return;
+	}
+
+	CY_FREE(header);
+}
+
+//-------------------------------------------------------------------------------------
+void BufPool::trim(void)
+{
+	ThreadCache* cache = _get_cache();
+	if (cache) cache->trim();
+}
+
+//-------------------------------------------------------------------------------------
+BufPool::Stats BufPool::get_thread_stats(void)
+{
+	Stats stats = { 0, 0, 0 };
+
+	ThreadCache* cache = _get_cache();
+	if (cache == nullptr) return stats;
+
+	stats.pooled = cache->stats->pooled.load(std::memory_order_relaxed) + cache->stats->remote_bytes.load(std::memory_order_relaxed);
+	stats.in_use = cache->stats->in_use.load(std::memory_order_relaxed);
+	stats.high_water = cache->stats->high_water.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//-------------------------------------------------------------------------------------
+BufPool::Stats BufPool::get_total_stats(void)
+{
+	return _get_registry().sum();
+}
+
+}
@@ -0,0 +1,58 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+#include "cyc_allocator.h"
+
+namespace cyclone
+{
+
+// BufPool
+// ----------------
+// Per-thread, size-class memory pool for byte buffers(the storage of RingBuf, Packet...).
+//
+// - Block sizes are power of two, from kMinBlockSize to kMaxBlockSize, bigger
+//   request goes to CY_MALLOC directly.
+// - Every thread keeps its own free lists for every memory tag, allocate()/deallocate()
+//   take no lock.
+// - A block can be freed in any thread, the one freed by another thread is pushed to a
+//   lock-free list of the thread which allocated it, and moved to its free lists when
+//   they are empty. If the allocating thread has exited, the block goes to the free list
+//   of the thread which frees it.
+// - The pooled memory of one thread is limited to kMaxPooledBytes, so is the list of the
+//   blocks freed by other threads, the extra blocks are returned to system.
+// - Every block remembers the thread which allocated it, so the in-use bytes are
+//   counted to the right thread even if the block is freed by another thread.
+//
+class BufPool
+{
+public:
+	enum { kMinBlockSize = 64, kMaxBlockSize = 1024 * 1024, kMaxPooledBytes = 4 * 1024 * 1024 };
+
+	struct Stats
+	{
+		size_t pooled;		//bytes in free lists of this thread
+		size_t in_use;		//bytes allocated by this thread and not freed
+		size_t high_water;	//max value of in_use
+	};
+
+	/// alloc a block at least `size` bytes, the real size of the block is returned by
+	/// `block_size` if it is not null, `tag` is the memory tag of the block (thread safe)
+	static void* allocate(size_t size, size_t* block_size = nullptr, int32_t tag = memory::kTagRingBuf);
+
+	/// free a block allocated by allocate(), can be called in any thread (thread safe)
+	static void deallocate(void* p);
+
+	/// return all pooled blocks of current thread to system (thread safe)
+	static void trim(void);
+
+	/// get the statistics of current thread (thread safe)
+	static Stats get_thread_stats(void);
+
+	/// get the sum of statistics of all threads (thread safe)
+	static Stats get_total_stats(void);
+};
+
+}
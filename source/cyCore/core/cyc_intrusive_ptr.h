@@ -0,0 +1,188 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+
+namespace cyclone
+{
+
+// RefCounted
+// ----------------
+// Intrusive reference counter base class (CRTP), the object is deleted when
+// the last reference is released.
+//
+// Two kinds of reference are supported:
+// - shared reference(IntrusivePtr), atomic counting, can be copied and
+//   released in any thread.
+// - local reference(LocalPtr), non-atomic counting, MUST be used in the thread
+//   which owns the object(for example the looper thread of a connection).
+//   All local references together hold only ONE shared reference, so copying
+//   a LocalPtr inside the owner thread never touches the atomic counter.
+//
+template<typename T>
+class RefCounted
+{
+public:
+	void add_ref(void) const {
+		m_refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void release(void) const {
+		if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			delete static_cast<T*>(const_cast<RefCounted*>(this));
+		}
+	}
+
+	//// local reference(NOT thread safe, call it in the owner thread only)
+	void add_local_ref(void) const {
+		if (m_local_refs++ == 0) add_ref();
+	}
+
+	void release_local(void) const {
+		assert(m_local_refs > 0);
+		if (--m_local_refs == 0) release();
+	}
+
+	//// get shared reference counts, all local references count as one(thread safe)
+	int32_t get_ref_counts(void) const { return m_refs.load(std::memory_order_relaxed); }
+
+	//// get local reference counts(NOT thread safe)
+	int32_t get_local_ref_counts(void) const { return m_local_refs; }
+
+protected:
+	RefCounted() : m_refs(0), m_local_refs(0) {}
+	~RefCounted() {}
+
+	RefCounted(const RefCounted&) = delete;
+	RefCounted& operator=(const RefCounted&) = delete;
+
+private:
+	mutable std::atomic<int32_t> m_refs;
+	mutable int32_t m_local_refs;
+};
+
+// IntrusivePtr: thread safe handle of RefCounted object, same usage as std::shared_ptr
+template<typename T>
+class IntrusivePtr
+{
+public:
+	T* get(void) const { return m_ptr; }
+	T* operator->(void) const { assert(m_ptr); return m_ptr; }
+	T& operator*(void) const { assert(m_ptr); return *m_ptr; }
+	explicit operator bool(void) const { return m_ptr != nullptr; }
+
+	void reset(void) {
+		IntrusivePtr().swap(*this);
+	}
+
+	void swap(IntrusivePtr& other) {
+		std::swap(m_ptr, other.m_ptr);
+	}
+
+	IntrusivePtr& operator=(const IntrusivePtr& other) {
+		IntrusivePtr(other).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(IntrusivePtr&& other) {
+		IntrusivePtr(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	IntrusivePtr& operator=(std::nullptr_t) {
+		reset();
+		return *this;
+	}
+
+public:
+	IntrusivePtr() : m_ptr(nullptr) {}
+	IntrusivePtr(std::nullptr_t) : m_ptr(nullptr) {}
+	explicit IntrusivePtr(T* p) : m_ptr(p) { if (m_ptr) m_ptr->add_ref(); }
+	IntrusivePtr(const IntrusivePtr& other) : m_ptr(other.m_ptr) { if (m_ptr) m_ptr->add_ref(); }
+	IntrusivePtr(IntrusivePtr&& other) : m_ptr(other.m_ptr) { other.m_ptr = nullptr; }
+	~IntrusivePtr() { if (m_ptr) m_ptr->release(); }
+
+private:
+	T* m_ptr;
+};
+
+// LocalPtr: thread confined handle of RefCounted object, NOT thread safe.
+// It converts to IntrusivePtr automatically when the object escapes to other thread.
+template<typename T>
+class LocalPtr
+{
+public:
+	T* get(void) const { return m_ptr; }
+	T* operator->(void) const { assert(m_ptr); return m_ptr; }
+	T& operator*(void) const { assert(m_ptr); return *m_ptr; }
+	explicit operator bool(void) const { return m_ptr != nullptr; }
+
+	//// escape to a shared handle
+	operator IntrusivePtr<T>(void) const { return IntrusivePtr<T>(m_ptr); }
+
+	void reset(void) {
+		LocalPtr().swap(*this);
+	}
+
+	void swap(LocalPtr& other) {
+		std::swap(m_ptr, other.m_ptr);
+	}
+
+	LocalPtr& operator=(const LocalPtr& other) {
+		LocalPtr(other).swap(*this);
+		return *this;
+	}
+
+	LocalPtr& operator=(LocalPtr&& other) {
+		LocalPtr(std::move(other)).swap(*this);
+		return *this;
+	}
+
+public:
+	LocalPtr() : m_ptr(nullptr) {}
+	LocalPtr(std::nullptr_t) : m_ptr(nullptr) {}
+	explicit LocalPtr(T* p) : m_ptr(p) { if (m_ptr) m_ptr->add_local_ref(); }
+	explicit LocalPtr(const IntrusivePtr<T>& other) : m_ptr(other.get()) { if (m_ptr) m_ptr->add_local_ref(); }
+	LocalPtr(const LocalPtr& other) : m_ptr(other.m_ptr) { if (m_ptr) m_ptr->add_local_ref(); }
+	LocalPtr(LocalPtr&& other) : m_ptr(other.m_ptr) { other.m_ptr = nullptr; }
+	~LocalPtr() { if (m_ptr) m_ptr->release_local(); }
+
+private:
+	T* m_ptr;
+};
+
+//-------------------------------------------------------------------------------------
+template<typename T, typename U>
+inline bool operator==(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) { return a.get() == b.get(); }
+template<typename T, typename U>
+inline bool operator!=(const IntrusivePtr<T>& a, const IntrusivePtr<U>& b) { return a.get() != b.get(); }
+template<typename T>
+inline bool operator==(const IntrusivePtr<T>& a, std::nullptr_t) { return a.get() == nullptr; }
+template<typename T>
+inline bool operator!=(const IntrusivePtr<T>& a, std::nullptr_t) { return a.get() != nullptr; }
+template<typename T>
+inline bool operator==(std::nullptr_t, const IntrusivePtr<T>& a) { return a.get() == nullptr; }
+template<typename T>
+inline bool operator!=(std::nullptr_t, const IntrusivePtr<T>& a) { return a.get() != nullptr; }
+
+template<typename T, typename U>
+inline bool operator==(const LocalPtr<T>& a, const LocalPtr<U>& b) { return a.get() == b.get(); }
+template<typename T, typename U>
+inline bool operator!=(const LocalPtr<T>& a, const LocalPtr<U>& b) { return a.get() != b.get(); }
+template<typename T>
+inline bool operator==(const LocalPtr<T>& a, std::nullptr_t) { return a.get() == nullptr; }
+template<typename T>
+inline bool operator!=(const LocalPtr<T>& a, std::nullptr_t) { return a.get() != nullptr; }
+
+}
+
+namespace std {
+	template <typename T>
+	struct hash<cyclone::IntrusivePtr<T>> {
+		std::size_t operator()(const cyclone::IntrusivePtr<T>& p) const {
+			return std::hash<T*>()(p.get());
+		}
+	};
+}
@@ -31,10 +31,34 @@ namespace cyclone
 //   next node value before performing the CAS to advance the head. If CAS
 //   fails the read is discarded. Because ELEM_T is required to be cheap to
 //   copy/move this tradeoff is acceptable.
+// - The hot fields(heads, tail, size) are kept in different cache lines to
+//   avoid false sharing between producers and consumers.
 //
+// The queue mode is selected by template parameter Q_MODE:
+// - kLFQueueMPMC: multiple producers and multiple consumers, the node pool
+//   implementation above (default).
+// - kLFQueueMPSC: multiple producers and ONE consumer, a bounded ring(Vyukov
+//   style), every slot has a sequence number, push takes one CAS and pop takes
+//   none. Q_SIZE must be power of 2.
+// - kLFQueueSPSC: ONE producer and ONE consumer, a bounded ring without CAS,
+//   every side caches the index of the other side. Q_SIZE must be power of 2.
+// The ring queues can hold Q_SIZE elements, the MPMC queue holds Q_SIZE-1
+// elements(one node is the sentinel).
+//
+// push_bulk()/pop_bulk() move many elements in one call, the ring queues
+// claim all slots with one atomic operation.
+//
+
+enum LockFreeQueueMode
+{
+	kLFQueueMPMC = 0,
+	kLFQueueMPSC,
+	kLFQueueSPSC
+};
 
+enum { kCacheLineSize = 64 };
 
-template <typename ELEM_T, int32_t Q_SIZE = 65536>  
+template <typename ELEM_T, int32_t Q_SIZE = 65536, int32_t Q_MODE = kLFQueueMPMC>
 class LockFreeQueue
 {
 public:
@@ -63,6 +87,14 @@ public:
 	// the queue is empty.
 	bool pop(ELEM_T &data);
 
+	// Enqueue `counts` elements in order. Returns the number of elements
+	// pushed, it is less than `counts` if the queue is full.
+	size_t push_bulk(const ELEM_T* data, size_t counts);
+
+	// Dequeue at most `max_counts` elements. Returns the number of elements
+	// popped.
+	size_t pop_bulk(ELEM_T* data, size_t max_counts);
+
 	// Approximate size (may be slightly stale under concurrency).
 	size_t size() const {
 		return m_size.load(std::memory_order_acquire);
@@ -81,11 +113,16 @@ private:
 	};
 
 private:
-	// Head and tail of the queue (both TaggedIndex to mitigate ABA on updates).
+	// Head and tail of the queue (both TaggedIndex to mitigate ABA on updates),
+	// every hot field takes its own cache line.
+	char _pad0[kCacheLineSize];
 	std::atomic<TaggedIndex> m_head;
+	char _pad1[kCacheLineSize - sizeof(TaggedIndex)];
 	std::atomic<TaggedIndex> m_tail;
+	char _pad2[kCacheLineSize - sizeof(TaggedIndex)];
 	// Approximate number of elements in the queue.
 	std::atomic<size_t> m_size;
+	char _pad3[kCacheLineSize - sizeof(size_t)];
 
 private:
 	// Helpers to pack/unpack a TaggedIndex composed of (tag, index).
@@ -109,6 +146,7 @@ private:
 
 	// Pool head uses TaggedIndex (tag + index) to mitigate ABA on the free list.
 	std::atomic<TaggedIndex> m_poolHead;
+	char _pad4[kCacheLineSize - sizeof(TaggedIndex)];
 	// Fixed-size node pool storage.
 	Node m_nodePool[size_t(Q_SIZE)];
 
@@ -126,8 +164,8 @@ public:
 // - Initializes the internal free pool as a singly-linked list of indices
 //   (m_nodePool[Q_SIZE-1] -> ... -> m_nodePool[0]). Then alloc() is called
 //   to remove one node to use as the dummy sentinel for the MS queue.
-template <typename ELEM_T, int32_t Q_SIZE>
-LockFreeQueue<ELEM_T, Q_SIZE>::LockFreeQueue()
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::LockFreeQueue()
 {
 	//init memory pool
 	for (int32_t i = 0; i < Q_SIZE; ++i)
@@ -151,8 +189,8 @@ LockFreeQueue<ELEM_T, Q_SIZE>::LockFreeQueue()
 // Destructor
 // - Does not attempt to destroy elements or drain the queue. ELEM_T must be
 //   trivially destructible per class constraints.
-template <typename ELEM_T, int32_t Q_SIZE>
-LockFreeQueue<ELEM_T, Q_SIZE>::~LockFreeQueue()
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::~LockFreeQueue()
 {
 
 }
@@ -165,8 +203,8 @@ LockFreeQueue<ELEM_T, Q_SIZE>::~LockFreeQueue()
 //   the approximate size.
 // Note: element assignment must not throw (enforced by static_assert) to
 // avoid leaking the allocated node.
-template <typename ELEM_T, int32_t Q_SIZE>
-bool LockFreeQueue<ELEM_T, Q_SIZE>::push(const ELEM_T& data)
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+bool LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::push(const ELEM_T& data)
 {
 	int32_t newIdx = alloc();
 	if(newIdx < 0 || newIdx >= Q_SIZE) return false; //queue full	
@@ -220,8 +258,8 @@ bool LockFreeQueue<ELEM_T, Q_SIZE>::push(const ELEM_T& data)
 //   pool and return the read value.
 // - The implementation reads the node value before advancing head (optimistic
 //   read). If CAS fails the read is discarded and the operation is retried.
-template <typename ELEM_T, int32_t Q_SIZE>
-bool LockFreeQueue<ELEM_T, Q_SIZE>::pop(ELEM_T& data)
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+bool LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::pop(ELEM_T& data)
 {
 	for (;;) 
 	{
@@ -269,11 +307,29 @@ bool LockFreeQueue<ELEM_T, Q_SIZE>::pop(ELEM_T& data)
 	}
 }
 
+// push_bulk/pop_bulk
+// - The node pool queue has no cheaper way than one by one.
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+size_t LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::push_bulk(const ELEM_T* data, size_t counts)
+{
+	size_t pushed = 0;
+	while (pushed < counts && push(data[pushed])) pushed++;
+	return pushed;
+}
+
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+size_t LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::pop_bulk(ELEM_T* data, size_t max_counts)
+{
+	size_t popped = 0;
+	while (popped < max_counts && pop(data[popped])) popped++;
+	return popped;
+}
+
 // alloc
 // - Pop an index from the internal free pool (m_poolHead). Returns
 //   kEmptyIndex if the pool is empty.
-template <typename ELEM_T, int32_t Q_SIZE>
-int32_t LockFreeQueue<ELEM_T, Q_SIZE>::alloc() 
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+int32_t LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::alloc() 
 {
 	for (;;) 
 	{
@@ -296,8 +352,8 @@ int32_t LockFreeQueue<ELEM_T, Q_SIZE>::alloc()
 // - Push an index back to the internal free pool (m_poolHead) using a
 //   lock-free CAS loop. The node's next field is set to the current head
 //   index before the CAS.
-template <typename ELEM_T, int32_t Q_SIZE>
-void LockFreeQueue<ELEM_T, Q_SIZE>::free(int32_t idx)
+template <typename ELEM_T, int32_t Q_SIZE, int32_t Q_MODE>
+void LockFreeQueue<ELEM_T, Q_SIZE, Q_MODE>::free(int32_t idx)
 {
 	if (idx < 0 || idx >= Q_SIZE) return;
 
@@ -317,4 +373,236 @@ void LockFreeQueue<ELEM_T, Q_SIZE>::free(int32_t idx)
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//MPSC
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Bounded ring for multiple producers and ONE consumer (Vyukov style).
+// - Every slot has a sequence number. A slot at position `pos` is free when its
+//   sequence is `pos`, and is readable when its sequence is `pos+1`.
+// - push() claims one slot by CAS on the enqueue position, push_bulk() claims
+//   many slots with one CAS, the free space is computed from the dequeue position
+//   because the consumer frees the slots in order.
+// - The consumer owns the dequeue position, pop() takes no CAS.
+template <typename ELEM_T, int32_t Q_SIZE>
+class LockFreeQueue<ELEM_T, Q_SIZE, kLFQueueMPSC>
+{
+public:
+	static_assert(std::is_trivial<ELEM_T>::value, "The type ELEM_T must be trivial");
+	static_assert(Q_SIZE >= 2 && (Q_SIZE & (Q_SIZE - 1)) == 0, "Q_SIZE must be power of 2");
+
+	// Enqueue an element (thread safe). Returns false if the queue is full.
+	bool push(const ELEM_T& data)
+	{
+		size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			size_t seq = m_buffer[pos & kMask].seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+			}
+			else if (diff < 0)
+			{
+				return false; //queue full
+			}
+			else
+			{
+				pos = m_enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		Cell& cell = m_buffer[pos & kMask];
+		cell.value = data;
+		cell.seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Enqueue elements in order (thread safe). Returns the number of elements pushed.
+	size_t push_bulk(const ELEM_T* data, size_t counts)
+	{
+		if (counts == 0) return 0;
+
+		size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		size_t n = 0;
+		for (;;)
+		{
+			size_t head = m_dequeue_pos.load(std::memory_order_acquire);
+			size_t used = pos - head;
+			if (used > (size_t)Q_SIZE) {
+				//stale enqueue position
+				pos = m_enqueue_pos.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (used == (size_t)Q_SIZE) return 0; //queue full
+
+			n = std::min(counts, (size_t)Q_SIZE - used);
+			if (m_enqueue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+		}
+
+		for (size_t i = 0; i < n; i++)
+		{
+			Cell& cell = m_buffer[(pos + i) & kMask];
+			cell.value = data[i];
+			cell.seq.store(pos + i + 1, std::memory_order_release);
+		}
+		return n;
+	}
+
+	// Dequeue an element (consumer thread only). Returns false if the queue is empty.
+	bool pop(ELEM_T& data)
+	{
+		return pop_bulk(&data, 1) == 1;
+	}
+
+	// Dequeue at most `max_counts` elements (consumer thread only).
+	size_t pop_bulk(ELEM_T* data, size_t max_counts)
+	{
+		size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+		size_t n = 0;
+		while (n < max_counts)
+		{
+			Cell& cell = m_buffer[(pos + n) & kMask];
+			if (cell.seq.load(std::memory_order_acquire) != pos + n + 1) break;
+
+			data[n] = cell.value;
+			cell.seq.store(pos + n + (size_t)Q_SIZE, std::memory_order_release);
+			n++;
+		}
+		if (n > 0) {
+			m_dequeue_pos.store(pos + n, std::memory_order_release);
+		}
+		return n;
+	}
+
+	// Approximate size (may be slightly stale under concurrency).
+	size_t size() const {
+		size_t head = m_dequeue_pos.load(std::memory_order_acquire);
+		size_t tail = m_enqueue_pos.load(std::memory_order_acquire);
+		return tail > head ? std::min(tail - head, (size_t)Q_SIZE) : 0;
+	}
+
+private:
+	enum { kMask = Q_SIZE - 1 };
+
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		ELEM_T value;
+	};
+
+	char _pad0[kCacheLineSize];
+	std::atomic<size_t> m_enqueue_pos;
+	char _pad1[kCacheLineSize - sizeof(size_t)];
+	std::atomic<size_t> m_dequeue_pos;
+	char _pad2[kCacheLineSize - sizeof(size_t)];
+	Cell m_buffer[size_t(Q_SIZE)];
+
+public:
+	LockFreeQueue()
+	{
+		for (size_t i = 0; i < (size_t)Q_SIZE; i++) {
+			m_buffer[i].seq.store(i, std::memory_order_relaxed);
+		}
+		m_enqueue_pos.store(0, std::memory_order_relaxed);
+		m_dequeue_pos.store(0, std::memory_order_relaxed);
+	}
+	virtual ~LockFreeQueue() {}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//SPSC
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Bounded ring for ONE producer and ONE consumer.
+// - The producer owns the tail, the consumer owns the head, no CAS is needed.
+// - Every side caches the position of the other side and reloads it only when
+//   the cached value says the queue is full(or empty), so the shared cache lines
+//   are touched rarely.
+template <typename ELEM_T, int32_t Q_SIZE>
+class LockFreeQueue<ELEM_T, Q_SIZE, kLFQueueSPSC>
+{
+public:
+	static_assert(std::is_trivial<ELEM_T>::value, "The type ELEM_T must be trivial");
+	static_assert(Q_SIZE >= 2 && (Q_SIZE & (Q_SIZE - 1)) == 0, "Q_SIZE must be power of 2");
+
+	// Enqueue an element (producer thread only). Returns false if the queue is full.
+	bool push(const ELEM_T& data)
+	{
+		return push_bulk(&data, 1) == 1;
+	}
+
+	// Enqueue elements in order (producer thread only). Returns the number of elements pushed.
+	size_t push_bulk(const ELEM_T* data, size_t counts)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t free_counts = (size_t)Q_SIZE - (tail - m_cached_head);
+		if (free_counts < counts) {
+			m_cached_head = m_head.load(std::memory_order_acquire);
+			free_counts = (size_t)Q_SIZE - (tail - m_cached_head);
+		}
+
+		size_t n = std::min(counts, free_counts);
+		for (size_t i = 0; i < n; i++) {
+			m_buffer[(tail + i) & kMask] = data[i];
+		}
+		if (n > 0) {
+			m_tail.store(tail + n, std::memory_order_release);
+		}
+		return n;
+	}
+
+	// Dequeue an element (consumer thread only). Returns false if the queue is empty.
+	bool pop(ELEM_T& data)
+	{
+		return pop_bulk(&data, 1) == 1;
+	}
+
+	// Dequeue at most `max_counts` elements (consumer thread only).
+	size_t pop_bulk(ELEM_T* data, size_t max_counts)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		size_t counts = m_cached_tail - head;
+		if (counts < max_counts) {
+			m_cached_tail = m_tail.load(std::memory_order_acquire);
+			counts = m_cached_tail - head;
+		}
+
+		size_t n = std::min(counts, max_counts);
+		for (size_t i = 0; i < n; i++) {
+			data[i] = m_buffer[(head + i) & kMask];
+		}
+		if (n > 0) {
+			m_head.store(head + n, std::memory_order_release);
+		}
+		return n;
+	}
+
+	// Approximate size (may be slightly stale under concurrency).
+	size_t size() const {
+		size_t head = m_head.load(std::memory_order_acquire);
+		size_t tail = m_tail.load(std::memory_order_acquire);
+		return tail > head ? tail - head : 0;
+	}
+
+private:
+	enum { kMask = Q_SIZE - 1 };
+
+	//producer side
+	char _pad0[kCacheLineSize];
+	std::atomic<size_t> m_tail;
+	size_t m_cached_head;
+	char _pad1[kCacheLineSize - 2 * sizeof(size_t)];
+	//consumer side
+	std::atomic<size_t> m_head;
+	size_t m_cached_tail;
+	char _pad2[kCacheLineSize - 2 * sizeof(size_t)];
+	ELEM_T m_buffer[size_t(Q_SIZE)];
+
+public:
+	LockFreeQueue() : m_tail(0), m_cached_head(0), m_head(0), m_cached_tail(0) {}
+	virtual ~LockFreeQueue() {}
+};
+
 }
@@ -3,7 +3,6 @@ Copyright(C) thecodeway.com
 */
 #include <cy_core.h>
 #include "cyc_logger.h"
-#include <fstream>
 
 #ifdef CY_SYS_WINDOWS
 #include <Shlwapi.h>
@@ -21,16 +20,430 @@ namespace cyclone
 
 #define DEFAULT_LOG_PATH		"./logs/"
 
+//-------------------------------------------------------------------------------------
+namespace {
+
+//-------------------------------------------------------------------------------------
+// Byte ring which holds the log records of one thread, one producer(the owner thread)
+// and one consumer(who holds the flush lock).
+// Every record is aligned to kRecordAlign, a record never wraps, the space at the
+// end of the ring is filled by a padding record if it's not enough.
+struct RecordHead
+{
+	uint32_t size;			//total size of the record, include head and padding
+	uint16_t level;
+	uint16_t name_size;
+	uint32_t message_size;
+	uint32_t site_id;		//0: message is text, others: message is the arguments of the call site
+	int64_t time;			//utc time, micro seconds
+};
+
+struct StageBuffer
+{
+	enum { kCapacity = 64 * 1024, kRecordAlign = 32, kMaxRecordSize = kCapacity / 4, kMaxNameSize = 64 };
+	enum { kPaddingLevel = 0xFFFF };
+	static_assert(sizeof(RecordHead) <= kRecordAlign, "record head is too large");
+
+	char* buf;
+	char _pad0[kCacheLineSize - sizeof(char*)];
+	std::atomic<size_t> write_pos;
+	char _pad1[kCacheLineSize - sizeof(size_t)];
+	std::atomic<size_t> read_pos;
+	char _pad2[kCacheLineSize - sizeof(size_t)];
+	atomic_bool_t alive;
+
+	StageBuffer() : write_pos(0), read_pos(0), alive(true)
+	{
+		buf = (char*)CY_MALLOC_TAG(kCapacity, memory::kTagLogger);
+	}
+	~StageBuffer()
+	{
+		CY_FREE(buf);
+	}
+
+	//return false if the buffer is full(producer thread only), `half_full` is set if the
+	//used space exceeds half of capacity after this record
+	bool write(LOG_LEVEL level, int64_t time, uint32_t site_id, const char* name, const char* message, size_t message_size, bool& half_full)
+	{
+		size_t name_size = std::min(strlen(name), (size_t)kMaxNameSize);
+		size_t max_message_size = kMaxRecordSize - sizeof(RecordHead) - name_size;
+		if (message_size > max_message_size) message_size = max_message_size;
+
+		size_t need = (sizeof(RecordHead) + name_size + message_size + kRecordAlign - 1) & ~((size_t)kRecordAlign - 1);
+
+		size_t pos = write_pos.load(std::memory_order_relaxed);
+		size_t used = pos - read_pos.load(std::memory_order_acquire);
+		size_t offset = pos & (kCapacity - 1);
+		size_t tail_room = kCapacity - offset;
+		size_t total = (need > tail_room) ? (tail_room + need) : need;
+		if (used + total > kCapacity) return false;
+
+		if (need > tail_room) {
+			//padding at the end of buffer
+			RecordHead* padding = (RecordHead*)(buf + offset);
+			padding->size = (uint32_t)tail_room;
+			padding->level = kPaddingLevel;
+			pos += tail_room;
+			offset = 0;
+		}
+
+		RecordHead* head = (RecordHead*)(buf + offset);
+		head->size = (uint32_t)need;
+		head->level = (uint16_t)level;
+		head->name_size = (uint16_t)name_size;
+		head->message_size = (uint32_t)message_size;
+		head->site_id = site_id;
+		head->time = time;
+		memcpy((char*)(head + 1), name, name_size);
+		memcpy((char*)(head + 1) + name_size, message, message_size);
+
+		write_pos.store(pos + need, std::memory_order_release);
+
+		half_full = (used < kCapacity / 2) && (used + total >= kCapacity / 2);
+		return true;
+	}
+};
+
+//-------------------------------------------------------------------------------------
+struct RecordRef
+{
+	const RecordHead* head;
+	size_t index;	//keep the order of same thread(stable sort)
+};
+
+//-------------------------------------------------------------------------------------
+struct SiteInfo
+{
+	std::string file;
+	int32_t line;
+	std::string format;
+};
+
+//-------------------------------------------------------------------------------------
+// binary log file
+// | magic(8) | version(uint32) | record | record | ...
+// site record:  | size(uint32) | kBinarySite(uint8) | id(uint32) | line(uint32) | file_size(uint16) | format_size(uint16) | file | format |
+// event record: | size(uint32) | kBinaryEvent(uint8) | site_id(uint32) | level(uint8) | name_size(uint8) | time(int64) | name | arguments |
+// the site 0 is "%s", the argument is the text message
+const char kBinaryMagic[8] = { 'C', 'Y', 'L', 'O', 'G', 'B', 'I', 'N' };
+const uint32_t kBinaryVersion = 1;
+enum { kBinarySite = 1, kBinaryEvent = 2 };
+
+//-------------------------------------------------------------------------------------
+template<typename T>
+void _append_raw(std::string& buf, T value)
+{
+	buf.append((const char*)&value, sizeof(value));
+}
+
+//-------------------------------------------------------------------------------------
+template<typename T>
+bool _read_raw(const char*& p, const char* end, T& value)
+{
+	if ((size_t)(end - p) < sizeof(T)) return false;
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+// read the arguments written by log_detail::ArgWriter
+struct ArgReader
+{
+	struct Arg
+	{
+		uint8_t type;
+		int64_t i;
+		uint64_t u;
+		double d;
+		const char* s;
+		size_t len;
+
+		int64_t as_int(void) const {
+			return type == log_detail::kArgDouble ? (int64_t)d : (type == log_detail::kArgInt ? i : (int64_t)u);
+		}
+		uint64_t as_uint(void) const {
+			return type == log_detail::kArgDouble ? (uint64_t)d : (type == log_detail::kArgInt ? (uint64_t)i : u);
+		}
+		double as_double(void) const {
+			return type == log_detail::kArgDouble ? d : (type == log_detail::kArgInt ? (double)i : (double)u);
+		}
+	};
+
+	const char* p;
+	const char* end;
+	int32_t left;
+
+	ArgReader(const char* args, size_t size) : p(args), end(args + size), left(0)
+	{
+		uint8_t counts = 0;
+		if (_read_raw(p, end, counts)) left = counts;
+	}
+
+	bool next(Arg& arg)
+	{
+		arg.type = 0; arg.i = 0; arg.u = 0; arg.d = 0.0; arg.s = ""; arg.len = 0;
+		if (left <= 0 || !_read_raw(p, end, arg.type)) return false;
+		left--;
+
+		switch (arg.type) {
+		case log_detail::kArgInt: return _read_raw(p, end, arg.i);
+		case log_detail::kArgUInt:
+		case log_detail::kArgPointer: return _read_raw(p, end, arg.u);
+		case log_detail::kArgDouble: return _read_raw(p, end, arg.d);
+		case log_detail::kArgString:
+		{
+			uint16_t len = 0;
+			if (!_read_raw(p, end, len) || (size_t)(end - p) < len) return false;
+			arg.s = p;
+			arg.len = len;
+			p += len;
+			return true;
+		}
+		default:
+			left = 0;
+			return false;
+		}
+	}
+};
+
+//-------------------------------------------------------------------------------------
+template<typename T>
+void _append_format(std::string& out, const std::string& spec, T value)
+{
+	char temp[256];
+	int len = std::snprintf(temp, sizeof(temp), spec.c_str(), value);
+	if (len < 0) return;
+	if ((size_t)len < sizeof(temp)) {
+		out.append(temp, (size_t)len);
+		return;
+	}
+	size_t begin = out.size();
+	out.resize(begin + (size_t)len + 1);
+	std::snprintf(&out[begin], (size_t)len + 1, spec.c_str(), value);
+	out.resize(begin + (size_t)len);
+}
+
+//-------------------------------------------------------------------------------------
+// all integers are stored as 64 bits, convert it to the type of the length modifier as printf
+// reads it from va_list, so '%x' of -1 is 'ffffffff' and '%hhu' of 257 is '1'
+void _append_integer(std::string& out, std::string spec, const std::string& length, char conversion, const ArgReader::Arg& arg)
+{
+	spec += "ll";
+	spec += conversion;
+
+	if (conversion == 'd' || conversion == 'i') {
+		int64_t v = arg.as_int();
+		if (length == "hh") v = (signed char)v;
+		else if (length == "h") v = (short)v;
+		else if (length == "l") v = (long)v;
+		else if (length == "z") v = (std::make_signed<size_t>::type)v;
+		else if (length == "t") v = (ptrdiff_t)v;
+		else if (length == "j") v = (intmax_t)v;
+		else if (length != "ll" && length != "q" && length != "L") v = (int)v;
+		_append_format(out, spec, (long long)v);
+	}
+	else {
+		uint64_t v = arg.as_uint();
+		if (length == "hh") v = (unsigned char)v;
+		else if (length == "h") v = (unsigned short)v;
+		else if (length == "l") v = (unsigned long)v;
+		else if (length == "z") v = (size_t)v;
+		else if (length == "t") v = (std::make_unsigned<ptrdiff_t>::type)v;
+		else if (length == "j") v = (uintmax_t)v;
+		else if (length != "ll" && length != "q" && length != "L") v = (unsigned int)v;
+		_append_format(out, spec, (unsigned long long)v);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+// format the arguments with printf style format string
+void _render_args(const char* format, const char* args, size_t args_size, std::string& out)
+{
+	ArgReader reader(args, args_size);
+	ArgReader::Arg arg;
+
+	const char* f = format;
+	while (*f) {
+		if (*f != '%') {
+			const char* next = strchr(f, '%');
+			size_t len = next ? (size_t)(next - f) : strlen(f);
+			out.append(f, len);
+			f += len;
+			continue;
+		}
+		if (f[1] == '%') {
+			out += '%';
+			f += 2;
+			continue;
+		}
+
+		//flags, width, precision
+		std::string spec = "%";
+		const char* q = f + 1;
+		while (*q && strchr("-+ #0", *q)) spec += *q++;
+		if (*q == '*') {
+			reader.next(arg);
+			spec += std::to_string(arg.as_int());
+			q++;
+		}
+		else {
+			while (*q >= '0' && *q <= '9') spec += *q++;
+		}
+		if (*q == '.') {
+			spec += *q++;
+			if (*q == '*') {
+				reader.next(arg);
+				spec += std::to_string(arg.as_int());
+				q++;
+			}
+			else {
+				while (*q >= '0' && *q <= '9') spec += *q++;
+			}
+		}
+		//length modifier, the integer is truncated to it
+		std::string length;
+		while (*q && strchr("hlLqjzt", *q)) length += *q++;
+
+		char conversion = *q;
+		if (conversion == 0) {
+			out.append(f);
+			break;
+		}
+		q++;
+
+		if (!reader.next(arg)) {
+			out += "<?>";
+			f = q;
+			continue;
+		}
+
+		switch (conversion) {
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+			_append_integer(out, spec, length, conversion, arg);
+			break;
+		case 'c':
+			spec += 'c';
+			_append_format(out, spec, (int)arg.as_int());
+			break;
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+			spec += conversion;
+			_append_format(out, spec, arg.as_double());
+			break;
+		case 's':
+			spec += 's';
+			if (arg.type == log_detail::kArgString) {
+				_append_format(out, spec, std::string(arg.s, arg.len).c_str());
+			}
+			else {
+				out += "<?>";
+			}
+			break;
+		case 'p':
+			spec += 'p';
+			_append_format(out, spec, (void*)(uintptr_t)arg.as_uint());
+			break;
+		case 'n':
+			break;
+		default:
+			out.append(f, (size_t)(q - f));
+			break;
+		}
+		f = q;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+const char* _get_level_name(uint16_t level)
+{
+	static const char* level_name[L_MAXIMUM_LEVEL] = { "[T]", "[D]", "[I]", "[W]", "[E]", "[F]" };
+	return level < L_MAXIMUM_LEVEL ? level_name[level] : "[?]";
+}
+
+//-------------------------------------------------------------------------------------
+// format utc time(micro seconds) to local time, cached in one second
+struct TimeFormatter
+{
+	int64_t cached_second;
+	char cached_time[32];
+
+	TimeFormatter() : cached_second(-1) { cached_time[0] = 0; }
+
+	const char* format(int64_t time)
+	{
+		int64_t second = time / (1000ll * 1000ll);
+		if (second != cached_second) {
+			time_t local_time = (time_t)second;
+			struct tm tm_now;
+#ifdef CY_SYS_WINDOWS
+			localtime_s(&tm_now, &local_time);
+#else
+			localtime_r(&local_time, &tm_now);
+#endif
+			strftime(cached_time, sizeof(cached_time), "%Y_%m_%d-%H:%M:%S ", &tm_now);
+			cached_second = second;
+		}
+		return cached_time;
+	}
+};
+
+//the logger can't be touched after it is destroyed(process exit)
+static atomic_bool_t s_logger_destroyed(false);
+
+}
+
 //-------------------------------------------------------------------------------------
 struct DiskLogFile
 {
 	std::string file_path;
 	std::string file_path_name;
 	sys_api::mutex_t lock;
-	const char* level_name[L_MAXIMUM_LEVEL];
-	LOG_LEVEL level_threshold;
+	std::atomic<int32_t> level_threshold;
 	bool logpath_created;
 
+	//staging buffers of all threads
+	sys_api::mutex_t stage_lock;
+	std::vector<StageBuffer*> stages;
+	sys_api::mutex_t shared_stage_lock;
+	StageBuffer* shared_stage;		//for the thread which has exited(thread local storage is destroyed)
+
+	//call sites of CY_LOG, the id of site is index+1
+	sys_api::mutex_t site_lock;
+	std::vector<SiteInfo*> sites;
+	std::atomic<int32_t> rate_limit;
+
+	//flush thread
+	sys_api::mutex_t flush_lock;		//consumer of all staging buffers
+	std::atomic<int32_t> flusher_state;	//0: not started, 1: running, 2: stopped
+	thread_t flusher;
+	sys_api::signal_t flusher_signal;
+	atomic_int64_t drop_counts;
+	int64_t reported_drop_counts;
+
+	//log file(protected by flush_lock)
+	FILE* file;
+	std::string file_open_name;
+	bool file_binary;
+	size_t file_size;
+	int64_t file_open_time;
+	int32_t rotate_index;
+	size_t max_file_size;
+	int32_t max_seconds;
+	atomic_bool_t console;
+	atomic_bool_t binary;
+
+	std::string file_buf;
+	std::string stdout_buf;
+	std::string stderr_buf;
+	std::string text_buf;
+	std::vector<RecordRef> records;
+	std::vector<const SiteInfo*> site_cache;	//sites known by flush thread
+	std::vector<bool> site_written;			//sites written to current binary file
+	TimeFormatter time_formatter;
+
+	enum { kFlushInterval = 100 };	//ms
+	enum { kDefaultRateLimit = 1000 };
+
 	DiskLogFile() 
 	{
 #ifdef CY_SYS_WINDOWS
@@ -63,6 +476,10 @@ struct DiskLogFile
 
 		//create lock
 		lock = sys_api::mutex_create();
+		stage_lock = sys_api::mutex_create();
+		shared_stage_lock = sys_api::mutex_create();
+		site_lock = sys_api::mutex_create();
+		flush_lock = sys_api::mutex_create();
 
 		//default level(all level will be written)
 		level_threshold = L_DEBUG;
@@ -70,18 +487,96 @@ struct DiskLogFile
 		//log path didn't created
 		logpath_created = false;
 
-		//set level name
-		level_name[L_TRACE] = "[T]";
-		level_name[L_DEBUG] = "[D]";
-		level_name[L_INFO]  = "[I]";
-		level_name[L_WARN]  = "[W]";
-		level_name[L_ERROR] = "[E]";
-		level_name[L_FATAL] = "[F]";
+		shared_stage = new StageBuffer();
+		stages.push_back(shared_stage);
+
+		rate_limit = kDefaultRateLimit;
+
+		flusher_state = 0;
+		flusher = nullptr;
+		flusher_signal = sys_api::signal_create();
+		drop_counts = 0;
+		reported_drop_counts = 0;
+
+		file = nullptr;
+		file_binary = false;
+		file_size = 0;
+		file_open_time = 0;
+		rotate_index = 0;
+		max_file_size = 0;
+		max_seconds = 0;
+		console = true;
+		binary = false;
 	}
+
 	~DiskLogFile()
 	{
+		//stop flush thread and write the rest
+		if (flusher_state.exchange(2) == 1) {
+			sys_api::signal_notify(flusher_signal);
+			sys_api::thread_join(flusher);
+		}
+		flush();
+		s_logger_destroyed = true;
+
+		if (file) fclose(file);
+		for (auto stage : stages) delete stage;
+		stages.clear();
+		for (auto site : sites) delete site;
+		sites.clear();
+
+		sys_api::signal_destroy(flusher_signal);
+		sys_api::mutex_destroy(flush_lock);
+		sys_api::mutex_destroy(site_lock);
+		sys_api::mutex_destroy(shared_stage_lock);
+		sys_api::mutex_destroy(stage_lock);
 		sys_api::mutex_destroy(lock);
 	}
+
+	StageBuffer* create_stage(void)
+	{
+		StageBuffer* stage = new StageBuffer();
+		sys_api::auto_mutex guard(stage_lock);
+		stages.push_back(stage);
+		return stage;
+	}
+
+	void register_site(LogSite& site, const char* format)
+	{
+		sys_api::auto_mutex guard(site_lock);
+		if (site.id.load(std::memory_order_relaxed) != 0) return;
+
+		SiteInfo* info = new SiteInfo();
+		info->file = site.file;
+		info->line = site.line;
+		info->format = format;
+		sites.push_back(info);
+
+		site.format.store(format, std::memory_order_relaxed);
+		site.id.store((uint32_t)sites.size(), std::memory_order_release);
+	}
+
+	void start_flusher(void)
+	{
+		int32_t expected = 0;
+		if (flusher_state.compare_exchange_strong(expected, 1)) {
+			flusher = sys_api::thread_create([this](void*) {
+				while (flusher_state.load() == 1) {
+					sys_api::signal_timewait(flusher_signal, kFlushInterval);
+					flush();
+				}
+			}, nullptr, "logger");
+		}
+	}
+
+	void write(LOG_LEVEL level, int64_t time, uint32_t site_id, const char* message, size_t message_size);
+	void flush(void);
+
+private:
+	bool _open_file(void);
+	void _rotate_file(void);
+	const SiteInfo* _get_site(uint32_t site_id);
+	void _append_record(uint16_t level, int64_t time, uint32_t site_id, const char* name, size_t name_size, const char* message, size_t message_size);
 };
 
 //-------------------------------------------------------------------------------------
@@ -91,6 +586,333 @@ static DiskLogFile& _get_disk_log(void)
 	return thefile;
 }
 
+//-------------------------------------------------------------------------------------
+namespace {
+
+struct ThreadStage
+{
+	StageBuffer* stage;
+
+	ThreadStage() : stage(nullptr) {}
+	~ThreadStage();
+};
+
+//the stage object can't be touched after it is destroyed(thread exit)
+static thread_local bool s_stage_destroyed = false;
+static thread_local ThreadStage s_thread_stage;
+
+//-------------------------------------------------------------------------------------
+ThreadStage::~ThreadStage()
+{
+	//the buffer is deleted by flush thread after all records have been written
+	if (stage) stage->alive = false;
+	s_stage_destroyed = true;
+}
+
+//-------------------------------------------------------------------------------------
+// "time level [thread] message"
+void _append_text_line(std::string& out, TimeFormatter& formatter, uint16_t level, int64_t time, 
+	const char* name, size_t name_size, const char* text, size_t text_size)
+{
+	out += formatter.format(time);
+	out += _get_level_name(level);
+	out += " [";
+	out.append(name, name_size);
+	out += "] ";
+	out.append(text, text_size);
+	out += '\n';
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+bool DiskLogFile::_open_file(void)
+{
+	//check dir
+	{
+		sys_api::auto_mutex guard(lock);
+#ifdef CY_SYS_WINDOWS
+		if (!logpath_created && PathFileExists(file_path.c_str()) != TRUE) {
+			if (0 == CreateDirectory(file_path.c_str(), NULL))
+#else
+		if (!logpath_created && access(file_path.c_str(), F_OK) != 0) {
+			if (mkdir(file_path.c_str(), 0755) != 0)
+#endif
+			{
+				//create log path failed!
+				return false;
+			}
+		}
+		logpath_created = true;
+	}
+
+	file_binary = binary.load();
+	file_open_name = file_binary ? (file_path_name + ".bin") : file_path_name;
+	site_written.clear();
+
+	file = fopen(file_open_name.c_str(), "ab");
+	if (file == nullptr) return false;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	file_size = size > 0 ? (size_t)size : 0;
+	file_open_time = sys_api::performance_time_now();
+
+	if (file_binary && file_size == 0) {
+		std::string header(kBinaryMagic, sizeof(kBinaryMagic));
+		_append_raw(header, kBinaryVersion);
+		fwrite(header.c_str(), 1, header.size(), file);
+		file_size += header.size();
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void DiskLogFile::_rotate_file(void)
+{
+	if (file == nullptr) return;
+	fclose(file);
+	file = nullptr;
+
+	//find a unused name
+	char rotate_name[512];
+	for (;;) {
+		std::snprintf(rotate_name, 512, "%s.%d", file_open_name.c_str(), ++rotate_index);
+#ifdef CY_SYS_WINDOWS
+		if (PathFileExists(rotate_name) != TRUE) break;
+#else
+		if (access(rotate_name, F_OK) != 0) break;
+#endif
+	}
+	::rename(file_open_name.c_str(), rotate_name);
+}
+
+//-------------------------------------------------------------------------------------
+const SiteInfo* DiskLogFile::_get_site(uint32_t site_id)
+{
+	if (site_id == 0) return nullptr;
+	if (site_id > site_cache.size()) {
+		//the sites are never removed, only the new sites need be copied
+		sys_api::auto_mutex guard(site_lock);
+		for (size_t i = site_cache.size(); i < sites.size(); i++) {
+			site_cache.push_back(sites[i]);
+		}
+	}
+	return site_id <= site_cache.size() ? site_cache[site_id - 1] : nullptr;
+}
+
+//-------------------------------------------------------------------------------------
+void DiskLogFile::_append_record(uint16_t level, int64_t time, uint32_t site_id, 
+	const char* name, size_t name_size, const char* message, size_t message_size)
+{
+	const SiteInfo* site = _get_site(site_id);
+	if (site == nullptr) site_id = 0;
+
+	bool to_console = console.load(std::memory_order_relaxed);
+	if (file_binary) {
+		//site definition, once per file
+		if (site && (site_written.size() < site_id || !site_written[site_id - 1])) {
+			if (site_written.size() < site_id) site_written.resize(site_id, false);
+			site_written[site_id - 1] = true;
+
+			size_t file_name_size = std::min(site->file.size(), (size_t)0xFFFF);
+			size_t format_size = std::min(site->format.size(), (size_t)0xFFFF);
+			_append_raw(file_buf, (uint32_t)(1 + 4 + 4 + 2 + 2 + file_name_size + format_size));
+			_append_raw(file_buf, (uint8_t)kBinarySite);
+			_append_raw(file_buf, site_id);
+			_append_raw(file_buf, (uint32_t)site->line);
+			_append_raw(file_buf, (uint16_t)file_name_size);
+			_append_raw(file_buf, (uint16_t)format_size);
+			file_buf.append(site->file.c_str(), file_name_size);
+			file_buf.append(site->format.c_str(), format_size);
+		}
+
+		//text message is the only argument of site 0
+		std::string text_args;
+		if (site == nullptr) {
+			size_t text_size = std::min(message_size, (size_t)0xFFFF);
+			_append_raw(text_args, (uint8_t)1);
+			_append_raw(text_args, (uint8_t)log_detail::kArgString);
+			_append_raw(text_args, (uint16_t)text_size);
+			text_args.append(message, text_size);
+		}
+		const char* args = site ? message : text_args.c_str();
+		size_t args_size = site ? message_size : text_args.size();
+
+		name_size = std::min(name_size, (size_t)0xFF);
+		_append_raw(file_buf, (uint32_t)(1 + 4 + 1 + 1 + 8 + name_size + args_size));
+		_append_raw(file_buf, (uint8_t)kBinaryEvent);
+		_append_raw(file_buf, site_id);
+		_append_raw(file_buf, (uint8_t)level);
+		_append_raw(file_buf, (uint8_t)name_size);
+		_append_raw(file_buf, time);
+		file_buf.append(name, name_size);
+		file_buf.append(args, args_size);
+
+		if (!to_console) return;
+	}
+
+	//deferred formatting
+	const char* text = message;
+	size_t text_size = message_size;
+	if (site) {
+		text_buf.clear();
+		_render_args(site->format.c_str(), message, message_size, text_buf);
+		text = text_buf.c_str();
+		text_size = text_buf.size();
+	}
+
+	size_t begin = file_buf.size();
+	_append_text_line(file_buf, time_formatter, level, time, name, name_size, text, text_size);
+
+	if (to_console) {
+		//one more space after time
+		std::string& console_buf = level >= L_ERROR ? stderr_buf : stdout_buf;
+		size_t time_size = strlen(time_formatter.cached_time);
+		console_buf.append(file_buf, begin, time_size);
+		console_buf += ' ';
+		console_buf.append(file_buf, begin + time_size, file_buf.size() - begin - time_size);
+	}
+	if (file_binary) file_buf.resize(begin);
+}
+
+//-------------------------------------------------------------------------------------
+void DiskLogFile::write(LOG_LEVEL level, int64_t time, uint32_t site_id, const char* message, size_t message_size)
+{
+	bool half_full = false;
+	bool written = false;
+	if (!s_stage_destroyed) {
+		if (s_thread_stage.stage == nullptr) {
+			s_thread_stage.stage = create_stage();
+		}
+		written = s_thread_stage.stage->write(level, time, site_id, sys_api::thread_get_current_name(), message, message_size, half_full);
+	}
+	else {
+		sys_api::auto_mutex guard(shared_stage_lock);
+		written = shared_stage->write(level, time, site_id, sys_api::thread_get_current_name(), message, message_size, half_full);
+	}
+
+	if (!written) drop_counts++;
+
+	start_flusher();
+	if (level >= L_FATAL) {
+		flush();
+	}
+	else if (half_full || !written) {
+		sys_api::signal_notify(flusher_signal);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void DiskLogFile::flush(void)
+{
+	sys_api::auto_mutex guard(flush_lock);
+
+	//snapshot of all staging buffers
+	std::vector<StageBuffer*> snapshot;
+	{
+		sys_api::auto_mutex stage_guard(stage_lock);
+		snapshot = stages;
+	}
+
+	//collect records
+	std::vector<size_t> end_pos(snapshot.size());
+	records.clear();
+	for (size_t i = 0; i < snapshot.size(); i++) {
+		StageBuffer* stage = snapshot[i];
+		size_t pos = stage->read_pos.load(std::memory_order_relaxed);
+		size_t end = stage->write_pos.load(std::memory_order_acquire);
+		end_pos[i] = end;
+
+		while (pos < end) {
+			const RecordHead* head = (const RecordHead*)(stage->buf + (pos & (StageBuffer::kCapacity - 1)));
+			if (head->level != StageBuffer::kPaddingLevel) {
+				RecordRef ref = { head, records.size() };
+				records.push_back(ref);
+			}
+			pos += head->size;
+		}
+	}
+
+	int64_t dropped = drop_counts.load();
+	if (records.empty() && dropped == reported_drop_counts) return;
+
+	//sort by time, keep the order of same thread
+	std::sort(records.begin(), records.end(), [](const RecordRef& a, const RecordRef& b) {
+		if (a.head->time != b.head->time) return a.head->time < b.head->time;
+		return a.index < b.index;
+	});
+
+	//rotate
+	if (file) {
+		int64_t open_seconds = (sys_api::performance_time_now() - file_open_time) / (1000ll * 1000ll);
+		if ((max_file_size > 0 && file_size >= max_file_size) || (max_seconds > 0 && open_seconds >= max_seconds)) {
+			_rotate_file();
+		}
+	}
+	//the format(text or binary) is decided by the file
+	if (file == nullptr) _open_file();
+
+	file_buf.clear();
+	stdout_buf.clear();
+	stderr_buf.clear();
+	for (auto& ref : records) {
+		const RecordHead* head = ref.head;
+		const char* name = (const char*)(head + 1);
+		_append_record(head->level, head->time, head->site_id, name, head->name_size, name + head->name_size, head->message_size);
+	}
+
+	//release the staging buffers
+	for (size_t i = 0; i < snapshot.size(); i++) {
+		snapshot[i]->read_pos.store(end_pos[i], std::memory_order_release);
+	}
+
+	if (dropped != reported_drop_counts) {
+		char drop_message[128];
+		int len = std::snprintf(drop_message, 128, "%" PRId64 " log lines dropped, staging buffer is full", dropped - reported_drop_counts);
+		_append_record(L_WARN, sys_api::utc_time_now(), 0, "logger", 6, drop_message, len > 0 ? (size_t)len : 0);
+		reported_drop_counts = dropped;
+	}
+
+	//write to disk
+	if (file != nullptr) {
+		fwrite(file_buf.c_str(), 1, file_buf.size(), file);
+		fflush(file);
+		file_size += file_buf.size();
+	}
+
+	//print to stand output last
+	if (!stdout_buf.empty()) {
+		fwrite(stdout_buf.c_str(), 1, stdout_buf.size(), stdout);
+		fflush(stdout);
+	}
+	if (!stderr_buf.empty()) {
+		fwrite(stderr_buf.c_str(), 1, stderr_buf.size(), stderr);
+	}
+
+	//delete the staging buffers of exited threads
+	{
+		sys_api::auto_mutex stage_guard(stage_lock);
+		for (auto it = stages.begin(); it != stages.end();) {
+			StageBuffer* stage = *it;
+			if (!stage->alive.load() && stage->read_pos.load() == stage->write_pos.load()) {
+				delete stage;
+				it = stages.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	//free the memory of large batch
+	if (file_buf.capacity() > 1024 * 1024) {
+		std::string().swap(file_buf);
+		std::string().swap(stdout_buf);
+		std::string().swap(stderr_buf);
+	}
+}
+
 //-------------------------------------------------------------------------------------
 bool set_log_filename(const char* pathName, const char* fileName)
 {
@@ -101,6 +923,11 @@ bool set_log_filename(const char* pathName, const char* fileName)
 	bool withSeperator = (pathEnd == '/' || pathEnd == '\\');
 
 	DiskLogFile& thefile = _get_disk_log();
+
+	//write the logs to old file
+	thefile.flush();
+
+	sys_api::auto_mutex flush_guard(thefile.flush_lock);
 	sys_api::auto_mutex guard(thefile.lock);
 
 	thefile.file_path = pathName;
@@ -110,6 +937,13 @@ bool set_log_filename(const char* pathName, const char* fileName)
 	thefile.file_path_name += fileName;
 
 	thefile.logpath_created = false;
+
+	//reopen in next flush
+	if (thefile.file) {
+		fclose(thefile.file);
+		thefile.file = nullptr;
+	}
+	thefile.rotate_index = 0;
 	return true;
 }
 
@@ -127,42 +961,198 @@ void set_log_threshold(LOG_LEVEL level)
 	if (level > L_MAXIMUM_LEVEL)return;
 
 	DiskLogFile& thefile = _get_disk_log();
-	sys_api::auto_mutex guard(thefile.lock);
-
 	thefile.level_threshold = level;
 }
 
 //-------------------------------------------------------------------------------------
-void disk_log(LOG_LEVEL level, const char* message, ...)
+void set_log_rotation(size_t max_file_size, int32_t max_seconds)
 {
-	assert(level < L_MAXIMUM_LEVEL);
-	if (level >= L_MAXIMUM_LEVEL)return;
+	DiskLogFile& thefile = _get_disk_log();
+	sys_api::auto_mutex guard(thefile.flush_lock);
+
+	thefile.max_file_size = max_file_size;
+	thefile.max_seconds = max_seconds > 0 ? max_seconds : 0;
+}
 
+//-------------------------------------------------------------------------------------
+void set_log_console(bool enable)
+{
 	DiskLogFile& thefile = _get_disk_log();
-	sys_api::auto_mutex guard(thefile.lock);
+	thefile.console = enable;
+}
 
-	//check the level
-	if (level < thefile.level_threshold) return;
+//-------------------------------------------------------------------------------------
+void log_flush(void)
+{
+	if (s_logger_destroyed.load()) return;
+	_get_disk_log().flush();
+}
 
-	//check dir
-#ifdef CY_SYS_WINDOWS
-	if (!thefile.logpath_created && PathFileExists(thefile.file_path.c_str())!=TRUE) {
-		if (0 == CreateDirectory(thefile.file_path.c_str(), NULL))
-#else
-	if (!thefile.logpath_created && access(thefile.file_path.c_str(), F_OK)!=0) {
-		if (mkdir(thefile.file_path.c_str(), 0755) != 0)
-#endif
-		{
-			//create log path failed!
-			return;
+//-------------------------------------------------------------------------------------
+int64_t get_log_drop_counts(void)
+{
+	return _get_disk_log().drop_counts.load();
+}
+
+//-------------------------------------------------------------------------------------
+bool is_log_enabled(LOG_LEVEL level)
+{
+	if (s_logger_destroyed.load(std::memory_order_relaxed)) return false;
+	return (int32_t)level >= _get_disk_log().level_threshold.load(std::memory_order_relaxed);
+}
+
+//-------------------------------------------------------------------------------------
+void set_log_binary(bool enable)
+{
+	DiskLogFile& thefile = _get_disk_log();
+
+	//write the logs to old file
+	thefile.flush();
+
+	sys_api::auto_mutex flush_guard(thefile.flush_lock);
+	if (thefile.binary.exchange(enable) == enable) return;
+
+	//reopen in next flush
+	if (thefile.file) {
+		fclose(thefile.file);
+		thefile.file = nullptr;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void set_log_rate_limit(int32_t lines_per_second)
+{
+	_get_disk_log().rate_limit = lines_per_second > 0 ? lines_per_second : 0;
+}
+
+//-------------------------------------------------------------------------------------
+bool log_decode_file(const char* binary_file, FILE* output)
+{
+	FILE* fp = fopen(binary_file, "rb");
+	if (fp == nullptr) return false;
+
+	std::string content;
+	char temp[64 * 1024];
+	size_t read_size;
+	while ((read_size = fread(temp, 1, sizeof(temp), fp)) > 0) {
+		content.append(temp, read_size);
+	}
+	fclose(fp);
+
+	const char* p = content.c_str();
+	const char* end = p + content.size();
+	uint32_t version = 0;
+	if (content.size() < sizeof(kBinaryMagic) || memcmp(p, kBinaryMagic, sizeof(kBinaryMagic)) != 0) return false;
+	p += sizeof(kBinaryMagic);
+	if (!_read_raw(p, end, version) || version != kBinaryVersion) return false;
+
+	std::vector<std::string> formats(1, "%s");
+	TimeFormatter formatter;
+	std::string out;
+	std::string text;
+
+	uint32_t record_size = 0;
+	while (_read_raw(p, end, record_size)) {
+		if ((size_t)(end - p) < record_size) break;	//the last record is not complete
+		const char* record = p;
+		const char* record_end = p + record_size;
+		p = record_end;
+
+		uint8_t type = 0;
+		if (!_read_raw(record, record_end, type)) continue;
+
+		if (type == kBinarySite) {
+			uint32_t id = 0, line = 0;
+			uint16_t file_size = 0, format_size = 0;
+			if (!_read_raw(record, record_end, id) || !_read_raw(record, record_end, line) ||
+				!_read_raw(record, record_end, file_size) || !_read_raw(record, record_end, format_size)) continue;
+			if (id == 0 || (size_t)(record_end - record) < (size_t)file_size + format_size) continue;
+
+			if (formats.size() <= id) formats.resize((size_t)id + 1, "%s");
+			formats[id].assign(record + file_size, format_size);
+		}
+		else if (type == kBinaryEvent) {
+			uint32_t site_id = 0;
+			uint8_t level = 0, name_size = 0;
+			int64_t time = 0;
+			if (!_read_raw(record, record_end, site_id) || !_read_raw(record, record_end, level) ||
+				!_read_raw(record, record_end, name_size) || !_read_raw(record, record_end, time)) continue;
+			if ((size_t)(record_end - record) < name_size) continue;
+
+			const char* format = site_id < formats.size() ? formats[site_id].c_str() : "%s";
+			text.clear();
+			_render_args(format, record + name_size, (size_t)(record_end - record) - name_size, text);
+			_append_text_line(out, formatter, level, time, record, name_size, text.c_str(), text.size());
+		}
+
+		if (out.size() > 64 * 1024) {
+			fwrite(out.c_str(), 1, out.size(), output);
+			out.clear();
 		}
-		thefile.logpath_created = true;
 	}
+	fwrite(out.c_str(), 1, out.size(), output);
+	fflush(output);
+	return true;
+}
 
-	std::ofstream logFile(thefile.file_path_name.c_str(), std::ios::app);
+//-------------------------------------------------------------------------------------
+namespace log_detail
+{
 
-	char timebuf[32] = { 0 };
-	sys_api::local_time_now(timebuf, 32, "%Y_%m_%d-%H:%M:%S ");
+//-------------------------------------------------------------------------------------
+Prepare prepare(LogSite& site, LOG_LEVEL level, const char* format, int64_t& now)
+{
+	if (level >= L_MAXIMUM_LEVEL || s_logger_destroyed.load(std::memory_order_relaxed)) return kSkip;
+	DiskLogFile& thefile = _get_disk_log();
+
+	if (site.id.load(std::memory_order_acquire) == 0) {
+		thefile.register_site(site, format);
+	}
+	//the format is not a constant string
+	if (site.format.load(std::memory_order_relaxed) != format) return kText;
+
+	now = sys_api::utc_time_now();
+
+	int32_t limit = thefile.rate_limit.load(std::memory_order_relaxed);
+	if (limit > 0) {
+		int64_t second = now / (1000ll * 1000ll);
+		int64_t window = site.window.load(std::memory_order_relaxed);
+		if (window != second && site.window.compare_exchange_strong(window, second)) {
+			site.window_counts.store(0, std::memory_order_relaxed);
+			int32_t suppressed = site.suppressed.exchange(0);
+			if (suppressed > 0) {
+				disk_log(L_WARN, "%d similar log lines suppressed at %s:%d", suppressed, site.file, site.line);
+			}
+		}
+		if (site.window_counts.fetch_add(1, std::memory_order_relaxed) >= limit) {
+			site.suppressed++;
+			return kSkip;
+		}
+	}
+	return kBinary;
+}
+
+//-------------------------------------------------------------------------------------
+void commit(LogSite& site, LOG_LEVEL level, int64_t now, const ArgWriter& writer)
+{
+	_get_disk_log().write(level, now, site.id.load(std::memory_order_relaxed), writer.buf, writer.size);
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+void disk_log(LOG_LEVEL level, const char* message, ...)
+{
+	assert(level < L_MAXIMUM_LEVEL);
+	if (level >= L_MAXIMUM_LEVEL)return;
+
+	if (s_logger_destroyed.load(std::memory_order_relaxed)) return;
+	DiskLogFile& thefile = _get_disk_log();
+
+	//check the level
+	if ((int32_t)level < thefile.level_threshold.load(std::memory_order_relaxed)) return;
+
+	int64_t now = sys_api::utc_time_now();
 
 	static const int32_t STATIC_BUF_LENGTH = 2048;
 
@@ -174,32 +1164,23 @@ void disk_log(LOG_LEVEL level, const char* message, ...)
 		va_start(ptr, message);
 		len = vsnprintf(nullptr, 0, message, ptr);
 		if (len > 0) {
-			p = (char*)CY_MALLOC((size_t)(len + 1));
+			p = (char*)CY_MALLOC_TAG((size_t)(len + 1), memory::kTagLogger);
 			va_start(ptr, message);
 			vsnprintf(p, (size_t)len + 1, message, ptr);
 			p[len] = 0;
 		}
 	}
 	else if (len >= STATIC_BUF_LENGTH) {
-		p = (char*)CY_MALLOC((size_t)(len + 1));
+		p = (char*)CY_MALLOC_TAG((size_t)(len + 1), memory::kTagLogger);
 		va_start(ptr, message);
 		vsnprintf(p, (size_t)len + 1, message, ptr);
 		p[len] = 0;
 	}
 	va_end(ptr);
+	size_t message_size = len > 0 ? (size_t)len : 0;
 
-	logFile << timebuf
-		<< thefile.level_name[level] << " [" 
-		<< sys_api::thread_get_current_name() << "] " 
-		<< p << std::endl;
-	logFile.close();
-
-	//print to stand output last
-	fprintf(level >= L_ERROR ? stderr : stdout, "%s %s [%s] %s\n",
-		timebuf,
-		thefile.level_name[level],
-		sys_api::thread_get_current_name(),
-		p);
+	//write to staging buffer
+	thefile.write(level, now, 0, p, message_size);
 
 	if (p != szTemp) {
 		CY_FREE(p);
@@ -23,6 +23,27 @@ enum LOG_LEVEL
 //----------------------
 // log api
 //----------------------
+// The log is written asynchronously:
+// - every thread formats the message into its own lock-free staging buffer,
+//   no lock and no file operation in the caller thread.
+// - a background thread(named "logger") collects the staging buffers of all
+//   threads, sorts the lines by time and writes them in large batches to a
+//   log file which is kept open.
+// - if the staging buffer of a thread is full, the line is dropped and the
+//   drop counter is increased, the caller is never blocked.
+// - the L_FATAL log is flushed to disk before disk_log() returns.
+//
+// CY_LOG defers the formatting:
+// - every call site registers its format string once, the caller thread copies
+//   only the raw arguments and the time into the staging buffer, the text is
+//   formatted by the background thread(or by the tool cyclone_logdecode if the
+//   log is written in binary mode). the format should be a string literal, the
+//   site whose format pointer changes is formatted in the caller thread.
+// - the call sites lower than CY_LOG_COMPILE_LEVEL are removed at compile time,
+//   the arguments of the call sites lower than the threshold are not evaluated.
+// - every call site is limited to `rate limit` lines per second, the suppressed
+//   lines are counted and reported.
+//
 
 //log to a disk file
 //default filename = process_name.date-time24h.hostname.pid.log
@@ -40,11 +61,160 @@ const char* get_log_filename(void);
 //all the log message lower than this level will be ignored
 void set_log_threshold(LOG_LEVEL level);
 
+//rotate the log file when its size exceeds max_file_size(bytes), or it has been
+//written for max_seconds, 0 means no limit(default). 
+//the old file is renamed to "filename.1", "filename.2"...
+void set_log_rotation(size_t max_file_size, int32_t max_seconds);
+
+//print the log to stdout/stderr too, default is true
+void set_log_console(bool enable);
+
+//write all the log lines logged before this call to disk, blocked until done
+void log_flush(void);
+
+//get the counts of log lines dropped because the staging buffer was full
+int64_t get_log_drop_counts(void);
+
+//is the log of this level written(thread safe)
+bool is_log_enabled(LOG_LEVEL level);
+
+//write the log in binary format to "filename.bin", default is false(text)
+//the binary log can be converted to text by tool cyclone_logdecode
+void set_log_binary(bool enable);
+
+//set the max lines of one CY_LOG call site per second, 0 means no limit, default is 1000
+void set_log_rate_limit(int32_t lines_per_second);
+
+//convert a binary log file to text, return false if the file is not a binary log
+bool log_decode_file(const char* binary_file, FILE* output);
+
+//----------------------
+// call site of CY_LOG
+//----------------------
+struct LogSite
+{
+	const char* file;
+	int32_t line;
+	std::atomic<uint32_t> id;				//0 means not registered
+	std::atomic<const char*> format;		//format string registered
+	std::atomic<int64_t> window;			//current second of rate limit
+	std::atomic<int32_t> window_counts;
+	std::atomic<int32_t> suppressed;
+
+	constexpr LogSite(const char* _file, int32_t _line)
+		: file(_file), line(_line), id(0), format(nullptr), window(0), window_counts(0), suppressed(0) {}
+};
+
+namespace log_detail
+{
+
+enum { kMaxArgsSize = 1024, kMaxArgCounts = 255 };
+enum ArgType { kArgInt = 1, kArgUInt, kArgDouble, kArgString, kArgPointer };
+enum Prepare { kSkip = 0, kBinary, kText };
+
+//encode the arguments of CY_LOG: | counts(uint8) | type(uint8) value | type(uint8) value |...
+struct ArgWriter
+{
+	char buf[kMaxArgsSize];
+	size_t size;
+	bool full;		//the rest arguments are dropped
+
+	ArgWriter() : size(1), full(false) { buf[0] = 0; }
+
+	void put(uint8_t type, const void* value, size_t value_size) {
+		if (full || (uint8_t)buf[0] == kMaxArgCounts || size + 1 + value_size > kMaxArgsSize) { full = true; return; }
+		buf[size] = (char)type;
+		memcpy(buf + size + 1, value, value_size);
+		size += 1 + value_size;
+		buf[0]++;
+	}
+
+	void put_string(const char* s) {
+		if (s == nullptr) s = "(null)";
+		size_t room = kMaxArgsSize - size;
+		if (full || (uint8_t)buf[0] == kMaxArgCounts || room < 1 + sizeof(uint16_t)) { full = true; return; }
+		size_t len = std::min(strlen(s), room - 1 - sizeof(uint16_t));
+		uint16_t len16 = (uint16_t)len;
+		buf[size] = (char)kArgString;
+		memcpy(buf + size + 1, &len16, sizeof(len16));
+		memcpy(buf + size + 1 + sizeof(len16), s, len);
+		size += 1 + sizeof(len16) + len;
+		buf[0]++;
+	}
+};
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+write_arg(ArgWriter& w, T v) { int64_t value = v; w.put(kArgInt, &value, sizeof(value)); }
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+write_arg(ArgWriter& w, T v) { uint64_t value = v; w.put(kArgUInt, &value, sizeof(value)); }
+
+template<typename T>
+typename std::enable_if<std::is_enum<T>::value>::type
+write_arg(ArgWriter& w, T v) { write_arg(w, (typename std::underlying_type<T>::type)v); }
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+write_arg(ArgWriter& w, T v) { double value = v; w.put(kArgDouble, &value, sizeof(value)); }
+
+inline void write_arg(ArgWriter& w, const char* v) { w.put_string(v); }
+inline void write_arg(ArgWriter& w, char* v) { w.put_string(v); }
+inline void write_arg(ArgWriter& w, std::nullptr_t) { uint64_t value = 0; w.put(kArgPointer, &value, sizeof(value)); }
+
+template<typename T>
+void write_arg(ArgWriter& w, T* v) { uint64_t value = (uint64_t)(uintptr_t)v; w.put(kArgPointer, &value, sizeof(value)); }
+
+inline void write_args(ArgWriter&) {}
+
+template<typename T, typename... Args>
+void write_args(ArgWriter& w, T first, Args... rest) {
+	write_arg(w, first);
+	write_args(w, rest...);
+}
+
+//register the site and check rate limit
+Prepare prepare(LogSite& site, LOG_LEVEL level, const char* format, int64_t& now);
+
+//write the encoded arguments to staging buffer
+void commit(LogSite& site, LOG_LEVEL level, int64_t now, const ArgWriter& writer);
+
+}
+
+template<typename... Args>
+void log_site_write(LogSite& site, LOG_LEVEL level, const char* format, Args... args)
+{
+	int64_t now = 0;
+	switch (log_detail::prepare(site, level, format, now))
+	{
+	case log_detail::kBinary:
+	{
+		log_detail::ArgWriter writer;
+		log_detail::write_args(writer, args...);
+		log_detail::commit(site, level, now, writer);
+	}
+	break;
+
+	case log_detail::kText:
+		disk_log(level, format, args...);
+		break;
+
+	default: break;
+	}
+}
+
 }
 
 //useful macro
 #ifdef CY_ENABLE_LOG
-#define CY_LOG cyclone::disk_log
+#define CY_LOG(level, ...) \
+	do { \
+		if ((int32_t)(level) >= CY_LOG_COMPILE_LEVEL && cyclone::is_log_enabled((cyclone::LOG_LEVEL)(level))) { \
+			static cyclone::LogSite _cy_log_site(__FILE__, __LINE__); \
+			cyclone::log_site_write(_cy_log_site, (cyclone::LOG_LEVEL)(level), __VA_ARGS__); \
+		} \
+	} while (0)
 #else
 #define CY_LOG (void)
 #endif
@@ -0,0 +1,244 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include "cyc_rcu.h"
+
+namespace cyclone
+{
+namespace rcu
+{
+
+//-------------------------------------------------------------------------------------
+struct alignas(64) reader_slot_s
+{
+	std::atomic<uint64_t> epoch;	//0 means the reader is not in critical section
+	atomic_bool_t used;
+};
+
+//-------------------------------------------------------------------------------------
+struct retired_s
+{
+	void* p;
+	deleter_func deleter;
+	uint64_t epoch;
+};
+
+//-------------------------------------------------------------------------------------
+struct RcuDomain
+{
+	std::atomic<uint64_t> global_epoch;
+	atomic_int32_t overflow_readers;
+	reader_slot_s slots[kMaxReaderSlots];
+
+	sys_api::mutex_t retire_lock;
+	std::vector<retired_s> retired_list;
+
+	enum { kReclaimThreshold = 64 };
+
+	RcuDomain()
+		: global_epoch(1)
+		, overflow_readers(0)
+	{
+		for (int32_t i = 0; i < kMaxReaderSlots; i++) {
+			slots[i].epoch.store(0, std::memory_order_relaxed);
+			slots[i].used.store(false, std::memory_order_relaxed);
+		}
+		retire_lock = sys_api::mutex_create();
+	}
+
+	~RcuDomain()
+	{
+		//process exit, no reader any more
+		for (auto& r : retired_list) r.deleter(r.p);
+		retired_list.clear();
+		sys_api::mutex_destroy(retire_lock);
+	}
+
+	// get the oldest epoch of all active readers, return 0 if reclamation must be postponed
+	uint64_t min_reader_epoch(void) const
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (overflow_readers.load(std::memory_order_seq_cst) > 0) return 0;
+
+		uint64_t min_epoch = std::numeric_limits<uint64_t>::max();
+		for (int32_t i = 0; i < kMaxReaderSlots; i++) {
+			uint64_t e = slots[i].epoch.load(std::memory_order_seq_cst);
+			if (e != 0 && e < min_epoch) min_epoch = e;
+		}
+		return min_epoch;
+	}
+
+	// move the objects that no reader can see to `freeable`, called with retire_lock held
+	void collect_locked(std::vector<retired_s>& freeable)
+	{
+		if (retired_list.empty()) return;
+
+		//step the epoch so new readers can't block the objects retired before
+		global_epoch.fetch_add(1, std::memory_order_seq_cst);
+
+		uint64_t min_epoch = min_reader_epoch();
+		if (min_epoch == 0) return;
+
+		size_t keep = 0;
+		for (size_t i = 0; i < retired_list.size(); i++) {
+			retired_s& r = retired_list[i];
+			if (r.epoch < min_epoch) {
+				freeable.push_back(r);
+			}
+			else {
+				retired_list[keep++] = r;
+			}
+		}
+		retired_list.resize(keep);
+	}
+
+	// call deleters outside the lock, a deleter may retire other objects
+	static void release(std::vector<retired_s>& freeable)
+	{
+		for (auto& r : freeable) r.deleter(r.p);
+		freeable.clear();
+	}
+};
+
+//-------------------------------------------------------------------------------------
+static RcuDomain& _get_domain(void)
+{
+	static RcuDomain domain;
+	return domain;
+}
+
+//-------------------------------------------------------------------------------------
+struct ThreadReader
+{
+	int32_t slot_index;	//-1: not allocated, -2: overflow reader
+	int32_t nesting;
+
+	ThreadReader() : slot_index(-1), nesting(0) {}
+	~ThreadReader()
+	{
+		if (slot_index >= 0) {
+			reader_slot_s& slot = _get_domain().slots[slot_index];
+			slot.epoch.store(0, std::memory_order_release);
+			slot.used.store(false, std::memory_order_release);
+		}
+	}
+
+	void acquire_slot(RcuDomain& domain)
+	{
+		for (int32_t i = 0; i < kMaxReaderSlots; i++) {
+			bool expected = false;
+			if (!domain.slots[i].used.load(std::memory_order_relaxed) &&
+				domain.slots[i].used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+				slot_index = i;
+				return;
+			}
+		}
+		slot_index = -2;
+	}
+};
+static thread_local ThreadReader s_thread_reader;
+
+//-------------------------------------------------------------------------------------
+void read_lock(void)
+{
+	ThreadReader& reader = s_thread_reader;
+	if (reader.nesting++ > 0) return;
+
+	RcuDomain& domain = _get_domain();
+	if (reader.slot_index == -1) reader.acquire_slot(domain);
+
+	if (reader.slot_index >= 0) {
+		reader_slot_s& slot = domain.slots[reader.slot_index];
+		slot.epoch.store(domain.global_epoch.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+	}
+	else {
+		domain.overflow_readers.fetch_add(1, std::memory_order_seq_cst);
+	}
+	//make sure the slot is visible before any shared pointer is loaded
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+//-------------------------------------------------------------------------------------
+void read_unlock(void)
+{
+	ThreadReader& reader = s_thread_reader;
+	assert(reader.nesting > 0);
+	if (--reader.nesting > 0) return;
+
+	RcuDomain& domain = _get_domain();
+	if (reader.slot_index >= 0) {
+		domain.slots[reader.slot_index].epoch.store(0, std::memory_order_release);
+	}
+	else {
+		domain.overflow_readers.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void retire(void* p, deleter_func deleter)
+{
+	if (p == nullptr || deleter == nullptr) return;
+
+	RcuDomain& domain = _get_domain();
+	std::vector<retired_s> freeable;
+	{
+		sys_api::auto_mutex lock(domain.retire_lock);
+
+		retired_s r;
+		r.p = p;
+		r.deleter = deleter;
+		r.epoch = domain.global_epoch.load(std::memory_order_seq_cst);
+		domain.retired_list.push_back(r);
+
+		if (domain.retired_list.size() >= RcuDomain::kReclaimThreshold) {
+			domain.collect_locked(freeable);
+		}
+	}
+	RcuDomain::release(freeable);
+}
+
+//-------------------------------------------------------------------------------------
+void reclaim(void)
+{
+	RcuDomain& domain = _get_domain();
+	std::vector<retired_s> freeable;
+	{
+		sys_api::auto_mutex lock(domain.retire_lock);
+		domain.collect_locked(freeable);
+	}
+	RcuDomain::release(freeable);
+}
+
+//-------------------------------------------------------------------------------------
+void synchronize(void)
+{
+	assert(s_thread_reader.nesting == 0);
+
+	RcuDomain& domain = _get_domain();
+	std::vector<retired_s> freeable;
+	for (;;) {
+		bool empty = false;
+		{
+			sys_api::auto_mutex lock(domain.retire_lock);
+			domain.collect_locked(freeable);
+			empty = domain.retired_list.empty();
+		}
+		RcuDomain::release(freeable);
+		if (empty) return;
+
+		sys_api::thread_yield();
+	}
+}
+
+//-------------------------------------------------------------------------------------
+size_t get_retired_counts(void)
+{
+	RcuDomain& domain = _get_domain();
+	sys_api::auto_mutex lock(domain.retire_lock);
+
+	return domain.retired_list.size();
+}
+
+}
+}
@@ -0,0 +1,306 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+#include "cyc_system_api.h"
+
+namespace cyclone
+{
+
+// rcu
+// ----------------
+// A process wide, epoch based read-copy-update domain.
+//
+// - Readers call read_lock()/read_unlock() (or use read_guard) around every
+//   access to a shared structure. Both functions are lock-free: a reader only
+//   publishes the current global epoch in its own cache-line sized slot.
+// - Writers unlink an object from the shared structure first, then hand it to
+//   retire(). The object is released only after every reader that could still
+//   see it has left its critical section.
+// - Read sections can be nested, but must not block for a long time, retired
+//   objects are held until the oldest reader leaves.
+// - The domain has kMaxReaderSlots slots, a reader thread takes one slot on its
+//   first read_lock() and gives it back when the thread exits. If all slots are
+//   in use the reader still works, but reclamation is postponed until all of
+//   those overflow readers have left.
+//
+namespace rcu
+{
+enum { kMaxReaderSlots = 256 };
+
+typedef void(*deleter_func)(void*);
+
+/// enter read-side critical section (thread safe, lock-free)
+void read_lock(void);
+
+/// leave read-side critical section (thread safe, lock-free)
+void read_unlock(void);
+
+/// retire an object which has already been unlinked from the shared structure,
+/// `deleter` will be called with `p` once no reader can reference it (thread safe).
+/// The retired objects are only collected every few dozen retirements, so the owner
+/// should also call reclaim() periodically, e.g. from a looper timer
+void retire(void* p, deleter_func deleter);
+
+/// release all retired objects that are no longer referenced by any reader (thread safe)
+void reclaim(void);
+
+/// wait until all readers that entered before this call have left, then reclaim
+/// everything retired so far. Can't be called inside a read-side critical section.
+void synchronize(void);
+
+/// get the counts of retired objects that wait to be released (thread safe)
+size_t get_retired_counts(void);
+
+/// RAII helper for read-side critical section
+struct read_guard : noncopyable
+{
+	read_guard() { read_lock(); }
+	~read_guard() { read_unlock(); }
+};
+
+}
+
+// RcuHashMap
+// ----------------
+// A chained hash map from int32_t key to VALUE_T, optimized for read-mostly
+// workloads where any thread needs to look values up.
+//
+// - find() runs inside an rcu read section and takes no lock at all; it copies
+//   the value out, so VALUE_T should be cheap to copy (an id, a smart pointer...).
+// - insert()/erase()/clear() are serialized by an internal writer mutex. Nodes
+//   are immutable after they are published: insert() prepends a new node, erase()
+//   copies the nodes in front of the victim and swings the bucket head. Replaced
+//   nodes and tables are handed to rcu::retire().
+// - The bucket table doubles when the average chain length exceeds 2, the new
+//   table is published atomically and the old one is retired as a whole.
+//
+template<typename VALUE_T>
+class RcuHashMap : noncopyable
+{
+public:
+	/// find value by key, return false if not exist (thread safe, lock-free)
+	bool find(int32_t key, VALUE_T& value) const;
+
+	/// insert a value, return false if the key already exist (thread safe)
+	bool insert(int32_t key, const VALUE_T& value);
+
+	/// erase a value, return false if the key not exist (thread safe)
+	bool erase(int32_t key);
+
+	/// remove all values (thread safe)
+	void clear(void);
+
+	/// approximate counts of values (thread safe)
+	size_t size(void) const { return m_size.load(std::memory_order_relaxed); }
+
+	/// current bucket counts (thread safe)
+	size_t bucket_counts(void) const {
+		rcu::read_guard guard;
+		return m_table.load(std::memory_order_acquire)->mask + 1;
+	}
+
+private:
+	struct Node
+	{
+		int32_t key;
+		VALUE_T value;
+		Node* next;
+
+		Node(int32_t k, const VALUE_T& v, Node* n) : key(k), value(v), next(n) {}
+	};
+
+	struct Table
+	{
+		size_t mask;
+		std::atomic<Node*>* buckets;
+
+		explicit Table(size_t bucket_counts) : mask(bucket_counts - 1) {
+			buckets = new std::atomic<Node*>[bucket_counts];
+			for (size_t i = 0; i < bucket_counts; i++) buckets[i].store(nullptr, std::memory_order_relaxed);
+		}
+		~Table() { delete[] buckets; }
+
+		std::atomic<Node*>& bucket(int32_t key) const {
+			return buckets[_hash(key) & mask];
+		}
+	};
+
+	std::atomic<Table*> m_table;
+	std::atomic<size_t> m_size;
+	sys_api::mutex_t m_write_lock;
+
+	enum { kDefaultBucketCounts = 64, kMaxLoadFactor = 2 };
+
+private:
+	static size_t _hash(int32_t key) {
+		//fibonacci hashing, spread sequential ids to all buckets
+		return (size_t)(((uint64_t)(uint32_t)key * 0x9E3779B97F4A7C15ull) >> 16);
+	}
+
+	static void _delete_node(void* p) { delete (Node*)p; }
+	static void _delete_table(void* p);
+
+	void _grow(Table* table);
+
+public:
+	explicit RcuHashMap(size_t bucket_counts = kDefaultBucketCounts);
+	~RcuHashMap();
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//Impl
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+RcuHashMap<VALUE_T>::RcuHashMap(size_t bucket_counts)
+	: m_size(0)
+{
+	size_t counts = 2;
+	while (counts < bucket_counts) counts *= 2;
+
+	m_table.store(new Table(counts), std::memory_order_release);
+	m_write_lock = sys_api::mutex_create();
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+RcuHashMap<VALUE_T>::~RcuHashMap()
+{
+	//no reader should access the map now
+	_delete_table(m_table.load(std::memory_order_acquire));
+	m_table.store(nullptr, std::memory_order_relaxed);
+
+	sys_api::mutex_destroy(m_write_lock);
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+bool RcuHashMap<VALUE_T>::find(int32_t key, VALUE_T& value) const
+{
+	rcu::read_guard guard;
+
+	const Table* table = m_table.load(std::memory_order_seq_cst);
+	for (const Node* node = table->bucket(key).load(std::memory_order_acquire); node != nullptr; node = node->next) {
+		if (node->key == key) {
+			value = node->value;
+			return true;
+		}
+	}
+	return false;
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+bool RcuHashMap<VALUE_T>::insert(int32_t key, const VALUE_T& value)
+{
+	sys_api::auto_mutex lock(m_write_lock);
+
+	Table* table = m_table.load(std::memory_order_relaxed);
+	std::atomic<Node*>& bucket = table->bucket(key);
+
+	Node* head = bucket.load(std::memory_order_relaxed);
+	for (Node* node = head; node != nullptr; node = node->next) {
+		if (node->key == key) return false;
+	}
+
+	//publish the new node at the head of chain
+	bucket.store(new Node(key, value, head), std::memory_order_release);
+	size_t counts = m_size.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	if (counts > (table->mask + 1) * kMaxLoadFactor) {
+		_grow(table);
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+bool RcuHashMap<VALUE_T>::erase(int32_t key)
+{
+	sys_api::auto_mutex lock(m_write_lock);
+
+	Table* table = m_table.load(std::memory_order_relaxed);
+	std::atomic<Node*>& bucket = table->bucket(key);
+
+	Node* head = bucket.load(std::memory_order_relaxed);
+	Node* victim = head;
+	while (victim != nullptr && victim->key != key) victim = victim->next;
+	if (victim == nullptr) return false;
+
+	//copy the nodes in front of victim, so the published nodes are never changed
+	Node* new_head = victim->next;
+	Node** tail = &new_head;
+	for (Node* node = head; node != victim; node = node->next) {
+		Node* copy = new Node(node->key, node->value, victim->next);
+		*tail = copy;
+		tail = &(copy->next);
+	}
+
+	bucket.store(new_head, std::memory_order_seq_cst);
+	m_size.fetch_sub(1, std::memory_order_relaxed);
+
+	//retire the replaced nodes
+	Node* node = head;
+	while (node != victim) {
+		Node* next = node->next;
+		rcu::retire(node, _delete_node);
+		node = next;
+	}
+	rcu::retire(victim, _delete_node);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+void RcuHashMap<VALUE_T>::clear(void)
+{
+	sys_api::auto_mutex lock(m_write_lock);
+
+	Table* table = m_table.load(std::memory_order_relaxed);
+	m_table.store(new Table(table->mask + 1), std::memory_order_seq_cst);
+	m_size.store(0, std::memory_order_relaxed);
+
+	rcu::retire(table, _delete_table);
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+void RcuHashMap<VALUE_T>::_grow(Table* table)
+{
+	//called with write lock held
+	Table* new_table = new Table((table->mask + 1) * 2);
+
+	for (size_t i = 0; i <= table->mask; i++) {
+		for (Node* node = table->buckets[i].load(std::memory_order_relaxed); node != nullptr; node = node->next) {
+			std::atomic<Node*>& bucket = new_table->bucket(node->key);
+			bucket.store(new Node(node->key, node->value, bucket.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+		}
+	}
+
+	m_table.store(new_table, std::memory_order_seq_cst);
+	rcu::retire(table, _delete_table);
+}
+
+//-------------------------------------------------------------------------------------
+template<typename VALUE_T>
+void RcuHashMap<VALUE_T>::_delete_table(void* p)
+{
+	Table* table = (Table*)p;
+	if (table == nullptr) return;
+
+	for (size_t i = 0; i <= table->mask; i++) {
+		Node* node = table->buckets[i].load(std::memory_order_relaxed);
+		while (node != nullptr) {
+			Node* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+	delete table;
+}
+
+}
@@ -5,52 +5,206 @@ Copyright(C) thecodeway.com
 #include <cy_crypt.h>
 
 #include "cyc_ring_buf.h"
+#include "cyc_buf_pool.h"
 #ifdef CY_HAVE_SYS_UIO_H
 #include <sys/uio.h>
 #endif
+#ifdef CY_HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
 
 namespace cyclone
 {
 
 //-------------------------------------------------------------------------------------
-RingBuf::RingBuf(size_t _capacity)
+static std::atomic<int32_t> s_shrink_idle_ms(RingBuf::kDefaultShrinkIdleMs);
+static std::atomic<int32_t> s_shrink_usage_percent(RingBuf::kDefaultShrinkUsagePercent);
+
+//-------------------------------------------------------------------------------------
+static size_t _get_page_size(void)
+{
+#ifdef CY_HAVE_MEMFD_CREATE
+	static const size_t page_size = (size_t)::sysconf(_SC_PAGESIZE);
+	return page_size;
+#else
+	return 1;
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+static uint8_t* _alloc_buf(size_t size, bool& mirrored)
+{
+#ifdef CY_HAVE_MEMFD_CREATE
+	if (mirrored) {
+		assert(size % _get_page_size() == 0);
+
+		int fd = ::memfd_create("cyclone_ringbuf", MFD_CLOEXEC);
+		if (fd >= 0 && ::ftruncate(fd, (off_t)size) == 0) {
+			//reserve address space, then map the file twice
+			uint8_t* base = (uint8_t*)::mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (base != (uint8_t*)MAP_FAILED) {
+				if (::mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+					::mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED) {
+					::close(fd);
+					return base;
+				}
+				::munmap(base, size * 2);
+			}
+		}
+		if (fd >= 0) ::close(fd);
+		CY_LOG(L_WARN, "create mirrored ring buf failed, err=%d", errno);
+	}
+#endif
+	mirrored = false;
+	return (uint8_t*)BufPool::allocate(size);
+}
+
+//-------------------------------------------------------------------------------------
+static void _free_buf(uint8_t* buf, size_t size, bool mirrored)
+{
+#ifdef CY_HAVE_MEMFD_CREATE
+	if (mirrored) {
+		::munmap(buf, size * 2);
+		return;
+	}
+#else
+	(void)size;
+	assert(!mirrored);
+#endif
+	BufPool::deallocate(buf);
+}
+
+//-------------------------------------------------------------------------------------
+RingBuf::RingBuf(size_t _capacity, bool mirrored)
+	: m_low_since(-1)
+#ifdef CY_HAVE_MEMFD_CREATE
+	, m_mirrored(mirrored)
+#else
+	, m_mirrored(false)
+#endif
 {
+	(void)mirrored;
+
 	/* One byte is used for detecting the full condition. */
-	m_buf = (uint8_t*)CY_MALLOC(_capacity + 1);
-	m_end = _capacity + 1;
+	m_end = (_capacity > 0) ? _round_end(_capacity + 1) : 1;
+	m_buf = (_capacity > 0) ? _alloc_buf(m_end, m_mirrored) : nullptr;
 	reset();
 }
 
 //-------------------------------------------------------------------------------------
 RingBuf::~RingBuf()
 {
-	CY_FREE(this->m_buf);
+	if (m_buf) {
+		_free_buf(m_buf, m_end, m_mirrored);
+		m_buf = nullptr;
+	}
 }
 
 //-------------------------------------------------------------------------------------
-void RingBuf::resize(size_t need_size)
+bool RingBuf::release_memory(void)
 {
-	if (capacity() >= need_size) return;
+	if (m_buf == nullptr || !empty()) return false;
 
-	//auto inc size
-	size_t new_size = 2;
-	while (new_size < need_size) new_size *= 2;
+	_free_buf(m_buf, m_end, m_mirrored);
+	m_buf = nullptr;
+	m_end = 1;
+	m_low_since = -1;
+	reset();
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void RingBuf::set_shrink_policy(int32_t idle_ms, int32_t usage_percent)
+{
+	s_shrink_idle_ms = idle_ms < 0 ? 0 : idle_ms;
+	s_shrink_usage_percent = usage_percent < 0 ? 0 : (usage_percent > 100 ? 100 : usage_percent);
+}
+
+//-------------------------------------------------------------------------------------
+size_t RingBuf::_round_end(size_t end) const
+{
+	if (!m_mirrored) return end;
+
+	size_t page_size = _get_page_size();
+	return (end + page_size - 1) / page_size * page_size;
+}
+
+//-------------------------------------------------------------------------------------
+void RingBuf::_realloc(size_t new_end)
+{
+	new_end = _round_end(new_end);
 
 	//copy old data
 	size_t old_size = size();
-	uint8_t* buf = (uint8_t*)CY_MALLOC(new_size);
-	this->memcpy_out(buf, old_size);
+	assert(new_end > old_size);
+	bool mirrored = m_mirrored;
+	uint8_t* buf = _alloc_buf(new_end, mirrored);
+	this->peek(0, buf, old_size);
 
 	//free old buf
-	CY_FREE(m_buf);
+	if (m_buf) _free_buf(m_buf, m_end, m_mirrored);
 
 	//reset
 	m_buf = buf;
-	m_end = new_size;
+	m_end = new_end;
+	m_mirrored = mirrored;
 	m_read = 0;
 	m_write = old_size;
 }
 
+//-------------------------------------------------------------------------------------
+void RingBuf::_check_usage_high(void)
+{
+	//a burst ends the low usage period, even if it's consumed at once
+	if (m_low_since < 0) return;
+
+	int32_t usage_percent = s_shrink_usage_percent.load(std::memory_order_relaxed);
+	if (size() * 100 >= capacity() * (size_t)usage_percent) m_low_since = -1;
+}
+
+//-------------------------------------------------------------------------------------
+bool RingBuf::shrink_if_idle(void)
+{
+	return _check_shrink();
+}
+
+//-------------------------------------------------------------------------------------
+bool RingBuf::_check_shrink(void)
+{
+	if (m_end <= _round_end(kDefaultCapacity + 1)) return false;
+
+	int32_t usage_percent = s_shrink_usage_percent.load(std::memory_order_relaxed);
+	if (usage_percent == 0 || size() * 100 >= capacity() * (size_t)usage_percent) {
+		m_low_since = -1;
+		return false;
+	}
+
+	int64_t now = sys_api::performance_time_now();
+	if (m_low_since < 0) m_low_since = now;
+	if (now - m_low_since < (int64_t)s_shrink_idle_ms.load(std::memory_order_relaxed) * 1000) return false;
+
+	//shrink to the smallest size which keep the usage below half
+	size_t new_end = kDefaultCapacity + 1;
+	while (new_end < m_end && new_end < size() * 2 + 1) new_end *= 2;
+	bool shrunk = _round_end(new_end) < m_end;
+	if (shrunk) _realloc(new_end);
+	m_low_since = -1;
+	return shrunk;
+}
+
+//-------------------------------------------------------------------------------------
+void RingBuf::resize(size_t need_size)
+{
+	if (capacity() >= need_size) return;
+
+	//auto inc size
+	size_t new_size = 2;
+	while (new_size < need_size) new_size *= 2;
+
+	_realloc(new_size);
+	m_low_since = -1;
+}
+
 //-------------------------------------------------------------------------------------
 void RingBuf::memcpy_into(const void *src, size_t count)
 {
@@ -63,14 +217,15 @@ void RingBuf::memcpy_into(const void *src, size_t count)
 	//write data
 	size_t nwritten = 0;
 	while (nwritten != count) {
-		size_t n = (size_t)std::min((size_t)(m_end - m_write), count - nwritten);
+		size_t n = (size_t)std::min(_linear_size(m_write), count - nwritten);
 		memcpy(m_buf+m_write, csrc + nwritten, n);
 		m_write += n;
 		nwritten += n;
 
 		// wrap?
-		if (m_write >= m_end) m_write = 0;
+		if (m_write >= m_end) m_write -= m_end;
 	}
+	_check_usage_high();
 }
 
 //-------------------------------------------------------------------------------------
@@ -83,17 +238,18 @@ size_t RingBuf::memcpy_out(void *dst, size_t count)
 	char* cdst = (char*)dst;
 	size_t nread = 0;
 	while (nread != count) {
-		size_t n = std::min((size_t)(m_end - m_read), count - nread);
+		size_t n = std::min(_linear_size(m_read), count - nread);
 		memcpy(cdst + nread, m_buf + m_read, n);
 		m_read += n;
 		nread += n;
 
 		// wrap 
-		if (m_read >= m_end) m_read = 0;
+		if (m_read >= m_end) m_read -= m_end;
 	}
 
 	//reset read and write index to zero
 	if (empty()) reset();
+	_check_shrink();
 	return count;
 }
 
@@ -106,17 +262,18 @@ size_t RingBuf::moveto(RingBuf& dst, size_t count)
 
 	size_t nread = 0;
 	while (nread != count) {
-		size_t n = std::min((size_t)(m_end - m_read), count - nread);
+		size_t n = std::min(_linear_size(m_read), count - nread);
 		dst.memcpy_into(m_buf + m_read, n);
 		m_read += n;
 		nread += n;
 
 		// wrap 
-		if (m_read >= m_end) m_read = 0;
+		if (m_read >= m_end) m_read -= m_end;
 	}
 
 	//reset read and write index to zero
 	if (empty()) reset();
+	_check_shrink();
 	return count;
 }
 
@@ -131,18 +288,18 @@ ssize_t RingBuf::search(size_t off, uint8_t data) const
 
 	size_t nread = 0;
 	while (nread != search_count) {
-		size_t n = std::min((size_t)(m_end - read_off), search_count - nread);
+		size_t n = std::min(_linear_size(read_off), search_count - nread);
 		const uint8_t* p = (uint8_t*)memchr(m_buf + read_off, (int)data, n);
 		if (p != nullptr) {
 			size_t pos = (size_t)(std::ptrdiff_t)(p - m_buf);
-			return (pos > m_read) ? (ssize_t)(pos - m_read) : (ssize_t)(pos + m_end - m_read);
+			return (pos >= m_read) ? (ssize_t)(pos - m_read) : (ssize_t)(pos + m_end - m_read);
 		}
 
 		read_off += n;
 		nread += n;
 
 		// wrap 
-		if (read_off >= m_end) read_off = 0;
+		if (read_off >= m_end) read_off -= m_end;
 	}
 
 	return -1;
@@ -161,13 +318,13 @@ size_t RingBuf::peek(size_t off, void* dst, size_t count) const
 
 	size_t nread = 0;
 	while (nread != count) {
-		size_t n = std::min((size_t)(m_end - read_off), count - nread);
+		size_t n = std::min(_linear_size(read_off), count - nread);
 		memcpy(cdst + nread, m_buf + read_off, n);
 		read_off += n;
 		nread += n;
 
 		// wrap 
-		if (read_off >= m_end) read_off = 0;
+		if (read_off >= m_end) read_off -= m_end;
 	}
 
 	return count;
@@ -185,6 +342,7 @@ size_t RingBuf::discard(size_t count)
 
 	//reset read and write index to zero
 	if (empty()) reset();
+	_check_shrink();
 
 	return count;
 }
@@ -195,6 +353,9 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 	const size_t STACK_BUF_SIZE = 0xFFFF;
 	char stack_buf[STACK_BUF_SIZE];
 
+	//lazy buffer without extra buffer, alloc default memory first
+	if (m_buf == nullptr && !extra_buf) resize(kDefaultCapacity);
+
 #ifndef CY_HAVE_READWRITE_V
 	//TODO: it is not correct to call read() more than once in on event call!
 	size_t count = get_free_size();
@@ -202,7 +363,7 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 	//in windows call read three times maxmium
 	ssize_t nwritten = 0;
 	while (nwritten != (ssize_t)count)	{
-		ssize_t n = (ssize_t)std::min((ssize_t)(m_end - m_write), (ssize_t)(count - nwritten));
+		ssize_t n = (ssize_t)std::min((ssize_t)_linear_size(m_write), (ssize_t)(count - nwritten));
 		ssize_t len = socket_api::read(fd, m_buf + m_write, (ssize_t)n);
 		if (len == 0) return 0; //EOF
 		if (len < 0) return socket_api::is_lasterror_WOULDBLOCK() ? nwritten : len;
@@ -211,7 +372,7 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 		nwritten += len;
 
 		// wrap?
-		if (m_write >= m_end) m_write = 0;
+		if (m_write >= m_end) m_write -= m_end;
 
 		//no more data?
 		if (len < n) return nwritten;
@@ -235,7 +396,7 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 	size_t nwritten = 0;
 	size_t write_off = m_write;
 	while (nwritten != count)	{
-		size_t n = std::min((size_t)(m_end - write_off), count - nwritten);
+		size_t n = std::min(_linear_size(write_off), count - nwritten);
 		vec[vec_counts].iov_base = m_buf + write_off;
 		vec[vec_counts].iov_len = n;
 		vec_counts++;
@@ -244,7 +405,7 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 		write_off += n;
 
 		// wrap?
-		if (write_off >= m_end) write_off = 0;
+		if (write_off >= m_end) write_off -= m_end;
 	}
 
 	//add extra buff
@@ -262,13 +423,13 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 	count = std::min(get_free_size(), (size_t)read_counts);
 	nwritten = 0;
 	while (nwritten != count)	{
-		size_t n = std::min((size_t)(m_end - m_write), count - nwritten);
+		size_t n = std::min(_linear_size(m_write), count - nwritten);
 
 		nwritten += n;
 		m_write += n;
 
 		// wrap?
-		if (m_write >= m_end) m_write = 0;
+		if (m_write >= m_end) m_write -= m_end;
 	}
 
 	//append extra data
@@ -276,6 +437,7 @@ ssize_t RingBuf::read_socket(socket_t fd, bool extra_buf)
 		assert(extra_buf);
 		memcpy_into(stack_buf, (size_t)read_counts - nwritten);
 	}
+	_check_usage_high();
 
 	return read_counts;
 #endif
@@ -291,7 +453,7 @@ ssize_t RingBuf::write_socket(socket_t fd)
 
 	size_t nsended = 0;
 	while (nsended != count) {
-		size_t n = std::min((size_t)(m_end - m_read), count - nsended);
+		size_t n = std::min(_linear_size(m_read), count - nsended);
 
 		ssize_t len = socket_api::write(fd, (const char*)m_buf + m_read, (ssize_t)n);
 		if (len == 0) break; //nothing was written
@@ -305,7 +467,7 @@ ssize_t RingBuf::write_socket(socket_t fd)
 		nsended += len;
 
 		// wrap 
-		if (m_read >= m_end) m_read = 0;
+		if (m_read >= m_end) m_read -= m_end;
 
 		//socket buf busy, try next time
 		if(len < (ssize_t)n) {
@@ -315,6 +477,7 @@ ssize_t RingBuf::write_socket(socket_t fd)
 
 	//reset read and write index to zero
 	if (empty()) reset();
+	_check_shrink();
 
 	return (ssize_t)nsended;
 #else
@@ -325,7 +488,7 @@ ssize_t RingBuf::write_socket(socket_t fd)
 	size_t nsended = 0;
 	size_t read_off = m_read;
 	while (nsended != count) {
-		size_t n = std::min((size_t)(m_end - read_off), count - nsended);
+		size_t n = std::min(_linear_size(read_off), count - nsended);
 
 		vec[vec_counts].iov_base = m_buf + read_off;
 		vec[vec_counts].iov_len = n;
@@ -335,7 +498,7 @@ ssize_t RingBuf::write_socket(socket_t fd)
 		nsended += n;
 
 		// wrap 
-		if (read_off >= m_end) read_off = 0;
+		if (read_off >= m_end) read_off -= m_end;
 	}
 
 	//call sys function
@@ -345,17 +508,18 @@ ssize_t RingBuf::write_socket(socket_t fd)
 	//adjust point
 	nsended = 0;
 	while (nsended != (size_t)write_counts) {
-		size_t n = std::min((size_t)(m_end - m_read), (size_t)write_counts - nsended);
+		size_t n = std::min(_linear_size(m_read), (size_t)write_counts - nsended);
 
 		m_read += n;
 		nsended += n;
 
 		// wrap 
-		if (m_read >= m_end) m_read = 0;
+		if (m_read >= m_end) m_read -= m_end;
 	}
 
 	//reset read and write index to zero
 	if (empty()) reset();
+	_check_shrink();
 
 	return (ssize_t)nsended;
 #endif
@@ -375,23 +539,63 @@ uint32_t RingBuf::checksum(size_t off, size_t count) const
 
 	size_t nread = 0;
 	while (nread != count) {
-		size_t n = std::min((size_t)(m_end - read_off), count - nread);
+		size_t n = std::min(_linear_size(read_off), count - nread);
 		adler = adler32(adler, m_buf + read_off, n);
 		read_off += n;
 		nread += n;
 
 		// wrap 
-		if (read_off >= m_end) read_off = 0;
+		if (read_off >= m_end) read_off -= m_end;
 	}
 
 	return adler;
 }
 
+//-------------------------------------------------------------------------------------
+uint32_t RingBuf::checksum_crc32c(size_t off, size_t count) const
+{
+	uint32_t crc = INITIAL_CRC32C;
+
+	size_t bytes_used = size();
+	if (off > bytes_used) return crc;
+	if (off + count > bytes_used) return crc;
+	if (count == 0) return crc;
+
+	size_t read_off = (m_read + off) % m_end;
+
+	size_t nread = 0;
+	while (nread != count) {
+		size_t n = std::min(_linear_size(read_off), count - nread);
+		crc = crc32c(crc, m_buf + read_off, n);
+		read_off += n;
+		nread += n;
+
+		// wrap 
+		if (read_off >= m_end) read_off -= m_end;
+	}
+
+	return crc;
+}
+
+//-------------------------------------------------------------------------------------
+const uint8_t* RingBuf::peek_view(size_t off, size_t& count) const
+{
+	size_t bytes_used = size();
+	if (off >= bytes_used) {
+		count = 0;
+		return nullptr;
+	}
+
+	size_t read_off = (m_read + off) % m_end;
+	count = std::min(_linear_size(read_off), bytes_used - off);
+	return m_buf + read_off;
+}
+
 //-------------------------------------------------------------------------------------
 uint8_t* RingBuf::normalize(void)
 {
 	if (empty()) reset();
-	if (m_write >= m_read) return m_buf + m_read;
+	if (m_write >= m_read || m_mirrored) return m_buf + m_read;
 
 	//need move memory
 	char default_temp_block[kDefaultCapacity];
@@ -401,7 +605,7 @@ uint8_t* RingBuf::normalize(void)
 
 	//alloc a temp block memory
 	size_t temp_block = std::min(first_block, second_block);
-	char* p = (temp_block <= kDefaultCapacity) ? default_temp_block : (char*)CY_MALLOC(temp_block);
+	char* p = (temp_block <= kDefaultCapacity) ? default_temp_block : (char*)CY_MALLOC_TAG(temp_block, memory::kTagRingBuf);
 
 	//which block is the smaller block?
 	if (first_block <= second_block) {
@@ -23,6 +23,15 @@ Copyright(C) thecodeway.com
 ///    |                   |                  |                  |
 /// m_beginPoint <=     m_writeIndex   <=   m_readIndex   <=  m_endIndex
 ///
+///  mirrored mode, the same pages are mapped twice back to back, so the readable
+///  (and writable) bytes are always contiguous in memory
+///    +-------------------+------------------+------------------+-------------------+
+///    |  readable bytes   |  writable bytes  |  readable bytes  |  readable bytes   |
+///    |  (CONTENT PART2)  |                  | (CONTENT PART1)  |  (CONTENT PART2)  |
+///    +-------------------+------------------+------------------+-------------------+
+///    |                   |                  |                  |                   |
+/// m_beginPoint <=     m_writeIndex   <=   m_readIndex   <=  m_endIndex  <=  m_endIndex*2
+///
 
 namespace cyclone
 {
@@ -59,7 +68,7 @@ public:
 
 	/// return is full
 	bool full(void) const {
-		return get_free_size() == 0;
+		return m_buf != nullptr && get_free_size() == 0;
 	}
 
 	//// re-alloca memory, make sure capacity greater need_size
@@ -99,11 +108,66 @@ public:
 	//// or len equ 0 return initial adler value (1)
 	uint32_t checksum(size_t off, size_t count) const;
 
+	//// calculate the crc32c of data from off to off+len
+	//// if off greater than size() or off+count greater than size() 
+	//// or len equ 0 return initial crc32c value (0)
+	uint32_t checksum_crc32c(size_t off, size_t count) const;
+
 	//// move all data to a flat memory block and return point
+	//// (mirrored buffer is always flat, no memory will be moved)
 	uint8_t* normalize(void);
 
+	//// get the point of data from `off` without copy, `count` returns the size of
+	//// contiguous bytes, it's all the data after `off` if the buffer is mirrored.
+	//// return nullptr if no data. the point is invalid after any write operation
+	const uint8_t* peek_view(size_t off, size_t& count) const;
+
+	//// call `func(uint8_t* data, size_t len)` on every contiguous span of data from off to off+count
+	//// (two spans at most), the data can be modified in place(e.g. encrypt).
+	//// return false and do nothing if the range is out of data
+	template<typename FUNC>
+	bool for_each_span(size_t off, size_t count, FUNC func) {
+		if (off + count > size()) return false;
+
+		size_t span_off = (m_read + off) % m_end;
+		size_t done = 0;
+		while (done != count) {
+			size_t n = std::min(_linear_size(span_off), count - done);
+			func(m_buf + span_off, n);
+			span_off += n;
+			done += n;
+
+			// wrap
+			if (span_off >= m_end) span_off -= m_end;
+		}
+		return true;
+	}
+
+	//// is mirrored buffer
+	bool is_mirrored(void) const { return m_mirrored; }
+
+	//// free the internal memory if the ring buffer is empty, the memory will be
+	//// allocated again when next data come in. return true if memory was released
+	bool release_memory(void);
+
+	//// set the shrink policy of all ring buf(thread safe). The memory comes from the
+	//// per-thread BufPool, a buffer bigger than default capacity is shrunk back after its
+	//// data size stays below `usage_percent`% of capacity for `idle_ms` milliseconds
+	//// (checked when data is consumed, or by shrink_if_idle()).
+	//// idle_ms=0 shrinks at once, usage_percent=0 disables it
+	static void set_shrink_policy(int32_t idle_ms, int32_t usage_percent);
+
+	//// check the shrink policy without consuming data, call it periodically for a buffer
+	//// which may stay idle after drained(e.g. connection timer). return true if shrunk
+	bool shrink_if_idle(void);
+
+	enum { kDefaultShrinkIdleMs = 10 * 1000, kDefaultShrinkUsagePercent = 25 };
+
 public:
-	RingBuf(size_t capacity = kDefaultCapacity);
+	/// capacity=0 means lazy mode, no memory is allocated until the first write
+	/// mirrored=true maps the memory twice(memfd_create+mmap, linux only), the capacity is rounded
+	/// up to page size. It falls back to normal buffer if the platform doesn't support it
+	RingBuf(size_t capacity = kDefaultCapacity, bool mirrored = false);
 	~RingBuf();
 
 private:
@@ -111,6 +175,25 @@ private:
 	size_t m_end;
 	size_t m_read;
 	size_t m_write;
+	int64_t m_low_since;	//time(us) when the usage became low, -1 means not low
+	bool m_mirrored;
+
+private:
+	//// bytes can be accessed linearly from `off`
+	size_t _linear_size(size_t off) const {
+		return (m_mirrored ? m_end * 2 : m_end) - off;
+	}
+
+	//// round up the end index to the size that can be allocated
+	size_t _round_end(size_t end) const;
+
+	//// move data to a new block memory with m_end=new_end
+	void _realloc(size_t new_end);
+
+	//// check shrink policy after data consumed
+	bool _check_shrink(void);
+	//// reset the low usage time after data written
+	void _check_usage_high(void);
 };
 
 }
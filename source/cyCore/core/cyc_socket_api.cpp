@@ -12,6 +12,20 @@ Copyright(C) thecodeway.com
 #endif
 #include <fcntl.h>
 
+//UDP segmentation offload(GSO) since linux 4.18, receive offload(GRO) since linux 5.0
+#if defined(CY_SYS_LINUX) || defined(CY_SYS_ANDROID)
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#define CY_HAVE_UDP_OFFLOAD 1
+#endif
+
 //
 // Winsock Reference https://msdn.microsoft.com/en-us/library/ms741416(v=vs.85).aspx
 //
@@ -241,6 +255,123 @@ ssize_t recvfrom(socket_t s, void* buf, size_t len, struct sockaddr_in& peer_add
 	return _len;
 }
 
+//-------------------------------------------------------------------------------------
+int32_t recv_batch(socket_t s, datagram_t* datagrams, int32_t counts)
+{
+	if (counts > MAX_BATCH_DATAGRAMS) counts = MAX_BATCH_DATAGRAMS;
+
+#ifdef CY_HAVE_RECVMMSG
+	struct mmsghdr msgs[MAX_BATCH_DATAGRAMS];
+	struct iovec iovs[MAX_BATCH_DATAGRAMS];
+	//the segment size of GRO is passed in control message
+	union { char buf[CMSG_SPACE(sizeof(int))]; struct cmsghdr align; } controls[MAX_BATCH_DATAGRAMS];
+
+	memset(msgs, 0, sizeof(msgs[0]) * (size_t)counts);
+	for (int32_t i = 0; i < counts; i++) {
+		iovs[i].iov_base = datagrams[i].buf;
+		iovs[i].iov_len = datagrams[i].len;
+		msgs[i].msg_hdr.msg_name = &(datagrams[i].peer_addr);
+		msgs[i].msg_hdr.msg_namelen = (socklen_t)sizeof(datagrams[i].peer_addr);
+		msgs[i].msg_hdr.msg_iov = &(iovs[i]);
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = controls[i].buf;
+		msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
+	}
+
+	int ret = ::recvmmsg(s, msgs, (unsigned int)counts, 0, nullptr);
+	if (ret < 0) {
+		return is_lasterror_WOULDBLOCK() ? 0 : -1;
+	}
+
+	for (int32_t i = 0; i < ret; i++) {
+		datagram_t& dgram = datagrams[i];
+		dgram.len = msgs[i].msg_len;
+		dgram.truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+		dgram.segment_size = 0;
+#ifdef CY_HAVE_UDP_OFFLOAD
+		for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&(msgs[i].msg_hdr)); cmsg != nullptr; cmsg = CMSG_NXTHDR(&(msgs[i].msg_hdr), cmsg)) {
+			if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+				int segment_size = 0;
+				memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+				dgram.segment_size = (uint16_t)segment_size;
+			}
+		}
+#endif
+	}
+	return ret;
+#else
+	int32_t i = 0;
+	for (; i < counts; i++) {
+		datagram_t& dgram = datagrams[i];
+		ssize_t len = recvfrom(s, dgram.buf, dgram.len, dgram.peer_addr);
+		if (len < 0) {
+			if (i > 0 || is_lasterror_WOULDBLOCK()) break;
+			return -1;
+		}
+		dgram.len = (size_t)len;
+		dgram.segment_size = 0;
+		dgram.truncated = false;
+	}
+	return i;
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+int32_t send_batch(socket_t s, const datagram_t* datagrams, int32_t counts)
+{
+	if (counts > MAX_BATCH_DATAGRAMS) counts = MAX_BATCH_DATAGRAMS;
+
+#ifdef CY_HAVE_SENDMMSG
+	struct mmsghdr msgs[MAX_BATCH_DATAGRAMS];
+	struct iovec iovs[MAX_BATCH_DATAGRAMS];
+	union { char buf[CMSG_SPACE(sizeof(uint16_t))]; struct cmsghdr align; } controls[MAX_BATCH_DATAGRAMS];
+
+	memset(msgs, 0, sizeof(msgs[0]) * (size_t)counts);
+	for (int32_t i = 0; i < counts; i++) {
+		const datagram_t& dgram = datagrams[i];
+		iovs[i].iov_base = dgram.buf;
+		iovs[i].iov_len = dgram.len;
+		msgs[i].msg_hdr.msg_name = const_cast<struct sockaddr_in*>(&(dgram.peer_addr));
+		msgs[i].msg_hdr.msg_namelen = (socklen_t)sizeof(dgram.peer_addr);
+		msgs[i].msg_hdr.msg_iov = &(iovs[i]);
+		msgs[i].msg_hdr.msg_iovlen = 1;
+
+#ifdef CY_HAVE_UDP_OFFLOAD
+		if (dgram.segment_size > 0 && dgram.len > dgram.segment_size) {
+			//the kernel splits the buf into datagrams
+			msgs[i].msg_hdr.msg_control = controls[i].buf;
+			msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
+
+			struct cmsghdr* cmsg = CMSG_FIRSTHDR(&(msgs[i].msg_hdr));
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			memcpy(CMSG_DATA(cmsg), &(dgram.segment_size), sizeof(uint16_t));
+		}
+#else
+		(void)controls;
+#endif
+	}
+
+	int ret = ::sendmmsg(s, msgs, (unsigned int)counts, 0);
+	if (ret < 0) {
+		return is_lasterror_WOULDBLOCK() ? 0 : -1;
+	}
+	return ret;
+#else
+	int32_t i = 0;
+	for (; i < counts; i++) {
+		const datagram_t& dgram = datagrams[i];
+		assert(dgram.segment_size == 0);
+		if (sendto(s, (const char*)dgram.buf, dgram.len, dgram.peer_addr) < 0) {
+			if (i > 0 || is_lasterror_WOULDBLOCK()) break;
+			return -1;
+		}
+	}
+	return i;
+#endif
+}
+
 //-------------------------------------------------------------------------------------
 bool shutdown(socket_t s)
 {
@@ -289,6 +420,33 @@ bool set_reuse_port(socket_t s, bool on)
 #endif
 }
 
+//-------------------------------------------------------------------------------------
+bool set_udp_gro(socket_t s, bool on)
+{
+#ifdef CY_HAVE_UDP_OFFLOAD
+	//don't log the error, it's not supported by old kernel
+	int optval = on ? 1 : 0;
+	return 0 == ::setsockopt(s, SOL_UDP, UDP_GRO, &optval, static_cast<socklen_t>(sizeof optval));
+#else
+	(void)s;
+	(void)on;
+	return false;
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+bool is_udp_gso_supported(socket_t s)
+{
+#ifdef CY_HAVE_UDP_OFFLOAD
+	int optval = 0;
+	socklen_t optlen = static_cast<socklen_t>(sizeof optval);
+	return 0 == ::getsockopt(s, SOL_UDP, UDP_SEGMENT, &optval, &optlen);
+#else
+	(void)s;
+	return false;
+#endif
+}
+
 //-------------------------------------------------------------------------------------
 bool set_keep_alive(socket_t s, bool on)
 {
@@ -49,6 +49,25 @@ ssize_t read(socket_t s, void *buf, size_t len);
 /// receive from socket
 ssize_t recvfrom(socket_t s, void* buf, size_t len, struct sockaddr_in& peer_addr);
 
+/// one datagram of recv_batch/send_batch
+struct datagram_t
+{
+	void* buf;
+	size_t len;					//size of buf when receiving(set to the received size), size of data when sending
+	struct sockaddr_in peer_addr;
+	uint16_t segment_size;		//GRO/GSO segment size, the buf holds several datagrams of this size(the last one may be shorter), 0 means one datagram
+	bool truncated;				//the datagram is bigger than buf and has been truncated(receiving only)
+};
+enum { MAX_BATCH_DATAGRAMS = 64 };
+
+/// receive datagrams with one system call(recvmmsg) if the system supports, return the counts of
+/// received datagrams, 0 if no datagram is ready(non-block socket), -1 if failed
+int32_t recv_batch(socket_t s, datagram_t* datagrams, int32_t counts);
+
+/// send datagrams with one system call(sendmmsg) if the system supports, return the counts of
+/// sent datagrams, 0 if the send buffer is full(non-block socket), -1 if failed
+int32_t send_batch(socket_t s, const datagram_t* datagrams, int32_t counts);
+
 /// shutdown read and write part of a socket connection
 bool shutdown(socket_t s);
 
@@ -67,6 +86,12 @@ bool set_reuse_addr(socket_t s, bool on);
 /// Enable/disable SO_REUSEPORT
 bool set_reuse_port(socket_t s, bool on);
 
+/// Enable/disable UDP generic receive offload(UDP_GRO), return false if the system does not support
+bool set_udp_gro(socket_t s, bool on);
+
+/// is UDP generic segmentation offload(UDP_SEGMENT) supported by the system
+bool is_udp_gso_supported(socket_t s);
+
 /// Enable/disable SO_KEEPALIVE
 bool set_keep_alive(socket_t s, bool on);
 
@@ -10,6 +10,9 @@ Copyright(C) thecodeway.com
 #else
 #include <sys/syscall.h>
 #include <sys/time.h>
+#ifdef CY_SYS_LINUX
+#include <linux/futex.h>
+#endif
 #include <sched.h>
 #include <condition_variable>
 #endif
@@ -18,9 +21,16 @@ Copyright(C) thecodeway.com
 #include <libproc.h>
 #endif
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CY_HAVE_TSC 1
+#endif
+
 #include <time.h>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 
 namespace cyclone
@@ -211,6 +221,149 @@ void thread_yield(void)
 	std::this_thread::yield();
 }
 
+//-------------------------------------------------------------------------------------
+namespace {
+
+//-------------------------------------------------------------------------------------
+inline void _cpu_relax(void)
+{
+#ifdef CY_HAVE_TSC
+	_mm_pause();
+#else
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+#ifndef CY_SYS_LINUX
+//-------------------------------------------------------------------------------------
+// parking table, the waiters of the same address are always in the same bucket
+struct ParkingBucket
+{
+	std::mutex mu;
+	std::condition_variable cv;
+};
+
+enum { kParkingBuckets = 64 };
+
+ParkingBucket& _get_parking_bucket(const void* addr)
+{
+	static ParkingBucket buckets[kParkingBuckets];
+	return buckets[((uintptr_t)addr >> 4) % kParkingBuckets];
+}
+#endif
+
+}
+
+//-------------------------------------------------------------------------------------
+void futex_wait(std::atomic<int32_t>* addr, int32_t expected)
+{
+#ifdef CY_SYS_LINUX
+	::syscall(SYS_futex, (int32_t*)addr, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+	ParkingBucket& bucket = _get_parking_bucket(addr);
+	std::unique_lock<std::mutex> guard(bucket.mu);
+	if (addr->load() == expected) bucket.cv.wait(guard);
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+void futex_wake(std::atomic<int32_t>* addr, bool all)
+{
+#ifdef CY_SYS_LINUX
+	::syscall(SYS_futex, (int32_t*)addr, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, nullptr, nullptr, 0);
+#else
+	(void)all;
+	//other addresses may share the bucket, wake all of them
+	ParkingBucket& bucket = _get_parking_bucket(addr);
+	std::lock_guard<std::mutex> guard(bucket.mu);
+	bucket.cv.notify_all();
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+void futex_mutex::_lock_slow(int32_t c, int32_t spin_counts)
+{
+	//spin while the lock is held without waiters
+	for (int32_t i = 0; i < spin_counts && c == kLocked; i++) {
+		_cpu_relax();
+		c = m_state.load(std::memory_order_relaxed);
+		if (c == kUnlocked) {
+			if (m_state.compare_exchange_strong(c, kLocked, std::memory_order_acquire, std::memory_order_relaxed)) return;
+		}
+	}
+
+	//mark contended and park
+	if (c != kContended) c = m_state.exchange(kContended, std::memory_order_acquire);
+	while (c != kUnlocked) {
+		futex_wait(&m_state, kContended);
+		c = m_state.exchange(kContended, std::memory_order_acquire);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void rw_mutex::_wake(void)
+{
+	if (m_sleepers.load() == 0) return;
+	m_seq++;
+	futex_wake(&m_seq, true);
+}
+
+//-------------------------------------------------------------------------------------
+void rw_mutex::lock_shared(void)
+{
+	for (int32_t i = 0; ; i++) {
+		int32_t s = m_state.load();
+		if (s >= 0 && m_writers_waiting.load() == 0) {
+			if (m_state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) return;
+			continue;
+		}
+		if (i < spin_mutex::kSpinCounts) {
+			_cpu_relax();
+			continue;
+		}
+
+		//recheck the state after m_sleepers increased, so the wake can't be lost
+		int32_t seq = m_seq.load();
+		m_sleepers++;
+		s = m_state.load();
+		if (s < 0 || m_writers_waiting.load() != 0) futex_wait(&m_seq, seq);
+		m_sleepers--;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void rw_mutex::unlock_shared(void)
+{
+	if (m_state.fetch_sub(1) == 1) _wake();
+}
+
+//-------------------------------------------------------------------------------------
+void rw_mutex::lock(void)
+{
+	m_writers_waiting++;
+	for (int32_t i = 0; ; i++) {
+		int32_t s = 0;
+		if (m_state.compare_exchange_weak(s, -1, std::memory_order_acquire)) break;
+		if (i < spin_mutex::kSpinCounts) {
+			_cpu_relax();
+			continue;
+		}
+
+		int32_t seq = m_seq.load();
+		m_sleepers++;
+		if (m_state.load() != 0) futex_wait(&m_seq, seq);
+		m_sleepers--;
+	}
+	m_writers_waiting--;
+}
+
+//-------------------------------------------------------------------------------------
+void rw_mutex::unlock(void)
+{
+	m_state.store(0);
+	_wake();
+}
+
 //-------------------------------------------------------------------------------------
 struct mutex_data_s
 {
@@ -535,6 +688,118 @@ int64_t performance_time_now(void)
 #endif
 }
 
+//-------------------------------------------------------------------------------------
+namespace {
+
+//-------------------------------------------------------------------------------------
+int64_t _monotonic_now_ns(void)
+{
+#ifdef CY_SYS_WINDOWS
+	return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	struct timespec tsNow = { 0, 0 };
+	clock_gettime(CLOCK_MONOTONIC, &tsNow);
+	return (int64_t)tsNow.tv_sec * 1000ll * 1000ll * 1000ll + tsNow.tv_nsec;
+#endif
+}
+
+#ifdef CY_HAVE_TSC
+//-------------------------------------------------------------------------------------
+__extension__ typedef unsigned __int128 uint128_t;
+
+// ns = base_ns + ((tsc - base_tsc) * mult) >> kShift
+struct TscClock
+{
+	enum { kUnknown = 0, kCalibrating, kReady, kUnavailable };
+	enum { kShift = 32 };
+	static const int64_t kCalibrationTime = 50ll * 1000ll * 1000ll;	//ns
+
+	std::atomic<int32_t> state;
+	atomic_bool_t publishing;
+	uint64_t begin_tsc;
+	int64_t begin_ns;
+	uint64_t base_tsc;
+	int64_t base_ns;
+	uint64_t mult;
+
+	constexpr TscClock() : state(kUnknown), publishing(false), begin_tsc(0), begin_ns(0), base_tsc(0), base_ns(0), mult(0) {}
+
+	//the TSC runs at constant rate in all ACPI P-, C- and T-states
+	static bool is_invariant(void)
+	{
+		unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+		if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) return false;
+		if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) return false;
+		return (edx & (1u << 8)) != 0;
+	}
+
+	int64_t now(void)
+	{
+		if (state.load(std::memory_order_acquire) == kReady) {
+			uint64_t delta = __rdtsc() - base_tsc;
+			return base_ns + (int64_t)(((uint128_t)delta * mult) >> kShift);
+		}
+		return _slow_now();
+	}
+
+	int64_t _slow_now(void)
+	{
+		static std::once_flag initialzed;
+		std::call_once(initialzed, [this]() {
+			if (!is_invariant()) {
+				state = kUnavailable;
+				return;
+			}
+			begin_ns = _monotonic_now_ns();
+			begin_tsc = __rdtsc();
+			state = kCalibrating;
+		});
+
+		int64_t now_ns = _monotonic_now_ns();
+		if (state.load(std::memory_order_acquire) != kCalibrating || now_ns - begin_ns < kCalibrationTime) return now_ns;
+
+		//only one thread publish the result
+		if (publishing.exchange(true)) return now_ns;
+
+		uint64_t now_tsc = __rdtsc();
+		if (now_tsc <= begin_tsc) {
+			state = kUnavailable;
+			return now_ns;
+		}
+		mult = (uint64_t)((((uint128_t)(now_ns - begin_ns)) << kShift) / (now_tsc - begin_tsc));
+		base_tsc = now_tsc;
+		base_ns = now_ns;
+		state.store(kReady, std::memory_order_release);
+		return now_ns;
+	}
+};
+
+static TscClock s_tsc_clock;
+#endif
+
+}
+
+//-------------------------------------------------------------------------------------
+int64_t fast_now_ns(void)
+{
+#ifdef CY_HAVE_TSC
+	return s_tsc_clock.now();
+#else
+	return _monotonic_now_ns();
+#endif
+}
+
+//-------------------------------------------------------------------------------------
+bool fast_now_is_tsc(void)
+{
+#ifdef CY_HAVE_TSC
+	return s_tsc_clock.state.load() == TscClock::kReady;
+#else
+	return false;
+#endif
+}
+
 //-------------------------------------------------------------------------------------
 int32_t get_cpu_counts(void)
 {
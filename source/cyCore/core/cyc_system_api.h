@@ -119,6 +119,99 @@ struct auto_mutex
 	mutex_t _m;
 };
 
+//----------------------
+// lightweight lock functions
+//----------------------
+// The locks below are plain objects(no allocation, can be used as class member),
+// the uncontended lock/unlock is one atomic instruction. They are NOT reentrant,
+// lock twice in the same thread is a deadlock.
+
+/// Block the calling thread while `*addr == expected`, may return spuriously.
+/// Use futex on linux, a hashed table of condition variables on other platforms.
+void futex_wait(std::atomic<int32_t>* addr, int32_t expected);
+
+/// Wake one(or all) threads waiting on `addr`
+void futex_wake(std::atomic<int32_t>* addr, bool all);
+
+/// Mutex with three states(unlocked, locked, locked with waiters), the thread parks
+/// in kernel immediately if the lock is held by another thread.
+class futex_mutex : noncopyable
+{
+public:
+	void lock(void) {
+		int32_t c = kUnlocked;
+		if (!m_state.compare_exchange_strong(c, kLocked, std::memory_order_acquire, std::memory_order_relaxed)) _lock_slow(c, 0);
+	}
+	bool try_lock(void) {
+		int32_t c = kUnlocked;
+		return m_state.compare_exchange_strong(c, kLocked, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+	void unlock(void) {
+		if (m_state.exchange(kUnlocked, std::memory_order_release) == kContended) futex_wake(&m_state, false);
+	}
+
+public:
+	futex_mutex() : m_state(kUnlocked) {}
+
+protected:
+	enum { kUnlocked = 0, kLocked = 1, kContended = 2 };
+	std::atomic<int32_t> m_state;
+
+	void _lock_slow(int32_t c, int32_t spin_counts);
+};
+
+/// Adaptive mutex, spin for a while before parking in kernel, for the short 
+/// critical section which is seldom contended.
+class spin_mutex : public futex_mutex
+{
+public:
+	enum { kSpinCounts = 100 };
+
+	void lock(void) {
+		int32_t c = kUnlocked;
+		if (!m_state.compare_exchange_strong(c, kLocked, std::memory_order_acquire, std::memory_order_relaxed)) _lock_slow(c, kSpinCounts);
+	}
+};
+
+/// Reader-writer lock, many readers or one writer. The waiting writer blocks the
+/// new readers(writer preferred).
+class rw_mutex : noncopyable
+{
+public:
+	void lock_shared(void);
+	void unlock_shared(void);
+	void lock(void);
+	void unlock(void);
+
+public:
+	rw_mutex() : m_state(0), m_writers_waiting(0), m_sleepers(0), m_seq(0) {}
+
+private:
+	std::atomic<int32_t> m_state;			//-1: writer locked, 0: free, >0: reader counts
+	std::atomic<int32_t> m_writers_waiting;
+	std::atomic<int32_t> m_sleepers;
+	std::atomic<int32_t> m_seq;				//changed every time the waiters should recheck
+
+	void _wake(void);
+};
+
+/// RAII helper of futex_mutex/spin_mutex/rw_mutex(writer)
+template<typename LOCK>
+struct auto_lock
+{
+	auto_lock(LOCK& l) : _l(l) { _l.lock(); }
+	~auto_lock() { _l.unlock(); }
+	LOCK& _l;
+};
+
+/// RAII helper of rw_mutex(reader)
+struct auto_read_lock
+{
+	auto_read_lock(rw_mutex& l) : _l(l) { _l.lock_shared(); }
+	~auto_read_lock() { _l.unlock_shared(); }
+	rw_mutex& _l;
+};
+
 //----------------------
 // signal functions
 //----------------------
@@ -172,8 +265,20 @@ void local_time_now(char* time_dest, size_t max_size, const char* format);
 
 /// Return a high-resolution performance counter value. The return value is
 /// microseconds(second*1000*1000) elapsed since the first call to this function (monotonic).
+/// It always reads the system monotonic clock, the same clock of timers.
 int64_t performance_time_now(void);
 
+/// Return a monotonic time in nanoseconds, the base is not defined(only the difference
+/// of two values is meaningful). It reads the TSC of CPU directly when the TSC is
+/// invariant, the TSC frequency is calibrated against the system monotonic clock in the
+/// first 50ms, the system monotonic clock is used before calibration done or if the TSC
+/// is not available. It's opt-in for hot paths which can accept a small drift from the
+/// system clock, the calibration is never repeated.
+int64_t fast_now_ns(void);
+
+/// Is fast_now_ns() using the TSC now
+bool fast_now_is_tsc(void);
+
 //----------------------
 // utility functions
 //----------------------
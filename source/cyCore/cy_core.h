@@ -5,9 +5,13 @@ Copyright(C) thecodeway.com
 
 #include <cyclone_config.h>
 
+#include <core/cyc_allocator.h>
 #include <core/cyc_logger.h>
 #include <core/cyc_socket_api.h>
 #include <core/cyc_system_api.h>
 #include <core/cyc_ring_buf.h>
 #include <core/cyc_atomic.h>
 #include <core/cyc_lf_queue.h>
+#include <core/cyc_rcu.h>
+#include <core/cyc_intrusive_ptr.h>
+#include <core/cyc_buf_pool.h>
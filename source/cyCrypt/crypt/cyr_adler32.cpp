@@ -3,6 +3,11 @@ Copyright(C) thecodeway.com
 */
 #include <cy_crypt.h>
 #include "cyr_adler32.h"
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <immintrin.h>
+#endif
 
 /* adler32.c -- compute the Adler-32 checksum of a data stream
 * Copyright (C) 1995-2011 Mark Adler
@@ -63,15 +68,11 @@ namespace cyclone
 #  define MOD28(a) a %= BASE
 #  define MOD63(a) a %= BASE
 #endif
-uint32_t adler32(uint32_t adler, const uint8_t* buf, size_t len)
+static uint32_t _adler32_scalar(uint32_t adler, const uint8_t* buf, size_t len)
 {
 	uint32_t sum2;
     unsigned n;
-	
-	/* initial Adler-32 value */
-	if (buf == nullptr || len == 0)
-		return INITIAL_ADLER;
-	
+
 	/* split Adler-32 into component sums */
     sum2 = (adler >> 16) & 0xffff;
     adler &= 0xffff;
@@ -130,4 +131,206 @@ uint32_t adler32(uint32_t adler, const uint8_t* buf, size_t len)
     return adler | (sum2 << 16);
 }
 
+//-------------------------------------------------------------------------------------
+//sum the remaining bytes(less than NMAX) after the vector blocks
+static inline uint32_t _adler32_tail(uint32_t adler, uint32_t sum2, const uint8_t* buf, size_t len)
+{
+	if (len) {
+		while (len >= 16) {
+			len -= 16;
+			DO16(buf);
+			buf += 16;
+		}
+		while (len--) {
+			adler += (uint32_t)(*buf++);
+			sum2 += adler;
+		}
+		MOD(adler);
+		MOD(sum2);
+	}
+	return adler | (sum2 << 16);
+}
+
+#if defined(CY_CRYPT_X86)
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+//-------------------------------------------------------------------------------------
+//For a block of n bytes, adler(s1) increases by the sum of the bytes, and sum2(s2)
+//increases by n*s1 plus the sum of byte[i]*(n-i). The byte sums are made by psadbw and
+//the weighted sums by pmaddubsw, s1 of every block is accumulated in `ps` and
+//multiplied by the block size once before the modulo.
+SSSE3_TARGET
+static uint32_t _adler32_ssse3(uint32_t adler, const uint8_t* buf, size_t len)
+{
+	const unsigned BLOCK = 32;
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = adler >> 16;
+
+	size_t blocks = len / BLOCK;
+	len -= blocks * BLOCK;
+
+	const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+
+	while (blocks) {
+		unsigned n = NMAX / BLOCK;
+		if (n > blocks) n = (unsigned)blocks;
+		blocks -= n;
+
+		__m128i v_ps = _mm_set_epi32(0, 0, 0, (int)(s1 * n));
+		__m128i v_s2 = _mm_set_epi32(0, 0, 0, (int)s2);
+		__m128i v_s1 = _mm_setzero_si128();
+		do {
+			const __m128i bytes1 = _mm_loadu_si128((const __m128i*)buf);
+			const __m128i bytes2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+
+			v_ps = _mm_add_epi32(v_ps, v_s1);
+			v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+			v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+			v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+			v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+			buf += BLOCK;
+		} while (--n);
+		v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+		//horizontal sum
+		v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 += (uint32_t)_mm_cvtsi128_si32(v_s1);
+		v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s2 = (uint32_t)_mm_cvtsi128_si32(v_s2);
+
+		MOD(s1);
+		MOD(s2);
+	}
+	return _adler32_tail(s1, s2, buf, len);
+}
+
+//-------------------------------------------------------------------------------------
+AVX2_TARGET
+static uint32_t _adler32_avx2(uint32_t adler, const uint8_t* buf, size_t len)
+{
+	const unsigned BLOCK = 64;
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = adler >> 16;
+
+	size_t blocks = len / BLOCK;
+	len -= blocks * BLOCK;
+
+	const __m256i tap1 = _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49,
+		48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33);
+	const __m256i tap2 = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+
+	while (blocks) {
+		unsigned n = NMAX / BLOCK;
+		if (n > blocks) n = (unsigned)blocks;
+		blocks -= n;
+
+		__m256i v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0);
+		__m256i v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+		__m256i v_s1 = _mm256_setzero_si256();
+		do {
+			const __m256i bytes1 = _mm256_loadu_si256((const __m256i*)buf);
+			const __m256i bytes2 = _mm256_loadu_si256((const __m256i*)(buf + 32));
+
+			v_ps = _mm256_add_epi32(v_ps, v_s1);
+			v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes1, zero));
+			v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes1, tap1), ones));
+			v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes2, zero));
+			v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes2, tap2), ones));
+			buf += BLOCK;
+		} while (--n);
+		v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 6));
+
+		//horizontal sum
+		__m128i h_s1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+		h_s1 = _mm_add_epi32(h_s1, _mm_shuffle_epi32(h_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+		h_s1 = _mm_add_epi32(h_s1, _mm_shuffle_epi32(h_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 += (uint32_t)_mm_cvtsi128_si32(h_s1);
+		__m128i h_s2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+		h_s2 = _mm_add_epi32(h_s2, _mm_shuffle_epi32(h_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+		h_s2 = _mm_add_epi32(h_s2, _mm_shuffle_epi32(h_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s2 = (uint32_t)_mm_cvtsi128_si32(h_s2);
+
+		MOD(s1);
+		MOD(s2);
+	}
+	return _adler32_tail(s1, s2, buf, len);
+}
+#endif
+
+//-------------------------------------------------------------------------------------
+typedef uint32_t(*Adler32Func)(uint32_t adler, const uint8_t* buf, size_t len);
+
+static Adler32Func _adler32_func(Adler32Implementation impl)
+{
+	if (!adler32_is_supported(impl)) return _adler32_scalar;
+
+	switch (impl) {
+#if defined(CY_CRYPT_X86)
+	case ADLER32_SSSE3: return _adler32_ssse3;
+	case ADLER32_AVX2: return _adler32_avx2;
+#endif
+	case ADLER32_AUTO:
+		if (adler32_is_supported(ADLER32_AVX2)) return _adler32_func(ADLER32_AVX2);
+		if (adler32_is_supported(ADLER32_SSSE3)) return _adler32_func(ADLER32_SSSE3);
+		return _adler32_scalar;
+	default: return _adler32_scalar;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+uint32_t adler32(uint32_t adler, const uint8_t* buf, size_t len, Adler32Implementation impl)
+{
+	/* initial Adler-32 value */
+	if (buf == nullptr || len == 0)
+		return INITIAL_ADLER;
+
+	//short data is not worth the vector setup
+	if (len < 64) return _adler32_scalar(adler, buf, len);
+
+	if (impl == ADLER32_AUTO) {
+		static const Adler32Func auto_func = _adler32_func(ADLER32_AUTO);
+		return auto_func(adler, buf, len);
+	}
+	return _adler32_func(impl)(adler, buf, len);
+}
+
+//-------------------------------------------------------------------------------------
+bool adler32_is_supported(Adler32Implementation impl)
+{
+	switch (impl) {
+	case ADLER32_AUTO:
+	case ADLER32_SCALAR:
+		return true;
+#if defined(CY_CRYPT_X86)
+	case ADLER32_SSSE3:
+		return get_cpu_features().ssse3;
+	case ADLER32_AVX2:
+		return get_cpu_features().avx2;
+#endif
+	default:
+		return false;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+const char* adler32_implementation_name(Adler32Implementation impl)
+{
+	switch (impl) {
+	case ADLER32_AUTO: return "auto";
+	case ADLER32_SCALAR: return "scalar";
+	case ADLER32_SSSE3: return "ssse3";
+	case ADLER32_AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
 }
@@ -27,7 +27,21 @@ namespace cyclone
 *   adler = cyclone::adler32(adler, buffer, length);
 * }
 *
+* The data is summed by SSSE3 or AVX2 kernels if current cpu supports, the result is
+* the same as the scalar(zlib) implementation.
 */
-uint32_t adler32(uint32_t adler, const uint8_t* buf, size_t len);
+enum Adler32Implementation {
+	ADLER32_AUTO = 0,	//the fastest one supported by current cpu
+	ADLER32_SCALAR,		//zlib
+	ADLER32_SSSE3,		//32 bytes each step
+	ADLER32_AVX2,		//64 bytes each step
+};
+
+//@remark the scalar implementation is used if `impl` is not supported by current cpu
+uint32_t adler32(uint32_t adler, const uint8_t* buf, size_t len, Adler32Implementation impl = ADLER32_AUTO);
+
+//is the implementation supported by current cpu
+bool adler32_is_supported(Adler32Implementation impl);
+const char* adler32_implementation_name(Adler32Implementation impl);
 
 }
@@ -0,0 +1,558 @@
+/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_crypt.h>
+#include <cy_core.h>
+#include "cyr_chacha20.h"
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <immintrin.h>
+#endif
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+static inline uint32_t _load_le32(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+//-------------------------------------------------------------------------------------
+static inline void _store_le32(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+//-------------------------------------------------------------------------------------
+static inline uint32_t _rotl32(uint32_t v, int n)
+{
+	return (v << n) | (v >> (32 - n));
+}
+
+#define CHACHA_QR(a, b, c, d) \
+	a += b; d ^= a; d = _rotl32(d, 16); \
+	c += d; b ^= c; b = _rotl32(b, 12); \
+	a += b; d ^= a; d = _rotl32(d, 8); \
+	c += d; b ^= c; b = _rotl32(b, 7);
+
+//-------------------------------------------------------------------------------------
+void ChaCha20::block(const uint32_t* state, uint8_t* keystream)
+{
+	uint32_t x[16];
+	memcpy(x, state, sizeof(x));
+
+	for (int i = 0; i < 10; i++) {
+		CHACHA_QR(x[0], x[4], x[8], x[12]);
+		CHACHA_QR(x[1], x[5], x[9], x[13]);
+		CHACHA_QR(x[2], x[6], x[10], x[14]);
+		CHACHA_QR(x[3], x[7], x[11], x[15]);
+		CHACHA_QR(x[0], x[5], x[10], x[15]);
+		CHACHA_QR(x[1], x[6], x[11], x[12]);
+		CHACHA_QR(x[2], x[7], x[8], x[13]);
+		CHACHA_QR(x[3], x[4], x[9], x[14]);
+	}
+	for (int i = 0; i < 16; i++) {
+		_store_le32(keystream + i * 4, x[i] + state[i]);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+static void _portable_blocks(uint32_t* state, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	uint8_t keystream[ChaCha20::BLOCK_SIZE];
+	for (size_t i = 0; i < blocks; i++, input += ChaCha20::BLOCK_SIZE, output += ChaCha20::BLOCK_SIZE) {
+		ChaCha20::block(state, keystream);
+		for (size_t j = 0; j < ChaCha20::BLOCK_SIZE; j++) output[j] = (uint8_t)(input[j] ^ keystream[j]);
+		state[12]++;
+	}
+}
+
+//SIMD kernels
+//Each register holds the same state word of 4(SSE2) or 8(AVX2) blocks, so the rounds are the
+//same as the portable code. The words are transposed back to blocks before xor into data.
+#if defined(CY_CRYPT_X86)
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+#define CHACHA_QR_SIMD(ADD, XOR, ROTL, a, b, c, d) \
+	a = ADD(a, b); d = XOR(d, a); d = ROTL(d, 16); \
+	c = ADD(c, d); b = XOR(b, c); b = ROTL(b, 12); \
+	a = ADD(a, b); d = XOR(d, a); d = ROTL(d, 8); \
+	c = ADD(c, d); b = XOR(b, c); b = ROTL(b, 7);
+
+#define CHACHA_DOUBLE_ROUND_SIMD(ADD, XOR, ROTL, x) \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[0], x[4], x[8], x[12]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[1], x[5], x[9], x[13]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[2], x[6], x[10], x[14]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[3], x[7], x[11], x[15]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[0], x[5], x[10], x[15]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[1], x[6], x[11], x[12]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[2], x[7], x[8], x[13]); \
+	CHACHA_QR_SIMD(ADD, XOR, ROTL, x[3], x[4], x[9], x[14]);
+
+#define SSE2_ROTL(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - n))
+#define AVX2_ROTL(v, n) _mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - n))
+
+//-------------------------------------------------------------------------------------
+SSE2_TARGET
+static void _sse2_blocks(uint32_t* state, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	for (size_t n = 0; n + 4 <= blocks; n += 4, input += 256, output += 256) {
+		__m128i x[16], s[16];
+		for (int i = 0; i < 16; i++) s[i] = _mm_set1_epi32((int32_t)state[i]);
+		s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+		for (int i = 0; i < 16; i++) x[i] = s[i];
+
+		for (int i = 0; i < 10; i++) {
+			CHACHA_DOUBLE_ROUND_SIMD(_mm_add_epi32, _mm_xor_si128, SSE2_ROTL, x);
+		}
+
+		//transpose every 4 words of 4 blocks
+		for (int g = 0; g < 4; g++) {
+			__m128i a0 = _mm_add_epi32(x[g * 4 + 0], s[g * 4 + 0]);
+			__m128i a1 = _mm_add_epi32(x[g * 4 + 1], s[g * 4 + 1]);
+			__m128i a2 = _mm_add_epi32(x[g * 4 + 2], s[g * 4 + 2]);
+			__m128i a3 = _mm_add_epi32(x[g * 4 + 3], s[g * 4 + 3]);
+			__m128i t0 = _mm_unpacklo_epi32(a0, a1);
+			__m128i t1 = _mm_unpacklo_epi32(a2, a3);
+			__m128i t2 = _mm_unpackhi_epi32(a0, a1);
+			__m128i t3 = _mm_unpackhi_epi32(a2, a3);
+			__m128i b[4] = { _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3) };
+			for (int k = 0; k < 4; k++) {
+				size_t off = (size_t)(k * 64 + g * 16);
+				__m128i in = _mm_loadu_si128((const __m128i*)(input + off));
+				_mm_storeu_si128((__m128i*)(output + off), _mm_xor_si128(in, b[k]));
+			}
+		}
+		state[12] += 4;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+AVX2_TARGET
+static void _avx2_blocks(uint32_t* state, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	for (size_t n = 0; n + 8 <= blocks; n += 8, input += 512, output += 512) {
+		__m256i x[16], s[16];
+		for (int i = 0; i < 16; i++) s[i] = _mm256_set1_epi32((int32_t)state[i]);
+		s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+		for (int i = 0; i < 16; i++) x[i] = s[i];
+
+		for (int i = 0; i < 10; i++) {
+			CHACHA_DOUBLE_ROUND_SIMD(_mm256_add_epi32, _mm256_xor_si256, AVX2_ROTL, x);
+		}
+
+		//transpose in 128 bits lanes, the low lane is block k and the high lane is block k+4
+		__m256i b[4][4];
+		for (int g = 0; g < 4; g++) {
+			__m256i a0 = _mm256_add_epi32(x[g * 4 + 0], s[g * 4 + 0]);
+			__m256i a1 = _mm256_add_epi32(x[g * 4 + 1], s[g * 4 + 1]);
+			__m256i a2 = _mm256_add_epi32(x[g * 4 + 2], s[g * 4 + 2]);
+			__m256i a3 = _mm256_add_epi32(x[g * 4 + 3], s[g * 4 + 3]);
+			__m256i t0 = _mm256_unpacklo_epi32(a0, a1);
+			__m256i t1 = _mm256_unpacklo_epi32(a2, a3);
+			__m256i t2 = _mm256_unpackhi_epi32(a0, a1);
+			__m256i t3 = _mm256_unpackhi_epi32(a2, a3);
+			b[g][0] = _mm256_unpacklo_epi64(t0, t1);
+			b[g][1] = _mm256_unpackhi_epi64(t0, t1);
+			b[g][2] = _mm256_unpacklo_epi64(t2, t3);
+			b[g][3] = _mm256_unpackhi_epi64(t2, t3);
+		}
+		for (int k = 0; k < 4; k++) {
+			__m256i k01 = _mm256_permute2x128_si256(b[0][k], b[1][k], 0x20);
+			__m256i k23 = _mm256_permute2x128_si256(b[2][k], b[3][k], 0x20);
+			__m256i h01 = _mm256_permute2x128_si256(b[0][k], b[1][k], 0x31);
+			__m256i h23 = _mm256_permute2x128_si256(b[2][k], b[3][k], 0x31);
+
+			size_t lo = (size_t)k * 64, hi = (size_t)(k + 4) * 64;
+			_mm256_storeu_si256((__m256i*)(output + lo), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(input + lo)), k01));
+			_mm256_storeu_si256((__m256i*)(output + lo + 32), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(input + lo + 32)), k23));
+			_mm256_storeu_si256((__m256i*)(output + hi), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(input + hi)), h01));
+			_mm256_storeu_si256((__m256i*)(output + hi + 32), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(input + hi + 32)), h23));
+		}
+		state[12] += 8;
+	}
+}
+#endif
+
+//-------------------------------------------------------------------------------------
+bool ChaCha20::is_supported(Implementation impl)
+{
+	switch (impl) {
+	case IMPL_AUTO:
+	case IMPL_PORTABLE:
+		return true;
+#if defined(CY_CRYPT_X86)
+	case IMPL_SSE2:
+		return get_cpu_features().sse2;
+	case IMPL_AVX2:
+		return get_cpu_features().avx2;
+#endif
+	default:
+		return false;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+const char* ChaCha20::get_implementation_name(Implementation impl)
+{
+	switch (impl) {
+	case IMPL_AUTO: return "auto";
+	case IMPL_PORTABLE: return "portable";
+	case IMPL_SSE2: return "sse2";
+	case IMPL_AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+//-------------------------------------------------------------------------------------
+ChaCha20::ChaCha20(const uint8_t* key, const uint8_t* nonce, uint32_t counter, Implementation impl)
+{
+	//"expand 32-byte k"
+	m_state[0] = 0x61707865;
+	m_state[1] = 0x3320646e;
+	m_state[2] = 0x79622d32;
+	m_state[3] = 0x6b206574;
+	for (int i = 0; i < 8; i++) m_state[4 + i] = _load_le32(key + i * 4);
+	reset(nonce, counter);
+
+	if (impl == IMPL_AUTO) {
+		impl = IMPL_PORTABLE;
+		if (is_supported(IMPL_AVX2)) impl = IMPL_AVX2;
+		else if (is_supported(IMPL_SSE2)) impl = IMPL_SSE2;
+	}
+	m_impl = is_supported(impl) ? impl : IMPL_PORTABLE;
+}
+
+//-------------------------------------------------------------------------------------
+ChaCha20::~ChaCha20()
+{
+	//clean key memory(for safe)
+	memset(m_state, 0, sizeof(m_state));
+	memset(m_keystream, 0, sizeof(m_keystream));
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20::reset(const uint8_t* nonce, uint32_t counter)
+{
+	m_state[12] = counter;
+	for (int i = 0; i < 3; i++) m_state[13 + i] = _load_le32(nonce + i * 4);
+	m_keystream_used = BLOCK_SIZE;
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20::update(const uint8_t* input, uint8_t* output, size_t size)
+{
+	//keystream left by last call
+	while (size > 0 && m_keystream_used < BLOCK_SIZE) {
+		*(output++) = (uint8_t)(*(input++) ^ m_keystream[m_keystream_used++]);
+		size--;
+	}
+
+	size_t blocks = size / BLOCK_SIZE;
+	size_t done = 0;
+#if defined(CY_CRYPT_X86)
+	if (m_impl == IMPL_AVX2 && blocks >= 8) {
+		size_t n = blocks & ~(size_t)7;
+		_avx2_blocks(m_state, input, output, n);
+		done = n;
+	}
+	if ((m_impl == IMPL_AVX2 || m_impl == IMPL_SSE2) && blocks - done >= 4) {
+		size_t n = (blocks - done) & ~(size_t)3;
+		_sse2_blocks(m_state, input + done * BLOCK_SIZE, output + done * BLOCK_SIZE, n);
+		done += n;
+	}
+#endif
+	_portable_blocks(m_state, input + done * BLOCK_SIZE, output + done * BLOCK_SIZE, blocks - done);
+	input += blocks * BLOCK_SIZE;
+	output += blocks * BLOCK_SIZE;
+	size -= blocks * BLOCK_SIZE;
+
+	if (size > 0) {
+		block(m_state, m_keystream);
+		m_state[12]++;
+		for (m_keystream_used = 0; m_keystream_used < size; m_keystream_used++) {
+			output[m_keystream_used] = (uint8_t)(input[m_keystream_used] ^ m_keystream[m_keystream_used]);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+bool ChaCha20::update(RingBuf& buf, size_t off, size_t count)
+{
+	return buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		update(data, data, size);
+	});
+}
+
+//Poly1305, 26 bits limbs(poly1305-donna)
+//-------------------------------------------------------------------------------------
+Poly1305::Poly1305(const uint8_t* key)
+{
+	reset(key);
+}
+
+//-------------------------------------------------------------------------------------
+Poly1305::~Poly1305()
+{
+	memset(m_r, 0, sizeof(m_r));
+	memset(m_pad, 0, sizeof(m_pad));
+}
+
+//-------------------------------------------------------------------------------------
+void Poly1305::reset(const uint8_t* key)
+{
+	//r &= 0xffffffc0ffffffc0ffffffc0fffffff
+	m_r[0] = (_load_le32(key + 0)) & 0x3ffffff;
+	m_r[1] = (_load_le32(key + 3) >> 2) & 0x3ffff03;
+	m_r[2] = (_load_le32(key + 6) >> 4) & 0x3ffc0ff;
+	m_r[3] = (_load_le32(key + 9) >> 6) & 0x3f03fff;
+	m_r[4] = (_load_le32(key + 12) >> 8) & 0x00fffff;
+
+	for (int i = 0; i < 5; i++) m_h[i] = 0;
+	for (int i = 0; i < 4; i++) m_pad[i] = _load_le32(key + 16 + i * 4);
+	m_leftover = 0;
+}
+
+//-------------------------------------------------------------------------------------
+void Poly1305::_blocks(const uint8_t* data, size_t size, uint32_t hibit)
+{
+	const uint32_t r0 = m_r[0], r1 = m_r[1], r2 = m_r[2], r3 = m_r[3], r4 = m_r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = m_h[0], h1 = m_h[1], h2 = m_h[2], h3 = m_h[3], h4 = m_h[4];
+
+	for (; size >= 16; size -= 16, data += 16) {
+		//h += m[i]
+		h0 += (_load_le32(data + 0)) & 0x3ffffff;
+		h1 += (_load_le32(data + 3) >> 2) & 0x3ffffff;
+		h2 += (_load_le32(data + 6) >> 4) & 0x3ffffff;
+		h3 += (_load_le32(data + 9) >> 6) & 0x3ffffff;
+		h4 += (_load_le32(data + 12) >> 8) | hibit;
+
+		//h *= r
+		uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+		uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+		uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+		uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+		uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+		//(partial) h %= p
+		uint32_t c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+		d1 += c; c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+		d2 += c; c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+		d3 += c; c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+		d4 += c; c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+		h0 += c * 5; c = (h0 >> 26); h0 = h0 & 0x3ffffff;
+		h1 += c;
+	}
+
+	m_h[0] = h0; m_h[1] = h1; m_h[2] = h2; m_h[3] = h3; m_h[4] = h4;
+}
+
+//-------------------------------------------------------------------------------------
+void Poly1305::update(const uint8_t* data, size_t size)
+{
+	if (m_leftover > 0) {
+		size_t n = std::min(size, (size_t)16 - m_leftover);
+		memcpy(m_buffer + m_leftover, data, n);
+		m_leftover += n;
+		data += n;
+		size -= n;
+		if (m_leftover < 16) return;
+		_blocks(m_buffer, 16, 1u << 24);
+		m_leftover = 0;
+	}
+
+	size_t full = size & ~(size_t)15;
+	_blocks(data, full, 1u << 24);
+	m_leftover = size - full;
+	memcpy(m_buffer, data + full, m_leftover);
+}
+
+//-------------------------------------------------------------------------------------
+void Poly1305::finish(uint8_t* tag)
+{
+	//process the remaining block
+	if (m_leftover > 0) {
+		m_buffer[m_leftover] = 1;
+		for (size_t i = m_leftover + 1; i < 16; i++) m_buffer[i] = 0;
+		_blocks(m_buffer, 16, 0);
+		m_leftover = 0;
+	}
+
+	//fully carry h
+	uint32_t h0 = m_h[0], h1 = m_h[1], h2 = m_h[2], h3 = m_h[3], h4 = m_h[4];
+	uint32_t c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	//compute h + -p
+	uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	uint32_t g4 = h4 + c - (1u << 26);
+
+	//select h if h < p, or h + -p if h >= p
+	uint32_t mask = (g4 >> 31) - 1;
+	g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	//h = h % (2^128)
+	h0 = (h0) | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+
+	//mac = (h + pad) % (2^128)
+	uint64_t f = (uint64_t)h0 + m_pad[0]; h0 = (uint32_t)f;
+	f = (uint64_t)h1 + m_pad[1] + (f >> 32); h1 = (uint32_t)f;
+	f = (uint64_t)h2 + m_pad[2] + (f >> 32); h2 = (uint32_t)f;
+	f = (uint64_t)h3 + m_pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+	_store_le32(tag + 0, h0);
+	_store_le32(tag + 4, h1);
+	_store_le32(tag + 8, h2);
+	_store_le32(tag + 12, h3);
+}
+
+//ChaCha20-Poly1305
+//-------------------------------------------------------------------------------------
+static const uint8_t kZeroNonce[ChaCha20::NONCE_SIZE] = { 0 };
+static const uint8_t kZeroPad[16] = { 0 };
+
+//-------------------------------------------------------------------------------------
+ChaCha20Poly1305::ChaCha20Poly1305(const uint8_t* key, ChaCha20::Implementation impl)
+	: m_cipher(key, kZeroNonce, 0, impl)
+	, m_mac(kZeroPad)
+	, m_aad_size(0)
+	, m_text_size(0)
+	, m_aad_done(false)
+{
+	memcpy(m_key, key, KEY_SIZE);
+	start(kZeroNonce);
+}
+
+//-------------------------------------------------------------------------------------
+ChaCha20Poly1305::~ChaCha20Poly1305()
+{
+	memset(m_key, 0, sizeof(m_key));
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::start(const uint8_t* nonce)
+{
+	//the one-time poly1305 key is the first 32 bytes of block 0, the data begins from block 1
+	uint8_t poly_key[ChaCha20::BLOCK_SIZE] = { 0 };
+	m_cipher.reset(nonce, 0);
+	m_cipher.update(poly_key, poly_key, sizeof(poly_key));
+	m_mac.reset(poly_key);
+	memset(poly_key, 0, sizeof(poly_key));
+
+	m_aad_size = 0;
+	m_text_size = 0;
+	m_aad_done = false;
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::_pad_mac(uint64_t size)
+{
+	if (size % 16) m_mac.update(kZeroPad, 16 - (size_t)(size % 16));
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::update_aad(const uint8_t* aad, size_t size)
+{
+	assert(!m_aad_done);
+	m_mac.update(aad, size);
+	m_aad_size += size;
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::_crypt(const uint8_t* input, uint8_t* output, size_t size, bool encrypt)
+{
+	if (!m_aad_done) {
+		_pad_mac(m_aad_size);
+		m_aad_done = true;
+	}
+	m_text_size += size;
+
+	if (encrypt) {
+		m_cipher.update(input, output, size);
+		m_mac.update(output, size);
+	}
+	else {
+		m_mac.update(input, size);
+		m_cipher.update(input, output, size);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::encrypt(const uint8_t* input, uint8_t* output, size_t size)
+{
+	_crypt(input, output, size, true);
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::decrypt(const uint8_t* input, uint8_t* output, size_t size)
+{
+	_crypt(input, output, size, false);
+}
+
+//-------------------------------------------------------------------------------------
+bool ChaCha20Poly1305::encrypt(RingBuf& buf, size_t off, size_t count)
+{
+	return buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		_crypt(data, data, size, true);
+	});
+}
+
+//-------------------------------------------------------------------------------------
+bool ChaCha20Poly1305::decrypt(RingBuf& buf, size_t off, size_t count)
+{
+	return buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		_crypt(data, data, size, false);
+	});
+}
+
+//-------------------------------------------------------------------------------------
+void ChaCha20Poly1305::finish(uint8_t* tag)
+{
+	if (!m_aad_done) {
+		_pad_mac(m_aad_size);
+		m_aad_done = true;
+	}
+	_pad_mac(m_text_size);
+
+	//le64(len(aad)) || le64(len(ciphertext))
+	uint8_t length_block[16];
+	_store_le32(length_block + 0, (uint32_t)m_aad_size);
+	_store_le32(length_block + 4, (uint32_t)(m_aad_size >> 32));
+	_store_le32(length_block + 8, (uint32_t)m_text_size);
+	_store_le32(length_block + 12, (uint32_t)(m_text_size >> 32));
+	m_mac.update(length_block, sizeof(length_block));
+	m_mac.finish(tag);
+}
+
+//-------------------------------------------------------------------------------------
+bool ChaCha20Poly1305::verify(const uint8_t* tag)
+{
+	uint8_t expected[TAG_SIZE];
+	finish(expected);
+
+	uint8_t diff = 0;
+	for (size_t i = 0; i < TAG_SIZE; i++) diff = (uint8_t)(diff | (expected[i] ^ tag[i]));
+	return diff == 0;
+}
+
+}
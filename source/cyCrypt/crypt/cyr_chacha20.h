@@ -0,0 +1,133 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+
+namespace cyclone
+{
+
+//forward declaration
+class RingBuf;
+
+//ChaCha20 stream cipher(RFC 8439), 256 bits key, 96 bits nonce and 32 bits block counter.
+//Encryption and decryption are the same operation, data need not be padded. It's fast
+//on the cpu without AES instructions, multi blocks are generated by SSE2(4 blocks) or
+//AVX2(8 blocks) kernels if available.
+class ChaCha20
+{
+public:
+	enum { KEY_SIZE = 32, NONCE_SIZE = 12, BLOCK_SIZE = 64 };
+
+	enum Implementation {
+		IMPL_AUTO = 0,	//the fastest one supported by current cpu
+		IMPL_PORTABLE,	//one block each time
+		IMPL_SSE2,		//4 blocks each time
+		IMPL_AVX2,		//8 blocks each time
+	};
+
+	//xor the keystream into data, `size` can be any length, the keystream continues
+	//between calls. input and output can be the same memory
+	void update(const uint8_t* input, uint8_t* output, size_t size);
+	//encrypt/decrypt the data of ring buf from off to off+count in place
+	//@return false if the range is out of data
+	bool update(RingBuf& buf, size_t off, size_t count);
+
+	//restart the keystream with a new nonce and block counter
+	void reset(const uint8_t* nonce, uint32_t counter = 0);
+
+	Implementation get_implementation(void) const { return m_impl; }
+
+	//is the implementation supported by current cpu
+	static bool is_supported(Implementation impl);
+	static const char* get_implementation_name(Implementation impl);
+
+	//generate one keystream block of the state, used by ChaCha20Poly1305
+	static void block(const uint32_t* state, uint8_t* keystream);
+
+public:
+	//@remark the portable implementation is used if `impl` is not supported by current cpu
+	ChaCha20(const uint8_t* key, const uint8_t* nonce, uint32_t counter = 0, Implementation impl = IMPL_AUTO);
+	~ChaCha20();
+
+private:
+	uint32_t m_state[16];
+	uint8_t m_keystream[BLOCK_SIZE];	//keystream of last partial block
+	size_t m_keystream_used;			//BLOCK_SIZE means no keystream left
+	Implementation m_impl;
+};
+
+//Poly1305 one-time authenticator(RFC 8439), the key MUST NOT be reused
+class Poly1305
+{
+public:
+	enum { KEY_SIZE = 32, TAG_SIZE = 16 };
+
+	void update(const uint8_t* data, size_t size);
+	void finish(uint8_t* tag);
+
+	//restart with a new key
+	void reset(const uint8_t* key);
+
+public:
+	Poly1305(const uint8_t* key);
+	~Poly1305();
+
+private:
+	void _blocks(const uint8_t* data, size_t size, uint32_t hibit);
+
+private:
+	uint32_t m_r[5];
+	uint32_t m_h[5];
+	uint32_t m_pad[4];
+	uint8_t m_buffer[16];
+	size_t m_leftover;
+};
+
+//ChaCha20-Poly1305 AEAD(RFC 8439), the same usage as RijndaelGCM
+//	aead.start(nonce);
+//	aead.update_aad(header, header_size);		//optional, must before encrypt/decrypt
+//	aead.encrypt(data, data, data_size);		//or decrypt, can be called many times with any length
+//	aead.finish(tag);							//or aead.verify(tag) after decrypt
+class ChaCha20Poly1305
+{
+public:
+	enum { KEY_SIZE = 32, NONCE_SIZE = 12, TAG_SIZE = 16 };
+
+	//begin a new message, the nonce MUST NOT be reused with the same key
+	void start(const uint8_t* nonce);
+
+	//add additional authenticated data
+	void update_aad(const uint8_t* aad, size_t size);
+
+	//encrypt or decrypt the data, input and output can be the same memory
+	void encrypt(const uint8_t* input, uint8_t* output, size_t size);
+	void decrypt(const uint8_t* input, uint8_t* output, size_t size);
+	//encrypt or decrypt the data of ring buf from off to off+count in place
+	bool encrypt(RingBuf& buf, size_t off, size_t count);
+	bool decrypt(RingBuf& buf, size_t off, size_t count);
+
+	//get the authentication tag of the message
+	void finish(uint8_t* tag);
+	//compare the tag in constant time after decryption
+	bool verify(const uint8_t* tag);
+
+public:
+	ChaCha20Poly1305(const uint8_t* key, ChaCha20::Implementation impl = ChaCha20::IMPL_AUTO);
+	~ChaCha20Poly1305();
+
+private:
+	void _crypt(const uint8_t* input, uint8_t* output, size_t size, bool encrypt);
+	void _pad_mac(uint64_t size);
+
+private:
+	uint8_t m_key[KEY_SIZE];
+	ChaCha20 m_cipher;
+	Poly1305 m_mac;
+	uint64_t m_aad_size;
+	uint64_t m_text_size;
+	bool m_aad_done;
+};
+
+}
@@ -0,0 +1,60 @@
+/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_crypt.h>
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <cpuid.h>
+#elif defined(CY_CRYPT_ARM64)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+static CpuFeatures _detect_cpu_features(void)
+{
+	CpuFeatures features;
+	memset(&features, 0, sizeof(features));
+
+#if defined(CY_CRYPT_X86)
+	unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		features.sse2 = (edx & (1u << 26)) != 0;
+		features.ssse3 = (ecx & (1u << 9)) != 0;
+		features.sse41 = (ecx & (1u << 19)) != 0;
+		features.sse42 = (ecx & (1u << 20)) != 0;
+		features.aesni = (ecx & (1u << 25)) != 0;
+		features.pclmul = (ecx & (1u << 1)) != 0;
+
+		//avx2 need the os support of ymm registers(osxsave and xcr0)
+		bool osxsave = (ecx & (1u << 27)) != 0;
+		bool avx = (ecx & (1u << 28)) != 0;
+		if (osxsave && avx && __get_cpuid_max(0, nullptr) >= 7) {
+			unsigned int xcr0_lo = 0, xcr0_hi = 0;
+			__asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			features.avx2 = ((xcr0_lo & 6u) == 6u) && (ebx & (1u << 5)) != 0;
+		}
+	}
+#elif defined(CY_CRYPT_ARM64)
+	unsigned long hwcap = getauxval(AT_HWCAP);
+	features.neon = (hwcap & HWCAP_ASIMD) != 0;
+	features.arm_aes = (hwcap & HWCAP_AES) != 0;
+	features.arm_pmull = (hwcap & HWCAP_PMULL) != 0;
+	features.arm_crc32 = (hwcap & HWCAP_CRC32) != 0;
+#endif
+	return features;
+}
+
+//-------------------------------------------------------------------------------------
+const CpuFeatures& get_cpu_features(void)
+{
+	static const CpuFeatures features = _detect_cpu_features();
+	return features;
+}
+
+}
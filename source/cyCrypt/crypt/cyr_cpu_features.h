@@ -0,0 +1,39 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+
+//the SIMD/crypto kernels are compiled with function target attributes and selected
+//at runtime, so the library still runs on the cpu without these instructions
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CY_CRYPT_X86 1
+#elif defined(__aarch64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define CY_CRYPT_ARM64 1
+#endif
+
+namespace cyclone
+{
+
+//instruction sets which can be used by crypt algorithms, detected once at runtime
+struct CpuFeatures
+{
+	//x86
+	bool sse2;
+	bool ssse3;
+	bool sse41;
+	bool sse42;
+	bool avx2;
+	bool aesni;
+	bool pclmul;
+	//arm64
+	bool neon;
+	bool arm_aes;
+	bool arm_pmull;
+	bool arm_crc32;
+};
+
+const CpuFeatures& get_cpu_features(void);
+
+}
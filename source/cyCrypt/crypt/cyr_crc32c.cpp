@@ -0,0 +1,258 @@
+/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_crypt.h>
+#include "cyr_crc32c.h"
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <immintrin.h>
+#endif
+
+namespace cyclone
+{
+
+//CRC-32C polynomial, reversed
+#define CRC32C_POLY		(0x82f63b78u)
+
+//the sizes of the interleaved streams of the hardware implementation, must be power of two
+#define CRC32C_LONG		(8192)
+#define CRC32C_SHORT	(256)
+
+//-------------------------------------------------------------------------------------
+//multiply a matrix times a vector over the Galois field of two elements
+static uint32_t _gf2_matrix_times(const uint32_t* mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+	while (vec) {
+		if (vec & 1) sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+	return sum;
+}
+
+//-------------------------------------------------------------------------------------
+static void _gf2_matrix_square(uint32_t* square, const uint32_t* mat)
+{
+	for (int n = 0; n < 32; n++) {
+		square[n] = _gf2_matrix_times(mat, mat[n]);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+//build four lookup tables which apply `len` zero bytes to a crc, byte by byte on the
+//operand (Mark Adler's crc32c.c)
+static void _crc32c_zeros(uint32_t zeros[4][256], size_t len)
+{
+	uint32_t odd[32], even[32];
+
+	//operator for one zero bit
+	odd[0] = CRC32C_POLY;
+	uint32_t row = 1;
+	for (int n = 1; n < 32; n++) {
+		odd[n] = row;
+		row <<= 1;
+	}
+	//two zero bits and four zero bits
+	_gf2_matrix_square(even, odd);
+	_gf2_matrix_square(odd, even);
+
+	//the first square puts the operator for one zero byte in even, the next one puts
+	//the operator for two zero bytes in odd, and so on
+	const uint32_t* op = even;
+	for (;;) {
+		_gf2_matrix_square(even, odd);
+		op = even;
+		len >>= 1;
+		if (len == 0) break;
+		_gf2_matrix_square(odd, even);
+		op = odd;
+		len >>= 1;
+		if (len == 0) break;
+	}
+
+	for (uint32_t n = 0; n < 256; n++) {
+		zeros[0][n] = _gf2_matrix_times(op, n);
+		zeros[1][n] = _gf2_matrix_times(op, n << 8);
+		zeros[2][n] = _gf2_matrix_times(op, n << 16);
+		zeros[3][n] = _gf2_matrix_times(op, n << 24);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+struct Crc32cTables
+{
+	uint32_t slice[8][256];				//slicing-by-8
+	uint32_t long_zeros[4][256];		//shift a crc by CRC32C_LONG zero bytes
+	uint32_t short_zeros[4][256];		//shift a crc by CRC32C_SHORT zero bytes
+
+	Crc32cTables()
+	{
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t crc = n;
+			for (int k = 0; k < 8; k++) {
+				crc = (crc & 1) ? ((crc >> 1) ^ CRC32C_POLY) : (crc >> 1);
+			}
+			slice[0][n] = crc;
+		}
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t crc = slice[0][n];
+			for (int k = 1; k < 8; k++) {
+				crc = slice[0][crc & 0xff] ^ (crc >> 8);
+				slice[k][n] = crc;
+			}
+		}
+		_crc32c_zeros(long_zeros, CRC32C_LONG);
+		_crc32c_zeros(short_zeros, CRC32C_SHORT);
+	}
+};
+
+//-------------------------------------------------------------------------------------
+static const Crc32cTables& _crc32c_tables(void)
+{
+	static const Crc32cTables tables;
+	return tables;
+}
+
+//-------------------------------------------------------------------------------------
+static inline uint32_t _crc32c_shift(const uint32_t zeros[4][256], uint32_t crc)
+{
+	return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+		zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+//-------------------------------------------------------------------------------------
+static uint32_t _crc32c_scalar(uint32_t crc, const uint8_t* buf, size_t len)
+{
+	const Crc32cTables& t = _crc32c_tables();
+	crc = ~crc;
+
+	while (len >= 8) {
+		uint32_t lo = crc ^ ((uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24));
+		uint32_t hi = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8) | ((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+		crc = t.slice[7][lo & 0xff] ^ t.slice[6][(lo >> 8) & 0xff] ^ t.slice[5][(lo >> 16) & 0xff] ^ t.slice[4][lo >> 24] ^
+			t.slice[3][hi & 0xff] ^ t.slice[2][(hi >> 8) & 0xff] ^ t.slice[1][(hi >> 16) & 0xff] ^ t.slice[0][hi >> 24];
+		buf += 8;
+		len -= 8;
+	}
+	while (len--) {
+		crc = t.slice[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+#if defined(CY_CRYPT_X86) && defined(__x86_64__)
+#define SSE42_TARGET __attribute__((target("sse4.2")))
+
+//-------------------------------------------------------------------------------------
+SSE42_TARGET
+static inline uint64_t _crc32c_u64(uint64_t crc, const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return _mm_crc32_u64(crc, v);
+}
+
+//-------------------------------------------------------------------------------------
+//crc32 has a throughput of one per cycle but a latency of three cycles, so the data is
+//split into three streams which are computed independently, then the first two crcs
+//are shifted over the following streams and combined.
+template<size_t STREAM>
+SSE42_TARGET
+static inline const uint8_t* _crc32c_sse42_streams(uint64_t& crc0, const uint8_t* next, size_t& len, const uint32_t zeros[4][256])
+{
+	while (len >= STREAM * 3) {
+		uint64_t crc1 = 0, crc2 = 0;
+		const uint8_t* end = next + STREAM;
+		do {
+			crc0 = _crc32c_u64(crc0, next);
+			crc1 = _crc32c_u64(crc1, next + STREAM);
+			crc2 = _crc32c_u64(crc2, next + STREAM * 2);
+			next += 8;
+		} while (next < end);
+		crc0 = _crc32c_shift(zeros, (uint32_t)crc0) ^ crc1;
+		crc0 = _crc32c_shift(zeros, (uint32_t)crc0) ^ crc2;
+		next += STREAM * 2;
+		len -= STREAM * 3;
+	}
+	return next;
+}
+
+//-------------------------------------------------------------------------------------
+SSE42_TARGET
+static uint32_t _crc32c_sse42(uint32_t crc, const uint8_t* buf, size_t len)
+{
+	const Crc32cTables& t = _crc32c_tables();
+	const uint8_t* next = buf;
+	uint64_t crc0 = (uint32_t)~crc;
+
+	//bring the data pointer to an eight-byte boundary
+	while (len && ((uintptr_t)next & 7) != 0) {
+		crc0 = _mm_crc32_u8((uint32_t)crc0, *next++);
+		len--;
+	}
+
+	next = _crc32c_sse42_streams<CRC32C_LONG>(crc0, next, len, t.long_zeros);
+	next = _crc32c_sse42_streams<CRC32C_SHORT>(crc0, next, len, t.short_zeros);
+
+	while (len >= 8) {
+		crc0 = _crc32c_u64(crc0, next);
+		next += 8;
+		len -= 8;
+	}
+	while (len) {
+		crc0 = _mm_crc32_u8((uint32_t)crc0, *next++);
+		len--;
+	}
+	return ~(uint32_t)crc0;
+}
+#endif
+
+//-------------------------------------------------------------------------------------
+uint32_t crc32c(uint32_t crc, const uint8_t* buf, size_t len, Crc32cImplementation impl)
+{
+	if (buf == nullptr) return INITIAL_CRC32C;
+
+#if defined(CY_CRYPT_X86) && defined(__x86_64__)
+	if (impl == CRC32C_AUTO) {
+		static const bool has_sse42 = crc32c_is_supported(CRC32C_SSE42);
+		if (has_sse42) return _crc32c_sse42(crc, buf, len);
+	}
+	else if (impl == CRC32C_SSE42 && crc32c_is_supported(CRC32C_SSE42)) {
+		return _crc32c_sse42(crc, buf, len);
+	}
+#else
+	(void)impl;
+#endif
+	return _crc32c_scalar(crc, buf, len);
+}
+
+//-------------------------------------------------------------------------------------
+bool crc32c_is_supported(Crc32cImplementation impl)
+{
+	switch (impl) {
+	case CRC32C_AUTO:
+	case CRC32C_SCALAR:
+		return true;
+#if defined(CY_CRYPT_X86) && defined(__x86_64__)
+	case CRC32C_SSE42:
+		return get_cpu_features().sse42;
+#endif
+	default:
+		return false;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+const char* crc32c_implementation_name(Crc32cImplementation impl)
+{
+	switch (impl) {
+	case CRC32C_AUTO: return "auto";
+	case CRC32C_SCALAR: return "scalar";
+	case CRC32C_SSE42: return "sse42";
+	default: return "unknown";
+	}
+}
+
+}
@@ -0,0 +1,44 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+
+namespace cyclone
+{
+
+//initial crc32c value
+#define INITIAL_CRC32C	(0u)
+
+/*
+* Update a running CRC-32C(Castagnoli, the polynomial used by iSCSI, SCTP and ext4)
+* with the bytes buf[0..len-1] and return the updated crc. If buf is NULL, this
+* function returns the required initial value for the crc.
+*
+* The crc is computed by the SSE4.2 crc32 instruction if current cpu supports, three
+* independent streams are interleaved to hide the latency of the instruction.
+*
+* Usage example:
+*
+* uint32_t crc = cyclone::INITIAL_CRC32C;
+*
+* while (read_buffer(buffer, length) != EOF) {
+*   crc = cyclone::crc32c(crc, buffer, length);
+* }
+*
+*/
+enum Crc32cImplementation {
+	CRC32C_AUTO = 0,	//the fastest one supported by current cpu
+	CRC32C_SCALAR,		//slicing-by-8 tables
+	CRC32C_SSE42,		//crc32 instruction
+};
+
+//@remark the scalar implementation is used if `impl` is not supported by current cpu
+uint32_t crc32c(uint32_t crc, const uint8_t* buf, size_t len, Crc32cImplementation impl = CRC32C_AUTO);
+
+//is the implementation supported by current cpu
+bool crc32c_is_supported(Crc32cImplementation impl);
+const char* crc32c_implementation_name(Crc32cImplementation impl);
+
+}
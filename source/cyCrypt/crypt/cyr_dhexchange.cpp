@@ -94,6 +94,7 @@ _u128_sub(dhkey_t* r, const dhkey_t& a, const dhkey_t& b) {
 	_u128_add(r, a, invert_b);
 }
 
+#if !defined(__SIZEOF_INT128__)
 /*--------------------------------------------------------------------------*/
 /* r = a*b mod P */
 static void
@@ -154,15 +155,137 @@ _powmodp_r(dhkey_t* r, const dhkey_t& a, const dhkey_t& b)
 	*r = t;
 }
 
+#else
+/*--------------------------------------------------------------------------*/
+/* native 128 bits integer, P = 2^128-159 is a pseudo mersenne prime, so the
+   high half of a product is folded into the low half by multiplying 159 */
+__extension__ typedef unsigned __int128 u128_t;
+
+static const u128_t P128 = (((u128_t)0xffffffffffffffffULL) << 64) | 0xffffffffffffff61ULL;
+
+/*--------------------------------------------------------------------------*/
+static inline u128_t
+_key_to_u128(const dhkey_t& key) {
+	return (((u128_t)key.dq.high) << 64) | key.dq.low;
+}
+
+/*--------------------------------------------------------------------------*/
+static inline void
+_u128_to_key(dhkey_t* key, u128_t v) {
+	key->dq.low = (uint64_t)v;
+	key->dq.high = (uint64_t)(v >> 64);
+}
+
+/*--------------------------------------------------------------------------*/
+/* r = a*b mod P, a and b must less than P */
+static inline u128_t
+_mulmodp_u128(u128_t a, u128_t b)
+{
+	uint64_t a0 = (uint64_t)a, a1 = (uint64_t)(a >> 64);
+	uint64_t b0 = (uint64_t)b, b1 = (uint64_t)(b >> 64);
+
+	/* 256 bits product = hi*2^128 + lo */
+	u128_t p00 = (u128_t)a0 * b0;
+	u128_t p01 = (u128_t)a0 * b1;
+	u128_t p10 = (u128_t)a1 * b0;
+	u128_t p11 = (u128_t)a1 * b1;
+
+	u128_t mid = p01 + p10;
+	u128_t mid_carry = (mid < p01) ? ((u128_t)1 << 64) : 0;
+	u128_t lo = p00 + (mid << 64);
+	u128_t hi = p11 + (mid >> 64) + mid_carry + ((lo < p00) ? 1 : 0);
+
+	/* 2^128 = 159 (mod P), r = hi*159 + lo */
+	u128_t t0 = (u128_t)(uint64_t)hi * 159;
+	u128_t t1 = (u128_t)(uint64_t)(hi >> 64) * 159;
+	u128_t r = lo + t0;
+	uint64_t over = (r < t0) ? 1 : 0;
+	u128_t t1_low = t1 << 64;
+	r += t1_low;
+	over += (r < t1_low) ? 1 : 0;
+	over += (uint64_t)(t1 >> 64);
+
+	/* fold again, `over` is less than 2^8 */
+	u128_t t2 = (u128_t)over * 159;
+	r += t2;
+	if (r < t2) r += 159;
+	if (r >= P128) r -= P128;
+	return r;
+}
+
+/*--------------------------------------------------------------------------*/
+/* r = a^b mod P, fixed 4 bits window */
+static u128_t
+_powmodp_u128(u128_t a, u128_t b)
+{
+	if (a >= P128) a -= P128;
+
+	u128_t table[16];
+	table[0] = 1;
+	for (int i = 1; i < 16; i++) table[i] = _mulmodp_u128(table[i - 1], a);
+
+	u128_t r = 1;
+	for (int i = 124; i >= 0; i -= 4) {
+		if (r != 1) {
+			r = _mulmodp_u128(r, r);
+			r = _mulmodp_u128(r, r);
+			r = _mulmodp_u128(r, r);
+			r = _mulmodp_u128(r, r);
+		}
+		uint32_t w = (uint32_t)(b >> i) & 0xf;
+		if (w) r = _mulmodp_u128(r, table[w]);
+	}
+	return r;
+}
+
+/*--------------------------------------------------------------------------*/
+/* G^(j*16^i) for every 4 bits of the exponent, the public key is made by 32
+   multiplications at most */
+struct GeneratorTable
+{
+	u128_t powers[32][16];
+
+	GeneratorTable() {
+		u128_t base = _key_to_u128(G);
+		for (int i = 0; i < 32; i++) {
+			powers[i][0] = 1;
+			for (int j = 1; j < 16; j++) powers[i][j] = _mulmodp_u128(powers[i][j - 1], base);
+			base = _mulmodp_u128(powers[i][15], base);
+		}
+	}
+};
+
+/*--------------------------------------------------------------------------*/
+static u128_t
+_powmodg_u128(u128_t b)
+{
+	static const GeneratorTable table;
+
+	u128_t r = 1;
+	for (int i = 0; i < 32; i++) {
+		uint32_t w = (uint32_t)(b >> (i * 4)) & 0xf;
+		if (w) r = _mulmodp_u128(r, table.powers[i][w]);
+	}
+	return r;
+}
+#endif
+
 /*--------------------------------------------------------------------------*/
 /* r = a^b mod P */
 static void 
 _powmodp(dhkey_t* r, dhkey_t a, dhkey_t b)
 {
+#if defined(__SIZEOF_INT128__)
+	if (_u128_compare(a, G) == 0)
+		_u128_to_key(r, _powmodg_u128(_key_to_u128(b)));
+	else
+		_u128_to_key(r, _powmodp_u128(_key_to_u128(a), _key_to_u128(b)));
+#else
 	if (_u128_compare(a, P)>0)
 		_u128_sub(&a, a, P);
 
 	_powmodp_r(r, a, b);
+#endif
 }
 
 /*--------------------------------------------------------------------------*/
@@ -186,5 +309,86 @@ DH_generate_key_secret(dhkey_t& secret_key, const dhkey_t& my_private, const dhk
 	_powmodp(&secret_key, another_public, my_private);
 }
 
+/*--------------------------------------------------------------------------*/
+DHKeyPairPool::DHKeyPairPool(size_t capacity)
+	: m_pairs(nullptr)
+	, m_capacity(capacity > 0 ? capacity : 1)
+	, m_size(0)
+	, m_quit(false)
+{
+	m_pairs = new KeyPair[m_capacity];
+	m_fill_signal = sys_api::signal_create();
+	m_full_signal = sys_api::signal_create(true);
+	m_thread = sys_api::thread_create(std::bind(&DHKeyPairPool::_fill_thread, this), nullptr, "dh_pool");
+}
+
+/*--------------------------------------------------------------------------*/
+DHKeyPairPool::~DHKeyPairPool()
+{
+	m_quit = true;
+	sys_api::signal_notify(m_fill_signal);
+	sys_api::thread_join(m_thread);
+
+	sys_api::signal_destroy(m_fill_signal);
+	sys_api::signal_destroy(m_full_signal);
+
+	//clean key memory(for safe)
+	memset((void*)m_pairs, 0, sizeof(KeyPair) * m_capacity);
+	delete[] m_pairs;
+}
+
+/*--------------------------------------------------------------------------*/
+void DHKeyPairPool::_fill_thread(void)
+{
+	while (!m_quit) {
+		bool full = false;
+		while (!m_quit && !full) {
+			KeyPair pair;
+			DH_generate_key_pair(pair.public_key, pair.private_key);
+
+			sys_api::auto_lock<sys_api::futex_mutex> lock(m_lock);
+			if (m_size < m_capacity) m_pairs[m_size++] = pair;
+			full = (m_size == m_capacity);
+			if (full) sys_api::signal_notify(m_full_signal);
+		}
+		sys_api::signal_wait(m_fill_signal);
+	}
+}
+
+/*--------------------------------------------------------------------------*/
+void DHKeyPairPool::take(dhkey_t& public_key, dhkey_t& private_key)
+{
+	{
+		sys_api::auto_lock<sys_api::futex_mutex> lock(m_lock);
+		if (m_size > 0) {
+			KeyPair& pair = m_pairs[--m_size];
+			public_key = pair.public_key;
+			private_key = pair.private_key;
+			memset((void*)&pair, 0, sizeof(pair));
+
+			sys_api::signal_reset(m_full_signal);
+			sys_api::signal_notify(m_fill_signal);
+			return;
+		}
+	}
+
+	//pool is empty
+	sys_api::signal_notify(m_fill_signal);
+	DH_generate_key_pair(public_key, private_key);
+}
+
+/*--------------------------------------------------------------------------*/
+size_t DHKeyPairPool::size(void) const
+{
+	sys_api::auto_lock<sys_api::futex_mutex> lock(m_lock);
+	return m_size;
+}
+
+/*--------------------------------------------------------------------------*/
+bool DHKeyPairPool::wait_full(int32_t wait_time_ms) const
+{
+	return sys_api::signal_timewait(m_full_signal, wait_time_ms);
+}
+
 }
 
@@ -3,6 +3,9 @@ Copyright(C) thecodeway.com
 */
 #pragma once
 
+#include <cyclone_config.h>
+#include <core/cyc_system_api.h>
+
 namespace cyclone
 {
 
@@ -22,5 +25,43 @@ void DH_generate_key_pair(dhkey_t& public_key, dhkey_t& private_key);
 
 void DH_generate_key_secret(dhkey_t& secret_key, const dhkey_t& my_private, const dhkey_t& another_public);
 
+//Key pairs generated in a background thread, so the handshake in the io thread only
+//takes one from the pool. The pool is refilled after every take, and the key pair is
+//generated in the caller thread if the pool is empty.
+class DHKeyPairPool : noncopyable
+{
+public:
+	enum { kDefaultCapacity = 256 };
+
+	//take a key pair, every pair is taken only once
+	void take(dhkey_t& public_key, dhkey_t& private_key);
+
+	//key pairs in pool now
+	size_t size(void) const;
+	//wait until the pool is full, return false if timeout
+	bool wait_full(int32_t wait_time_ms) const;
+
+public:
+	DHKeyPairPool(size_t capacity = kDefaultCapacity);
+	~DHKeyPairPool();
+
+private:
+	struct KeyPair {
+		dhkey_t public_key;
+		dhkey_t private_key;
+	};
+
+	void _fill_thread(void);
+
+	KeyPair* m_pairs;
+	size_t m_capacity;
+	size_t m_size;
+	mutable sys_api::futex_mutex m_lock;
+	sys_api::signal_t m_fill_signal;
+	sys_api::signal_t m_full_signal;
+	thread_t m_thread;
+	std::atomic<bool> m_quit;
+};
+
 
 }
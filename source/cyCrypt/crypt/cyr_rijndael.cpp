@@ -3,6 +3,14 @@ Copyright(C) thecodeway.com
 */
 #include <cy_crypt.h>
 #include "cyr_rijndael.h"
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#elif defined(CY_CRYPT_ARM64)
+#include <arm_neon.h>
+#endif
 
 namespace cyclone
 {
@@ -504,7 +512,268 @@ const Rijndael::BLOCK Rijndael::DefaultIV = {
 	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
 
 //-------------------------------------------------------------------------------------
-Rijndael::Rijndael(const BLOCK key)
+static inline uint32_t _load_be32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+//-------------------------------------------------------------------------------------
+static inline void _store_be32(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+
+//-------------------------------------------------------------------------------------
+static inline uint32_t _bswap32(uint32_t v)
+{
+	return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+}
+
+//Hardware implementations
+//The round keys are the same as the table implementation(in byte order), the decryption
+//keys of the table implementation already have InvMixColumn applied, so they are the
+//keys of 'Equivalent Inverse Cipher' in FIPS-197 which aesdec/AESD need.
+//CBC encryption is serial, decryption interleaves 4 blocks to hide the latency of aes instructions.
+#if defined(CY_CRYPT_X86)
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+
+//-------------------------------------------------------------------------------------
+AESNI_TARGET
+static void _aesni_encrypt_cbc(const uint8_t (*keys)[16], const uint8_t* input, uint8_t* output, size_t size, uint8_t* iv)
+{
+	__m128i k[11];
+	for (int i = 0; i < 11; i++) k[i] = _mm_loadu_si128((const __m128i*)keys[i]);
+
+	__m128i chain = _mm_loadu_si128((const __m128i*)iv);
+	for (size_t i = 0; i < size; i += 16) {
+		__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(input + i)), chain);
+		b = _mm_xor_si128(b, k[0]);
+		for (int r = 1; r < 10; r++) b = _mm_aesenc_si128(b, k[r]);
+		chain = _mm_aesenclast_si128(b, k[10]);
+		_mm_storeu_si128((__m128i*)(output + i), chain);
+	}
+	_mm_storeu_si128((__m128i*)iv, chain);
+}
+
+//-------------------------------------------------------------------------------------
+AESNI_TARGET
+static void _aesni_decrypt_cbc(const uint8_t (*keys)[16], const uint8_t* input, uint8_t* output, size_t size, uint8_t* iv)
+{
+	__m128i k[11];
+	for (int i = 0; i < 11; i++) k[i] = _mm_loadu_si128((const __m128i*)keys[i]);
+
+	__m128i chain = _mm_loadu_si128((const __m128i*)iv);
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		__m128i c0 = _mm_loadu_si128((const __m128i*)(input + i));
+		__m128i c1 = _mm_loadu_si128((const __m128i*)(input + i + 16));
+		__m128i c2 = _mm_loadu_si128((const __m128i*)(input + i + 32));
+		__m128i c3 = _mm_loadu_si128((const __m128i*)(input + i + 48));
+		__m128i b0 = _mm_xor_si128(c0, k[0]);
+		__m128i b1 = _mm_xor_si128(c1, k[0]);
+		__m128i b2 = _mm_xor_si128(c2, k[0]);
+		__m128i b3 = _mm_xor_si128(c3, k[0]);
+		for (int r = 1; r < 10; r++) {
+			b0 = _mm_aesdec_si128(b0, k[r]);
+			b1 = _mm_aesdec_si128(b1, k[r]);
+			b2 = _mm_aesdec_si128(b2, k[r]);
+			b3 = _mm_aesdec_si128(b3, k[r]);
+		}
+		b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[10]), chain);
+		b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[10]), c0);
+		b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[10]), c1);
+		b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[10]), c2);
+		_mm_storeu_si128((__m128i*)(output + i), b0);
+		_mm_storeu_si128((__m128i*)(output + i + 16), b1);
+		_mm_storeu_si128((__m128i*)(output + i + 32), b2);
+		_mm_storeu_si128((__m128i*)(output + i + 48), b3);
+		chain = c3;
+	}
+	for (; i < size; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i*)(input + i));
+		__m128i b = _mm_xor_si128(c, k[0]);
+		for (int r = 1; r < 10; r++) b = _mm_aesdec_si128(b, k[r]);
+		b = _mm_xor_si128(_mm_aesdeclast_si128(b, k[10]), chain);
+		_mm_storeu_si128((__m128i*)(output + i), b);
+		chain = c;
+	}
+	_mm_storeu_si128((__m128i*)iv, chain);
+}
+
+//-------------------------------------------------------------------------------------
+AESNI_TARGET
+static void _aesni_ctr(const uint8_t (*keys)[16], uint8_t* counter, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	__m128i k[11];
+	for (int i = 0; i < 11; i++) k[i] = _mm_loadu_si128((const __m128i*)keys[i]);
+
+	int32_t prefix[3];
+	memcpy(prefix, counter, 12);
+	uint32_t ctr = _load_be32(counter + 12);
+
+	size_t i = 0;
+	for (; i + 8 <= blocks; i += 8, ctr += 8) {
+		__m128i b[8];
+		for (uint32_t j = 0; j < 8; j++) {
+			b[j] = _mm_xor_si128(_mm_set_epi32((int32_t)_bswap32(ctr + j), prefix[2], prefix[1], prefix[0]), k[0]);
+		}
+		for (int r = 1; r < 10; r++) {
+			for (int j = 0; j < 8; j++) b[j] = _mm_aesenc_si128(b[j], k[r]);
+		}
+		for (int j = 0; j < 8; j++) {
+			b[j] = _mm_aesenclast_si128(b[j], k[10]);
+			__m128i in = _mm_loadu_si128((const __m128i*)(input + (i + (size_t)j) * 16));
+			_mm_storeu_si128((__m128i*)(output + (i + (size_t)j) * 16), _mm_xor_si128(in, b[j]));
+		}
+	}
+	for (; i < blocks; i++, ctr++) {
+		__m128i b = _mm_xor_si128(_mm_set_epi32((int32_t)_bswap32(ctr), prefix[2], prefix[1], prefix[0]), k[0]);
+		for (int r = 1; r < 10; r++) b = _mm_aesenc_si128(b, k[r]);
+		b = _mm_aesenclast_si128(b, k[10]);
+		__m128i in = _mm_loadu_si128((const __m128i*)(input + i * 16));
+		_mm_storeu_si128((__m128i*)(output + i * 16), _mm_xor_si128(in, b));
+	}
+	_store_be32(counter + 12, ctr);
+}
+#endif
+
+#if defined(CY_CRYPT_ARM64)
+#ifdef __clang__
+#define ARMV8_AES_TARGET __attribute__((target("crypto")))
+#else
+#define ARMV8_AES_TARGET __attribute__((target("+crypto")))
+#endif
+
+//-------------------------------------------------------------------------------------
+ARMV8_AES_TARGET
+static void _armv8_encrypt_cbc(const uint8_t (*keys)[16], const uint8_t* input, uint8_t* output, size_t size, uint8_t* iv)
+{
+	uint8x16_t k[11];
+	for (int i = 0; i < 11; i++) k[i] = vld1q_u8(keys[i]);
+
+	uint8x16_t chain = vld1q_u8(iv);
+	for (size_t i = 0; i < size; i += 16) {
+		uint8x16_t b = veorq_u8(vld1q_u8(input + i), chain);
+		for (int r = 0; r < 9; r++) b = vaesmcq_u8(vaeseq_u8(b, k[r]));
+		chain = veorq_u8(vaeseq_u8(b, k[9]), k[10]);
+		vst1q_u8(output + i, chain);
+	}
+	vst1q_u8(iv, chain);
+}
+
+//-------------------------------------------------------------------------------------
+ARMV8_AES_TARGET
+static void _armv8_decrypt_cbc(const uint8_t (*keys)[16], const uint8_t* input, uint8_t* output, size_t size, uint8_t* iv)
+{
+	uint8x16_t k[11];
+	for (int i = 0; i < 11; i++) k[i] = vld1q_u8(keys[i]);
+
+	uint8x16_t chain = vld1q_u8(iv);
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		uint8x16_t c0 = vld1q_u8(input + i);
+		uint8x16_t c1 = vld1q_u8(input + i + 16);
+		uint8x16_t c2 = vld1q_u8(input + i + 32);
+		uint8x16_t c3 = vld1q_u8(input + i + 48);
+		uint8x16_t b0 = c0, b1 = c1, b2 = c2, b3 = c3;
+		for (int r = 0; r < 9; r++) {
+			b0 = vaesimcq_u8(vaesdq_u8(b0, k[r]));
+			b1 = vaesimcq_u8(vaesdq_u8(b1, k[r]));
+			b2 = vaesimcq_u8(vaesdq_u8(b2, k[r]));
+			b3 = vaesimcq_u8(vaesdq_u8(b3, k[r]));
+		}
+		b0 = veorq_u8(veorq_u8(vaesdq_u8(b0, k[9]), k[10]), chain);
+		b1 = veorq_u8(veorq_u8(vaesdq_u8(b1, k[9]), k[10]), c0);
+		b2 = veorq_u8(veorq_u8(vaesdq_u8(b2, k[9]), k[10]), c1);
+		b3 = veorq_u8(veorq_u8(vaesdq_u8(b3, k[9]), k[10]), c2);
+		vst1q_u8(output + i, b0);
+		vst1q_u8(output + i + 16, b1);
+		vst1q_u8(output + i + 32, b2);
+		vst1q_u8(output + i + 48, b3);
+		chain = c3;
+	}
+	for (; i < size; i += 16) {
+		uint8x16_t c = vld1q_u8(input + i);
+		uint8x16_t b = c;
+		for (int r = 0; r < 9; r++) b = vaesimcq_u8(vaesdq_u8(b, k[r]));
+		b = veorq_u8(veorq_u8(vaesdq_u8(b, k[9]), k[10]), chain);
+		vst1q_u8(output + i, b);
+		chain = c;
+	}
+	vst1q_u8(iv, chain);
+}
+
+//-------------------------------------------------------------------------------------
+ARMV8_AES_TARGET
+static void _armv8_ctr(const uint8_t (*keys)[16], uint8_t* counter, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	uint8x16_t k[11];
+	for (int i = 0; i < 11; i++) k[i] = vld1q_u8(keys[i]);
+
+	uint8_t ctr_block[4][16];
+	for (int j = 0; j < 4; j++) memcpy(ctr_block[j], counter, 12);
+	uint32_t ctr = _load_be32(counter + 12);
+
+	size_t i = 0;
+	for (; i + 4 <= blocks; i += 4, ctr += 4) {
+		uint8x16_t b[4];
+		for (uint32_t j = 0; j < 4; j++) {
+			_store_be32(ctr_block[j] + 12, ctr + j);
+			b[j] = vld1q_u8(ctr_block[j]);
+		}
+		for (int r = 0; r < 9; r++) {
+			for (int j = 0; j < 4; j++) b[j] = vaesmcq_u8(vaeseq_u8(b[j], k[r]));
+		}
+		for (int j = 0; j < 4; j++) {
+			b[j] = veorq_u8(vaeseq_u8(b[j], k[9]), k[10]);
+			vst1q_u8(output + (i + (size_t)j) * 16, veorq_u8(vld1q_u8(input + (i + (size_t)j) * 16), b[j]));
+		}
+	}
+	for (; i < blocks; i++, ctr++) {
+		_store_be32(ctr_block[0] + 12, ctr);
+		uint8x16_t b = vld1q_u8(ctr_block[0]);
+		for (int r = 0; r < 9; r++) b = vaesmcq_u8(vaeseq_u8(b, k[r]));
+		b = veorq_u8(vaeseq_u8(b, k[9]), k[10]);
+		vst1q_u8(output + i * 16, veorq_u8(vld1q_u8(input + i * 16), b));
+	}
+	_store_be32(counter + 12, ctr);
+}
+#endif
+
+//-------------------------------------------------------------------------------------
+bool Rijndael::is_supported(Implementation impl)
+{
+	switch (impl) {
+	case IMPL_AUTO:
+	case IMPL_TABLE:
+		return true;
+#if defined(CY_CRYPT_X86)
+	case IMPL_AESNI:
+		return get_cpu_features().aesni && get_cpu_features().sse2;
+#endif
+#if defined(CY_CRYPT_ARM64)
+	case IMPL_ARMV8:
+		return get_cpu_features().arm_aes;
+#endif
+	default:
+		return false;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+const char* Rijndael::get_implementation_name(Implementation impl)
+{
+	switch (impl) {
+	case IMPL_AUTO: return "auto";
+	case IMPL_TABLE: return "table";
+	case IMPL_AESNI: return "aesni";
+	case IMPL_ARMV8: return "armv8";
+	default: return "unknown";
+	}
+}
+
+//-------------------------------------------------------------------------------------
+Rijndael::Rijndael(const BLOCK key, Implementation impl)
 {
 	for (int i = 0; i <= ROUNDS; i++)
 	{
@@ -569,6 +838,24 @@ Rijndael::Rijndael(const BLOCK key)
 				sm_U4[tt & 0xFF];
 		}
 	}
+
+	//Round keys in byte order
+	for (int r = 0; r <= ROUNDS; r++) {
+		for (int j = 0; j < BC; j++) {
+			for (int b = 0; b < 4; b++) {
+				m_hwKe[r][j * 4 + b] = (uint8_t)(m_Ke[r][j] >> (24 - b * 8));
+				m_hwKd[r][j * 4 + b] = (uint8_t)(m_Kd[r][j] >> (24 - b * 8));
+			}
+		}
+	}
+
+	//Select implementation
+	if (impl == IMPL_AUTO) {
+		impl = IMPL_TABLE;
+		if (is_supported(IMPL_AESNI)) impl = IMPL_AESNI;
+		else if (is_supported(IMPL_ARMV8)) impl = IMPL_ARMV8;
+	}
+	m_impl = is_supported(impl) ? impl : IMPL_TABLE;
 }
 
 //-------------------------------------------------------------------------------------
@@ -597,6 +884,23 @@ void Rijndael::encrypt(const uint8_t* input, uint8_t* output, size_t size, BLOCK
 	else
 		memcpy(chain, DefaultIV, BLOCK_SIZE);
 
+	switch (m_impl) {
+#if defined(CY_CRYPT_X86)
+	case IMPL_AESNI:
+		_aesni_encrypt_cbc(m_hwKe, input, output, size, chain);
+		if (iv) memcpy(iv, chain, BLOCK_SIZE);
+		return;
+#endif
+#if defined(CY_CRYPT_ARM64)
+	case IMPL_ARMV8:
+		_armv8_encrypt_cbc(m_hwKe, input, output, size, chain);
+		if (iv) memcpy(iv, chain, BLOCK_SIZE);
+		return;
+#endif
+	default:
+		break;
+	}
+
 	for (size_t i = 0; i < size; i += BLOCK_SIZE, input += BLOCK_SIZE, output += BLOCK_SIZE) {
 		_xor(chain, input);
 		_encryptBlock(chain, output);
@@ -621,6 +925,23 @@ void Rijndael::decrypt(const uint8_t* input, uint8_t* output, size_t size, BLOCK
 	else
 		memcpy(chain, DefaultIV, BLOCK_SIZE);
 
+	switch (m_impl) {
+#if defined(CY_CRYPT_X86)
+	case IMPL_AESNI:
+		_aesni_decrypt_cbc(m_hwKd, input, output, size, chain);
+		if (iv) memcpy(iv, chain, BLOCK_SIZE);
+		return;
+#endif
+#if defined(CY_CRYPT_ARM64)
+	case IMPL_ARMV8:
+		_armv8_decrypt_cbc(m_hwKd, input, output, size, chain);
+		if (iv) memcpy(iv, chain, BLOCK_SIZE);
+		return;
+#endif
+	default:
+		break;
+	}
+
 	BLOCK temp;
 	for (size_t i = 0; i < size; i += BLOCK_SIZE, input += BLOCK_SIZE, output += BLOCK_SIZE) {
 		_decryptBlock(input, temp);
@@ -634,6 +955,60 @@ void Rijndael::decrypt(const uint8_t* input, uint8_t* output, size_t size, BLOCK
 		memcpy(iv, chain, BLOCK_SIZE);
 }
 
+//-------------------------------------------------------------------------------------
+void Rijndael::encrypt_block(const uint8_t* input, uint8_t* output)
+{
+	switch (m_impl) {
+#if defined(CY_CRYPT_X86)
+	case IMPL_AESNI:
+	{
+		BLOCK zero = { 0 };
+		_aesni_encrypt_cbc(m_hwKe, input, output, BLOCK_SIZE, zero);
+	}
+	return;
+#endif
+#if defined(CY_CRYPT_ARM64)
+	case IMPL_ARMV8:
+	{
+		BLOCK zero = { 0 };
+		_armv8_encrypt_cbc(m_hwKe, input, output, BLOCK_SIZE, zero);
+	}
+	return;
+#endif
+	default:
+		_encryptBlock(input, output);
+		return;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void Rijndael::ctr_blocks(BLOCK counter, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	switch (m_impl) {
+#if defined(CY_CRYPT_X86)
+	case IMPL_AESNI:
+		_aesni_ctr(m_hwKe, counter, input, output, blocks);
+		return;
+#endif
+#if defined(CY_CRYPT_ARM64)
+	case IMPL_ARMV8:
+		_armv8_ctr(m_hwKe, counter, input, output, blocks);
+		return;
+#endif
+	default:
+		break;
+	}
+
+	uint32_t ctr = _load_be32(counter + 12);
+	BLOCK keystream;
+	for (size_t i = 0; i < blocks; i++, ctr++, input += BLOCK_SIZE, output += BLOCK_SIZE) {
+		_store_be32(counter + 12, ctr);
+		_encryptBlock(counter, keystream);
+		for (int j = 0; j < BLOCK_SIZE; j++) output[j] = (uint8_t)(input[j] ^ keystream[j]);
+	}
+	_store_be32(counter + 12, ctr);
+}
+
 //-------------------------------------------------------------------------------------
 void Rijndael::_encryptBlock(uint8_t const* in, uint8_t* result)
 {
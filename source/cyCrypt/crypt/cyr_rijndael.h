@@ -17,10 +17,25 @@ public:
 	//Default Initial Vector
 	static const BLOCK DefaultIV;
 
+	//The code path of block cipher, all of them have the same output
+	enum Implementation {
+		IMPL_AUTO = 0,	//the fastest one supported by current cpu
+		IMPL_TABLE,		//portable T-tables
+		IMPL_AESNI,		//x86 AES-NI instructions
+		IMPL_ARMV8,		//ARMv8 crypto extension
+	};
+
 	//Construct, and expand a user-supplied key material into a session key.
-	Rijndael(const BLOCK key);
+	//@remark the table implementation is used if `impl` is not supported by current cpu
+	Rijndael(const BLOCK key, Implementation impl = IMPL_AUTO);
 	~Rijndael();
 
+	Implementation get_implementation(void) const { return m_impl; }
+
+	//is the implementation supported by current cpu
+	static bool is_supported(Implementation impl);
+	static const char* get_implementation_name(Implementation impl);
+
 public:
 	//Encrypt memory, use CBC mode
 	//@remark In CBC Mode a ciphertext block is obtained by first xoring the
@@ -32,6 +47,14 @@ public:
 	//@remark size should be > 0 and multiple of m_blockSize
 	void decrypt(const uint8_t* input, uint8_t* output, size_t size, BLOCK iv = nullptr);
 
+	//Encrypt exactly one block(ECB), used by other modes
+	void encrypt_block(const uint8_t* input, uint8_t* output);
+
+	//CTR mode kernel, xor the keystream of `blocks` counter blocks into input.
+	//@remark the last 32 bits of counter(big endian) is increased for each block(inc32 of GCM),
+	//and the next counter is returned in `counter`. Multi blocks are interleaved by hardware implementations
+	void ctr_blocks(BLOCK counter, const uint8_t* input, uint8_t* output, size_t blocks);
+
 private:
 	//Convenience method to encrypt exactly one block of plaintext, assuming
 	//Rijndael's default block size (128-bit).
@@ -50,6 +73,12 @@ private:
 	uint32_t m_Ke[ROUNDS + 1][BC];
 	//Decryption (m_Kd) round key
 	uint32_t m_Kd[ROUNDS + 1][BC];
+
+	//Round keys in byte order, used by hardware implementations
+	alignas(16) uint8_t m_hwKe[ROUNDS + 1][BLOCK_SIZE];
+	alignas(16) uint8_t m_hwKd[ROUNDS + 1][BLOCK_SIZE];
+
+	Implementation m_impl;
 };
 
 }
@@ -0,0 +1,495 @@
+/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_crypt.h>
+#include <cy_core.h>
+#include "cyr_rijndael_modes.h"
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+static inline uint64_t _load_be64(const uint8_t* p)
+{
+	uint64_t v = 0;
+	for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+	return v;
+}
+
+//-------------------------------------------------------------------------------------
+static inline void _store_be64(uint8_t* p, uint64_t v)
+{
+	for (int i = 7; i >= 0; i--, v >>= 8) p[i] = (uint8_t)v;
+}
+
+//-------------------------------------------------------------------------------------
+static inline void _xor_block(uint8_t* dst, const uint8_t* src, size_t size)
+{
+	for (size_t i = 0; i < size; i++) dst[i] ^= src[i];
+}
+
+//-------------------------------------------------------------------------------------
+//bulk data are processed in chunks, so the ciphertext is still in L1 cache when hashed
+static const size_t kChunkBlocks = 64;
+
+//-------------------------------------------------------------------------------------
+RijndaelCTR::RijndaelCTR(const Rijndael::BLOCK key, const Rijndael::BLOCK counter, Rijndael::Implementation impl)
+	: m_aes(key, impl)
+{
+	reset(counter);
+}
+
+//-------------------------------------------------------------------------------------
+RijndaelCTR::~RijndaelCTR()
+{
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelCTR::reset(const Rijndael::BLOCK counter)
+{
+	memcpy(m_counter, counter, BLOCK_SIZE);
+	m_keystream_used = BLOCK_SIZE;
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelCTR::update(const uint8_t* input, uint8_t* output, size_t size)
+{
+	//keystream left by last call
+	while (size > 0 && m_keystream_used < BLOCK_SIZE) {
+		*(output++) = (uint8_t)(*(input++) ^ m_keystream[m_keystream_used++]);
+		size--;
+	}
+
+	size_t blocks = size / BLOCK_SIZE;
+	if (blocks > 0) {
+		m_aes.ctr_blocks(m_counter, input, output, blocks);
+		input += blocks * BLOCK_SIZE;
+		output += blocks * BLOCK_SIZE;
+		size -= blocks * BLOCK_SIZE;
+	}
+
+	if (size > 0) {
+		memset(m_keystream, 0, BLOCK_SIZE);
+		m_aes.ctr_blocks(m_counter, m_keystream, m_keystream, 1);
+		for (m_keystream_used = 0; m_keystream_used < size; m_keystream_used++) {
+			output[m_keystream_used] = (uint8_t)(input[m_keystream_used] ^ m_keystream[m_keystream_used]);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+bool RijndaelCTR::update(RingBuf& buf, size_t off, size_t count)
+{
+	return buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		update(data, data, size);
+	});
+}
+
+//GHASH
+//The portable implementation is the 4-bit table method(Shoup's), the clmul implementation
+//follows "Intel Carry-Less Multiplication Instruction and its Usage for Computing the GCM Mode",
+//the data is byte reflected and 4 blocks are aggregated with H^1..H^4 before one reduction.
+//-------------------------------------------------------------------------------------
+static const uint64_t kLast4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+//-------------------------------------------------------------------------------------
+static void _gf_gen_table(const uint8_t* h, uint64_t* HL, uint64_t* HH)
+{
+	uint64_t vh = _load_be64(h);
+	uint64_t vl = _load_be64(h + 8);
+
+	//8 = 1000 corresponds to 1 in GF(2^128)
+	HL[8] = vl;
+	HH[8] = vh;
+	HL[0] = 0;
+	HH[0] = 0;
+
+	for (int i = 4; i > 0; i >>= 1) {
+		uint64_t T = (vl & 1) * 0xe1000000ull;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ (T << 32);
+		HL[i] = vl;
+		HH[i] = vh;
+	}
+	for (int i = 2; i <= 8; i *= 2) {
+		for (int j = 1; j < i; j++) {
+			HH[i + j] = HH[i] ^ HH[j];
+			HL[i + j] = HL[i] ^ HL[j];
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+static void _gf_mult(const uint64_t* HL, const uint64_t* HH, uint8_t* x)
+{
+	uint8_t lo = (uint8_t)(x[15] & 0xf);
+	uint64_t zh = HH[lo];
+	uint64_t zl = HL[lo];
+
+	for (int i = 15; i >= 0; i--) {
+		lo = (uint8_t)(x[i] & 0xf);
+		uint8_t hi = (uint8_t)((x[i] >> 4) & 0xf);
+
+		if (i != 15) {
+			uint8_t rem = (uint8_t)(zl & 0xf);
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (kLast4[rem] << 48);
+			zh ^= HH[lo];
+			zl ^= HL[lo];
+		}
+		uint8_t rem = (uint8_t)(zl & 0xf);
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (kLast4[rem] << 48);
+		zh ^= HH[hi];
+		zl ^= HL[hi];
+	}
+	_store_be64(x, zh);
+	_store_be64(x + 8, zl);
+}
+
+#if defined(CY_CRYPT_X86)
+#define CLMUL_TARGET __attribute__((target("pclmul,ssse3,sse2")))
+
+//-------------------------------------------------------------------------------------
+CLMUL_TARGET
+static inline __m128i _clmul_bswap(__m128i x)
+{
+	return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+//-------------------------------------------------------------------------------------
+//256 bits carry-less product of a and b
+CLMUL_TARGET
+static inline void _clmul_wide(__m128i a, __m128i b, __m128i& lo, __m128i& hi)
+{
+	__m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+	__m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+	__m128i t2 = _mm_clmulepi64_si128(a, b, 0x11);
+	lo = _mm_xor_si128(t0, _mm_slli_si128(t1, 8));
+	hi = _mm_xor_si128(t2, _mm_srli_si128(t1, 8));
+}
+
+//-------------------------------------------------------------------------------------
+//shift the 256 bits product left by 1(bit reflected) and reduce modulo x^128+x^7+x^2+x+1
+CLMUL_TARGET
+static inline __m128i _clmul_reduce(__m128i lo, __m128i hi)
+{
+	__m128i t7 = _mm_srli_epi32(lo, 31);
+	__m128i t8 = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+	__m128i t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	lo = _mm_or_si128(lo, t7);
+	hi = _mm_or_si128(hi, t8);
+	hi = _mm_or_si128(hi, t9);
+
+	t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	lo = _mm_xor_si128(lo, t7);
+
+	__m128i t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+	t2 = _mm_xor_si128(t2, t8);
+	lo = _mm_xor_si128(lo, t2);
+	return _mm_xor_si128(hi, lo);
+}
+
+//-------------------------------------------------------------------------------------
+CLMUL_TARGET
+static void _clmul_init(const uint8_t* h, uint8_t (*hpow)[16])
+{
+	__m128i h1 = _clmul_bswap(_mm_loadu_si128((const __m128i*)h));
+	__m128i lo, hi;
+	_clmul_wide(h1, h1, lo, hi);
+	__m128i h2 = _clmul_reduce(lo, hi);
+	_clmul_wide(h2, h1, lo, hi);
+	__m128i h3 = _clmul_reduce(lo, hi);
+	_clmul_wide(h3, h1, lo, hi);
+	__m128i h4 = _clmul_reduce(lo, hi);
+
+	_mm_storeu_si128((__m128i*)hpow[0], h1);
+	_mm_storeu_si128((__m128i*)hpow[1], h2);
+	_mm_storeu_si128((__m128i*)hpow[2], h3);
+	_mm_storeu_si128((__m128i*)hpow[3], h4);
+}
+
+//-------------------------------------------------------------------------------------
+CLMUL_TARGET
+static void _clmul_ghash(const uint8_t (*hpow)[16], uint8_t* ghash, const uint8_t* data, size_t blocks)
+{
+	__m128i h1 = _mm_loadu_si128((const __m128i*)hpow[0]);
+	__m128i h2 = _mm_loadu_si128((const __m128i*)hpow[1]);
+	__m128i h3 = _mm_loadu_si128((const __m128i*)hpow[2]);
+	__m128i h4 = _mm_loadu_si128((const __m128i*)hpow[3]);
+	__m128i x = _clmul_bswap(_mm_loadu_si128((const __m128i*)ghash));
+
+	size_t i = 0;
+	for (; i + 4 <= blocks; i += 4, data += 64) {
+		__m128i d0 = _clmul_bswap(_mm_loadu_si128((const __m128i*)data));
+		__m128i d1 = _clmul_bswap(_mm_loadu_si128((const __m128i*)(data + 16)));
+		__m128i d2 = _clmul_bswap(_mm_loadu_si128((const __m128i*)(data + 32)));
+		__m128i d3 = _clmul_bswap(_mm_loadu_si128((const __m128i*)(data + 48)));
+
+		//X' = (X^D0)*H^4 + D1*H^3 + D2*H^2 + D3*H
+		__m128i lo, hi, l, h;
+		_clmul_wide(_mm_xor_si128(x, d0), h4, lo, hi);
+		_clmul_wide(d1, h3, l, h);
+		lo = _mm_xor_si128(lo, l); hi = _mm_xor_si128(hi, h);
+		_clmul_wide(d2, h2, l, h);
+		lo = _mm_xor_si128(lo, l); hi = _mm_xor_si128(hi, h);
+		_clmul_wide(d3, h1, l, h);
+		lo = _mm_xor_si128(lo, l); hi = _mm_xor_si128(hi, h);
+		x = _clmul_reduce(lo, hi);
+	}
+	for (; i < blocks; i++, data += 16) {
+		__m128i d = _clmul_bswap(_mm_loadu_si128((const __m128i*)data));
+		__m128i lo, hi;
+		_clmul_wide(_mm_xor_si128(x, d), h1, lo, hi);
+		x = _clmul_reduce(lo, hi);
+	}
+	_mm_storeu_si128((__m128i*)ghash, _clmul_bswap(x));
+}
+#endif
+
+//-------------------------------------------------------------------------------------
+RijndaelGCM::RijndaelGCM(const Rijndael::BLOCK key, Rijndael::Implementation impl)
+	: m_aes(key, impl)
+	, m_clmul(false)
+{
+	memset(m_H, 0, BLOCK_SIZE);
+	m_aes.encrypt_block(m_H, m_H);
+	_gf_gen_table(m_H, m_HL, m_HH);
+	memset(m_Hpow, 0, sizeof(m_Hpow));
+
+#if defined(CY_CRYPT_X86)
+	//the table implementation is portable everywhere
+	if (impl != Rijndael::IMPL_TABLE && get_cpu_features().pclmul && get_cpu_features().ssse3) {
+		m_clmul = true;
+		_clmul_init(m_H, m_Hpow);
+	}
+#endif
+
+	const uint8_t zero_iv[IV_SIZE] = { 0 };
+	start(zero_iv, IV_SIZE);
+}
+
+//-------------------------------------------------------------------------------------
+RijndaelGCM::~RijndaelGCM()
+{
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::_ghash_blocks(const uint8_t* data, size_t blocks)
+{
+#if defined(CY_CRYPT_X86)
+	if (m_clmul) {
+		_clmul_ghash(m_Hpow, m_ghash, data, blocks);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < blocks; i++, data += BLOCK_SIZE) {
+		_xor_block(m_ghash, data, BLOCK_SIZE);
+		_gf_mult(m_HL, m_HH, m_ghash);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::start(const uint8_t* iv, size_t iv_size)
+{
+	assert(iv && iv_size > 0);
+
+	memset(m_ghash, 0, BLOCK_SIZE);
+	if (iv_size == IV_SIZE) {
+		//J0 = IV || 0^31 || 1
+		memcpy(m_counter, iv, IV_SIZE);
+		m_counter[12] = m_counter[13] = m_counter[14] = 0;
+		m_counter[15] = 1;
+	}
+	else {
+		//J0 = GHASH(IV || 0^(s+64) || [len(IV)]64)
+		size_t blocks = iv_size / BLOCK_SIZE;
+		_ghash_blocks(iv, blocks);
+		Rijndael::BLOCK last = { 0 };
+		if (iv_size % BLOCK_SIZE) {
+			memcpy(last, iv + blocks * BLOCK_SIZE, iv_size % BLOCK_SIZE);
+			_ghash_blocks(last, 1);
+			memset(last, 0, BLOCK_SIZE);
+		}
+		_store_be64(last + 8, (uint64_t)iv_size * 8);
+		_ghash_blocks(last, 1);
+		memcpy(m_counter, m_ghash, BLOCK_SIZE);
+		memset(m_ghash, 0, BLOCK_SIZE);
+	}
+
+	//E(K, J0) masks the tag, the data begins from inc32(J0)
+	memset(m_ek0, 0, BLOCK_SIZE);
+	m_aes.ctr_blocks(m_counter, m_ek0, m_ek0, 1);
+
+	m_partial_size = 0;
+	m_keystream_used = BLOCK_SIZE;
+	m_aad_size = 0;
+	m_text_size = 0;
+	m_aad_done = false;
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::update_aad(const uint8_t* aad, size_t size)
+{
+	assert(!m_aad_done);
+	m_aad_size += size;
+
+	if (m_partial_size > 0) {
+		size_t n = std::min(size, BLOCK_SIZE - m_partial_size);
+		memcpy(m_partial + m_partial_size, aad, n);
+		m_partial_size += n;
+		aad += n;
+		size -= n;
+		if (m_partial_size < BLOCK_SIZE) return;
+		_ghash_blocks(m_partial, 1);
+		m_partial_size = 0;
+	}
+
+	size_t blocks = size / BLOCK_SIZE;
+	_ghash_blocks(aad, blocks);
+	m_partial_size = size - blocks * BLOCK_SIZE;
+	memcpy(m_partial, aad + blocks * BLOCK_SIZE, m_partial_size);
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::_ghash_flush_aad(void)
+{
+	if (m_aad_done) return;
+	m_aad_done = true;
+
+	//aad is padded to block size
+	if (m_partial_size > 0) {
+		memset(m_partial + m_partial_size, 0, BLOCK_SIZE - m_partial_size);
+		_ghash_blocks(m_partial, 1);
+		m_partial_size = 0;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::_crypt(const uint8_t* input, uint8_t* output, size_t size, bool encrypt)
+{
+	_ghash_flush_aad();
+	m_text_size += size;
+
+	//keystream left by last call, the partial ciphertext block has the same size
+	while (size > 0 && m_keystream_used < BLOCK_SIZE) {
+		uint8_t in = *(input++);
+		uint8_t out = (uint8_t)(in ^ m_keystream[m_keystream_used++]);
+		*(output++) = out;
+		m_partial[m_partial_size++] = encrypt ? out : in;
+		size--;
+	}
+	if (m_partial_size == BLOCK_SIZE) {
+		_ghash_blocks(m_partial, 1);
+		m_partial_size = 0;
+	}
+
+	//hash the ciphertext, before decryption(maybe in place) or after encryption
+	while (size >= BLOCK_SIZE) {
+		size_t blocks = std::min(size / BLOCK_SIZE, kChunkBlocks);
+		if (!encrypt) _ghash_blocks(input, blocks);
+		m_aes.ctr_blocks(m_counter, input, output, blocks);
+		if (encrypt) _ghash_blocks(output, blocks);
+
+		input += blocks * BLOCK_SIZE;
+		output += blocks * BLOCK_SIZE;
+		size -= blocks * BLOCK_SIZE;
+	}
+
+	if (size > 0) {
+		memset(m_keystream, 0, BLOCK_SIZE);
+		m_aes.ctr_blocks(m_counter, m_keystream, m_keystream, 1);
+		for (m_keystream_used = 0; m_keystream_used < size; m_keystream_used++) {
+			uint8_t in = input[m_keystream_used];
+			uint8_t out = (uint8_t)(in ^ m_keystream[m_keystream_used]);
+			output[m_keystream_used] = out;
+			m_partial[m_keystream_used] = encrypt ? out : in;
+		}
+		m_partial_size = size;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::encrypt(const uint8_t* input, uint8_t* output, size_t size)
+{
+	_crypt(input, output, size, true);
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::decrypt(const uint8_t* input, uint8_t* output, size_t size)
+{
+	_crypt(input, output, size, false);
+}
+
+//-------------------------------------------------------------------------------------
+bool RijndaelGCM::encrypt(RingBuf& buf, size_t off, size_t count)
+{
+	return buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		_crypt(data, data, size, true);
+	});
+}
+
+//-------------------------------------------------------------------------------------
+bool RijndaelGCM::decrypt(RingBuf& buf, size_t off, size_t count)
+{
+	return buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		_crypt(data, data, size, false);
+	});
+}
+
+//-------------------------------------------------------------------------------------
+void RijndaelGCM::finish(uint8_t* tag, size_t tag_size)
+{
+	assert(tag_size <= TAG_SIZE);
+	_ghash_flush_aad();
+
+	//ciphertext is padded to block size
+	if (m_partial_size > 0) {
+		memset(m_partial + m_partial_size, 0, BLOCK_SIZE - m_partial_size);
+		_ghash_blocks(m_partial, 1);
+		m_partial_size = 0;
+	}
+	m_keystream_used = BLOCK_SIZE;
+
+	//[len(A)]64 || [len(C)]64
+	Rijndael::BLOCK length_block;
+	_store_be64(length_block, m_aad_size * 8);
+	_store_be64(length_block + 8, m_text_size * 8);
+	_ghash_blocks(length_block, 1);
+
+	Rijndael::BLOCK full_tag;
+	memcpy(full_tag, m_ghash, BLOCK_SIZE);
+	_xor_block(full_tag, m_ek0, BLOCK_SIZE);
+	memcpy(tag, full_tag, std::min(tag_size, (size_t)TAG_SIZE));
+}
+
+//-------------------------------------------------------------------------------------
+bool RijndaelGCM::verify(const uint8_t* tag, size_t tag_size)
+{
+	if (tag_size < MIN_TAG_SIZE || tag_size > TAG_SIZE) return false;
+
+	uint8_t expected[TAG_SIZE];
+	finish(expected, TAG_SIZE);
+
+	uint8_t diff = 0;
+	for (size_t i = 0; i < tag_size; i++) diff = (uint8_t)(diff | (expected[i] ^ tag[i]));
+	return diff == 0;
+}
+
+}
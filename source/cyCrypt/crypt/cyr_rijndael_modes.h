@@ -0,0 +1,110 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+#include <crypt/cyr_rijndael.h>
+
+namespace cyclone
+{
+
+//forward declaration
+class RingBuf;
+
+//AES-128 in CTR mode(NIST SP 800-38A), a stream cipher, encryption and decryption are
+//the same operation and the data need not be padded.
+//@remark the last 32 bits of the initial counter block is increased for each block(as GCM),
+//so one counter block can encrypt 64GB data at most
+class RijndaelCTR
+{
+public:
+	enum { BLOCK_SIZE = Rijndael::BLOCK_SIZE };
+
+	//xor the keystream into data, `size` can be any length, the keystream continues
+	//between calls. input and output can be the same memory
+	void update(const uint8_t* input, uint8_t* output, size_t size);
+	//encrypt/decrypt the data of ring buf from off to off+count in place
+	//@return false if the range is out of data
+	bool update(RingBuf& buf, size_t off, size_t count);
+
+	//restart the keystream with a new counter block
+	void reset(const Rijndael::BLOCK counter);
+
+public:
+	RijndaelCTR(const Rijndael::BLOCK key, const Rijndael::BLOCK counter, Rijndael::Implementation impl = Rijndael::IMPL_AUTO);
+	~RijndaelCTR();
+
+private:
+	Rijndael m_aes;
+	Rijndael::BLOCK m_counter;
+	Rijndael::BLOCK m_keystream;	//keystream of last partial block
+	size_t m_keystream_used;		//BLOCK_SIZE means no keystream left
+};
+
+//AES-128 in GCM mode(NIST SP 800-38D), authenticated encryption with associated data.
+//Usage:
+//	gcm.start(iv, 12);
+//	gcm.update_aad(header, header_size);		//optional, must before encrypt/decrypt
+//	gcm.encrypt(data, data, data_size);			//or decrypt, can be called many times with any length
+//	gcm.finish(tag);							//or gcm.verify(tag) after decrypt
+class RijndaelGCM
+{
+public:
+	enum { BLOCK_SIZE = Rijndael::BLOCK_SIZE, TAG_SIZE = 16, MIN_TAG_SIZE = 12, IV_SIZE = 12 };
+
+	//begin a new message, the recommended iv size is 12 bytes(IV_SIZE),
+	//the iv MUST NOT be reused with the same key
+	void start(const uint8_t* iv, size_t iv_size = IV_SIZE);
+
+	//add additional authenticated data
+	void update_aad(const uint8_t* aad, size_t size);
+
+	//encrypt or decrypt the data, input and output can be the same memory
+	void encrypt(const uint8_t* input, uint8_t* output, size_t size);
+	void decrypt(const uint8_t* input, uint8_t* output, size_t size);
+	//encrypt or decrypt the data of ring buf from off to off+count in place
+	bool encrypt(RingBuf& buf, size_t off, size_t count);
+	bool decrypt(RingBuf& buf, size_t off, size_t count);
+
+	//get the authentication tag of the message, tag_size is 16 or less(truncated)
+	void finish(uint8_t* tag, size_t tag_size = TAG_SIZE);
+	//compare the tag in constant time after decryption, a tag shorter than MIN_TAG_SIZE
+	//(SP 800-38D) is always rejected
+	bool verify(const uint8_t* tag, size_t tag_size = TAG_SIZE);
+
+	//is GHASH accelerated by carry-less multiplication instruction
+	bool is_ghash_accelerated(void) const { return m_clmul; }
+
+public:
+	RijndaelGCM(const Rijndael::BLOCK key, Rijndael::Implementation impl = Rijndael::IMPL_AUTO);
+	~RijndaelGCM();
+
+private:
+	void _crypt(const uint8_t* input, uint8_t* output, size_t size, bool encrypt);
+	void _ghash_flush_aad(void);
+	void _ghash_blocks(const uint8_t* data, size_t blocks);
+
+private:
+	Rijndael m_aes;
+	bool m_clmul;
+
+	//hash subkey H=E(K, 0^128) and tables of it
+	Rijndael::BLOCK m_H;
+	uint64_t m_HL[16];
+	uint64_t m_HH[16];
+	alignas(16) uint8_t m_Hpow[4][BLOCK_SIZE];	//H^1..H^4 byte reflected, used by clmul
+
+	Rijndael::BLOCK m_ek0;			//E(K, J0)
+	Rijndael::BLOCK m_counter;
+	Rijndael::BLOCK m_ghash;		//current hash value
+	Rijndael::BLOCK m_partial;		//partial block of aad or ciphertext to be hashed
+	size_t m_partial_size;
+	Rijndael::BLOCK m_keystream;
+	size_t m_keystream_used;
+	uint64_t m_aad_size;
+	uint64_t m_text_size;
+	bool m_aad_done;
+};
+
+}
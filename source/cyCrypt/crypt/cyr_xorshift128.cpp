@@ -2,7 +2,13 @@
 Copyright(C) thecodeway.com
 */
 #include <cy_crypt.h>
+#include <cy_core.h>
 #include "cyr_xorshift128.h"
+#include "cyr_cpu_features.h"
+
+#if defined(CY_CRYPT_X86)
+#include <immintrin.h>
+#endif
 
 namespace cyclone
 {
@@ -38,4 +44,240 @@ void xorshift128(uint8_t* buf, size_t byte_length, XorShift128& seed)
 	}
 }
 
+//-------------------------------------------------------------------------------------
+static inline uint64_t _load_le64(const uint8_t* p)
+{
+	uint64_t v = 0;
+	for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+	return v;
+}
+
+//-------------------------------------------------------------------------------------
+static inline void _store_le64(uint8_t* p, uint64_t v)
+{
+	for (int i = 0; i < 8; i++, v >>= 8) p[i] = (uint8_t)v;
+}
+
+//-------------------------------------------------------------------------------------
+//splitmix64, expand one seed to the seeds of all lanes
+static inline uint64_t _splitmix64(uint64_t& x)
+{
+	uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+//-------------------------------------------------------------------------------------
+static void _portable_blocks(uint64_t* seed0, uint64_t* seed1, size_t lanes, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	for (size_t n = 0; n < blocks; n++) {
+		for (size_t i = 0; i < lanes; i++, input += 8, output += 8) {
+			uint64_t x = seed0[i];
+			uint64_t y = seed1[i];
+			seed0[i] = y;
+			x ^= x << 23;
+			x ^= x >> 17;
+			x ^= y ^ (y >> 26);
+			seed1[i] = x;
+			_store_le64(output, _load_le64(input) ^ (x + y));
+		}
+	}
+}
+
+//SIMD kernels, the lanes are kept in registers during the loop and the 64 bits outputs are
+//stored in lane order, which is the byte order of little endian cpu
+#if defined(CY_CRYPT_X86)
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+#define XORSHIFT128_STEP(SLL, SRL, XOR, s0, s1, out) { \
+	x = s0; y = s1; s0 = y; \
+	x = XOR(x, SLL(x, 23)); \
+	x = XOR(x, SRL(x, 17)); \
+	x = XOR(x, XOR(y, SRL(y, 26))); \
+	s1 = x; out = x; }
+
+//-------------------------------------------------------------------------------------
+SSE2_TARGET
+static void _sse2_blocks(uint64_t* seed0, uint64_t* seed1, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	__m128i s0[4], s1[4];
+	for (int i = 0; i < 4; i++) {
+		s0[i] = _mm_loadu_si128((const __m128i*)(seed0 + i * 2));
+		s1[i] = _mm_loadu_si128((const __m128i*)(seed1 + i * 2));
+	}
+	for (size_t n = 0; n < blocks; n++, input += XorShift128Stream::BLOCK_SIZE, output += XorShift128Stream::BLOCK_SIZE) {
+		for (int i = 0; i < 4; i++) {
+			__m128i x, y, k;
+			XORSHIFT128_STEP(_mm_slli_epi64, _mm_srli_epi64, _mm_xor_si128, s0[i], s1[i], k);
+			k = _mm_add_epi64(k, y);
+			__m128i in = _mm_loadu_si128((const __m128i*)(input + i * 16));
+			_mm_storeu_si128((__m128i*)(output + i * 16), _mm_xor_si128(in, k));
+		}
+	}
+	for (int i = 0; i < 4; i++) {
+		_mm_storeu_si128((__m128i*)(seed0 + i * 2), s0[i]);
+		_mm_storeu_si128((__m128i*)(seed1 + i * 2), s1[i]);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+AVX2_TARGET
+static void _avx2_blocks(uint64_t* seed0, uint64_t* seed1, const uint8_t* input, uint8_t* output, size_t blocks)
+{
+	__m256i s0[2], s1[2];
+	for (int i = 0; i < 2; i++) {
+		s0[i] = _mm256_loadu_si256((const __m256i*)(seed0 + i * 4));
+		s1[i] = _mm256_loadu_si256((const __m256i*)(seed1 + i * 4));
+	}
+	for (size_t n = 0; n < blocks; n++, input += XorShift128Stream::BLOCK_SIZE, output += XorShift128Stream::BLOCK_SIZE) {
+		for (int i = 0; i < 2; i++) {
+			__m256i x, y, k;
+			XORSHIFT128_STEP(_mm256_slli_epi64, _mm256_srli_epi64, _mm256_xor_si256, s0[i], s1[i], k);
+			k = _mm256_add_epi64(k, y);
+			__m256i in = _mm256_loadu_si256((const __m256i*)(input + i * 32));
+			_mm256_storeu_si256((__m256i*)(output + i * 32), _mm256_xor_si256(in, k));
+		}
+	}
+	for (int i = 0; i < 2; i++) {
+		_mm256_storeu_si256((__m256i*)(seed0 + i * 4), s0[i]);
+		_mm256_storeu_si256((__m256i*)(seed1 + i * 4), s1[i]);
+	}
+}
+#endif
+
+//-------------------------------------------------------------------------------------
+bool XorShift128Stream::is_supported(Implementation impl)
+{
+	switch (impl) {
+	case IMPL_AUTO:
+	case IMPL_COMPAT:
+	case IMPL_PORTABLE:
+		return true;
+#if defined(CY_CRYPT_X86)
+	case IMPL_SSE2:
+		return get_cpu_features().sse2;
+	case IMPL_AVX2:
+		return get_cpu_features().avx2;
+#endif
+	default:
+		return false;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+const char* XorShift128Stream::get_implementation_name(Implementation impl)
+{
+	switch (impl) {
+	case IMPL_AUTO: return "auto";
+	case IMPL_COMPAT: return "compat";
+	case IMPL_PORTABLE: return "portable";
+	case IMPL_SSE2: return "sse2";
+	case IMPL_AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+//-------------------------------------------------------------------------------------
+XorShift128Stream::XorShift128Stream(const XorShift128& seed, Implementation impl)
+{
+	if (impl == IMPL_AUTO) {
+		impl = IMPL_PORTABLE;
+		if (is_supported(IMPL_AVX2)) impl = IMPL_AVX2;
+		else if (is_supported(IMPL_SSE2)) impl = IMPL_SSE2;
+	}
+	m_impl = is_supported(impl) ? impl : IMPL_PORTABLE;
+	m_keystream_size = (m_impl == IMPL_COMPAT) ? 8 : (size_t)BLOCK_SIZE;
+	reset(seed);
+}
+
+//-------------------------------------------------------------------------------------
+XorShift128Stream::~XorShift128Stream()
+{
+	memset(m_seed0, 0, sizeof(m_seed0));
+	memset(m_seed1, 0, sizeof(m_seed1));
+	memset(m_keystream, 0, sizeof(m_keystream));
+}
+
+//-------------------------------------------------------------------------------------
+void XorShift128Stream::reset(const XorShift128& seed)
+{
+	//the first lane is the seed itself, so it's the same sequence as XorShift128::next()
+	m_seed0[0] = seed.seed0;
+	m_seed1[0] = seed.seed1;
+
+	uint64_t x = seed.seed0 ^ ((seed.seed1 << 32) | (seed.seed1 >> 32));
+	for (size_t i = 1; i < LANES; i++) {
+		m_seed0[i] = _splitmix64(x);
+		m_seed1[i] = _splitmix64(x);
+		//all zero state never changes
+		if (m_seed0[i] == 0 && m_seed1[i] == 0) m_seed1[i] = 1;
+	}
+	m_keystream_used = m_keystream_size;
+}
+
+//-------------------------------------------------------------------------------------
+void XorShift128Stream::_update(const uint8_t* input, uint8_t* output, size_t size)
+{
+	//keystream left by last call
+	while (size > 0 && m_keystream_used < m_keystream_size) {
+		*(output++) = (uint8_t)(*(input++) ^ m_keystream[m_keystream_used++]);
+		size--;
+	}
+
+	size_t lanes = m_keystream_size / 8;
+	size_t blocks = size / m_keystream_size;
+#if defined(CY_CRYPT_X86)
+	if (m_impl == IMPL_AVX2) {
+		_avx2_blocks(m_seed0, m_seed1, input, output, blocks);
+	}
+	else if (m_impl == IMPL_SSE2) {
+		_sse2_blocks(m_seed0, m_seed1, input, output, blocks);
+	}
+	else
+#endif
+	{
+		_portable_blocks(m_seed0, m_seed1, lanes, input, output, blocks);
+	}
+	input += blocks * m_keystream_size;
+	output += blocks * m_keystream_size;
+	size -= blocks * m_keystream_size;
+
+	if (size > 0) {
+		memset(m_keystream, 0, m_keystream_size);
+		_portable_blocks(m_seed0, m_seed1, lanes, m_keystream, m_keystream, 1);
+		for (m_keystream_used = 0; m_keystream_used < size; m_keystream_used++) {
+			output[m_keystream_used] = (uint8_t)(input[m_keystream_used] ^ m_keystream[m_keystream_used]);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void XorShift128Stream::update(const uint8_t* input, uint8_t* output, size_t size)
+{
+	if (m_impl == IMPL_COMPAT) {
+		if (input != output) memmove(output, input, size);
+
+		XorShift128 seed;
+		seed.seed0 = m_seed0[0];
+		seed.seed1 = m_seed1[0];
+		xorshift128(output, size, seed);
+		m_seed0[0] = seed.seed0;
+		m_seed1[0] = seed.seed1;
+		return;
+	}
+	_update(input, output, size);
+}
+
+//-------------------------------------------------------------------------------------
+bool XorShift128Stream::update(RingBuf& buf, size_t off, size_t count)
+{
+	bool ret = buf.for_each_span(off, count, [this](uint8_t* data, size_t size) {
+		_update(data, data, size);
+	});
+	if (m_impl == IMPL_COMPAT) m_keystream_used = m_keystream_size;
+	return ret;
+}
+
 }
@@ -27,4 +27,58 @@ struct XorShift128 {
 
 void xorshift128(uint8_t* buf, size_t byte_length, XorShift128& seed);
 
+//forward declaration
+class RingBuf;
+
+//XorShift128+ keystream of 8 independent lanes, one 64 bits output of every lane makes a
+//64 bytes block. The lanes are stepped together by SSE2(2 lanes per register) or AVX2
+//(4 lanes per register) if available, all of the implementations except IMPL_COMPAT
+//generate the same keystream. It's a lightweight obfuscation, NOT a cipher.
+class XorShift128Stream
+{
+public:
+	enum { LANES = 8, BLOCK_SIZE = LANES * 8 };
+
+	enum Implementation {
+		IMPL_AUTO = 0,	//the fastest one supported by current cpu
+		IMPL_COMPAT,	//one lane, the same output as xorshift128() on every call
+		IMPL_PORTABLE,
+		IMPL_SSE2,
+		IMPL_AVX2,
+	};
+
+	//xor the keystream into data, input and output can be the same memory. The keystream
+	//continues between calls, except IMPL_COMPAT which drops the unused bytes of the last
+	//output like xorshift128()
+	void update(const uint8_t* input, uint8_t* output, size_t size);
+	//xor the keystream into the data of ring buf from off to off+count in place
+	//@return false if the range is out of data
+	bool update(RingBuf& buf, size_t off, size_t count);
+
+	//restart the keystream with a new seed
+	void reset(const XorShift128& seed);
+
+	Implementation get_implementation(void) const { return m_impl; }
+
+	//is the implementation supported by current cpu
+	static bool is_supported(Implementation impl);
+	static const char* get_implementation_name(Implementation impl);
+
+public:
+	//@remark the portable implementation is used if `impl` is not supported by current cpu
+	XorShift128Stream(const XorShift128& seed, Implementation impl = IMPL_AUTO);
+	~XorShift128Stream();
+
+private:
+	void _update(const uint8_t* input, uint8_t* output, size_t size);
+
+private:
+	uint64_t m_seed0[LANES];
+	uint64_t m_seed1[LANES];
+	uint8_t m_keystream[BLOCK_SIZE];	//keystream of last partial block
+	size_t m_keystream_size;			//8 in compat mode
+	size_t m_keystream_used;
+	Implementation m_impl;
+};
+
 }
@@ -5,7 +5,11 @@ Copyright(C) thecodeway.com
 
 #include <cyclone_config.h>
 
+#include <crypt/cyr_cpu_features.h>
 #include <crypt/cyr_adler32.h>
+#include <crypt/cyr_crc32c.h>
 #include <crypt/cyr_dhexchange.h>
 #include <crypt/cyr_xorshift128.h>
 #include <crypt/cyr_rijndael.h>
+#include <crypt/cyr_rijndael_modes.h>
+#include <crypt/cyr_chacha20.h>
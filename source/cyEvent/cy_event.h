@@ -7,5 +7,5 @@ Copyright(C) thecodeway.com
 
 #include <event/cye_pipe.h>
 #include <event/cye_looper.h>
-#include <event/cye_work_thread.h>
 #include <event/cye_packet.h>
+#include <event/cye_work_thread.h>
@@ -4,6 +4,7 @@ Copyright(C) thecodeway.com
 #include <cy_core.h>
 #include <cy_event.h>
 #include "cye_looper.h"
+#include <utility/cyu_histogram.h>
 #include "internal/cye_looper_epoll.h"
 #include "internal/cye_looper_select.h"
 
@@ -22,18 +23,19 @@ Looper::Looper()
 	: m_free_head(INVALID_EVENT_ID)
 	, m_active_channel_counts(0)
 	, m_loop_counts(0)
+	, m_cached_time(sys_api::performance_time_now())
+	, m_step_statistics(nullptr)
 	, m_current_thread(sys_api::thread_get_current_id())
 	, m_inner_pipe(nullptr)
 	, m_inner_pipe_touched(0)
 	, m_quit_cmd(0)
 {
-	m_lock = sys_api::mutex_create();
 }
 
 //-------------------------------------------------------------------------------------
 Looper::~Looper()
 {
-	sys_api::mutex_destroy(m_lock);
+	delete m_step_statistics;
 }
 
 //-------------------------------------------------------------------------------------
@@ -44,7 +46,7 @@ Looper::event_id_t Looper::register_event(socket_t sockfd,
 	event_callback _on_write)
 {
 	assert(sys_api::thread_get_current_id() == m_current_thread);
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 
 	//get a new channel slot
 	event_id_t id = _get_free_slot();
@@ -77,7 +79,7 @@ Looper::event_id_t Looper::register_timer_event(uint32_t milliSeconds,
 	timer_callback _on_timer)
 {
 	assert(sys_api::thread_get_current_id() == m_current_thread);
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 
 	//get a new channel slot
 	event_id_t id = _get_free_slot();
@@ -142,7 +144,7 @@ void Looper::delete_event(event_id_t id)
 {
 	assert(sys_api::thread_get_current_id() == m_current_thread);
 	if (id == INVALID_EVENT_ID) return;
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	assert((size_t)id < m_channelBuffer.size());
 
 	//disable it first
@@ -176,7 +178,7 @@ void Looper::delete_event(event_id_t id)
 //-------------------------------------------------------------------------------------
 void Looper::disable_read(event_id_t id)
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -187,7 +189,7 @@ void Looper::disable_read(event_id_t id)
 //-------------------------------------------------------------------------------------
 void Looper::enable_read(event_id_t id)
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -198,7 +200,7 @@ void Looper::enable_read(event_id_t id)
 //-------------------------------------------------------------------------------------
 bool Looper::is_read(event_id_t id) const
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return false;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -209,7 +211,7 @@ bool Looper::is_read(event_id_t id) const
 //-------------------------------------------------------------------------------------
 void Looper::disable_write(event_id_t id)
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -220,7 +222,7 @@ void Looper::disable_write(event_id_t id)
 //-------------------------------------------------------------------------------------
 void Looper::enable_write(event_id_t id)
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -231,7 +233,7 @@ void Looper::enable_write(event_id_t id)
 //-------------------------------------------------------------------------------------
 bool Looper::is_write(event_id_t id) const
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return false;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -242,7 +244,7 @@ bool Looper::is_write(event_id_t id) const
 //-------------------------------------------------------------------------------------
 void Looper::disable_all(event_id_t id)
 {
-	sys_api::auto_mutex lock(m_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 	if (id == INVALID_EVENT_ID) return;
 	assert((size_t)id < m_channelBuffer.size());
 
@@ -278,6 +280,7 @@ void Looper::loop(void)
 		//wait in kernel...
 		_poll(readList, writeList, true);
 		m_loop_counts++;
+		int64_t step_begin = update_cached_time();
 
 		if (is_quit_pending()) break;
 
@@ -304,6 +307,10 @@ void Looper::loop(void)
 			if (is_quit_pending()) break;
 		}
 
+		if (m_step_statistics) {
+			m_step_statistics->record(sys_api::performance_time_now() - step_begin);
+		}
+
 		if (is_quit_pending()) break;
 	}
 
@@ -325,6 +332,7 @@ void Looper::step(void)
 	//wait in kernel...
 	_poll(readList, writeList, false);
 	m_loop_counts++;
+	int64_t step_begin = update_cached_time();
 
 	if (is_quit_pending()) return;
 
@@ -348,6 +356,20 @@ void Looper::step(void)
 
 		if (is_quit_pending()) return;
 	}
+
+	if (m_step_statistics) {
+		m_step_statistics->record(sys_api::performance_time_now() - step_begin);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void Looper::start_step_statistics(void)
+{
+	assert(sys_api::thread_get_current_id() == m_current_thread);
+
+	//already start
+	if (m_step_statistics) return;
+	m_step_statistics = new LatencyHistogram();
 }
 
 //-------------------------------------------------------------------------------------
@@ -10,6 +10,10 @@ Copyright(C) thecodeway.com
 namespace cyclone
 {
 
+//defined in utility/cyu_histogram.h
+template<int32_t PRECISION_BITS, int32_t MAX_VALUE_BITS> class Histogram;
+typedef Histogram<5, 40> LatencyHistogram;
+
 class Looper : noncopyable
 {
 public:
@@ -72,6 +76,15 @@ public:
 	//----------------------
 	thread_id_t get_thread_id(void) const { return m_current_thread; }
 	uint64_t get_loop_counts(void) const { return m_loop_counts; }
+	//// performance time(microseconds) cached at the beginning of current reactor step, 
+	//// cheap enough to be called for every timer and statistics
+	int64_t get_cached_time(void) const { return m_cached_time; }
+	//// update the cached time
+	int64_t update_cached_time(void) { m_cached_time = sys_api::performance_time_now(); return m_cached_time; }
+	//// record the time(microseconds) of every reactor step(dispatch all active events)
+	void start_step_statistics(void);
+	//// get the histogram of reactor step time, nullptr if not started
+	const LatencyHistogram* get_step_statistics(void) const { return m_step_statistics; }
 
 protected:
 	Looper();
@@ -109,10 +122,12 @@ protected:
 	event_id_t m_free_head;			//free list head in event buf
 	int32_t m_active_channel_counts;
 	uint64_t m_loop_counts;
+	int64_t m_cached_time;
+	LatencyHistogram* m_step_statistics;
 
 	thread_id_t m_current_thread;
 
-	sys_api::mutex_t m_lock;
+	mutable sys_api::spin_mutex m_lock;	//uncontended mostly, the other thread only enable write event
 
 	Pipe* m_inner_pipe;	//pipe to push loop continue
 	atomic_int32_t m_inner_pipe_touched;
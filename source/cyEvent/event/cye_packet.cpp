@@ -11,20 +11,21 @@ namespace cyclone
 //-------------------------------------------------------------------------------------
 void* Packet::operator new(size_t size)
 {
-	void* p = CY_MALLOC(size);
+	void* p = BufPool::allocate(size, nullptr, memory::kTagPacket);
 	return p;
 }
 
 //-------------------------------------------------------------------------------------
 void Packet::operator delete(void* p)
 {
-	CY_FREE(p);
+	BufPool::deallocate(p);
 }
 
 //-------------------------------------------------------------------------------------
 Packet* Packet::alloc_packet(const Packet* other)
 {
 	Packet* p = new Packet();
+	p->add_ref();
 
 	if (other && other->m_memory_size > 0) {
 		p->_resize(other->m_head_size, other->get_packet_size());
@@ -37,7 +38,16 @@ Packet* Packet::alloc_packet(const Packet* other)
 //-------------------------------------------------------------------------------------
 void Packet::free_packet(Packet* p)
 {
-	delete p;
+	if (p) p->release();
+}
+
+//-------------------------------------------------------------------------------------
+PacketPtr Packet::alloc_shared_packet(const Packet* other)
+{
+	Packet* p = alloc_packet(other);
+	PacketPtr ptr(p);
+	p->release();
+	return ptr;
 }
 
 //-------------------------------------------------------------------------------------
@@ -63,9 +73,9 @@ void Packet::clean(void)
 {
 	m_head_size = 0;
 
-	if (m_memory_buf && m_memory_buf != m_static_buf)
+	if (m_memory_buf)
 	{
-		CY_FREE(m_memory_buf);
+		BufPool::deallocate(m_memory_buf);
 	}
 	m_memory_buf = nullptr;
 	m_memory_size = 0;
@@ -95,11 +105,12 @@ void Packet::_resize(size_t head_size, size_t packet_size)
 	m_memory_size = head_size + packet_size;
 	size_t need_memory_size = m_memory_size + MEMORY_SAFE_TAIL_SIZE;
 
-	if (need_memory_size <= STATIC_MEMORY_LENGTH)
-		m_memory_buf = m_static_buf;
-	else
-		m_memory_buf = (char*)CY_MALLOC(need_memory_size);
+	m_memory_buf = (char*)BufPool::allocate(need_memory_size, nullptr, memory::kTagPacket);
+#ifdef CY_ENABLE_DEBUG
 	memset(m_memory_buf, 0xCE, need_memory_size);	//fill memory with 0xCE (CyclonE)
+#else
+	memset(m_memory_buf + m_memory_size, 0, MEMORY_SAFE_TAIL_SIZE);
+#endif
 
 	m_packet_size = (uint16_t*)m_memory_buf;
 	m_packet_id = (uint16_t*)(m_memory_buf+sizeof(uint16_t));
@@ -22,11 +22,17 @@ MEMORY_SAFE_TAIL_SIZE   |         Safe Tail        |
 *MemorySize = HeadSize+PacketSize
 *PacketID and PacketSize is big endain 16bit ingeter
 
+*Packet object and memory come from per-thread size class pool(BufPool)
+*Packet allocated by alloc_packet() is reference counted, it can be shared by PacketPtr
+ and delivered to many threads without copy, a shared packet MUST NOT be changed any more.
 */
 namespace cyclone
 {
 
-class Packet : noncopyable
+class Packet;
+typedef IntrusivePtr<Packet> PacketPtr;
+
+class Packet : public RefCounted<Packet>, noncopyable
 {
 public:
 	void clean(void);
@@ -64,10 +70,8 @@ private:
 private:
 	size_t m_head_size;
 
-	enum { STATIC_MEMORY_LENGTH = 1024 };
 	enum { MEMORY_SAFE_TAIL_SIZE = 8 };
 
-	char m_static_buf[STATIC_MEMORY_LENGTH];
 	char*	m_memory_buf;
 	size_t	m_memory_size;
 
@@ -82,8 +86,12 @@ public:
 	void* operator new(size_t);
 	void operator delete(void*);
 
+	//// alloc a packet with one reference, copy from `other` if it's not null
 	static Packet* alloc_packet(const Packet* other = nullptr);
+	//// release the reference
 	static void free_packet(Packet*);
+	//// alloc a shared packet, copy from `other` if it's not null
+	static PacketPtr alloc_shared_packet(const Packet* other = nullptr);
 };
 
 }
@@ -14,15 +14,39 @@ WorkThread::WorkThread()
 	: m_thread(nullptr)
 	, m_looper(nullptr)
 	, m_is_queue_empty(true)
+	, m_spill_counts(0)
+	, m_overflow_policy(kSpill)
+	, m_batch_size(kDefaultBatchSize)
+	, m_depth(0)
+	, m_max_depth(0)
+	, m_posted_counts(0)
+	, m_processed_counts(0)
+	, m_spilled_counts(0)
+	, m_rejected_counts(0)
+	, m_max_latency(0)
+	, m_total_latency(0)
 	, m_on_start(nullptr)
 	, m_on_message(nullptr)
 {
+	m_spill_lock = sys_api::mutex_create();
 }
 
 //-------------------------------------------------------------------------------------
 WorkThread::~WorkThread()
 {
 	//TODO: stop the thread
+
+	//free the messages not processed
+	Message message;
+	while (m_message_queue.pop(message)) {
+		Packet::free_packet(message.packet);
+	}
+	for (auto& spilled : m_spill_list) {
+		Packet::free_packet(spilled.packet);
+	}
+	m_spill_list.clear();
+
+	sys_api::mutex_destroy(m_spill_lock);
 }
 
 //-------------------------------------------------------------------------------------
@@ -80,56 +104,184 @@ void WorkThread::_on_message(void)
 {
 	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
 
-	for (;;) {
-		int8_t dummy;
-		if (m_pipe.read((char*)&dummy, sizeof(dummy)) <= 0) break;
+	//read all wakeup signals
+	int8_t dummy[64];
+	while (m_pipe.read((char*)dummy, sizeof(dummy)) > 0);
+
+	//set empty flag before draining, so the message posted during draining will wakeup the looper again
+	m_is_queue_empty = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
 
-		for (;;) {
-			Packet* packet = nullptr;
-			if (!m_message_queue.pop(packet)) break;
+	int64_t now = m_looper->update_cached_time();
+	int32_t counts = 0;
 
-			//call listener
-			if (m_on_message) {
-				m_on_message(packet);
-			}
+	Message messages[kPopBulkSize];
+	while (counts < m_batch_size) {
+		size_t popped = m_message_queue.pop_bulk(messages, std::min((size_t)kPopBulkSize, (size_t)(m_batch_size - counts)));
+		if (popped == 0) break;
 
-			Packet::free_packet(packet);
+		for (size_t i = 0; i < popped; i++) {
+			_process_message(messages[i], now);
 		}
+		counts += (int32_t)popped;
 	}
 
-	//set empty flag
-	m_is_queue_empty = true;
+	if (counts < m_batch_size && m_spill_counts.load() > 0) {
+		SpillList spill_list;
+		{
+			sys_api::auto_mutex lock(m_spill_lock);
+			spill_list.swap(m_spill_list);
+		}
+
+		//the messages in queue are posted before the spilled ones
+		Message message;
+		while (m_message_queue.pop(message)) {
+			_process_message(message, now);
+			counts++;
+		}
+
+		for (auto& spilled : spill_list) {
+			_process_message(spilled, now);
+		}
+		counts += (int32_t)spill_list.size();
+
+		//all spilled messages are processed, the queue can be used again
+		m_spill_counts -= (int64_t)spill_list.size();
+	}
+
+	//too many messages, process the rest in next loop
+	if (counts >= m_batch_size) {
+		_wakeup();
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void WorkThread::_process_message(const Message& message, int64_t now)
+{
+	int64_t latency = now > message.post_time ? (now - message.post_time) : 0;
+	m_total_latency += latency;
+	if (latency > m_max_latency.load(std::memory_order_relaxed)) {
+		m_max_latency.store(latency, std::memory_order_relaxed);
+	}
+	m_depth--;
+	m_processed_counts++;
+
+	//call listener
+	if (m_on_message) {
+		m_on_message(message.packet);
+	}
+
+	Packet::free_packet(message.packet);
+}
+
+//-------------------------------------------------------------------------------------
+bool WorkThread::post_message(Packet* packet, OverflowPolicy policy)
+{
+	assert(packet != nullptr);
+
+	Message message;
+	message.packet = packet;
+	message.post_time = sys_api::performance_time_now();
+
+	//blocking in work thread will never return
+	if (policy == kBlock && m_looper && sys_api::thread_get_current_id() == m_looper->get_thread_id()) {
+		policy = kSpill;
+	}
+
+	//count it before it can be processed
+	int64_t depth = ++m_depth;
+
+	for (;;) {
+		//the queue can't be used when there are spilled messages, to keep the order
+		if (m_spill_counts.load() == 0 && m_message_queue.push(message)) break;
+
+		if (policy == kTry) {
+			m_depth--;
+			m_rejected_counts++;
+			return false;
+		}
+		else if (policy == kSpill) {
+			sys_api::auto_mutex lock(m_spill_lock);
+			m_spill_list.push_back(message);
+			m_spill_counts++;
+			m_spilled_counts++;
+			break;
+		}
+
+		//kBlock, wait the work thread
+		_wakeup();
+		sys_api::thread_yield();
+	}
+
+	m_posted_counts++;
+	if (depth > m_max_depth.load(std::memory_order_relaxed)) {
+		m_max_depth.store(depth, std::memory_order_relaxed);
+	}
+
+	_wakeup();
+	return true;
 }
 
 //-------------------------------------------------------------------------------------
-void WorkThread::send_message(uint16_t id, uint16_t size_part1, const char* msg_part1, uint16_t size_part2, const char* msg_part2)
+bool WorkThread::send_message(uint16_t id, uint16_t size_part1, const char* msg_part1, uint16_t size_part2, const char* msg_part2)
 {
 	Packet* packet = Packet::alloc_packet();
 	packet->build_from_memory(MESSAGE_HEAD_SIZE, id, size_part1, msg_part1, size_part2, msg_part2);
 
-	m_message_queue.push(packet);
+	if (post_message(packet)) return true;
 
-	_wakeup();
+	Packet::free_packet(packet);
+	return false;
 }
 
 //-------------------------------------------------------------------------------------
-void WorkThread::send_message(const Packet* message)
+bool WorkThread::send_message(const Packet* message)
 {
 	Packet* packet = Packet::alloc_packet(message);
-	m_message_queue.push(packet);
-	
-	_wakeup();
+
+	if (post_message(packet)) return true;
+
+	Packet::free_packet(packet);
+	return false;
 }
 
 //-------------------------------------------------------------------------------------
-void WorkThread::send_message(const Packet** message, int32_t counts)
+bool WorkThread::send_message(const PacketPtr& message)
+{
+	Packet* packet = message.get();
+	assert(packet != nullptr);
+
+	//the reference is released by free_packet after the message has been processed
+	packet->add_ref();
+
+	if (post_message(packet)) return true;
+
+	packet->release();
+	return false;
+}
+
+//-------------------------------------------------------------------------------------
+bool WorkThread::send_message(const Packet** message, int32_t counts)
 {
 	for (int32_t i = 0; i < counts; i++){
-		Packet* packet = Packet::alloc_packet(message[i]);
-		m_message_queue.push(packet);
+		if (!send_message(message[i])) return false;
 	}
+	return true;
+}
 
-	_wakeup();
+//-------------------------------------------------------------------------------------
+WorkThread::MailboxStats WorkThread::get_mailbox_stats(void) const
+{
+	MailboxStats stats;
+	stats.depth = m_depth.load();
+	stats.max_depth = m_max_depth.load();
+	stats.posted_counts = m_posted_counts.load();
+	stats.processed_counts = m_processed_counts.load();
+	stats.spilled_counts = m_spilled_counts.load();
+	stats.rejected_counts = m_rejected_counts.load();
+	stats.max_latency = m_max_latency.load();
+	stats.total_latency = m_total_latency.load();
+	return stats;
 }
 
 //-------------------------------------------------------------------------------------
@@ -144,8 +296,11 @@ void WorkThread::join(void)
 //-------------------------------------------------------------------------------------
 void WorkThread::_wakeup(void)
 {
+	//the message must be visible before the flag is checked
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
 	bool expected = true;
-	if (m_is_queue_empty.compare_exchange_strong(expected, false, std::memory_order_release, std::memory_order_relaxed))
+	if (m_is_queue_empty.compare_exchange_strong(expected, false))
 	{
 		int8_t dummy = 0;
 		m_pipe.write((const char*)&dummy, sizeof(dummy));
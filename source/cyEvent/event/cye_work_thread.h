@@ -7,7 +7,21 @@ namespace cyclone
 {
 //pre-define
 class Packet;
-
+typedef IntrusivePtr<Packet> PacketPtr;
+
+// WorkThread
+// ----------------
+// A thread with a looper and a message mailbox.
+//
+// - The mailbox is a bounded lock-free MPSC ring(kQueueSize), when it is full the message
+//   is handled by the overflow policy:
+//     kSpill: put into an unbounded spill list(mutex protected), never fails (default)
+//     kBlock: wait until the queue has room, spill if it's called in the work thread itself
+//     kTry:   fail and return false
+// - Messages sent from the same thread are delivered in order, whatever the policy is.
+// - At most `batch size` messages are processed in one wakeup, the rest are processed
+//   in the next loop so the other events of the looper are not starved.
+//
 class WorkThread : noncopyable
 {
 public:
@@ -16,6 +30,26 @@ public:
 
 public:
 	enum { MESSAGE_HEAD_SIZE = 4 };
+	enum { kQueueSize = 4096, kDefaultBatchSize = 1024, kPopBulkSize = 64 };
+
+	enum OverflowPolicy
+	{
+		kSpill = 0,
+		kBlock,
+		kTry
+	};
+
+	struct MailboxStats
+	{
+		int64_t depth;			//messages in the mailbox now
+		int64_t max_depth;
+		int64_t posted_counts;
+		int64_t processed_counts;
+		int64_t spilled_counts;	//messages went to spill list
+		int64_t rejected_counts;	//messages failed by kTry policy
+		int64_t max_latency;		//max time from post to process (micro second)
+		int64_t total_latency;	//sum of latency of processed messages (micro second)
+	};
 
 	//// run thread
 	void start(const char* name);
@@ -27,10 +61,25 @@ public:
 	void set_on_start(StartCallback func) { m_on_start = func; }
 	void set_on_message(MessageCallback func) { m_on_message = func; }
 
-	//// send message to this work thread (thread safe)
-	void send_message(uint16_t id, uint16_t size_part1, const char* msg_part1, uint16_t size_part2 = 0, const char* msg_part2 = nullptr);
-	void send_message(const Packet* message);
-	void send_message(const Packet** message, int32_t counts);
+	//// set overflow policy and batch size, call it before start
+	void set_overflow_policy(OverflowPolicy policy) { m_overflow_policy = policy; }
+	void set_batch_size(int32_t batch_size) { m_batch_size = batch_size > 0 ? batch_size : 1; }
+
+	//// send message to this work thread, the message is copied, 
+	//// return false if the message is rejected by overflow policy (thread safe)
+	bool send_message(uint16_t id, uint16_t size_part1, const char* msg_part1, uint16_t size_part2 = 0, const char* msg_part2 = nullptr);
+	bool send_message(const Packet* message);
+	bool send_message(const Packet** message, int32_t counts);
+	//// send a shared packet without copy, the packet MUST NOT be changed after sending (thread safe)
+	bool send_message(const PacketPtr& message);
+
+	//// post a packet allocated by Packet::alloc_packet, the mailbox takes the ownership without copy.
+	//// if it's rejected by overflow policy, return false and the caller still owns the packet (thread safe)
+	bool post_message(Packet* message) { return post_message(message, m_overflow_policy); }
+	bool post_message(Packet* message, OverflowPolicy policy);
+
+	//// get the statistics of mailbox (thread safe)
+	MailboxStats get_mailbox_stats(void) const;
 
 	//// get work thread looper (thread safe)
 	Looper* get_looper(void) const { return m_looper; }
@@ -48,9 +97,31 @@ private:
 	atomic_bool_t	m_is_queue_empty;
 	Pipe			m_pipe;
 
-	typedef LockFreeQueue<Packet*> MessageQueue;
+	struct Message
+	{
+		Packet* packet;
+		int64_t post_time;
+	};
+	typedef LockFreeQueue<Message, kQueueSize, kLFQueueMPSC> MessageQueue;
 	MessageQueue		m_message_queue;
 
+	typedef std::vector<Message> SpillList;
+	sys_api::mutex_t	m_spill_lock;
+	SpillList			m_spill_list;
+	atomic_int64_t		m_spill_counts;	//spilled but not processed, the queue is bypassed when it's not zero
+
+	OverflowPolicy	m_overflow_policy;
+	int32_t			m_batch_size;
+
+	atomic_int64_t	m_depth;
+	atomic_int64_t	m_max_depth;
+	atomic_int64_t	m_posted_counts;
+	atomic_int64_t	m_processed_counts;
+	atomic_int64_t	m_spilled_counts;
+	atomic_int64_t	m_rejected_counts;
+	atomic_int64_t	m_max_latency;
+	atomic_int64_t	m_total_latency;
+
 	StartCallback	m_on_start;
 	MessageCallback	m_on_message;
 
@@ -67,6 +138,9 @@ private:
 	//// on work thread receive message
 	void _on_message(void);
 
+	//// process one message in work thread
+	void _process_message(const Message& message, int64_t now);
+
 	/// wakeup the looper
 	void _wakeup(void);
 public:
@@ -9,3 +9,9 @@ Copyright(C) thecodeway.com
 #include <network/cyn_tcp_server.h>
 #include <network/cyn_tcp_connection.h>
 #include <network/cyn_tcp_client.h>
+#include <network/cyn_udp_socket.h>
+#include <network/cyn_udp_server.h>
+#include <network/cyn_reliable_channel.h>
+#include <network/cyn_udp_connection.h>
+#include <network/cyn_reliable_udp_server.h>
+#include <network/cyn_reliable_udp_client.h>
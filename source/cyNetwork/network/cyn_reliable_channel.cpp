@@ -0,0 +1,482 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include "cyn_reliable_channel.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+namespace {
+	//wrap around safe compare of sequence numbers and times
+	inline int32_t _diff(uint32_t later, uint32_t earlier) { return (int32_t)(later - earlier); }
+
+	inline void _encode16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v; }
+	inline void _encode32(uint8_t* p, uint32_t v) {
+		p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+	}
+	inline uint16_t _decode16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+	inline uint32_t _decode32(const uint8_t* p) {
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+	}
+
+	const uint32_t kInitialCwnd = 4;
+	const uint32_t kMinSsthresh = 2;
+}
+
+//-------------------------------------------------------------------------------------
+//segment head on wire, big endian
+// | conv(4) | cmd(1) | reserved(1) | wnd(2) | ts(4) | sn(4) | una(4) | len(2) |
+struct ReliableChannel::Head
+{
+	uint32_t conv;
+	uint8_t cmd;
+	uint16_t wnd;	//free slots of receive window
+	uint32_t ts;	//send time of data segment, or the echoed time in ack
+	uint32_t sn;
+	uint32_t una;	//all segments before it are received
+	uint16_t len;	//payload size
+
+	void encode(uint8_t* p) const {
+		_encode32(p, conv); p[4] = cmd; p[5] = 0; _encode16(p + 6, wnd);
+		_encode32(p + 8, ts); _encode32(p + 12, sn); _encode32(p + 16, una); _encode16(p + 20, len);
+	}
+	void decode(const uint8_t* p) {
+		conv = _decode32(p); cmd = p[4]; wnd = _decode16(p + 6);
+		ts = _decode32(p + 8); sn = _decode32(p + 12); una = _decode32(p + 16); len = _decode16(p + 20);
+	}
+};
+
+//-------------------------------------------------------------------------------------
+ReliableChannel::ReliableChannel(uint32_t conv, const Config& config, uint32_t now, OutputCallback output, DeliverCallback deliver)
+	: m_conv(conv)
+	, m_config(config)
+	, m_output(output)
+	, m_deliver(deliver)
+	, m_snd_una(0)
+	, m_snd_nxt(0)
+	, m_rmt_wnd(config.recv_window)
+	, m_recover(0)
+	, m_rcv_nxt(0)
+	, m_rcv_counts(0)
+	, m_ack_pending(false)
+	, m_ack_ts(0)
+	, m_srtt(0)
+	, m_rttvar(0)
+	, m_rto(config.initial_rto)
+	, m_cwnd(kInitialCwnd)
+	, m_cwnd_incr(0)
+	, m_ssthresh(config.send_window)
+	, m_current(now)
+	, m_last_send(now)
+	, m_last_recv(now)
+	, m_dead(false)
+	, m_out_size(0)
+{
+	//the ack with all sack blocks must fit in one datagram
+	assert(m_config.mtu >= kHeadSize + kMaxSackBlocks * 8 && m_config.mtu <= 0xFFFF);
+	assert(m_config.recv_window > 0 && m_config.recv_window <= 0xFFFF && (m_config.recv_window & (m_config.recv_window - 1)) == 0);
+
+	m_rcv_slots.resize(m_config.recv_window);
+	for (RecvSlot& slot : m_rcv_slots) {
+		slot.used = false;
+		slot.cmd = 0;
+	}
+	m_out.resize(m_config.mtu);
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-------------------------------------------------------------------------------------
+ReliableChannel::~ReliableChannel()
+{
+}
+
+//-------------------------------------------------------------------------------------
+ReliableChannel::Segment& ReliableChannel::_new_segment(uint8_t cmd)
+{
+	m_snd_queue.push_back(Segment());
+
+	Segment& seg = m_snd_queue.back();
+	seg.sn = 0;
+	seg.cmd = cmd;
+	seg.ts = seg.resend_ts = 0;
+	seg.rto = 0;
+	seg.xmit = 0;
+	seg.fastack = 0;
+	seg.acked = false;
+	return seg;
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::send(const uint8_t* data, size_t size)
+{
+	const size_t mss = m_config.mtu - kHeadSize;
+
+	while (size > 0) {
+		//small writes are merged into the last segment not sent
+		Segment* seg = m_snd_queue.empty() ? nullptr : &(m_snd_queue.back());
+		if (seg == nullptr || seg->cmd != kCmdPush || seg->data.size() >= mss) {
+			seg = &(_new_segment(kCmdPush));
+		}
+
+		size_t n = std::min(mss - seg->data.size(), size);
+		seg->data.insert(seg->data.end(), data, data + n);
+		data += n;
+		size -= n;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::send_control(uint8_t cmd)
+{
+	assert(cmd == kCmdConnect || cmd == kCmdClose);
+	_new_segment(cmd);
+}
+
+//-------------------------------------------------------------------------------------
+bool ReliableChannel::peek(const uint8_t* datagram, size_t size, uint32_t& conv, uint8_t& cmd)
+{
+	if (size < kHeadSize) return false;
+
+	Head head;
+	head.decode(datagram);
+	if (size < kHeadSize + (size_t)head.len) return false;
+
+	conv = head.conv;
+	cmd = head.cmd;
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+bool ReliableChannel::input(const uint8_t* datagram, size_t size, uint32_t now)
+{
+	m_current = now;
+
+	bool valid = false;
+	uint32_t acked_counts = 0;
+	bool has_sack = false;
+	uint32_t max_sack = 0;	//the biggest sn acked by selective ack
+
+	while (size >= kHeadSize) {
+		Head head;
+		head.decode(datagram);
+		if (head.conv != m_conv || size < kHeadSize + (size_t)head.len) break;
+
+		const uint8_t* payload = datagram + kHeadSize;
+		datagram += kHeadSize + head.len;
+		size -= kHeadSize + head.len;
+		valid = true;
+
+		m_rmt_wnd = head.wnd;
+
+		//cumulative ack, carried by every segment
+		uint32_t acked_before = acked_counts;
+		acked_counts += _ack_range(m_snd_una, head.una);
+
+		switch (head.cmd) {
+		case kCmdAck:
+		{
+			for (uint16_t i = 0; i + 8 <= head.len; i = (uint16_t)(i + 8)) {
+				uint32_t start = _decode32(payload + i);
+				uint32_t end = _decode32(payload + i + 4);
+				if (_diff(end, start) <= 0) continue;
+
+				acked_counts += _ack_range(start, end);
+				if (!has_sack || _diff(end - 1, max_sack) > 0) {
+					max_sack = end - 1;
+					has_sack = true;
+				}
+			}
+
+			//the echoed time is the send time of the segment transmission which triggered this
+			//ack, so the sample is valid for retransmitted segments too
+			if (acked_counts > acked_before && _diff(now, head.ts) >= 0) {
+				_update_rtt(now - head.ts);
+			}
+		}
+		break;
+
+		case kCmdPush:
+		case kCmdConnect:
+		case kCmdClose:
+			_receive_segment(head, payload);
+			break;
+
+		case kCmdPing:
+			m_ack_pending = true;
+			break;
+
+		default: break;
+		}
+	}
+	if (!valid) return false;
+
+	m_stats.recv_datagrams++;
+	m_last_recv = now;
+
+	//count the acks of later segments, only if that segment was sent after the last
+	//transmission of the skipped one
+	if (has_sack && !m_snd_buf.empty() && _diff(max_sack, m_snd_buf.front().sn) >= 0 && _diff(max_sack, m_snd_nxt) < 0) {
+		uint32_t sack_ts = m_snd_buf[max_sack - m_snd_buf.front().sn].ts;
+		for (Segment& seg : m_snd_buf) {
+			if (_diff(seg.sn, max_sack) >= 0) break;
+			if (!seg.acked && seg.xmit > 0 && _diff(sack_ts, seg.ts) >= 0) seg.fastack++;
+		}
+	}
+
+	if (acked_counts > 0) _ack_done(acked_counts);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+uint32_t ReliableChannel::_ack_range(uint32_t start, uint32_t end)
+{
+	if (m_snd_buf.empty()) return 0;
+
+	//only the segments in flight
+	uint32_t first = m_snd_buf.front().sn;
+	if (_diff(start, first) < 0) start = first;
+	if (_diff(end, m_snd_nxt) > 0) end = m_snd_nxt;
+
+	uint32_t counts = 0;
+	for (uint32_t sn = start; _diff(sn, end) < 0; sn++) {
+		Segment& seg = m_snd_buf[sn - first];
+		if (seg.acked) continue;
+
+		seg.acked = true;
+		counts++;
+	}
+	return counts;
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::_ack_done(uint32_t acked_counts)
+{
+	while (!m_snd_buf.empty() && m_snd_buf.front().acked) m_snd_buf.pop_front();
+	m_snd_una = m_snd_buf.empty() ? m_snd_nxt : m_snd_buf.front().sn;
+
+	if (!m_config.congestion_control) return;
+
+	//slow start, then one segment every window
+	for (uint32_t i = 0; i < acked_counts && m_cwnd < m_config.send_window; i++) {
+		if (m_cwnd < m_ssthresh) {
+			m_cwnd++;
+		}
+		else if (++m_cwnd_incr >= m_cwnd) {
+			m_cwnd_incr = 0;
+			m_cwnd++;
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::_update_rtt(uint32_t rtt)
+{
+	//RFC 6298
+	if (m_srtt == 0) {
+		m_srtt = std::max(rtt, 1u);
+		m_rttvar = rtt / 2;
+	}
+	else {
+		uint32_t delta = (rtt > m_srtt) ? (rtt - m_srtt) : (m_srtt - rtt);
+		m_rttvar = (3 * m_rttvar + delta) / 4;
+		m_srtt = std::max((7 * m_srtt + rtt) / 8, 1u);
+	}
+
+	uint32_t rto = m_srtt + std::max(m_config.interval, 4 * m_rttvar);
+	m_rto = std::min(std::max(rto, m_config.min_rto), m_config.max_rto);
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::_receive_segment(const Head& head, const uint8_t* payload)
+{
+	m_stats.recv_segments++;
+	m_ack_pending = true;
+	m_ack_ts = head.ts;
+
+	//received already, or out of receive window
+	if (_diff(head.sn, m_rcv_nxt) < 0) {
+		m_stats.duplicate_segments++;
+		return;
+	}
+	if (_diff(head.sn, m_rcv_nxt + m_config.recv_window) >= 0) return;
+
+	const uint32_t mask = m_config.recv_window - 1;
+	RecvSlot& slot = m_rcv_slots[head.sn & mask];
+	if (slot.used) {
+		m_stats.duplicate_segments++;
+		return;
+	}
+	slot.used = true;
+	slot.cmd = head.cmd;
+	slot.data.assign(payload, payload + head.len);
+	m_rcv_counts++;
+
+	//deliver in order
+	for (;;) {
+		RecvSlot& next = m_rcv_slots[m_rcv_nxt & mask];
+		if (!next.used) break;
+
+		next.used = false;
+		m_rcv_counts--;
+		m_rcv_nxt++;
+		if (m_deliver) m_deliver(next.cmd, next.data.data(), next.data.size());
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::_write(const Head& head, const uint8_t* payload)
+{
+	size_t size = kHeadSize + (size_t)head.len;
+	if (m_out_size + size > m_out.size()) _flush_output();
+
+	head.encode(&(m_out[m_out_size]));
+	if (head.len > 0) memcpy(&(m_out[m_out_size + kHeadSize]), payload, head.len);
+	m_out_size += size;
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::_write_ack(void)
+{
+	const uint32_t mask = m_config.recv_window - 1;
+
+	//ranges of out of order segments, lowest first
+	uint8_t blocks[kMaxSackBlocks * 8];
+	uint16_t len = 0;
+	uint32_t counts = m_rcv_counts;
+	for (uint32_t off = 1; off < m_config.recv_window && counts > 0 && len < sizeof(blocks);) {
+		if (!m_rcv_slots[(m_rcv_nxt + off) & mask].used) {
+			off++;
+			continue;
+		}
+
+		uint32_t start = m_rcv_nxt + off;
+		while (off < m_config.recv_window && m_rcv_slots[(m_rcv_nxt + off) & mask].used) {
+			off++;
+			counts--;
+		}
+		_encode32(blocks + len, start);
+		_encode32(blocks + len + 4, m_rcv_nxt + off);
+		len = (uint16_t)(len + 8);
+	}
+
+	Head head;
+	head.conv = m_conv;
+	head.cmd = kCmdAck;
+	head.wnd = (uint16_t)_recv_wnd();
+	head.ts = m_ack_ts;
+	head.sn = 0;
+	head.una = m_rcv_nxt;
+	head.len = len;
+	_write(head, blocks);
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::_flush_output(void)
+{
+	if (m_out_size == 0) return;
+
+	if (m_output) m_output(m_out.data(), m_out_size);
+	m_stats.sent_datagrams++;
+	m_last_send = m_current;
+	m_out_size = 0;
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableChannel::update(uint32_t now)
+{
+	m_current = now;
+
+	if (m_ack_pending) {
+		m_ack_pending = false;
+		_write_ack();
+	}
+
+	//move segments into the send window
+	uint32_t wnd = std::min(m_config.send_window, std::max(m_rmt_wnd, 1u));
+	if (m_config.congestion_control) wnd = std::min(wnd, m_cwnd);
+	while (!m_snd_queue.empty() && _diff(m_snd_nxt, m_snd_una + wnd) < 0) {
+		m_snd_buf.push_back(std::move(m_snd_queue.front()));
+		m_snd_queue.pop_front();
+		m_snd_buf.back().sn = m_snd_nxt++;
+	}
+
+	bool lost = false, fast = false;
+	for (Segment& seg : m_snd_buf) {
+		if (seg.acked) continue;
+
+		if (seg.xmit == 0) {
+			seg.rto = m_rto;
+		}
+		else if (_diff(now, seg.resend_ts) >= 0) {
+			seg.rto = std::min(seg.rto * 2, m_config.max_rto);
+			lost = true;
+			m_stats.retransmits++;
+		}
+		else if (m_config.fast_resend > 0 && seg.fastack >= m_config.fast_resend) {
+			//reduce the window once for the losses in one window
+			if (_diff(seg.sn, m_recover) >= 0) fast = true;
+			m_stats.fast_retransmits++;
+		}
+		else {
+			continue;
+		}
+
+		seg.xmit++;
+		seg.fastack = 0;
+		seg.ts = now;
+		seg.resend_ts = now + seg.rto;
+		if (seg.xmit > m_config.dead_link) m_dead = true;
+		m_stats.sent_segments++;
+
+		Head head;
+		head.conv = m_conv;
+		head.cmd = seg.cmd;
+		head.wnd = (uint16_t)_recv_wnd();
+		head.ts = now;
+		head.sn = seg.sn;
+		head.una = m_rcv_nxt;
+		head.len = (uint16_t)seg.data.size();
+		_write(head, seg.data.data());
+	}
+
+	//keep alive
+	if (m_config.keepalive > 0 && m_out_size == 0 && _diff(now, m_last_send) >= (int32_t)m_config.keepalive) {
+		Head head;
+		head.conv = m_conv;
+		head.cmd = kCmdPing;
+		head.wnd = (uint16_t)_recv_wnd();
+		head.ts = now;
+		head.sn = 0;
+		head.una = m_rcv_nxt;
+		head.len = 0;
+		_write(head, nullptr);
+	}
+	_flush_output();
+
+	if (m_config.congestion_control) {
+		if (fast) {
+			uint32_t inflight = m_snd_nxt - m_snd_una;
+			m_ssthresh = std::max(inflight / 2, kMinSsthresh);
+			m_cwnd = m_ssthresh + m_config.fast_resend;
+			m_cwnd_incr = 0;
+			m_recover = m_snd_nxt;
+		}
+		if (lost) {
+			m_ssthresh = std::max(m_cwnd / 2, kMinSsthresh);
+			m_cwnd = 1;
+			m_cwnd_incr = 0;
+			m_recover = m_snd_nxt;
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+bool ReliableChannel::is_dead(uint32_t now) const
+{
+	if (m_dead) return true;
+	return m_config.idle_timeout > 0 && _diff(now, m_last_recv) >= (int32_t)m_config.idle_timeout;
+}
+
+}
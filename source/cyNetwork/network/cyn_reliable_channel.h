@@ -0,0 +1,182 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cy_core.h>
+#include <deque>
+
+namespace cyclone
+{
+
+//ReliableChannel
+// ----------------
+// ARQ engine of reliable udp, an ordered byte stream over datagrams(similar to KCP). It does
+// no I/O itself, the datagrams are passed in with input() and out with the output callback,
+// all times are milliseconds of a monotonic clock.
+//
+// - The stream is split into segments of mtu size, and several segments are packed into one
+//   datagram. Every segment carries the cumulative ack(una) of the other direction.
+// - Ack segments carry up to kMaxSackBlocks selective ack ranges of the out of order segments,
+//   a segment is fast retransmitted when `fast_resend` acks have acknowledged the segments
+//   after it.
+// - The retransmit timeout is computed as RFC 6298 from the timestamp echoed by acks, it's
+//   doubled on every timeout retransmit.
+// - With congestion control, the send window is limited by cwnd(segments): slow start, then
+//   additive increase, halved on fast retransmit and reset to 1 on timeout.
+// - NOT thread safe.
+//
+class ReliableChannel : noncopyable
+{
+public:
+	enum Command { kCmdPush = 1, kCmdAck, kCmdPing, kCmdConnect, kCmdClose };
+	enum { kHeadSize = 22, kMaxSackBlocks = 8 };
+
+	struct Config
+	{
+		uint32_t mtu;				//max datagram size
+		uint32_t send_window;		//segments
+		uint32_t recv_window;		//segments, power of 2
+		uint32_t interval;			//update interval(ms)
+		uint32_t initial_rto;		//ms
+		uint32_t min_rto;			//ms
+		uint32_t max_rto;			//ms
+		uint32_t fast_resend;		//acks skipped a segment before it's resent, 0 means no fast retransmit
+		bool congestion_control;
+		uint32_t dead_link;			//the link is dead if a segment is sent this times without ack
+		uint32_t keepalive;			//send ping if nothing sent in this time(ms), 0 means never
+		uint32_t idle_timeout;		//the link is dead if nothing received in this time(ms), 0 means never
+
+		Config()
+			: mtu(1200), send_window(128), recv_window(128), interval(10)
+			, initial_rto(200), min_rto(30), max_rto(5000), fast_resend(2), congestion_control(true)
+			, dead_link(20), keepalive(5000), idle_timeout(30000) {}
+	};
+
+	struct Stats
+	{
+		int64_t sent_segments;		//data segments, retransmits included
+		int64_t retransmits;		//by timeout
+		int64_t fast_retransmits;	//by selective ack
+		int64_t recv_segments;		//data segments
+		int64_t duplicate_segments;
+		int64_t sent_datagrams;
+		int64_t recv_datagrams;
+	};
+
+	//send a datagram to peer
+	typedef std::function<void(const uint8_t* datagram, size_t size)> OutputCallback;
+	//data(kCmdPush) and control(kCmdConnect, kCmdClose) segments from peer, in order
+	typedef std::function<void(uint8_t cmd, const uint8_t* data, size_t size)> DeliverCallback;
+
+public:
+	/// queue stream data, it's sent in next update()
+	void send(const uint8_t* data, size_t size);
+	/// queue a control segment, it's delivered after all data queued before it
+	void send_control(uint8_t cmd);
+
+	/// input a datagram from peer, return false if it's not a datagram of this channel
+	bool input(const uint8_t* datagram, size_t size, uint32_t now);
+
+	/// send acks, new segments and retransmits. Call it every `interval` ms, and after
+	/// input() or send() to reduce latency
+	void update(uint32_t now);
+
+	/// all queued segments have been sent and acked
+	bool is_idle(void) const { return m_snd_queue.empty() && m_snd_buf.empty(); }
+	/// a segment exceeded dead_link, or nothing received in idle_timeout
+	bool is_dead(uint32_t now) const;
+
+	uint32_t get_conv(void) const { return m_conv; }
+	/// sequence number of the first segment not acked
+	uint32_t get_send_una(void) const { return m_snd_una; }
+	uint32_t get_rto(void) const { return m_rto; }
+	uint32_t get_srtt(void) const { return m_srtt; }
+	uint32_t get_cwnd(void) const { return m_cwnd; }
+	/// counts of segments queued or in flight
+	size_t get_waiting_segments(void) const { return m_snd_queue.size() + m_snd_buf.size(); }
+	const Config& get_config(void) const { return m_config; }
+	const Stats& get_stats(void) const { return m_stats; }
+
+	/// peek the conversation id and command of first segment, return false if the datagram is too short
+	static bool peek(const uint8_t* datagram, size_t size, uint32_t& conv, uint8_t& cmd);
+
+private:
+	struct Segment
+	{
+		uint32_t sn;
+		uint8_t cmd;
+		uint32_t ts;		//time of last transmission
+		uint32_t resend_ts;
+		uint32_t rto;
+		uint32_t xmit;		//transmission counts
+		uint32_t fastack;	//acks of later segments since last transmission
+		bool acked;
+		std::vector<uint8_t> data;
+	};
+
+	struct RecvSlot
+	{
+		bool used;
+		uint8_t cmd;
+		std::vector<uint8_t> data;
+	};
+
+	struct Head;
+
+	uint32_t m_conv;
+	Config m_config;
+	OutputCallback m_output;
+	DeliverCallback m_deliver;
+
+	//send side
+	std::deque<Segment> m_snd_queue;	//not sent yet
+	std::deque<Segment> m_snd_buf;		//in flight, ordered by sn
+	uint32_t m_snd_una;
+	uint32_t m_snd_nxt;
+	uint32_t m_rmt_wnd;
+	uint32_t m_recover;		//snd_nxt when the window was reduced by fast retransmit
+
+	//receive side, out of order segments in slot (sn % recv_window)
+	std::vector<RecvSlot> m_rcv_slots;
+	uint32_t m_rcv_nxt;
+	uint32_t m_rcv_counts;
+	bool m_ack_pending;
+	uint32_t m_ack_ts;		//timestamp echoed in next ack
+
+	//rtt and congestion
+	uint32_t m_srtt;
+	uint32_t m_rttvar;
+	uint32_t m_rto;
+	uint32_t m_cwnd;
+	uint32_t m_cwnd_incr;
+	uint32_t m_ssthresh;
+
+	uint32_t m_current;
+	uint32_t m_last_send;
+	uint32_t m_last_recv;
+	bool m_dead;
+
+	//datagram in building
+	std::vector<uint8_t> m_out;
+	size_t m_out_size;
+
+	Stats m_stats;
+
+private:
+	Segment& _new_segment(uint8_t cmd);
+	uint32_t _recv_wnd(void) const { return m_config.recv_window - m_rcv_counts; }
+	uint32_t _ack_range(uint32_t start, uint32_t end);
+	void _ack_done(uint32_t acked_counts);
+	void _update_rtt(uint32_t rtt);
+	void _receive_segment(const Head& head, const uint8_t* payload);
+	void _write(const Head& head, const uint8_t* payload);
+	void _write_ack(void);
+	void _flush_output(void);
+
+public:
+	ReliableChannel(uint32_t conv, const Config& config, uint32_t now, OutputCallback output, DeliverCallback deliver);
+	~ReliableChannel();
+};
+
+}
@@ -0,0 +1,151 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+#include "cyn_reliable_udp_client.h"
+
+#include <random>
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+ReliableUdpClient::ReliableUdpClient(Looper* looper, const ReliableChannel::Config& config, int32_t id)
+	: m_id(id)
+	, m_looper(looper)
+	, m_config(config)
+	, m_socket(looper, id)
+	, m_connected(false)
+	, m_timer_id(Looper::INVALID_EVENT_ID)
+{
+	m_listener.on_connected = nullptr;
+	m_listener.on_message = nullptr;
+	m_listener.on_close = nullptr;
+
+	m_socket.set_on_message([this](UdpSocket*, const UdpSocket::Datagram* datagrams, size_t counts) {
+		_on_message(datagrams, counts);
+	});
+}
+
+//-------------------------------------------------------------------------------------
+ReliableUdpClient::~ReliableUdpClient()
+{
+	if (m_timer_id != Looper::INVALID_EVENT_ID) {
+		m_looper->delete_event(m_timer_id);
+		m_timer_id = Looper::INVALID_EVENT_ID;
+	}
+
+	//close without callback
+	if (m_connection) {
+		m_connection->m_on_connected = nullptr;
+		m_connection->m_on_message = nullptr;
+		m_connection->m_on_close = nullptr;
+		m_connection->_close(UdpConnection::_now());
+		m_connection = nullptr;
+	}
+	m_socket.close();
+}
+
+//-------------------------------------------------------------------------------------
+bool ReliableUdpClient::connect(const Address& addr)
+{
+	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
+
+	//connect already, the closed connection lingering is replaced
+	if (m_connection && m_connection->get_state() != UdpConnection::kDisconnected) return false;
+
+	if (!m_socket.is_open()) {
+		UdpSocket::Options options;
+		options.max_datagram_size = std::max((size_t)m_config.mtu, options.max_datagram_size);
+		if (!m_socket.open(Address(0, false), false, options)) return false;
+	}
+	m_server_addr = addr;
+
+	//random conversation id, so the server can tell a reconnect from same address
+	std::random_device rd;
+	uint32_t conv = 0;
+	while (conv == 0) conv = (uint32_t)rd();
+
+	m_connected = false;
+	m_connection = UdpConnectionPtr(new UdpConnection(m_id, conv, &m_socket, addr, m_config, true));
+	m_connection->m_on_connected = [this](const UdpConnectionPtr& conn) {
+		m_connected = true;
+		if (m_listener.on_connected) m_listener.on_connected(this, conn, true);
+	};
+	m_connection->m_on_message = [this](const UdpConnectionPtr& conn) {
+		if (m_listener.on_message) m_listener.on_message(this, conn);
+	};
+	m_connection->m_on_close = [this](const UdpConnectionPtr& conn) {
+		if (!m_connected) {
+			if (m_listener.on_connected) m_listener.on_connected(this, conn, false);
+		}
+		else if (m_listener.on_close) {
+			m_listener.on_close(this, conn);
+		}
+	};
+
+	if (m_timer_id == Looper::INVALID_EVENT_ID) {
+		m_timer_id = m_looper->register_timer_event(m_config.interval, nullptr, [this](Looper::event_id_t, void*) {
+			_on_timer();
+		});
+	}
+
+	//send the connect segment now
+	m_connection->_update(UdpConnection::_now());
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpClient::disconnect(void)
+{
+	if (m_connection) m_connection->shutdown();
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpClient::send(const char* buf, size_t len)
+{
+	UdpConnectionPtr conn = m_connection;
+	if (conn) conn->send(buf, len);
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpClient::_on_message(const UdpSocket::Datagram* datagrams, size_t counts)
+{
+	UdpConnectionPtr conn = m_connection;
+	if (!conn) return;
+
+	const struct sockaddr_in& server_addr = m_server_addr.get_sockaddr_in();
+	uint32_t now = UdpConnection::_now();
+
+	for (size_t i = 0; i < counts; i++) {
+		const UdpSocket::Datagram& datagram = datagrams[i];
+		if (datagram.peer_addr.sin_addr.s_addr != server_addr.sin_addr.s_addr || datagram.peer_addr.sin_port != server_addr.sin_port) continue;
+
+		uint32_t conv;
+		uint8_t cmd;
+		if (!ReliableChannel::peek(datagram.data, datagram.size, conv, cmd) || conv != conn->get_conv()) continue;
+
+		conn->_input(datagram.data, datagram.size, now);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpClient::_on_timer(void)
+{
+	UdpConnectionPtr conn = m_connection;
+	if (!conn) return;
+
+	uint32_t now = UdpConnection::_now();
+	conn->_update(now);
+
+	//closed and lingered, wait next connect
+	if (conn->_is_expired(now)) {
+		m_connection = nullptr;
+		m_looper->delete_event(m_timer_id);
+		m_timer_id = Looper::INVALID_EVENT_ID;
+	}
+}
+
+}
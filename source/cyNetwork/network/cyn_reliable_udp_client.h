@@ -0,0 +1,67 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cy_core.h>
+#include <cy_event.h>
+#include "cyn_udp_socket.h"
+#include "cyn_udp_connection.h"
+
+namespace cyclone
+{
+
+//ReliableUdpClient
+// ----------------
+// Client of ReliableUdpServer, the same listener shape as TcpClient. It owns a UdpSocket on the
+// looper, and one UdpConnection with a random conversation id for every connect().
+//
+class ReliableUdpClient : noncopyable
+{
+public:
+	typedef std::function<void(ReliableUdpClient* client, const UdpConnectionPtr& conn, bool success)> ConnectedCallback;
+	typedef std::function<void(ReliableUdpClient* client, const UdpConnectionPtr& conn)> EventCallback;
+
+	struct Listener {
+		ConnectedCallback on_connected;		//success is false if the server didn't answer
+		EventCallback on_message;
+		EventCallback on_close;
+	};
+	Listener m_listener;
+
+public:
+	//// connect to remote server(NOT thread safe, call it in looper thread)
+	bool connect(const Address& addr);
+	//// close the connection after all data acked(NOT thread safe, call it in looper thread)
+	void disconnect(void);
+	//// get server address
+	Address get_server_address(void) const { return m_server_addr; }
+	/// send message(thread safe)
+	void send(const char* buf, size_t len);
+	/// get the connection, nullptr if not connected
+	UdpConnectionPtr get_connection(void) const { return m_connection; }
+	/// get the socket
+	const UdpSocket& get_socket(void) const { return m_socket; }
+	/// get looper
+	Looper* get_looper(void) const { return m_looper; }
+
+private:
+	int32_t m_id;
+	Looper* m_looper;
+	ReliableChannel::Config m_config;
+	UdpSocket m_socket;
+	Address m_server_addr;
+	UdpConnectionPtr m_connection;
+	bool m_connected;
+	Looper::event_id_t m_timer_id;
+
+private:
+	void _on_message(const UdpSocket::Datagram* datagrams, size_t counts);
+	void _on_timer(void);
+
+public:
+	ReliableUdpClient(Looper* looper, const ReliableChannel::Config& config = ReliableChannel::Config(), int32_t id = 0);
+	~ReliableUdpClient();
+};
+
+}
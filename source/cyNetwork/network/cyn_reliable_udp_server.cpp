@@ -0,0 +1,248 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+#include "cyn_reliable_udp_server.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+namespace {
+	struct ShutdownConnectionCmd
+	{
+		uint64_t peer_key;
+		int32_t conn_id;
+	};
+}
+
+//-------------------------------------------------------------------------------------
+ReliableUdpServer::ReliableUdpServer()
+	: m_max_connections(kDefaultMaxConnections)
+	, m_next_connection_id(1)
+	, m_connection_counts(0)
+{
+	m_listener.on_work_thread_start = nullptr;
+	m_listener.on_connected = nullptr;
+	m_listener.on_message = nullptr;
+	m_listener.on_close = nullptr;
+
+	m_udp_server.m_listener.on_work_thread_start = [this](UdpServer*, int32_t thread_index, Looper* looper) {
+		_on_work_thread_start(thread_index, looper);
+	};
+	m_udp_server.m_listener.on_work_thread_command = [this](UdpServer*, int32_t thread_index, Packet* cmd) {
+		_on_work_thread_command(thread_index, cmd);
+	};
+	m_udp_server.m_listener.on_message = [this](UdpServer*, int32_t thread_index, UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts) {
+		_on_message(thread_index, socket, datagrams, counts);
+	};
+}
+
+//-------------------------------------------------------------------------------------
+ReliableUdpServer::~ReliableUdpServer()
+{
+	for (WorkContext* context : m_contexts) delete context;
+	m_contexts.clear();
+}
+
+//-------------------------------------------------------------------------------------
+bool ReliableUdpServer::bind(const Address& bind_addr, bool enable_reuse_port)
+{
+	//the biggest datagram is one mtu
+	UdpSocket::Options options;
+	options.max_datagram_size = std::max((size_t)m_config.mtu, options.max_datagram_size);
+	return m_udp_server.bind(bind_addr, enable_reuse_port, options);
+}
+
+//-------------------------------------------------------------------------------------
+bool ReliableUdpServer::start(int32_t work_thread_counts)
+{
+	//contexts are ready before the work threads start
+	if (m_contexts.empty()) {
+		for (int32_t i = 0; i < work_thread_counts; i++) {
+			WorkContext* context = new WorkContext;
+			context->looper = nullptr;
+			context->timer_id = Looper::INVALID_EVENT_ID;
+			m_contexts.push_back(context);
+		}
+	}
+	if ((int32_t)m_contexts.size() != work_thread_counts) return false;
+
+	return m_udp_server.start(work_thread_counts);
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::join(void)
+{
+	m_udp_server.join();
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::stop(void)
+{
+	//close all connections before the sockets closed
+	Packet cmd;
+	cmd.build_from_memory(WorkThread::MESSAGE_HEAD_SIZE, (uint16_t)kCloseAllCmdID, 0, nullptr);
+	for (int32_t i = 0; i < m_udp_server.get_work_thread_counts(); i++) {
+		m_udp_server.send_work_message(i, &cmd);
+	}
+
+	m_udp_server.stop();
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::shutdown_connection(const UdpConnectionPtr& conn)
+{
+	for (size_t i = 0; i < m_contexts.size(); i++) {
+		if (m_contexts[i]->looper != conn->get_looper()) continue;
+
+		ShutdownConnectionCmd shutdownCmd;
+		shutdownCmd.peer_key = _peer_key(conn->get_peer_addr().get_sockaddr_in());
+		shutdownCmd.conn_id = conn->get_id();
+
+		Packet cmd;
+		cmd.build_from_memory(WorkThread::MESSAGE_HEAD_SIZE, (uint16_t)kShutdownConnectionCmdID, (uint16_t)sizeof(shutdownCmd), (const char*)&shutdownCmd);
+		m_udp_server.send_work_message((int32_t)i, &cmd);
+		return;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::_on_work_thread_start(int32_t thread_index, Looper* looper)
+{
+	m_contexts[(size_t)thread_index]->looper = looper;
+
+	if (m_listener.on_work_thread_start) {
+		m_listener.on_work_thread_start(this, thread_index, looper);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::_on_work_thread_command(int32_t thread_index, Packet* cmd)
+{
+	WorkContext* context = m_contexts[(size_t)thread_index];
+
+	switch (cmd->get_packet_id()) {
+	case kCloseAllCmdID:
+	{
+		if (context->timer_id != Looper::INVALID_EVENT_ID) {
+			context->looper->delete_event(context->timer_id);
+			context->timer_id = Looper::INVALID_EVENT_ID;
+		}
+
+		uint32_t now = UdpConnection::_now();
+		for (auto& it : context->connections) {
+			it.second->_close(now);
+		}
+		context->connections.clear();
+	}
+	break;
+
+	case kShutdownConnectionCmdID:
+	{
+		ShutdownConnectionCmd shutdownCmd;
+		memcpy(&shutdownCmd, cmd->get_packet_content(), sizeof(shutdownCmd));
+
+		auto it = context->connections.find(shutdownCmd.peer_key);
+		if (it != context->connections.end() && it->second->get_id() == shutdownCmd.conn_id) {
+			UdpConnectionPtr conn = it->second;
+			conn->shutdown();
+		}
+	}
+	break;
+
+	default: break;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+UdpConnectionPtr ReliableUdpServer::_new_connection(int32_t thread_index, UdpSocket* socket, uint32_t conv, const struct sockaddr_in& peer_addr)
+{
+	WorkContext* context = m_contexts[(size_t)thread_index];
+
+	//one timer updates all connections of the work thread
+	if (context->timer_id == Looper::INVALID_EVENT_ID) {
+		context->timer_id = context->looper->register_timer_event(m_config.interval, nullptr, [this, thread_index](Looper::event_id_t, void*) {
+			_on_timer(thread_index);
+		});
+	}
+
+	UdpConnectionPtr conn(new UdpConnection(m_next_connection_id++, conv, socket, Address(peer_addr), m_config, false));
+	conn->m_on_message = [this, thread_index](const UdpConnectionPtr& c) {
+		if (m_listener.on_message) m_listener.on_message(this, thread_index, c);
+	};
+	conn->m_on_close = [this, thread_index](const UdpConnectionPtr& c) {
+		m_connection_counts--;
+		if (m_listener.on_close) m_listener.on_close(this, thread_index, c);
+	};
+	context->connections[_peer_key(peer_addr)] = conn;
+	m_connection_counts++;
+
+	if (m_listener.on_connected) m_listener.on_connected(this, thread_index, conn);
+	return conn;
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::_on_message(int32_t thread_index, UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts)
+{
+	WorkContext* context = m_contexts[(size_t)thread_index];
+	uint32_t now = UdpConnection::_now();
+
+	for (size_t i = 0; i < counts; i++) {
+		const UdpSocket::Datagram& datagram = datagrams[i];
+
+		uint32_t conv;
+		uint8_t cmd;
+		if (!ReliableChannel::peek(datagram.data, datagram.size, conv, cmd)) continue;
+
+		uint64_t key = _peer_key(datagram.peer_addr);
+		auto it = context->connections.find(key);
+		UdpConnectionPtr conn = (it == context->connections.end()) ? UdpConnectionPtr() : it->second;
+
+		if (conn && conn->get_conv() != conv) {
+			//datagram of an old conversation
+			if (cmd != ReliableChannel::kCmdConnect) continue;
+
+			//the peer reconnects from same address
+			context->connections.erase(it);
+			conn->_close(now);
+			conn = nullptr;
+		}
+
+		if (!conn) {
+			//only the connect segment begins a conversation
+			if (cmd != ReliableChannel::kCmdConnect) continue;
+
+			//too many connections, the peer will retry or give up
+			if (m_max_connections > 0 && m_connection_counts.load() >= m_max_connections) {
+				CY_LOG(L_DEBUG, "reliable udp server refuse connect of conv %u, connection counts=%d", conv, m_connection_counts.load());
+				continue;
+			}
+			conn = _new_connection(thread_index, socket, conv, datagram.peer_addr);
+		}
+		conn->_input(datagram.data, datagram.size, now);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void ReliableUdpServer::_on_timer(int32_t thread_index)
+{
+	WorkContext* context = m_contexts[(size_t)thread_index];
+	uint32_t now = UdpConnection::_now();
+
+	for (auto it = context->connections.begin(); it != context->connections.end();) {
+		UdpConnectionPtr conn = it->second;
+		conn->_update(now);
+
+		if (conn->_is_expired(now)) {
+			it = context->connections.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+}
@@ -0,0 +1,114 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cy_core.h>
+#include <cy_event.h>
+#include "cyn_udp_server.h"
+#include "cyn_udp_connection.h"
+
+namespace cyclone
+{
+
+//ReliableUdpServer
+// ----------------
+// Server of UdpConnection, the same listener shape as TcpServer. It runs on a UdpServer, the
+// datagrams of one peer always go to the same work thread, and every work thread keeps the
+// connections of its peers, updated by one timer of the work thread.
+//
+// A connection is created when the connect segment of a new conversation comes, and released
+// a while after it's closed. The connect segment is not authenticated and its source address
+// can be spoofed, so the connections are capped, see set_max_connections().
+//
+class ReliableUdpServer : noncopyable
+{
+public:
+	typedef std::function<void(ReliableUdpServer* server, int32_t thread_index, Looper* looper)> WorkThreadStartCallback;
+	typedef std::function<void(ReliableUdpServer* server, int32_t thread_index, const UdpConnectionPtr& conn)> EventCallback;
+
+	struct Listener {
+		WorkThreadStartCallback on_work_thread_start;
+
+		EventCallback on_connected;
+		EventCallback on_message;
+		EventCallback on_close;
+	};
+	Listener m_listener;
+
+public:
+	/// set the bind address, port 0 means any port, see get_bind_address()
+	// NOT thread safe, and this function must be called before start the server
+	bool bind(const Address& bind_addr, bool enable_reuse_port = true);
+
+	/// set the config of connections
+	// NOT thread safe, and this function must be called before start the server
+	void set_channel_config(const ReliableChannel::Config& config) { m_config = config; }
+
+	/// set the max counts of connections not closed, connect segments beyond it are dropped,
+	/// 0 means no limit(default is kDefaultMaxConnections)
+	// NOT thread safe, and this function must be called before start the server
+	void set_max_connections(int32_t max_connections) { m_max_connections = max_connections; }
+	enum { kDefaultMaxConnections = 10000 };
+
+	/// start the server with n work threads
+	bool start(int32_t work_thread_counts);
+
+	/// wait server to terminate(thread safe)
+	void join(void);
+
+	/// stop the server, all connections are closed without notifying peer
+	//(NOT thread safe, you can't call this function in any work thread)
+	void stop(void);
+
+	/// shutdown a connection(thread safe)
+	void shutdown_connection(const UdpConnectionPtr& conn);
+
+	/// get bind address, it has the real port after the server started
+	Address get_bind_address(void) const { return m_udp_server.get_bind_address(); }
+
+	/// get counts of connections not closed(thread safe)
+	int32_t get_connection_counts(void) const { return m_connection_counts.load(); }
+
+	/// get work thread counts
+	int32_t get_work_thread_counts(void) const { return m_udp_server.get_work_thread_counts(); }
+
+private:
+	enum {
+		kCloseAllCmdID = UdpServer::kCustomWorkThreadCmdID_Begin,
+		kShutdownConnectionCmdID,
+	};
+
+	struct WorkContext
+	{
+		typedef std::unordered_map<uint64_t, UdpConnectionPtr> ConnectionMap;	//key: peer address
+
+		Looper* looper;
+		Looper::event_id_t timer_id;	//created with the first connection
+		ConnectionMap connections;
+	};
+
+	UdpServer m_udp_server;
+	ReliableChannel::Config m_config;
+	int32_t m_max_connections;
+	std::vector<WorkContext*> m_contexts;
+	atomic_int32_t m_next_connection_id;
+	atomic_int32_t m_connection_counts;
+
+private:
+	void _on_work_thread_start(int32_t thread_index, Looper* looper);
+	void _on_work_thread_command(int32_t thread_index, Packet* cmd);
+	void _on_message(int32_t thread_index, UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts);
+	void _on_timer(int32_t thread_index);
+	UdpConnectionPtr _new_connection(int32_t thread_index, UdpSocket* socket, uint32_t conv, const struct sockaddr_in& peer_addr);
+
+	static uint64_t _peer_key(const struct sockaddr_in& addr) {
+		return ((uint64_t)addr.sin_addr.s_addr << 16) | (uint64_t)addr.sin_port;
+	}
+
+public:
+	ReliableUdpServer();
+	~ReliableUdpServer();
+};
+
+}
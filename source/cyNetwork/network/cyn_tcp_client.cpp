@@ -116,18 +116,18 @@ void TcpClient::_on_connect_status_changed(bool timeout)
 		RELEASE_EVENT(m_looper, m_socket_event_id)
 
 		//established the connection
-		m_connection = std::make_shared<TcpConnection>(m_id, m_socket, m_looper, this);
+		m_connection = TcpConnectionPtr(new TcpConnection(m_id, m_socket, m_looper, this));
 		CY_LOG(L_DEBUG, "connect to %s:%d success", m_serverAddr.get_ip(), m_serverAddr.get_port());
 
 		//bind callback functions
 		if (m_listener.on_message) {
-			m_connection->set_on_message([this](TcpConnectionPtr conn) {
+			m_connection->set_on_message([this](const TcpConnectionLocalPtr& conn) {
 				m_listener.on_message(shared_from_this(), conn);
 			});
 		}
 
 		if(m_listener.on_close) {
-			m_connection->set_on_close([this](TcpConnectionPtr conn) {
+			m_connection->set_on_close([this](const TcpConnectionLocalPtr& conn) {
 				CY_LOG(L_DEBUG, "disconnect from %s:%d", m_serverAddr.get_ip(), m_serverAddr.get_port());
 				m_listener.on_close(shared_from_this(), conn);
 			});
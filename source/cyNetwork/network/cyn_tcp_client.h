@@ -17,8 +17,8 @@ class TcpClient : public std::enable_shared_from_this<TcpClient>, noncopyable, p
 {
 public:
 	typedef std::function<uint32_t(TcpClientPtr client, TcpConnectionPtr conn, bool success)> ConnectedCallback;
-	typedef std::function<void(TcpClientPtr client, TcpConnectionPtr conn)> MessageCallback;
-	typedef std::function<void(TcpClientPtr client, TcpConnectionPtr conn)> CloseCallback;
+	typedef std::function<void(TcpClientPtr client, const TcpConnectionLocalPtr& conn)> MessageCallback;
+	typedef std::function<void(TcpClientPtr client, const TcpConnectionLocalPtr& conn)> CloseCallback;
 
 	struct Listener {
 		ConnectedCallback on_connected;
@@ -10,17 +10,199 @@ namespace cyclone
 {
 
 //-------------------------------------------------------------------------------------
-TcpConnection::TcpConnection(int32_t id, socket_t sfd, Looper* looper, Owner* owner)
+namespace {
+
+// free lists of connection objects of one thread. An object is always returned to the pool of
+// the thread which allocated it: the owner thread pushes it to the local list, other threads(the
+// rcu reclaim timer of master thread, other work thread...) push it to the lock-free remote list,
+// which is taken by the owner thread when the local list is empty.
+// The pooled objects are counted by kTagDefault, not kTagConnection.
+struct ConnectionPool
+{
+	struct FreeNode { FreeNode* next; };
+
+	//owner thread only
+	FreeNode* head;
+	size_t counts;
+
+	std::atomic<FreeNode*> remote_head;
+	std::atomic<size_t> remote_counts;
+	atomic_bool_t alive;
+
+	ConnectionPool() : head(nullptr), counts(0), remote_head(nullptr), remote_counts(0), alive(true) {}
+
+	void push_remote(FreeNode* node)
+	{
+		FreeNode* old_head = remote_head.load(std::memory_order_relaxed);
+		do {
+			node->next = old_head;
+		} while (!remote_head.compare_exchange_weak(old_head, node, std::memory_order_release, std::memory_order_relaxed));
+		remote_counts.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void collect_remote(void)
+	{
+		FreeNode* node = remote_head.exchange(nullptr, std::memory_order_acquire);
+		while (node) {
+			FreeNode* next = node->next;
+			node->next = head;
+			head = node;
+			counts++;
+			remote_counts.fetch_sub(1, std::memory_order_relaxed);
+			node = next;
+		}
+	}
+
+	void release_all(void)
+	{
+		collect_remote();
+		while (head) {
+			FreeNode* next = head->next;
+			CY_FREE(head);
+			head = next;
+		}
+		counts = 0;
+	}
+};
+
+//every object remembers the pool of its thread
+struct alignas(16) PoolHeader
+{
+	ConnectionPool* owner;
+};
+
+//-------------------------------------------------------------------------------------
+// the pools are never deleted because the objects of an exited thread may still be in use,
+// the pool of an exited thread is taken over by the next new thread
+struct PoolRegistry
+{
+	sys_api::mutex_t lock;
+	std::vector<ConnectionPool*> pools;
+
+	PoolRegistry() { lock = sys_api::mutex_create(); }
+
+	ConnectionPool* acquire(void)
+	{
+		sys_api::auto_mutex guard(lock);
+		for (auto pool : pools) {
+			if (!pool->alive.load()) {
+				pool->alive = true;
+				return pool;
+			}
+		}
+		ConnectionPool* pool = new ConnectionPool();
+		pools.push_back(pool);
+		return pool;
+	}
+};
+
+PoolRegistry& _get_registry(void)
+{
+	static PoolRegistry registry;
+	return registry;
+}
+
+//-------------------------------------------------------------------------------------
+struct ThreadPool
+{
+	ConnectionPool* pool;
+
+	ThreadPool() : pool(_get_registry().acquire()) {}
+	~ThreadPool();
+};
+
+//the pool can't be touched after the thread exit
+static thread_local bool s_pool_destroyed = false;
+static thread_local ThreadPool s_pool;
+
+ThreadPool::~ThreadPool()
+{
+	pool->release_all();
+	s_pool_destroyed = true;
+	pool->alive = false;
+}
+
+ConnectionPool* _get_connection_pool(void)
+{
+	return s_pool_destroyed ? nullptr : s_pool.pool;
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+void* TcpConnection::operator new(size_t size)
+{
+	ConnectionPool* pool = _get_connection_pool();
+	if (pool && size == sizeof(TcpConnection)) {
+		if (pool->head == nullptr) pool->collect_remote();
+		if (pool->head) {
+			ConnectionPool::FreeNode* node = pool->head;
+			pool->head = node->next;
+			pool->counts--;
+			memory::set_tag(node, memory::kTagConnection);
+
+			//the free node overwrites the header
+			PoolHeader* header = (PoolHeader*)node;
+			header->owner = pool;
+			return header + 1;
+		}
+	}
+
+	PoolHeader* header = (PoolHeader*)CY_MALLOC_TAG(sizeof(PoolHeader) + size, memory::kTagConnection);
+	//only the objects of standard size can be reused
+	header->owner = (size == sizeof(TcpConnection)) ? pool : nullptr;
+	return header + 1;
+}
+
+//-------------------------------------------------------------------------------------
+void TcpConnection::operator delete(void* p)
+{
+	if (p == nullptr) return;
+
+	PoolHeader* header = (PoolHeader*)p - 1;
+	ConnectionPool* owner = header->owner;
+	ConnectionPool::FreeNode* node = (ConnectionPool::FreeNode*)header;
+
+	if (owner && owner == _get_connection_pool()) {
+		if (owner->counts < kMaxPooledConnections) {
+			memory::set_tag(node, memory::kTagDefault);
+			node->next = owner->head;
+			owner->head = node;
+			owner->counts++;
+			return;
+		}
+	}
+	else if (owner && owner->alive.load(std::memory_order_relaxed) &&
+		owner->remote_counts.load(std::memory_order_relaxed) < kMaxPooledConnections) {
+		//send it back to the thread which allocates connections
+		memory::set_tag(node, memory::kTagDefault);
+		owner->push_remote(node);
+		return;
+	}
+	CY_FREE(header);
+}
+
+//-------------------------------------------------------------------------------------
+size_t TcpConnection::get_pooled_counts(void)
+{
+	ConnectionPool* pool = _get_connection_pool();
+	return pool ? pool->counts + pool->remote_counts.load(std::memory_order_relaxed) : 0;
+}
+
+//-------------------------------------------------------------------------------------
+TcpConnection::TcpConnection(int32_t id, socket_t sfd, Looper* looper, Owner* owner, bool compact)
 	: m_id(id)
 	, m_socket(sfd)
 	, m_state(kConnected)
+	, m_compact(compact)
+	, m_local_addr(nullptr)
+	, m_peer_addr(nullptr)
 	, m_looper(looper)
 	, m_event_id(Looper::INVALID_EVENT_ID)
 	, m_owner(owner)
 	, m_param(nullptr)
-	, m_read_buf(kDefaultReadBufSize)
-	, m_write_buf(kDefaultWriteBufSize)
-	, m_write_buf_lock(nullptr)
+	, m_read_buf(compact ? 0 : kDefaultReadBufSize)
+	, m_write_buf(compact ? 0 : kDefaultWriteBufSize)
 	, m_on_message(nullptr)
 	, m_on_send_complete(nullptr)
 	, m_on_close(nullptr)
@@ -28,6 +210,7 @@ TcpConnection::TcpConnection(int32_t id, socket_t sfd, Looper* looper, Owner* ow
 	, m_writebuf_minmax_size(kDefaultWriteBufSize)
 	, m_read_statistics(nullptr)
 	, m_write_statistics(nullptr)
+	, m_message_statistics(nullptr)
 {
 	//set socket to non-block and close-onexec
 	socket_api::set_nonblock(sfd, true);
@@ -38,16 +221,11 @@ TcpConnection::TcpConnection(int32_t id, socket_t sfd, Looper* looper, Owner* ow
 	//set socket no-delay
 	socket_api::set_nodelay(sfd, true);
 
-	//init write buf lock
-	m_write_buf_lock = sys_api::mutex_create();
-
-	m_local_addr = Address(false, m_socket); //create local address
-	m_peer_addr = Address(true, m_socket); //create peer address
-
-	//set default debug name
-	char temp[MAX_PATH] = { 0 };
-	std::snprintf(temp, MAX_PATH, "connection_%d", id);
-	m_name = temp;
+	if (!m_compact) {
+		get_local_addr(); //create local address
+		get_peer_addr(); //create peer address
+		get_name(); //set default debug name
+	}
 
 	//register socket event
 	m_event_id = m_looper->register_event(m_socket,
@@ -71,10 +249,63 @@ TcpConnection::~TcpConnection()
 		m_read_statistics = nullptr;
 	}
 
+	if (m_message_statistics) {
+		delete m_message_statistics;
+		m_message_statistics = nullptr;
+	}
+
 	assert(get_state()==kDisconnected);
 	assert(m_socket == INVALID_SOCKET);
 	assert(m_event_id == Looper::INVALID_EVENT_ID);
-	assert(m_write_buf_lock == nullptr);
+
+	delete m_local_addr.load();
+	delete m_peer_addr.load();
+}
+
+//-------------------------------------------------------------------------------------
+const Address& TcpConnection::_get_address(std::atomic<Address*>& addr, bool peer) const
+{
+	Address* p = addr.load(std::memory_order_acquire);
+	if (p) return *p;
+
+	//the socket is still open, it will be created before close the socket
+	Address* new_addr = new Address(peer, m_socket);
+	if (addr.compare_exchange_strong(p, new_addr, std::memory_order_acq_rel)) return *new_addr;
+
+	//created by other thread
+	delete new_addr;
+	return *p;
+}
+
+//-------------------------------------------------------------------------------------
+const char* TcpConnection::get_name(void) const
+{
+	if (m_name.empty()) {
+		//default debug name
+		char temp[MAX_PATH] = { 0 };
+		std::snprintf(temp, MAX_PATH, "connection_%d", m_id);
+		m_name = temp;
+	}
+	return m_name.c_str();
+}
+
+//-------------------------------------------------------------------------------------
+size_t TcpConnection::get_memory_usage(void) const
+{
+	size_t usage = sizeof(TcpConnection);
+
+	//ring buf use one more byte
+	if (m_read_buf.capacity() > 0) usage += m_read_buf.capacity() + 1;
+	if (m_write_buf.capacity() > 0) usage += m_write_buf.capacity() + 1;
+
+	if (m_local_addr.load()) usage += sizeof(Address);
+	if (m_peer_addr.load()) usage += sizeof(Address);
+	if (!m_name.empty()) usage += m_name.capacity() + 1;
+
+	if (m_read_statistics) usage += m_read_statistics->get_memory_usage();
+	if (m_write_statistics) usage += m_write_statistics->get_memory_usage();
+	if (m_message_statistics) usage += sizeof(LatencyHistogram);
+	return usage;
 }
 
 //-------------------------------------------------------------------------------------
@@ -94,29 +325,34 @@ void TcpConnection::send(const char* buf, size_t len)
 	}
 	else
 	{
-		if (get_state() != kConnected)
+		State state;
 		{
-			//log error, give up send message
-			CY_LOG(L_ERROR, "send message state error, state=%d", get_state());
-			return;
-		}
+			//write to output buf
+			sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
 
-		//write to output buf
-		sys_api::auto_mutex lock(m_write_buf_lock);
-
-		//write to write buffer
-		m_write_buf.memcpy_into(buf, len);
+			//the state can't be changed to disconnected while the lock is held
+			state = get_state();
+			if (state == kConnected) {
+				//write to write buffer
+				m_write_buf.memcpy_into(buf, len);
 
-		//enable write event, wait socket ready
-		m_looper->enable_write(m_event_id);
+				//enable write event, wait socket ready
+				m_looper->enable_write(m_event_id);
+			}
+		}
 
+		if (state != kConnected)
+		{
+			//log error, give up send message
+			CY_LOG(L_ERROR, "send message state error, state=%d", state);
+		}
 	}
 }
 
 //-------------------------------------------------------------------------------------
 bool TcpConnection::_is_writeBuf_empty(void) const
 {
-	sys_api::auto_mutex lock(m_write_buf_lock);
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
 	return  m_write_buf.empty();
 }
 
@@ -143,7 +379,7 @@ void TcpConnection::_send(const char* buf, size_t len)
 		if (nwrote >= 0)
 		{
 			if (m_write_statistics) {
-				m_write_statistics->push(nwrote);
+				m_write_statistics->push(nwrote, m_looper->get_cached_time() / 1000ll);
 			}
 			remaining = len - (size_t)nwrote;
 		}
@@ -177,7 +413,7 @@ void TcpConnection::_send(const char* buf, size_t len)
 	}
 
 	if (remaining > 0) {
-		sys_api::auto_mutex lock(m_write_buf_lock);
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
 		//write to write buffer
 		m_write_buf.memcpy_into(buf + nwrote, remaining);
 	}
@@ -186,6 +422,17 @@ void TcpConnection::_send(const char* buf, size_t len)
 	m_looper->enable_write(m_event_id);
 }
 
+//-------------------------------------------------------------------------------------
+void TcpConnection::shrink_idle_buffers(void)
+{
+	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
+
+	m_read_buf.shrink_if_idle();
+
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
+	m_write_buf.shrink_if_idle();
+}
+
 //-------------------------------------------------------------------------------------
 void TcpConnection::shutdown(void)
 {
@@ -199,6 +446,8 @@ void TcpConnection::shutdown(void)
 	if (m_looper->is_write(m_event_id) && !_is_writeBuf_empty()) return;
 	
 	//ok, we can close the socket now
+	get_local_addr();
+	get_peer_addr();
 	socket_api::shutdown(m_socket);
 	_on_socket_close();
 }
@@ -213,11 +462,20 @@ void TcpConnection::_on_socket_read(void)
 	if (len > 0)
 	{
 		if (m_read_statistics) {
-			m_read_statistics->push(len);
+			m_read_statistics->push(len, m_looper->get_cached_time() / 1000ll);
 		}
 		//notify logic layer...
 		if (m_on_message) {
-			m_on_message(shared_from_this());
+			int64_t begin_time = m_message_statistics ? sys_api::performance_time_now() : 0;
+			m_on_message(TcpConnectionLocalPtr(this));
+			if (m_message_statistics) {
+				m_message_statistics->record(sys_api::performance_time_now() - begin_time);
+			}
+		}
+
+		//all data has been consumed
+		if (m_compact) {
+			m_read_buf.release_memory();
 		}
 	}
 	else if (len == 0)
@@ -241,7 +499,7 @@ void TcpConnection::_on_socket_write(void)
 	if (!(m_looper->is_write(m_event_id))) return;
 
 	{
-		sys_api::auto_mutex lock(m_write_buf_lock);
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
 		m_writebuf_minmax_size.update(m_write_buf.size());
 		if (!m_write_buf.empty()) {
 			ssize_t len = m_write_buf.write_socket(m_socket);
@@ -249,8 +507,8 @@ void TcpConnection::_on_socket_write(void)
 				//log error
 				CY_LOG(L_ERROR, "write socket error, err=%d", socket_api::get_lasterror());
 			}
-			if (m_write_statistics) {
-				m_write_statistics->push(len);
+			else if (m_write_statistics) {
+				m_write_statistics->push(len, m_looper->get_cached_time() / 1000ll);
 			}
 		}
 
@@ -261,11 +519,15 @@ void TcpConnection::_on_socket_write(void)
 
 		//no longer need care write-able event
 		m_looper->disable_write(m_event_id);
+
+		if (m_compact) {
+			m_write_buf.release_memory();
+		}
 	}
 
 	//write complete
 	if (m_on_send_complete) {
-		m_on_send_complete(this->shared_from_this());
+		m_on_send_complete(TcpConnectionLocalPtr(this));
 	}
 
 	//disconnecting? this is the last message send to client, we can shut it down again
@@ -280,10 +542,17 @@ void TcpConnection::_on_socket_close(void)
 	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
 	assert(m_state == kConnected || m_state == kDisconnecting);
 
-	TcpConnectionPtr thisPtr = shared_from_this();
+	TcpConnectionLocalPtr thisPtr(this);
+
+	//create address before the socket closed, it can't be queried any more
+	get_local_addr();
+	get_peer_addr();
 
-	//disable all event
-	m_state = kDisconnected;
+	//disable all event, send() of other thread checks the state with the write buf lock held
+	{
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
+		m_state = kDisconnected;
+	}
 
 	//delete looper event
 	m_looper->delete_event(m_event_id);
@@ -295,16 +564,17 @@ void TcpConnection::_on_socket_close(void)
 	}
 
 	//reset read/write buf
-	m_write_buf.reset();
+	{
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
+		m_write_buf.reset();
+		if (m_compact) m_write_buf.release_memory();
+	}
 	m_read_buf.reset();
+	if (m_compact) m_read_buf.release_memory();
 
 	//close socket
 	socket_api::close_socket(m_socket);
 	m_socket = INVALID_SOCKET;
-
-	//destroy write buf lock
-	sys_api::mutex_destroy(m_write_buf_lock);
-	m_write_buf_lock = nullptr;
 }
 
 //-------------------------------------------------------------------------------------
@@ -334,7 +604,7 @@ void TcpConnection::start_read_statistics(int32_t period_time)
 
 	//already start
 	if (m_read_statistics) return;
-	m_read_statistics = new PeriodValue <ssize_t>(period_time);
+	m_read_statistics = new WindowValue(period_time);
 }
 
 //-------------------------------------------------------------------------------------
@@ -344,7 +614,17 @@ void TcpConnection::start_write_statistics(int32_t period_time)
 
 	//already start
 	if (m_write_statistics) return;
-	m_write_statistics = new PeriodValue <ssize_t>(period_time);
+	m_write_statistics = new WindowValue(period_time);
+}
+
+//-------------------------------------------------------------------------------------
+void TcpConnection::start_message_statistics(void)
+{
+	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
+
+	//already start
+	if (m_message_statistics) return;
+	m_message_statistics = new LatencyHistogram();
 }
 
 //-------------------------------------------------------------------------------------
@@ -352,7 +632,8 @@ std::pair<size_t, int32_t> TcpConnection::get_read_statistics(void) const
 {
 	if (!m_read_statistics) return std::pair<size_t, int32_t>{0, 0};
 
-	return m_read_statistics->sum_and_counts();
+	auto sum_and_counts = m_read_statistics->sum_and_counts();
+	return std::pair<size_t, int32_t>{ (size_t)sum_and_counts.first, sum_and_counts.second };
 }
 
 //-------------------------------------------------------------------------------------
@@ -360,7 +641,24 @@ std::pair<size_t, int32_t> TcpConnection::get_write_statistics(void) const
 {
 	if (!m_write_statistics) return std::pair<size_t, int32_t>{0, 0};
 
-	return m_write_statistics->sum_and_counts();
+	auto sum_and_counts = m_write_statistics->sum_and_counts();
+	return std::pair<size_t, int32_t>{ (size_t)sum_and_counts.first, sum_and_counts.second };
+}
+
+//-------------------------------------------------------------------------------------
+double TcpConnection::get_read_speed(bool ewma) const
+{
+	if (!m_read_statistics) return 0.0;
+
+	return ewma ? m_read_statistics->ewma_rate() : m_read_statistics->rate();
+}
+
+//-------------------------------------------------------------------------------------
+double TcpConnection::get_write_speed(bool ewma) const
+{
+	if (!m_write_statistics) return 0.0;
+
+	return ewma ? m_write_statistics->ewma_rate() : m_write_statistics->rate();
 }
 
 
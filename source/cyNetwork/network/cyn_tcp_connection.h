@@ -6,17 +6,22 @@ Copyright(C) thecodeway.com
 #include <cyclone_config.h>
 #include <network/cyn_address.h>
 #include <utility/cyu_statistics.h>
+#include <utility/cyu_histogram.h>
 
 namespace cyclone
 {
 
 class TcpConnection;
-typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
+//thread safe handle, atomic reference counting
+typedef IntrusivePtr<TcpConnection> TcpConnectionPtr;
+//handle used in the looper thread of connection only, no atomic operation when copy it.
+//it converts to TcpConnectionPtr automatically if the connection need be hold in other thread.
+typedef LocalPtr<TcpConnection> TcpConnectionLocalPtr;
 
-class TcpConnection : public std::enable_shared_from_this<TcpConnection>, noncopyable
+class TcpConnection : public RefCounted<TcpConnection>, noncopyable
 {
 public:
-	typedef std::function<void(TcpConnectionPtr conn)> EventCallback;
+	typedef std::function<void(const TcpConnectionLocalPtr& conn)> EventCallback;
 	class Owner {
 	public:
 		enum OWNER_TYPE { kServer=0, kClient };
@@ -32,6 +37,17 @@ public:
 	//
 	enum State { kConnecting, kConnected, kDisconnecting, kDisconnected };
 
+	//compact connection mode, for servers which hold lots of mostly idle connections
+	// - read/write buf are allocated when data come in, and released when drained
+	// - peer/local address and debug name are created on first use
+	// - connection objects are recycled through per-thread free lists, an object freed in other
+	//   thread goes back to the list of the thread which allocated it
+	//
+	//memory budget of one idle compact connection: the object itself(write buf lock included) and
+	//the heap memory it owns. The pool header of the object and the looper channel are not counted,
+	//see get_memory_usage()
+	enum { kCompactMemoryBudget = 512 };
+
 	/// get id(thread safe)
 	int32_t get_id(void) const { return m_id; }
 
@@ -39,10 +55,13 @@ public:
 	State get_state(void) const;
 
 	/// get peer address (thread safe)
-	const Address& get_peer_addr(void) const { return m_peer_addr; }
+	const Address& get_peer_addr(void) const { return _get_address(m_peer_addr, true); }
 
 	/// get local address (thread safe)
-	const Address& get_local_addr(void) const { return m_local_addr; }
+	const Address& get_local_addr(void) const { return _get_address(m_local_addr, false); }
+
+	/// is compact connection(thread safe)
+	bool is_compact(void) const { return m_compact; }
 
 	/// get input stream buf (NOT thread safe, call it in work thread)
 	RingBuf& get_input_buf(void) { return m_read_buf; }
@@ -55,7 +74,7 @@ public:
 
 	/// set/get connection debug name(NOT thread safe)
 	void set_name(const char* name);
-	const char* get_name(void) const { return m_name.c_str(); }
+	const char* get_name(void) const;
 
 	/// get owner
 	Owner* get_owner(void) { return m_owner; }
@@ -75,12 +94,17 @@ public:
 	/// shutdown the connection
 	void shutdown(void);
 
+	/// shrink the read/write buf if they have been idle for a while, see RingBuf::set_shrink_policy
+	/// (NOT thread safe, call it in work thread periodically)
+	void shrink_idle_buffers(void);
+
 private:
 	int32_t m_id;
 	socket_t m_socket;
 	std::atomic<State> m_state;
-	Address m_local_addr;
-	Address m_peer_addr;
+	bool m_compact;
+	mutable std::atomic<Address*> m_local_addr;
+	mutable std::atomic<Address*> m_peer_addr;
 	Looper* m_looper;
 	Looper::event_id_t m_event_id;
 	Owner* m_owner;
@@ -91,13 +115,13 @@ private:
 	RingBuf m_read_buf;
 
 	RingBuf m_write_buf;
-	sys_api::mutex_t m_write_buf_lock;	//for multi thread lock
+	mutable sys_api::spin_mutex m_write_buf_lock;	//for multi thread lock
 
 	EventCallback m_on_message;
 	EventCallback m_on_send_complete;
 	EventCallback m_on_close;
 
-	std::string m_name;
+	mutable std::string m_name;
 
 private:
 	//// on socket read event
@@ -118,6 +142,9 @@ private:
 	//// is write buf empty(thread safe)
 	bool _is_writeBuf_empty(void) const;
 
+	//// create address on first use(thread safe)
+	const Address& _get_address(std::atomic<Address*>& addr, bool peer) const;
+
 public:
 	// record the max size of read buf and write buf
 	size_t get_readebuf_max_size(void) const { return m_readbuf_minmax_size.max(); }
@@ -132,14 +159,39 @@ public:
 	std::pair<size_t, int32_t> get_read_statistics(void) const;
 	std::pair<size_t, int32_t> get_write_statistics(void) const;
 
+	// get read and write speed(bytes per second) in given time, and the moving average of speed
+	double get_read_speed(bool ewma = false) const;
+	double get_write_speed(bool ewma = false) const;
+
+	// record the time(microseconds) of on_message callback 
+	// not thread safe, must call in work thread, and can only be called once
+	void start_message_statistics(void);
+	// get the histogram of on_message callback time, nullptr if not started
+	const LatencyHistogram* get_message_statistics(void) const { return m_message_statistics; }
+
 private:
 	MinMaxValue <size_t> m_readbuf_minmax_size;
 	MinMaxValue <size_t> m_writebuf_minmax_size;
-	PeriodValue <ssize_t>* m_read_statistics;
-	PeriodValue <ssize_t>* m_write_statistics;
+	WindowValue* m_read_statistics;
+	WindowValue* m_write_statistics;
+	LatencyHistogram* m_message_statistics;
+
+public:
+	// memory held by this connection now, in bytes(NOT thread safe, call it in work thread)
+	size_t get_memory_usage(void) const;
+
+	// counts of free connection objects wait to be reused in current thread(thread safe)
+	static size_t get_pooled_counts(void);
+
+	//connection objects are recycled by per-thread free lists, to reduce heap fragmentation
+	static void* operator new(size_t size);
+	static void operator delete(void* p);
+
+private:
+	enum { kMaxPooledConnections = 4096 };	//of one thread
 
 public:
-	TcpConnection(int32_t id, socket_t sfd, Looper* looper, Owner* owner);
+	TcpConnection(int32_t id, socket_t sfd, Looper* looper, Owner* owner, bool compact=false);
 	~TcpConnection();
 };
 
@@ -19,6 +19,7 @@ TcpServer::TcpServer()
 	, m_running(0)
 	, m_shutdown_ing(0)
 	, m_next_connection_id(kStartConnectionID)  //start from 1
+	, m_compact_connection(false)
 {
 	m_listener.on_master_thread_start = nullptr;
 	m_listener.on_master_thread_command = nullptr;
@@ -155,6 +156,10 @@ void TcpServer::join(void)
 		delete work;
 	}
 	m_work_thread_pool.clear();
+
+	//release all connections which retired by directory
+	m_connection_directory.clear();
+	rcu::synchronize();
 	m_running = 0;
 
 	CY_LOG(L_DEBUG, "accept thread stop!");
@@ -171,6 +176,14 @@ void TcpServer::shutdown_connection(TcpConnectionPtr conn)
 	work->send_thread_message(TcpServerWorkThread::CloseConnectionCmd::ID, sizeof(closeConnectionCmd), (const char*)&closeConnectionCmd);
 }
 
+//-------------------------------------------------------------------------------------
+TcpConnectionPtr TcpServer::get_connection(int32_t connection_id) const
+{
+	TcpConnectionPtr conn;
+	if (!m_connection_directory.find(connection_id, conn)) return nullptr;
+	return conn;
+}
+
 //-------------------------------------------------------------------------------------
 void TcpServer::send_master_message(uint16_t id, uint16_t size, const char* message)
 {
@@ -206,7 +219,42 @@ void TcpServer::send_work_message(int32_t work_thread_index, const Packet** mess
 }
 
 //-------------------------------------------------------------------------------------
-void TcpServer::_on_socket_connected(int32_t work_thread_index, TcpConnectionPtr conn)
+void TcpServer::send_work_message(int32_t work_thread_index, const PacketPtr& message)
+{
+	assert(work_thread_index >= 0 && work_thread_index < m_workthread_counts);
+
+	TcpServerWorkThread* work = m_work_thread_pool[(size_t)work_thread_index];
+	work->send_thread_message(message);
+}
+
+//-------------------------------------------------------------------------------------
+void TcpServer::broadcast_work_message(const PacketPtr& message)
+{
+	for (auto work : m_work_thread_pool) {
+		work->send_thread_message(message);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+bool TcpServer::post_work_message(int32_t work_thread_index, Packet* message)
+{
+	assert(work_thread_index >= 0 && work_thread_index < m_workthread_counts);
+
+	TcpServerWorkThread* work = m_work_thread_pool[(size_t)work_thread_index];
+	return work->post_thread_message(message);
+}
+
+//-------------------------------------------------------------------------------------
+WorkThread::MailboxStats TcpServer::get_work_mailbox_stats(int32_t work_thread_index) const
+{
+	assert(work_thread_index >= 0 && work_thread_index < m_workthread_counts);
+
+	const TcpServerWorkThread* work = m_work_thread_pool[(size_t)work_thread_index];
+	return work->get_mailbox_stats();
+}
+
+//-------------------------------------------------------------------------------------
+void TcpServer::_on_socket_connected(int32_t work_thread_index, const TcpConnectionLocalPtr& conn)
 {
 	if (m_listener.on_connected) {
 		m_listener.on_connected(this, work_thread_index, conn);
@@ -214,7 +262,7 @@ void TcpServer::_on_socket_connected(int32_t work_thread_index, TcpConnectionPtr
 }
 
 //-------------------------------------------------------------------------------------
-void TcpServer::_on_socket_message(int32_t work_thread_index, TcpConnectionPtr conn)
+void TcpServer::_on_socket_message(int32_t work_thread_index, const TcpConnectionLocalPtr& conn)
 {
 	if (m_listener.on_message) {
 		m_listener.on_message(this, work_thread_index, conn);
@@ -222,8 +270,11 @@ void TcpServer::_on_socket_message(int32_t work_thread_index, TcpConnectionPtr c
 }
 
 //-------------------------------------------------------------------------------------
-void TcpServer::_on_socket_close(int32_t work_thread_index, TcpConnectionPtr conn)
+void TcpServer::_on_socket_close(int32_t work_thread_index, const TcpConnectionLocalPtr& conn)
 {
+	//other threads can't find this connection any more
+	m_connection_directory.erase(conn->get_id());
+
 	if (m_listener.on_close) {
 		m_listener.on_close(this, work_thread_index, conn);
 	}
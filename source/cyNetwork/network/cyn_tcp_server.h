@@ -23,7 +23,8 @@ public:
 	typedef std::function<void(TcpServer* server, int32_t thread_index, Looper* looper)> WorkThreadStartCallback;
 	typedef std::function<void(TcpServer* server, int32_t thread_index, Packet* cmd)> WorkThreadCommandCallback;
 
-	typedef std::function<void(TcpServer* server, int32_t thread_index, TcpConnectionPtr conn)> EventCallback;
+	//the connection handle is valid in the work thread only, convert it to TcpConnectionPtr to hold it in other thread
+	typedef std::function<void(TcpServer* server, int32_t thread_index, const TcpConnectionLocalPtr& conn)> EventCallback;
 
 	enum { kCustomMasterThreadCmdID_Begin=10 };
 
@@ -45,6 +46,11 @@ public:
 	// NOT thread safe, and this function must be called before start the server
 	bool bind(const Address& bind_addr, bool enable_reuse_port=true);
 
+	/// use compact connection for lots of mostly idle clients, see TcpConnection::kCompactMemoryBudget
+	// NOT thread safe, and this function must be called before start the server
+	void set_compact_connection(bool compact) { if (m_running == 0) m_compact_connection = compact; }
+	bool is_compact_connection(void) const { return m_compact_connection; }
+
 	/// start the server(start one accept thread and n work threads)
 	/// (thread safe, but you wouldn't want call it again...)
 	bool start(int32_t work_thread_counts);
@@ -59,6 +65,13 @@ public:
 	/// shutdown one of connection(thread safe)
 	void shutdown_connection(TcpConnectionPtr conn);
 
+	/// get connection by id, return nullptr if the connection not exist or closed
+	/// (thread safe, lock-free, can be called in any thread)
+	TcpConnectionPtr get_connection(int32_t connection_id) const;
+
+	/// get current connection counts(thread safe)
+	size_t get_connection_counts(void) const { return m_connection_directory.size(); }
+
 	/// get bind address, if index is invalid return default Address value
 	Address get_bind_address(size_t index);
 
@@ -72,6 +85,18 @@ public:
 	/// send work message to one of work thread(thread safe)
 	void send_work_message(int32_t work_thread_index, const Packet* message);
 	void send_work_message(int32_t work_thread_index, const Packet** message, int32_t counts);
+	/// send a shared packet without copy, the packet MUST NOT be changed after sending(thread safe)
+	void send_work_message(int32_t work_thread_index, const PacketPtr& message);
+
+	/// send a shared packet to all work threads without copy(thread safe)
+	void broadcast_work_message(const PacketPtr& message);
+
+	/// post a packet allocated by Packet::alloc_packet to one of work thread, the work thread
+	/// takes the ownership without copy, return false if it's rejected and the caller still owns it(thread safe)
+	bool post_work_message(int32_t work_thread_index, Packet* message);
+
+	/// get the statistics of work thread mailbox(thread safe)
+	WorkThread::MailboxStats get_work_mailbox_stats(int32_t work_thread_index) const;
 
 	/// get work thread counts
 	int32_t get_work_thread_counts(void) const { return m_workthread_counts; }
@@ -98,6 +123,11 @@ private:
 
 	enum { kStartConnectionID = 1 };
 	atomic_int32_t m_next_connection_id;
+	bool m_compact_connection;
+
+	/// all connections of work threads, read-mostly, updated by work thread only
+	typedef RcuHashMap<TcpConnectionPtr> ConnectionDirectory;
+	ConnectionDirectory m_connection_directory;
 
 private:
 	//called by master thread
@@ -106,9 +136,9 @@ private:
 	friend class TcpServerMasterThread;
 private:
 	// called by server work thread only
-	void _on_socket_connected(int32_t work_thread_index, TcpConnectionPtr conn);
-	void _on_socket_message(int32_t work_thread_index, TcpConnectionPtr conn);
-	void _on_socket_close(int32_t work_thread_index, TcpConnectionPtr conn);
+	void _on_socket_connected(int32_t work_thread_index, const TcpConnectionLocalPtr& conn);
+	void _on_socket_message(int32_t work_thread_index, const TcpConnectionLocalPtr& conn);
+	void _on_socket_close(int32_t work_thread_index, const TcpConnectionLocalPtr& conn);
 
 	friend class TcpServerWorkThread;
 public:
@@ -0,0 +1,182 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+#include "cyn_udp_connection.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+UdpConnection::UdpConnection(int32_t id, uint32_t conv, UdpSocket* socket, const Address& peer_addr, const ReliableChannel::Config& config, bool active)
+	: m_id(id)
+	, m_conv(conv)
+	, m_state(active ? kConnecting : kConnected)
+	, m_peer_addr(peer_addr)
+	, m_looper(socket->get_looper())
+	, m_socket(socket)
+	, m_channel(conv, config, _now(),
+		[this](const uint8_t* datagram, size_t size) {
+			m_socket->send(datagram, size, m_peer_addr);
+		},
+		[this](uint8_t cmd, const uint8_t* data, size_t size) {
+			if (get_state() == kDisconnected) return;
+
+			if (cmd == ReliableChannel::kCmdPush) {
+				m_read_buf.memcpy_into(data, size);
+				m_has_message = true;
+			}
+			else if (cmd == ReliableChannel::kCmdClose) {
+				m_peer_closed = true;
+			}
+		})
+	, m_param(nullptr)
+	, m_read_buf(kDefaultReadBufSize)
+	, m_has_message(false)
+	, m_peer_closed(false)
+	, m_close_time(0)
+	, m_on_connected(nullptr)
+	, m_on_message(nullptr)
+	, m_on_close(nullptr)
+{
+	//the first segment of client
+	if (active) m_channel.send_control(ReliableChannel::kCmdConnect);
+}
+
+//-------------------------------------------------------------------------------------
+UdpConnection::~UdpConnection()
+{
+}
+
+//-------------------------------------------------------------------------------------
+uint32_t UdpConnection::_now(void)
+{
+	return (uint32_t)(sys_api::performance_time_now() / 1000);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpConnection::send(const char* buf, size_t len)
+{
+	if (buf == nullptr || len == 0) return;
+
+	State state = get_state();
+	if (state != kConnecting && state != kConnected) {
+		//log error, give up send message
+		CY_LOG(L_ERROR, "send message state error, state=%d", state);
+		return;
+	}
+
+	sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
+	if (sys_api::thread_get_current_id() == m_looper->get_thread_id())
+	{
+		//keep the order of the message sent in other thread
+		if (!m_write_buf.empty()) {
+			m_channel.send(m_write_buf.normalize(), m_write_buf.size());
+			m_write_buf.reset();
+		}
+		m_channel.send((const uint8_t*)buf, len);
+		m_channel.update(_now());
+	}
+	else
+	{
+		//sent in next update
+		m_write_buf.memcpy_into(buf, len);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpConnection::shutdown(void)
+{
+	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
+
+	State state = get_state();
+	if (state != kConnecting && state != kConnected) return;
+
+	//set the state to disconnecting, and wait the close acked by peer
+	m_state = kDisconnecting;
+	{
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
+		if (!m_write_buf.empty()) {
+			m_channel.send(m_write_buf.normalize(), m_write_buf.size());
+			m_write_buf.reset();
+		}
+	}
+	m_channel.send_control(ReliableChannel::kCmdClose);
+
+	uint32_t now = _now();
+	m_channel.update(now);
+	_check_state(now);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpConnection::_input(const uint8_t* datagram, size_t size, uint32_t now)
+{
+	if (!m_channel.input(datagram, size, now)) return;
+
+	//ack at once
+	m_channel.update(now);
+	if (get_state() != kDisconnected) _check_state(now);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpConnection::_update(uint32_t now)
+{
+	//closed connection only acks the input of peer
+	if (get_state() == kDisconnected) return;
+
+	{
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_write_buf_lock);
+		if (!m_write_buf.empty()) {
+			m_channel.send(m_write_buf.normalize(), m_write_buf.size());
+			m_write_buf.reset();
+		}
+	}
+	m_channel.update(now);
+	_check_state(now);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpConnection::_check_state(uint32_t now)
+{
+	//connect segment acked by server
+	if (get_state() == kConnecting && m_channel.get_send_una() != 0) {
+		m_state = kConnected;
+		if (m_on_connected) m_on_connected(UdpConnectionPtr(this));
+	}
+
+	if (m_has_message) {
+		m_has_message = false;
+		if (m_on_message) m_on_message(UdpConnectionPtr(this));
+	}
+
+	State state = get_state();
+	if (state == kDisconnected) return;
+
+	if (m_peer_closed || m_channel.is_dead(now) || (state == kDisconnecting && m_channel.is_idle())) {
+		_close(now);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpConnection::_close(uint32_t now)
+{
+	if (get_state() == kDisconnected) return;
+
+	m_state = kDisconnected;
+	m_close_time = now;
+
+	if (m_on_close) m_on_close(UdpConnectionPtr(this));
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpConnection::_is_expired(uint32_t now) const
+{
+	if (get_state() != kDisconnected) return false;
+
+	uint32_t linger = std::max((uint32_t)kMinLingerTime, m_channel.get_rto() * 2);
+	return (int32_t)(now - m_close_time) >= (int32_t)linger;
+}
+
+}
@@ -0,0 +1,131 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cy_core.h>
+#include <cy_event.h>
+#include <network/cyn_address.h>
+#include <network/cyn_udp_socket.h>
+#include <network/cyn_reliable_channel.h>
+
+namespace cyclone
+{
+
+class UdpConnection;
+//thread safe handle, atomic reference counting
+typedef IntrusivePtr<UdpConnection> UdpConnectionPtr;
+
+//UdpConnection
+// ----------------
+// Reliable, ordered connection over udp(see ReliableChannel). It has the same on_message/send/
+// on_close shape as TcpConnection, so the application code can switch the transport.
+//
+// The connection doesn't own a socket, the owner(ReliableUdpServer or ReliableUdpClient) passes
+// the datagrams of peer to it, and updates all its connections with one timer of the looper.
+//
+class UdpConnection : public RefCounted<UdpConnection>, noncopyable
+{
+public:
+	typedef std::function<void(const UdpConnectionPtr& conn)> EventCallback;
+
+	//connection state
+	//                ack of connect               shutdown()
+	//  kConnecting -----------------> kConnected -------------> kDisconnecting
+	//       |                             |                          |
+	//       |  dead link                  | close from peer,         | all data acked,
+	//       |                             | dead link                | dead link
+	//        ----------------------------> kDisconnected <-----------
+	//
+	enum State { kConnecting, kConnected, kDisconnecting, kDisconnected };
+
+	/// get id(thread safe)
+	int32_t get_id(void) const { return m_id; }
+
+	/// get conversation id, it's chosen by client and unique for one peer address(thread safe)
+	uint32_t get_conv(void) const { return m_conv; }
+
+	/// get current state(thread safe)
+	State get_state(void) const { return m_state.load(); }
+
+	/// get peer address (thread safe)
+	const Address& get_peer_addr(void) const { return m_peer_addr; }
+
+	/// get looper
+	Looper* get_looper(void) const { return m_looper; }
+
+	/// get input stream buf (NOT thread safe, call it in work thread)
+	RingBuf& get_input_buf(void) { return m_read_buf; }
+
+	/// send message(thread safe), the message sent in other thread is sent in next update
+	void send(const char* buf, size_t len);
+
+	/// close the connection after all data sent is acked by peer(NOT thread safe, call it in work thread)
+	void shutdown(void);
+
+	/// set/get param(NOT thread safe)
+	void set_param(void* param) { m_param = param; }
+	void* get_param(void) { return m_param; }
+
+	/// get the reliable channel, for rtt and statistics(NOT thread safe, call it in work thread)
+	const ReliableChannel& get_channel(void) const { return m_channel; }
+
+	///set callback function
+	void set_on_message(EventCallback callback) { m_on_message = callback; }
+	void set_on_close(EventCallback callback) { m_on_close = callback; }
+
+private:
+	int32_t m_id;
+	uint32_t m_conv;
+	std::atomic<State> m_state;
+	Address m_peer_addr;
+	Looper* m_looper;
+	UdpSocket* m_socket;
+	ReliableChannel m_channel;
+	void* m_param;
+
+	enum { kDefaultReadBufSize = 1024 };
+	//the connection is kept this time(ms) at least after closed, to ack the retransmitted close of peer
+	enum { kMinLingerTime = 1000 };
+
+	RingBuf m_read_buf;
+	bool m_has_message;
+	bool m_peer_closed;
+	uint32_t m_close_time;
+
+	RingBuf m_write_buf;	//message sent in other thread
+	mutable sys_api::spin_mutex m_write_buf_lock;
+
+	EventCallback m_on_connected;
+	EventCallback m_on_message;
+	EventCallback m_on_close;
+
+private:
+	//// input a datagram of peer
+	void _input(const uint8_t* datagram, size_t size, uint32_t now);
+
+	//// update the channel, called by the timer of owner
+	void _update(uint32_t now);
+
+	//// check the state after the channel updated
+	void _check_state(uint32_t now);
+
+	//// close the connection now without notifying peer
+	void _close(uint32_t now);
+
+	//// closed and the linger time passed, the owner can release it
+	bool _is_expired(uint32_t now) const;
+
+	//// time of the channel(milliseconds)
+	static uint32_t _now(void);
+
+	friend class ReliableUdpServer;
+	friend class ReliableUdpClient;
+
+	UdpConnection(int32_t id, uint32_t conv, UdpSocket* socket, const Address& peer_addr, const ReliableChannel::Config& config, bool active);
+
+public:
+	~UdpConnection();
+};
+
+}
@@ -0,0 +1,181 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+#include "cyn_udp_server.h"
+#include "internal/cyn_udp_server_work_thread.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+UdpServer::UdpServer()
+	: m_bind_addr(0, true)
+	, m_enable_reuse_port(true)
+	, m_socket_counts(0)
+	, m_workthread_counts(0)
+	, m_running(0)
+	, m_shutdown_ing(0)
+{
+	m_listener.on_work_thread_start = nullptr;
+	m_listener.on_work_thread_command = nullptr;
+	m_listener.on_message = nullptr;
+}
+
+//-------------------------------------------------------------------------------------
+UdpServer::~UdpServer()
+{
+	assert(m_running.load() == 0);
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpServer::bind(const Address& bind_addr, bool enable_reuse_port, const UdpSocket::Options& options)
+{
+	//is running already?
+	if (m_running > 0) return false;
+
+	m_bind_addr = bind_addr;
+	m_enable_reuse_port = enable_reuse_port;
+	m_socket_options = options;
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpServer::_create_sockets(int32_t counts, std::vector<socket_t>& sockets)
+{
+	Address bind_addr = m_bind_addr;
+	for (int32_t i = 0; i < counts; i++) {
+		socket_t sfd = socket_api::create_socket(true);
+		if (sfd == INVALID_SOCKET) break;
+
+		if (m_enable_reuse_port && !socket_api::set_reuse_port(sfd, true)) {
+			//only one socket if the system doesn't support
+			if (i > 0) {
+				socket_api::close_socket(sfd);
+				break;
+			}
+			m_enable_reuse_port = false;
+			counts = 1;
+		}
+
+		if (!socket_api::bind(sfd, bind_addr.get_sockaddr_in())) {
+			socket_api::close_socket(sfd);
+			break;
+		}
+		sockets.push_back(sfd);
+
+		//the other sockets use the port of first socket
+		if (i == 0) {
+			bind_addr = Address(false, sfd);
+		}
+	}
+
+	if ((int32_t)sockets.size() != counts) {
+		CY_LOG(L_ERROR, "UdpServer bind to %s:%d failed", m_bind_addr.get_ip(), m_bind_addr.get_port());
+		for (socket_t sfd : sockets) socket_api::close_socket(sfd);
+		sockets.clear();
+		return false;
+	}
+
+	m_bind_addr = bind_addr;
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpServer::start(int32_t work_thread_counts)
+{
+	CY_LOG(L_INFO, "UdpServer start with %d work thread(s)", work_thread_counts);
+
+	if (work_thread_counts<1 || work_thread_counts > MAX_WORK_THREAD_COUNTS) {
+		CY_LOG(L_ERROR, "param thread counts error");
+		return false;
+	}
+
+	//is running already?
+	if (m_running.exchange(1) > 0) return false;
+
+	//create and bind sockets in current thread, so the bind error is returned here
+	std::vector<socket_t> sockets;
+	if (!_create_sockets(m_enable_reuse_port ? work_thread_counts : 1, sockets)) {
+		m_running = 0;
+		return false;
+	}
+	m_socket_counts = (int32_t)sockets.size();
+	if (m_socket_counts < work_thread_counts) {
+		CY_LOG(L_INFO, "UdpServer without reuse port, only work thread 0 receives datagrams");
+	}
+
+	//start work thread pool
+	m_workthread_counts = work_thread_counts;
+	for (int32_t i = 0; i < m_workthread_counts; i++) {
+		socket_t sfd = (i < m_socket_counts) ? sockets[(size_t)i] : INVALID_SOCKET;
+		m_work_thread_pool.push_back(new UdpServerWorkThread(this, i, sfd));
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServer::stop(void)
+{
+	//not running?
+	if (m_running == 0) return;
+	//is shutdown in processing?
+	if (m_shutdown_ing.exchange(1) > 0)return;
+
+	//this function can't run in work thread
+	for (auto work : m_work_thread_pool) {
+		if (work->is_in_workthread()) {
+			CY_LOG(L_ERROR, "you can't stop server in work thread.");
+			return;
+		}
+	}
+
+	for (auto work : m_work_thread_pool) {
+		work->send_thread_message(UdpServerWorkThread::ShutdownCmd::ID, 0, nullptr);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServer::join(void)
+{
+	//wait all thread quit
+	for (auto work : m_work_thread_pool) {
+		work->join();
+		delete work;
+	}
+	m_work_thread_pool.clear();
+	m_running = 0;
+	m_shutdown_ing = 0;
+}
+
+//-------------------------------------------------------------------------------------
+UdpSocket* UdpServer::get_socket(int32_t work_thread_index)
+{
+	assert(work_thread_index >= 0 && work_thread_index < m_workthread_counts);
+
+	UdpServerWorkThread* work = m_work_thread_pool[(size_t)work_thread_index];
+	assert(work->is_in_workthread());
+	return work->get_socket();
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServer::send_work_message(int32_t work_thread_index, const Packet* message)
+{
+	assert(work_thread_index >= 0 && work_thread_index < m_workthread_counts);
+
+	UdpServerWorkThread* work = m_work_thread_pool[(size_t)work_thread_index];
+	work->send_thread_message(message);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServer::send_work_message(int32_t work_thread_index, const PacketPtr& message)
+{
+	assert(work_thread_index >= 0 && work_thread_index < m_workthread_counts);
+
+	UdpServerWorkThread* work = m_work_thread_pool[(size_t)work_thread_index];
+	work->send_thread_message(message);
+}
+
+}
@@ -0,0 +1,101 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cy_core.h>
+#include <cy_event.h>
+#include "cyn_udp_socket.h"
+
+namespace cyclone
+{
+
+//pre-define
+class UdpServerWorkThread;
+
+//UdpServer
+// ----------------
+// Every work thread runs a UdpSocket. With reuse port, all work threads have their own socket
+// bound to the same address, and the kernel fans out the datagrams by peer address(the datagrams
+// of one peer always go to the same thread). Without it, only work thread 0 has a socket.
+//
+class UdpServer : noncopyable
+{
+public:
+	typedef std::function<void(UdpServer* server, int32_t thread_index, Looper* looper)> WorkThreadStartCallback;
+	typedef std::function<void(UdpServer* server, int32_t thread_index, Packet* cmd)> WorkThreadCommandCallback;
+
+	//the datagrams are valid in the callback only, reply them with socket->send()
+	typedef std::function<void(UdpServer* server, int32_t thread_index, UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts)> MessageCallback;
+
+	enum { kCustomWorkThreadCmdID_Begin = 10 };
+
+	struct Listener {
+		WorkThreadStartCallback on_work_thread_start;
+		WorkThreadCommandCallback on_work_thread_command;
+
+		MessageCallback on_message;
+	};
+	Listener m_listener;
+
+public:
+	/// set the bind address, port 0 means any port, see get_bind_address()
+	// NOT thread safe, and this function must be called before start the server
+	bool bind(const Address& bind_addr, bool enable_reuse_port = true, const UdpSocket::Options& options = UdpSocket::Options());
+
+	/// start the server with n work threads
+	/// (thread safe, but you wouldn't want call it again...)
+	bool start(int32_t work_thread_counts);
+
+	/// wait server to terminate(thread safe)
+	void join(void);
+
+	/// stop the server, the queued datagrams are sent before the sockets closed
+	//(NOT thread safe, you can't call this function in any work thread)
+	void stop(void);
+
+	/// get bind address, it has the real port after the server started
+	Address get_bind_address(void) const { return m_bind_addr; }
+
+	/// get the socket of work thread, nullptr if the work thread has no socket
+	/// (NOT thread safe, MUST call in the work thread)
+	UdpSocket* get_socket(int32_t work_thread_index);
+
+	/// get the counts of sockets, it's the work thread counts if reuse port is enabled
+	int32_t get_socket_counts(void) const { return m_socket_counts; }
+
+	/// send work message to one of work thread(thread safe)
+	void send_work_message(int32_t work_thread_index, const Packet* message);
+	/// send a shared packet without copy, the packet MUST NOT be changed after sending(thread safe)
+	void send_work_message(int32_t work_thread_index, const PacketPtr& message);
+
+	/// get work thread counts
+	int32_t get_work_thread_counts(void) const { return m_workthread_counts; }
+
+private:
+	enum { MAX_WORK_THREAD_COUNTS = 32 };
+
+	Address m_bind_addr;
+	bool m_enable_reuse_port;
+	UdpSocket::Options m_socket_options;
+	int32_t m_socket_counts;
+
+	/// work thread pool
+	typedef std::vector< UdpServerWorkThread* > ServerWorkThreadArray;
+	ServerWorkThreadArray m_work_thread_pool;
+	int32_t m_workthread_counts;
+
+	atomic_int32_t m_running;
+	atomic_int32_t m_shutdown_ing;
+
+private:
+	// create the bound sockets of work threads
+	bool _create_sockets(int32_t counts, std::vector<socket_t>& sockets);
+
+	friend class UdpServerWorkThread;
+public:
+	UdpServer();
+	~UdpServer();
+};
+
+}
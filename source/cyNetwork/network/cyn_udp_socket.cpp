@@ -0,0 +1,358 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+#include "cyn_udp_socket.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+namespace {
+	//max payload of ipv4 udp datagram
+	const size_t kMaxDatagramSize = 65507;
+	//max segments of one GSO send(UDP_MAX_SEGMENTS of linux kernel)
+	const size_t kMaxGsoSegments = 64;
+	//read at most this rounds in one read event, so other events of looper are not starved
+	const int32_t kMaxReadRounds = 8;
+
+	inline bool _same_peer(const struct sockaddr_in& a, const struct sockaddr_in& b) {
+		return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+	}
+
+	//the device or the kernel can't send this super datagram
+	inline bool _is_gso_error(int err) {
+		return err == EIO || err == EINVAL || err == EOPNOTSUPP;
+	}
+
+	//icmp error of an earlier datagram reported by this send, the datagram itself is not sent
+	inline bool _is_pending_error(int err) {
+#ifdef CY_SYS_WINDOWS
+		return err == WSAECONNRESET || err == WSAENETRESET;
+#else
+		return err == ECONNREFUSED || err == EHOSTUNREACH || err == ENETUNREACH;
+#endif
+	}
+}
+
+//-------------------------------------------------------------------------------------
+UdpSocket::UdpSocket(Looper* looper, int32_t id)
+	: m_id(id)
+	, m_looper(looper)
+	, m_socket(INVALID_SOCKET)
+	, m_event_id(Looper::INVALID_EVENT_ID)
+	, m_on_message(nullptr)
+	, m_gro_enabled(false)
+	, m_gso_enabled(false)
+	, m_in_callback(false)
+	, m_recv_arena(nullptr)
+	, m_recv_slot_size(0)
+	, m_recv_slot_counts(0)
+	, m_send_arena(nullptr)
+	, m_send_arena_size(0)
+	, m_send_arena_used(0)
+	, m_send_head(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+//-------------------------------------------------------------------------------------
+UdpSocket::~UdpSocket()
+{
+	close();
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpSocket::open(const Address& bind_addr, bool enable_reuse_port, const Options& options)
+{
+	assert(m_socket == INVALID_SOCKET);
+
+	socket_t sfd = socket_api::create_socket(true);
+	if (sfd == INVALID_SOCKET) return false;
+
+	if (enable_reuse_port) {
+		socket_api::set_reuse_port(sfd, true);
+	}
+
+	if (!socket_api::bind(sfd, bind_addr.get_sockaddr_in())) {
+		socket_api::close_socket(sfd);
+		return false;
+	}
+	return attach(sfd, options);
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpSocket::attach(socket_t sfd, const Options& options)
+{
+	assert(m_socket == INVALID_SOCKET && sfd != INVALID_SOCKET);
+	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
+
+	m_socket = sfd;
+	m_options = options;
+	if (m_options.max_datagram_size == 0 || m_options.max_datagram_size > kMaxDatagramSize) {
+		m_options.max_datagram_size = kMaxDatagramSize;
+	}
+
+	socket_api::set_nonblock(m_socket, true);
+	socket_api::set_close_onexec(m_socket, true);
+
+	m_gro_enabled = m_options.enable_gro && socket_api::set_udp_gro(m_socket, true);
+	m_gso_enabled = m_options.enable_gso && socket_api::is_udp_gso_supported(m_socket);
+
+	//one receive slot holds a coalesced datagram if GRO is enabled
+	m_recv_slot_size = m_gro_enabled ? (size_t)kMaxGroSegmentBytes : m_options.max_datagram_size;
+	size_t slot_counts = (size_t)BufPool::kMaxBlockSize / m_recv_slot_size;
+	if (slot_counts > (size_t)socket_api::MAX_BATCH_DATAGRAMS) slot_counts = (size_t)socket_api::MAX_BATCH_DATAGRAMS;
+	if (slot_counts == 0) slot_counts = 1;
+	m_recv_slot_counts = (int32_t)slot_counts;
+	m_recv_arena = (uint8_t*)BufPool::allocate(m_recv_slot_size * slot_counts, nullptr, memory::kTagDatagram);
+
+	m_send_arena = (uint8_t*)BufPool::allocate(kSendArenaSize, &m_send_arena_size, memory::kTagDatagram);
+	m_send_arena_used = 0;
+
+	//register socket event
+	m_event_id = m_looper->register_event(m_socket,
+		Looper::kRead,
+		this,
+		std::bind(&UdpSocket::_on_socket_read, this),
+		std::bind(&UdpSocket::_on_socket_write, this)
+	);
+
+	CY_LOG(L_DEBUG, "udp socket %d open, port=%d, gro=%d, gso=%d", m_id, get_local_addr().get_port(), m_gro_enabled, m_gso_enabled);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void UdpSocket::close(void)
+{
+	if (m_socket == INVALID_SOCKET) return;
+
+	//best effort, the datagrams which can't be sent now are dropped
+	flush();
+
+	m_looper->delete_event(m_event_id);
+	m_event_id = Looper::INVALID_EVENT_ID;
+
+	socket_api::close_socket(m_socket);
+	m_socket = INVALID_SOCKET;
+
+	BufPool::deallocate(m_recv_arena);
+	m_recv_arena = nullptr;
+	BufPool::deallocate(m_send_arena);
+	m_send_arena = nullptr;
+	m_send_arena_size = m_send_arena_used = 0;
+
+	m_stats.dropped_datagrams += (int64_t)(m_send_queue.size() - m_send_head);
+	m_send_queue.clear();
+	m_send_head = 0;
+	m_received.clear();
+}
+
+//-------------------------------------------------------------------------------------
+Address UdpSocket::get_local_addr(void) const
+{
+	return Address(false, m_socket);
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpSocket::send(const void* buf, size_t len, const struct sockaddr_in& peer_addr)
+{
+	if (m_socket == INVALID_SOCKET) return false;
+	assert(sys_api::thread_get_current_id() == m_looper->get_thread_id());
+
+	if (len > m_options.max_datagram_size) {
+		m_stats.dropped_datagrams++;
+		return false;
+	}
+
+	//the arena is full, try to make room
+	if (m_send_arena_used + len > m_send_arena_size) {
+		flush();
+		if (m_send_arena_used + len > m_send_arena_size) {
+			m_stats.dropped_datagrams++;
+			return false;
+		}
+	}
+
+	SendEntry entry;
+	entry.peer_addr = peer_addr;
+	entry.offset = (uint32_t)m_send_arena_used;
+	entry.size = (uint32_t)len;
+	if (len > 0) memcpy(m_send_arena + m_send_arena_used, buf, len);
+	m_send_arena_used += len;
+	m_send_queue.push_back(entry);
+
+	//the queue is flushed when the callback returns, otherwise in next looper step
+	if (!m_in_callback) _update_write_event();
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpSocket::flush(void)
+{
+	if (m_socket == INVALID_SOCKET) return false;
+
+	socket_api::datagram_t batch[socket_api::MAX_BATCH_DATAGRAMS];
+	size_t entry_counts[socket_api::MAX_BATCH_DATAGRAMS];	//queued datagrams in one batch item
+	size_t retried_head = m_send_queue.size();	//the entry has been sent again after a pending error
+
+	while (m_send_head < m_send_queue.size()) {
+		int32_t batch_counts = 0;
+
+		size_t pos = m_send_head;
+		while (pos < m_send_queue.size() && batch_counts < (int32_t)socket_api::MAX_BATCH_DATAGRAMS) {
+			const SendEntry& first = m_send_queue[pos];
+			socket_api::datagram_t& dgram = batch[batch_counts];
+			dgram.buf = m_send_arena + first.offset;
+			dgram.len = first.size;
+			dgram.peer_addr = first.peer_addr;
+			dgram.segment_size = 0;
+			dgram.truncated = false;
+
+			//the datagrams are contiguous in arena, the following ones of same size to same peer
+			//are sent as one super datagram, the last one can be shorter
+			size_t next = pos + 1;
+			if (m_gso_enabled && first.size > 0) {
+				while (next < m_send_queue.size() && next - pos < kMaxGsoSegments) {
+					const SendEntry& entry = m_send_queue[next];
+					if (entry.size == 0 || entry.size > first.size || dgram.len + entry.size > kMaxDatagramSize || !_same_peer(entry.peer_addr, first.peer_addr)) break;
+					assert(entry.offset == first.offset + dgram.len);
+
+					dgram.len += entry.size;
+					next++;
+					if (entry.size < first.size) break;
+				}
+				if (next - pos > 1) {
+					dgram.segment_size = (uint16_t)first.size;
+				}
+			}
+			entry_counts[batch_counts++] = next - pos;
+			pos = next;
+		}
+
+		int32_t sent = socket_api::send_batch(m_socket, batch, batch_counts);
+		if (sent < 0) {
+			//only the first item is failed, the others are not tried
+			int err = socket_api::get_lasterror();
+			if (batch[0].segment_size > 0 && _is_gso_error(err)) {
+				//the device doesn't support checksum offload or the segment is bigger than mtu, send them one by one
+				CY_LOG(L_WARN, "udp socket %d send with gso failed, err=%d, disable gso", m_id, err);
+				m_gso_enabled = false;
+				continue;
+			}
+			if (_is_pending_error(err) && retried_head != m_send_head) {
+				//the error belongs to other peer, send it again
+				retried_head = m_send_head;
+				continue;
+			}
+			//drop the failed one
+			CY_LOG(L_DEBUG, "udp socket %d send failed, err=%d", m_id, err);
+			m_send_head += entry_counts[0];
+			m_stats.dropped_datagrams += (int64_t)entry_counts[0];
+			continue;
+		}
+
+		if (sent > 0) m_stats.send_calls++;
+		for (int32_t i = 0; i < sent; i++) {
+			m_send_head += entry_counts[i];
+			m_stats.send_datagrams += (int64_t)entry_counts[i];
+		}
+
+		//the send buffer is full, wait the socket writable, otherwise the next one is failed
+		//and it will be dropped in next round
+		if (sent == 0) break;
+	}
+
+	bool done = (m_send_head == m_send_queue.size());
+	if (done) {
+		m_send_queue.clear();
+		m_send_head = 0;
+		m_send_arena_used = 0;
+	}
+	_update_write_event();
+	return done;
+}
+
+//-------------------------------------------------------------------------------------
+void UdpSocket::_update_write_event(void)
+{
+	if (m_event_id == Looper::INVALID_EVENT_ID) return;
+
+	bool queued = m_send_head < m_send_queue.size();
+	if (queued != m_looper->is_write(m_event_id)) {
+		if (queued) m_looper->enable_write(m_event_id);
+		else m_looper->disable_write(m_event_id);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpSocket::_on_socket_read(void)
+{
+	socket_api::datagram_t slots[socket_api::MAX_BATCH_DATAGRAMS];
+
+	for (int32_t round = 0; round < kMaxReadRounds; round++) {
+		for (int32_t i = 0; i < m_recv_slot_counts; i++) {
+			slots[i].buf = m_recv_arena + (size_t)i * m_recv_slot_size;
+			slots[i].len = m_recv_slot_size;
+		}
+
+		int32_t counts = socket_api::recv_batch(m_socket, slots, m_recv_slot_counts);
+		if (counts <= 0) {
+			if (counts < 0) {
+				CY_LOG(L_DEBUG, "udp socket %d receive failed, err=%d", m_id, socket_api::get_lasterror());
+			}
+			break;
+		}
+		m_stats.recv_calls++;
+
+		//split the coalesced datagrams
+		m_received.clear();
+		for (int32_t i = 0; i < counts; i++) {
+			const socket_api::datagram_t& slot = slots[i];
+			if (slot.truncated || (slot.segment_size == 0 && slot.len > m_options.max_datagram_size)) {
+				m_stats.dropped_datagrams++;
+				continue;
+			}
+
+			Datagram dgram;
+			dgram.peer_addr = slot.peer_addr;
+			if (slot.segment_size == 0) {
+				dgram.data = (const uint8_t*)slot.buf;
+				dgram.size = slot.len;
+				m_received.push_back(dgram);
+				continue;
+			}
+			for (size_t off = 0; off < slot.len; off += slot.segment_size) {
+				dgram.data = (const uint8_t*)slot.buf + off;
+				dgram.size = std::min((size_t)slot.segment_size, slot.len - off);
+				m_received.push_back(dgram);
+			}
+		}
+		m_stats.recv_datagrams += (int64_t)m_received.size();
+
+		if (!m_received.empty() && m_on_message) {
+			m_in_callback = true;
+			m_on_message(this, m_received.data(), m_received.size());
+			m_in_callback = false;
+
+			//closed in callback
+			if (m_socket == INVALID_SOCKET) return;
+		}
+
+		//send the replies of this batch together
+		flush();
+
+		//all ready datagrams have been received
+		if (counts < m_recv_slot_counts) break;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpSocket::_on_socket_write(void)
+{
+	flush();
+}
+
+}
@@ -0,0 +1,133 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cy_core.h>
+#include <cy_event.h>
+#include <network/cyn_address.h>
+
+namespace cyclone
+{
+
+//UdpSocket
+// ----------------
+// Non-block udp socket on a looper, datagrams are received and sent in batches.
+//
+// - Ready datagrams are received with one recvmmsg call per batch, and passed to the
+//   callback together. The receive slots are one block of BufPool.
+// - send() copies the datagram to a send arena(one block of BufPool), the queued datagrams
+//   are sent with one sendmmsg call when the receive callback returns, when the looper
+//   reports the socket writable, or when flush() is called.
+// - If UDP GSO is supported, the queued datagrams of same size to same peer are sent as one
+//   super datagram, and the kernel splits them. If UDP GRO is supported, the kernel may
+//   coalesce the received datagrams, they are split again before passed to the callback.
+// - The socket is NOT thread safe, all functions must be called in the looper thread.
+//
+class UdpSocket : noncopyable
+{
+public:
+	struct Datagram
+	{
+		const uint8_t* data;
+		size_t size;
+		struct sockaddr_in peer_addr;
+	};
+	typedef std::function<void(UdpSocket* socket, const Datagram* datagrams, size_t counts)> MessageCallback;
+
+	enum { kDefaultMaxDatagramSize = 2048, kMaxGroSegmentBytes = 65536 };
+	enum { kSendArenaSize = 256 * 1024 };
+
+	struct Options
+	{
+		size_t max_datagram_size;	//bigger datagrams are dropped
+		bool enable_gro;
+		bool enable_gso;
+
+		Options() : max_datagram_size(kDefaultMaxDatagramSize), enable_gro(true), enable_gso(true) {}
+	};
+
+	struct Stats
+	{
+		int64_t recv_datagrams;
+		int64_t recv_calls;		//system calls which returned datagrams
+		int64_t send_datagrams;
+		int64_t send_calls;		//system calls which sent datagrams
+		int64_t dropped_datagrams;	//truncated in receiving, or the send arena is full
+	};
+
+public:
+	/// create socket and bind it to the address, port 0 means any port
+	bool open(const Address& bind_addr, bool enable_reuse_port = false, const Options& options = Options());
+
+	/// take the ownership of a bound udp socket
+	bool attach(socket_t sfd, const Options& options = Options());
+
+	/// send all queued datagrams and close the socket
+	void close(void);
+
+	/// queue a datagram, return false if it's dropped(too big, or the send arena is full)
+	bool send(const void* buf, size_t len, const struct sockaddr_in& peer_addr);
+	bool send(const void* buf, size_t len, const Address& peer_addr) { return send(buf, len, peer_addr.get_sockaddr_in()); }
+
+	/// send queued datagrams now, return false if some datagrams are still queued(the send buffer of socket is full)
+	bool flush(void);
+
+	/// set the callback of received datagrams
+	void set_on_message(MessageCallback func) { m_on_message = func; }
+
+	int32_t get_id(void) const { return m_id; }
+	socket_t get_socket(void) const { return m_socket; }
+	Looper* get_looper(void) const { return m_looper; }
+	Address get_local_addr(void) const;
+	bool is_open(void) const { return m_socket != INVALID_SOCKET; }
+	bool is_gro_enabled(void) const { return m_gro_enabled; }
+	bool is_gso_enabled(void) const { return m_gso_enabled; }
+	size_t get_queued_counts(void) const { return m_send_queue.size() - m_send_head; }
+	const Stats& get_stats(void) const { return m_stats; }
+
+private:
+	struct SendEntry
+	{
+		struct sockaddr_in peer_addr;
+		uint32_t offset;	//offset in send arena
+		uint32_t size;
+	};
+
+	int32_t m_id;
+	Looper* m_looper;
+	socket_t m_socket;
+	Looper::event_id_t m_event_id;
+	MessageCallback m_on_message;
+
+	Options m_options;
+	bool m_gro_enabled;
+	bool m_gso_enabled;
+	bool m_in_callback;
+
+	//receive slots
+	uint8_t* m_recv_arena;
+	size_t m_recv_slot_size;
+	int32_t m_recv_slot_counts;
+	std::vector<Datagram> m_received;
+
+	//send arena
+	uint8_t* m_send_arena;
+	size_t m_send_arena_size;
+	size_t m_send_arena_used;
+	std::vector<SendEntry> m_send_queue;
+	size_t m_send_head;	//first entry not sent
+
+	Stats m_stats;
+
+private:
+	void _on_socket_read(void);
+	void _on_socket_write(void);
+	void _update_write_event(void);
+
+public:
+	UdpSocket(Looper* looper, int32_t id = 0);
+	~UdpSocket();
+};
+
+}
@@ -10,6 +10,7 @@ namespace cyclone
 //-------------------------------------------------------------------------------------
 TcpServerMasterThread::TcpServerMasterThread(TcpServer* server)
 	: m_server(server)
+	, m_reclaim_timer_id(Looper::INVALID_EVENT_ID)
 {
 	assert(m_server);
 }
@@ -138,6 +139,11 @@ bool TcpServerMasterThread::_on_thread_start(void)
 
 	CY_LOG(L_DEBUG, "tcp master thread run, listen %d port(s)", counts);
 
+	m_reclaim_timer_id = m_master_thread.get_looper()->register_timer_event(kReclaimIntervalMs, nullptr,
+		[](Looper::event_id_t, void*) {
+		rcu::reclaim();
+	});
+
 	if (m_server->m_listener.on_master_thread_start)
 	{
 		m_server->m_listener.on_master_thread_start(m_server, m_master_thread.get_looper());
@@ -171,6 +177,11 @@ void TcpServerMasterThread::_on_thread_message(Packet* message)
 		}
 		m_acceptor_sockets.clear();
 
+		if (m_reclaim_timer_id != Looper::INVALID_EVENT_ID) {
+			looper->delete_event(m_reclaim_timer_id);
+			m_reclaim_timer_id = Looper::INVALID_EVENT_ID;
+		}
+
 		//stop looper
 		looper->push_stop_request();
 	}
@@ -19,6 +19,10 @@ public:
 		kCustomCmdID_Begin = TcpServer::kCustomMasterThreadCmdID_Begin,
 	};
 
+	//period to release the connections retired by directory, an idle server may not retire
+	//enough objects to trigger the reclamation in rcu::retire()
+	enum { kReclaimIntervalMs = 1000 };
+
 	struct ShutdownCmd
 	{
 		enum { ID = kShutdownCmdID };
@@ -56,6 +60,7 @@ private:
 
 	typedef std::vector< std::tuple<socket_t, Looper::event_id_t> > SocketVector;
 	SocketVector m_acceptor_sockets;
+	Looper::event_id_t m_reclaim_timer_id;
 
 private:
 	/// master thread function start
@@ -12,6 +12,7 @@ namespace cyclone
 TcpServerWorkThread::TcpServerWorkThread(TcpServer* server, int32_t index)
 	: m_server(server)
 	, m_index(index)
+	, m_shrink_timer_id(Looper::INVALID_EVENT_ID)
 {
 	//run work thread
 	m_work_thread = new WorkThread();
@@ -51,6 +52,20 @@ void TcpServerWorkThread::send_thread_message(const Packet** message, int32_t co
 	m_work_thread->send_message(message, counts);
 }
 
+//-------------------------------------------------------------------------------------
+void TcpServerWorkThread::send_thread_message(const PacketPtr& message)
+{
+	assert(m_work_thread);
+	m_work_thread->send_message(message);
+}
+
+//-------------------------------------------------------------------------------------
+bool TcpServerWorkThread::post_thread_message(Packet* message)
+{
+	assert(m_work_thread);
+	return m_work_thread->post_message(message);
+}
+
 //-------------------------------------------------------------------------------------
 bool TcpServerWorkThread::is_in_workthread(void) const
 {
@@ -58,7 +73,7 @@ bool TcpServerWorkThread::is_in_workthread(void) const
 }
 
 //-------------------------------------------------------------------------------------
-TcpConnectionPtr TcpServerWorkThread::get_connection(int32_t connection_id)
+TcpConnectionLocalPtr TcpServerWorkThread::get_connection(int32_t connection_id)
 {
 	assert(is_in_workthread());
 
@@ -72,12 +87,38 @@ bool TcpServerWorkThread::_on_workthread_start(void)
 {
 	CY_LOG(L_INFO, "Tcp work thread %d start...", m_index);
 
+	m_shrink_timer_id = m_work_thread->get_looper()->register_timer_event(kShrinkCheckIntervalMs, nullptr,
+		[this](Looper::event_id_t, void*) {
+		_on_shrink_timer();
+	});
+
 	if (m_server->m_listener.on_work_thread_start) {
 		m_server->m_listener.on_work_thread_start(m_server, get_index(), m_work_thread->get_looper());
 	}
 	return true;
 }
 
+//-------------------------------------------------------------------------------------
+void TcpServerWorkThread::_on_shrink_timer(void)
+{
+	for (auto& it : m_connections) {
+		if (it.second->get_state() != TcpConnection::kDisconnected) it.second->shrink_idle_buffers();
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void TcpServerWorkThread::_quit_loop(void)
+{
+	Looper* looper = m_work_thread->get_looper();
+	if (m_shrink_timer_id != Looper::INVALID_EVENT_ID) {
+		looper->delete_event(m_shrink_timer_id);
+		m_shrink_timer_id = Looper::INVALID_EVENT_ID;
+	}
+
+	//push loop quit command
+	looper->push_stop_request();
+}
+
 //-------------------------------------------------------------------------------------
 void TcpServerWorkThread::_on_workthread_message(Packet* message)
 {
@@ -93,16 +134,22 @@ void TcpServerWorkThread::_on_workthread_message(Packet* message)
 		memcpy(&newConnectionCmd, message->get_packet_content(), sizeof(NewConnectionCmd));
 
 		//create tcp connection 
-		TcpConnectionPtr conn = std::make_shared<TcpConnection>(m_server->get_next_connection_id(), newConnectionCmd.sfd, m_work_thread->get_looper(), this);
-		CY_LOG(L_DEBUG, "receive new connection, id=%d, peer_addr=%s:%d", conn->get_id(), conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port());
+		TcpConnectionLocalPtr conn(new TcpConnection(m_server->get_next_connection_id(), newConnectionCmd.sfd, m_work_thread->get_looper(), this, m_server->is_compact_connection()));
+		if (conn->is_compact()) {
+			//don't create address just for log
+			CY_LOG(L_DEBUG, "receive new connection, id=%d", conn->get_id());
+		}
+		else {
+			CY_LOG(L_DEBUG, "receive new connection, id=%d, peer_addr=%s:%d", conn->get_id(), conn->get_peer_addr().get_ip(), conn->get_peer_addr().get_port());
+		}
 
 		//bind onMessage function
-		conn->set_on_message([this](TcpConnectionPtr connection) {
+		conn->set_on_message([this](const TcpConnectionLocalPtr& connection) {
 			m_server->_on_socket_message(this->get_index(), connection);
 		});
 
 		//bind onClose function
-		conn->set_on_close([this](TcpConnectionPtr connection) {
+		conn->set_on_close([this](const TcpConnectionLocalPtr& connection) {
 			m_server->_on_socket_close(this->get_index(), connection);
 		});
 
@@ -110,6 +157,7 @@ void TcpServerWorkThread::_on_workthread_message(Packet* message)
 		m_server->_on_socket_connected(get_index(), conn);
 		
 		m_connections.insert(std::make_pair(conn->get_id(), conn));
+		m_server->m_connection_directory.insert(conn->get_id(), TcpConnectionPtr(conn));
 	}
 	else if (msg_id == CloseConnectionCmd::ID)
 	{
@@ -120,7 +168,7 @@ void TcpServerWorkThread::_on_workthread_message(Packet* message)
 		ConnectionMap::iterator it = m_connections.find(closeConnectionCmd.conn_id);
 		if (it == m_connections.end()) return;
 
-		TcpConnectionPtr conn = it->second;
+		TcpConnectionLocalPtr conn = it->second;
 		TcpConnection::State curr_state = conn->get_state();
 
 		CY_LOG(L_DEBUG, "receive close connection cmd, id=%d, state=%d", conn->get_id(), conn->get_state());
@@ -142,8 +190,7 @@ void TcpServerWorkThread::_on_workthread_message(Packet* message)
 
 		//if all connection is shutdown, and server is in shutdown process, quit the loop
 		if (m_connections.empty() && closeConnectionCmd.shutdown_ing > 0) {
-			//push loop quit command
-			m_work_thread->get_looper()->push_stop_request();
+			_quit_loop();
 			return;
 		}
 	}
@@ -152,8 +199,7 @@ void TcpServerWorkThread::_on_workthread_message(Packet* message)
 		CY_LOG(L_DEBUG, "receive shutdown cmd");
 		//all connection is disconnect, just quit the loop
 		if (m_connections.empty()) {
-			//push loop request command
-			m_work_thread->get_looper()->push_stop_request();
+			_quit_loop();
 			return;
 		}
 
@@ -161,7 +207,7 @@ void TcpServerWorkThread::_on_workthread_message(Packet* message)
 		ConnectionMap::iterator it, end = m_connections.end();
 		for (it = m_connections.begin(); it != end; ++it)
 		{
-			TcpConnectionPtr conn = it->second;
+			const TcpConnectionLocalPtr& conn = it->second;
 			if (conn->get_state() == TcpConnection::kConnected)
 			{
 				conn->shutdown();
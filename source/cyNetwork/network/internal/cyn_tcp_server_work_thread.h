@@ -12,6 +12,10 @@ class TcpServerWorkThread : noncopyable, public TcpConnection::Owner
 {
 public:
 	enum { kNewConnectionCmdID = 1, kCloseConnectionCmdID, kShutdownCmdID };
+
+	//period to check the buffers of connections, a drained buffer is never consumed again
+	//to trigger the shrink policy of RingBuf
+	enum { kShrinkCheckIntervalMs = 1000 };
 	struct NewConnectionCmd
 	{
 		enum { ID = kNewConnectionCmdID };
@@ -35,6 +39,11 @@ public: //call by TcpServer Only
 	void send_thread_message(uint16_t id, uint16_t size, const char* message);
 	void send_thread_message(const Packet* message);
 	void send_thread_message(const Packet** message, int32_t counts);
+	void send_thread_message(const PacketPtr& message);
+	//// post a packet without copy, the work thread takes the ownership (thread safe)
+	bool post_thread_message(Packet* message);
+	//// get the statistics of work thread mailbox (thread safe)
+	WorkThread::MailboxStats get_mailbox_stats(void) const { return m_work_thread->get_mailbox_stats(); }
 
 	//// get work thread index in work thread pool (thread safe)
 	int32_t get_index(void) const { return m_index; }
@@ -43,7 +52,7 @@ public: //call by TcpServer Only
 	//// join work thread(thread safe)
 	void join(void);
 	//// get connection(NOT thread safe, MUST call in work thread)
-	TcpConnectionPtr get_connection(int32_t connection_id);
+	TcpConnectionLocalPtr get_connection(int32_t connection_id);
 	/// Connection Owner type
 	virtual OWNER_TYPE get_connection_owner_type(void) const override { return kServer; }
 
@@ -52,13 +61,17 @@ private:
 	const int32_t	m_index;
 	WorkThread*		m_work_thread;
 
-	typedef std::unordered_map< int32_t, TcpConnectionPtr > ConnectionMap;
+	//hold local reference of all connections, so the handles passed to callbacks never touch the atomic counter
+	typedef std::unordered_map< int32_t, TcpConnectionLocalPtr > ConnectionMap;
 	ConnectionMap	m_connections;
+	Looper::event_id_t m_shrink_timer_id;
 
 private:
 	//// called by work thread
 	bool _on_workthread_start(void);
 	void _on_workthread_message(Packet*);
+	void _on_shrink_timer(void);
+	void _quit_loop(void);
 
 public:
 	TcpServerWorkThread(TcpServer* server, int32_t index);
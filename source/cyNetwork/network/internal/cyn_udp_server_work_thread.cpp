@@ -0,0 +1,124 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+
+#include <cy_network.h>
+#include "cyn_udp_server_work_thread.h"
+
+namespace cyclone
+{
+
+//-------------------------------------------------------------------------------------
+UdpServerWorkThread::UdpServerWorkThread(UdpServer* server, int32_t index, socket_t sfd)
+	: m_server(server)
+	, m_index(index)
+	, m_sfd(sfd)
+	, m_socket(nullptr)
+{
+	//run work thread
+	m_work_thread = new WorkThread();
+	m_work_thread->set_on_start(std::bind(&UdpServerWorkThread::_on_workthread_start, this));
+	m_work_thread->set_on_message(std::bind(&UdpServerWorkThread::_on_workthread_message, this, std::placeholders::_1));
+
+	char temp[MAX_PATH] = { 0 };
+	std::snprintf(temp, MAX_PATH, "udp_work_%d", m_index);
+	m_work_thread->start(temp);
+}
+
+//-------------------------------------------------------------------------------------
+UdpServerWorkThread::~UdpServerWorkThread()
+{
+	delete m_work_thread;
+
+	//the socket is closed in work thread normally
+	if (m_socket) {
+		delete m_socket;
+		m_socket = nullptr;
+	}
+	else if (m_sfd != INVALID_SOCKET) {
+		socket_api::close_socket(m_sfd);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServerWorkThread::send_thread_message(uint16_t id, uint16_t size, const char* message)
+{
+	assert(m_work_thread);
+	m_work_thread->send_message(id, size, message);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServerWorkThread::send_thread_message(const Packet* message)
+{
+	assert(m_work_thread);
+	m_work_thread->send_message(message);
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServerWorkThread::send_thread_message(const PacketPtr& message)
+{
+	assert(m_work_thread);
+	m_work_thread->send_message(message);
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpServerWorkThread::is_in_workthread(void) const
+{
+	return sys_api::thread_get_current_id() == m_work_thread->get_looper()->get_thread_id();
+}
+
+//-------------------------------------------------------------------------------------
+bool UdpServerWorkThread::_on_workthread_start(void)
+{
+	CY_LOG(L_INFO, "Udp work thread %d start...", m_index);
+
+	if (m_sfd != INVALID_SOCKET) {
+		m_socket = new UdpSocket(m_work_thread->get_looper(), m_index);
+		m_socket->set_on_message([this](UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts) {
+			if (m_server->m_listener.on_message) {
+				m_server->m_listener.on_message(m_server, m_index, socket, datagrams, counts);
+			}
+		});
+		m_socket->attach(m_sfd, m_server->m_socket_options);
+		m_sfd = INVALID_SOCKET;
+	}
+
+	if (m_server->m_listener.on_work_thread_start) {
+		m_server->m_listener.on_work_thread_start(m_server, m_index, m_work_thread->get_looper());
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServerWorkThread::_on_workthread_message(Packet* message)
+{
+	assert(is_in_workthread());
+	assert(message);
+
+	uint16_t msg_id = message->get_packet_id();
+	if (msg_id == ShutdownCmd::ID)
+	{
+		CY_LOG(L_DEBUG, "receive shutdown cmd");
+		if (m_socket) {
+			m_socket->close();
+			delete m_socket;
+			m_socket = nullptr;
+		}
+		m_work_thread->get_looper()->push_stop_request();
+	}
+	else
+	{
+		//extra message
+		if (m_server->m_listener.on_work_thread_command) {
+			m_server->m_listener.on_work_thread_command(m_server, m_index, message);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void UdpServerWorkThread::join(void)
+{
+	m_work_thread->join();
+}
+
+}
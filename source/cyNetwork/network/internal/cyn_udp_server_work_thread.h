@@ -0,0 +1,53 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include "../cyn_udp_socket.h"
+
+namespace cyclone
+{
+
+class UdpServerWorkThread : noncopyable
+{
+public:
+	enum { kShutdownCmdID = 1 };
+
+	struct ShutdownCmd
+	{
+		enum { ID = kShutdownCmdID };
+	};
+
+public: //call by UdpServer Only
+	//// send message to this work thread (thread safe)
+	void send_thread_message(uint16_t id, uint16_t size, const char* message);
+	void send_thread_message(const Packet* message);
+	void send_thread_message(const PacketPtr& message);
+
+	//// get work thread index in work thread pool (thread safe)
+	int32_t get_index(void) const { return m_index; }
+	//// is current thread in work thread (thread safe)
+	bool is_in_workthread(void) const;
+	//// join work thread(thread safe)
+	void join(void);
+	//// get the socket of this thread, nullptr if no socket(NOT thread safe, MUST call in work thread)
+	UdpSocket* get_socket(void) { return m_socket; }
+
+private:
+	UdpServer*		m_server;
+	const int32_t	m_index;
+	WorkThread*		m_work_thread;
+	socket_t		m_sfd;
+	UdpSocket*		m_socket;
+
+private:
+	//// called by work thread
+	bool _on_workthread_start(void);
+	void _on_workthread_message(Packet*);
+
+public:
+	UdpServerWorkThread(UdpServer* server, int32_t index, socket_t sfd);
+	~UdpServerWorkThread();
+};
+
+}
@@ -0,0 +1,203 @@
+﻿/*
+Copyright(C) thecodeway.com
+*/
+#pragma once
+
+#include <cyclone_config.h>
+#include <cy_core.h>
+
+#include <cmath>
+
+namespace cyclone
+{
+
+// Histogram:
+// Log-linear histogram(like HdrHistogram) of non-negative integer values, such as latency 
+// in microseconds or nanoseconds.
+//
+// - The values less than 2^PRECISION_BITS are counted exactly, the bigger values are counted
+//   in buckets whose width is 1/2^PRECISION_BITS of the value(relative error).
+// - The values not less than 2^MAX_VALUE_BITS are counted in the last bucket.
+// - record() is lock-free(relaxed atomic add), it's better to keep one instance per thread
+//   in hot path, and merge them when query.
+// - snapshot() moves the counts into another instance and resets this one, it is used to
+//   get the statistics of an interval.
+//
+template<int32_t PRECISION_BITS = 5, int32_t MAX_VALUE_BITS = 40>
+class Histogram : noncopyable
+{
+public:
+	static_assert(PRECISION_BITS >= 1 && PRECISION_BITS <= 16, "precision bits error");
+	static_assert(MAX_VALUE_BITS > PRECISION_BITS && MAX_VALUE_BITS <= 63, "max value bits error");
+
+	enum { kSubBucketCounts = 1 << PRECISION_BITS };
+	enum { kBucketCounts = (MAX_VALUE_BITS - PRECISION_BITS + 1) * kSubBucketCounts };
+
+	/// record one value(thread safe)
+	void record(int64_t value, uint64_t counts = 1)
+	{
+		if (value < 0) value = 0;
+		m_counts[_get_index((uint64_t)value)].fetch_add(counts, std::memory_order_relaxed);
+		m_total.fetch_add(counts, std::memory_order_relaxed);
+		m_sum.fetch_add(value * (int64_t)counts, std::memory_order_relaxed);
+
+		int64_t min_value = m_min.load(std::memory_order_relaxed);
+		while (value < min_value && !m_min.compare_exchange_weak(min_value, value, std::memory_order_relaxed));
+		int64_t max_value = m_max.load(std::memory_order_relaxed);
+		while (value > max_value && !m_max.compare_exchange_weak(max_value, value, std::memory_order_relaxed));
+	}
+
+	/// add all counts of other histogram to this one(thread safe)
+	void merge(const Histogram& other)
+	{
+		for (int32_t i = 0; i < kBucketCounts; i++) {
+			uint64_t counts = other.m_counts[i].load(std::memory_order_relaxed);
+			if (counts > 0) m_counts[i].fetch_add(counts, std::memory_order_relaxed);
+		}
+		_merge_summary(other.m_total.load(std::memory_order_relaxed), other.m_sum.load(std::memory_order_relaxed),
+			other.m_min.load(std::memory_order_relaxed), other.m_max.load(std::memory_order_relaxed));
+	}
+
+	/// move the counts to `interval`(add to it) and reset this one, the values recorded
+	/// by other threads during snapshot are kept in one of them
+	void snapshot(Histogram& interval)
+	{
+		uint64_t total = 0;
+		for (int32_t i = 0; i < kBucketCounts; i++) {
+			uint64_t counts = m_counts[i].exchange(0, std::memory_order_relaxed);
+			if (counts > 0) {
+				interval.m_counts[i].fetch_add(counts, std::memory_order_relaxed);
+				total += counts;
+			}
+		}
+		m_total.fetch_sub(total, std::memory_order_relaxed);
+		int64_t sum = m_sum.exchange(0, std::memory_order_relaxed);
+		int64_t min_value = m_min.exchange(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+		int64_t max_value = m_max.exchange(0, std::memory_order_relaxed);
+		interval._merge_summary(total, sum, min_value, max_value);
+	}
+
+	/// reset all counts(NOT thread safe)
+	void reset(void)
+	{
+		for (int32_t i = 0; i < kBucketCounts; i++) m_counts[i].store(0, std::memory_order_relaxed);
+		m_total = 0;
+		m_sum = 0;
+		m_min = std::numeric_limits<int64_t>::max();
+		m_max = 0;
+	}
+
+	uint64_t total_counts(void) const { return m_total.load(std::memory_order_relaxed); }
+	int64_t min(void) const { return total_counts() > 0 ? m_min.load(std::memory_order_relaxed) : 0; }
+	int64_t max(void) const { return m_max.load(std::memory_order_relaxed); }
+	double mean(void) const {
+		uint64_t total = total_counts();
+		return total > 0 ? (double)m_sum.load(std::memory_order_relaxed) / (double)total : 0.0;
+	}
+
+	/// get the value at percentile(0.0~100.0), the result is the highest value which is
+	/// equivalent to the bucket(no more than max value)
+	int64_t value_at_percentile(double percentile) const
+	{
+		uint64_t total = 0;
+		for (int32_t i = 0; i < kBucketCounts; i++) total += m_counts[i].load(std::memory_order_relaxed);
+		if (total == 0) return 0;
+
+		if (percentile < 0.0) percentile = 0.0;
+		if (percentile > 100.0) percentile = 100.0;
+		uint64_t target = (uint64_t)std::ceil(percentile / 100.0 * (double)total);
+		if (target == 0) target = 1;
+
+		uint64_t counts = 0;
+		for (int32_t i = 0; i < kBucketCounts; i++) {
+			counts += m_counts[i].load(std::memory_order_relaxed);
+			if (counts >= target) {
+				//the last bucket holds all overflow values
+				int64_t max_value = max();
+				if (i == kBucketCounts - 1) return max_value;
+				int64_t value = (int64_t)_get_highest_value(i);
+				return (max_value > 0 && value > max_value) ? max_value : value;
+			}
+		}
+		return max();
+	}
+
+	/// "counts=100 min=1 mean=2.5 p50=2 p90=4 p99=8 p999=9 max=10"
+	std::string summary(void) const
+	{
+		char temp[256];
+		std::snprintf(temp, sizeof(temp), "counts=%" PRIu64 " min=%" PRId64 " mean=%.1f p50=%" PRId64 " p90=%" PRId64 " p99=%" PRId64 " p999=%" PRId64 " max=%" PRId64,
+			total_counts(), min(), mean(), value_at_percentile(50.0), value_at_percentile(90.0), value_at_percentile(99.0), value_at_percentile(99.9), max());
+		return temp;
+	}
+
+	/// the lowest and highest value which are counted in the same bucket of `value`
+	static uint64_t lowest_equivalent_value(uint64_t value) { return _get_lowest_value(_get_index(value)); }
+	static uint64_t highest_equivalent_value(uint64_t value) { return _get_highest_value(_get_index(value)); }
+
+public:
+	Histogram() : m_total(0), m_sum(0), m_min(std::numeric_limits<int64_t>::max()), m_max(0)
+	{
+		for (int32_t i = 0; i < kBucketCounts; i++) m_counts[i] = 0;
+	}
+
+private:
+	std::atomic<uint64_t> m_counts[kBucketCounts];
+	std::atomic<uint64_t> m_total;
+	std::atomic<int64_t> m_sum;
+	std::atomic<int64_t> m_min;
+	std::atomic<int64_t> m_max;
+
+private:
+	static int32_t _get_msb(uint64_t value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return 63 - __builtin_clzll(value);
+#else
+		int32_t msb = 0;
+		while (value >>= 1) msb++;
+		return msb;
+#endif
+	}
+
+	static int32_t _get_index(uint64_t value)
+	{
+		if (value < (uint64_t)kSubBucketCounts) return (int32_t)value;
+		int32_t msb = _get_msb(value);
+		if (msb >= MAX_VALUE_BITS) return kBucketCounts - 1;
+
+		int32_t shift = msb - PRECISION_BITS;
+		return (shift + 1) * kSubBucketCounts + (int32_t)((value >> shift) - (uint64_t)kSubBucketCounts);
+	}
+
+	static uint64_t _get_lowest_value(int32_t index)
+	{
+		if (index < kSubBucketCounts) return (uint64_t)index;
+		int32_t shift = index / kSubBucketCounts - 1;
+		return ((uint64_t)kSubBucketCounts + (uint64_t)(index % kSubBucketCounts)) << shift;
+	}
+
+	static uint64_t _get_highest_value(int32_t index)
+	{
+		if (index < kSubBucketCounts) return (uint64_t)index;
+		int32_t shift = index / kSubBucketCounts - 1;
+		return _get_lowest_value(index) + ((uint64_t)1 << shift) - 1;
+	}
+
+	void _merge_summary(uint64_t total, int64_t sum, int64_t min_value, int64_t max_value)
+	{
+		if (total == 0) return;
+		m_total.fetch_add(total, std::memory_order_relaxed);
+		m_sum.fetch_add(sum, std::memory_order_relaxed);
+
+		int64_t current = m_min.load(std::memory_order_relaxed);
+		while (min_value < current && !m_min.compare_exchange_weak(current, min_value, std::memory_order_relaxed));
+		current = m_max.load(std::memory_order_relaxed);
+		while (max_value > current && !m_max.compare_exchange_weak(current, max_value, std::memory_order_relaxed));
+	}
+};
+
+//latency histogram in microseconds, 3% precision, max value is about 12 days
+typedef Histogram<5, 40> LatencyHistogram;
+
+}
@@ -72,7 +72,7 @@ struct PeriodValue
 public:
 	void push(const T& value, int64_t cur_performance_time=0)
 	{
-		sys_api::auto_mutex lock(m_lock);
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 
 		if (cur_performance_time == 0) {
 			cur_performance_time = sys_api::performance_time_now() / 1000ll;
@@ -96,7 +96,7 @@ public:
 
 	std::pair<T, int32_t> sum_and_counts(int64_t cur_performance_time = 0) const
 	{
-		sys_api::auto_mutex lock(m_lock);
+		sys_api::auto_lock<sys_api::spin_mutex> lock(m_lock);
 
 		if (cur_performance_time == 0) {
 			cur_performance_time = sys_api::performance_time_now() / 1000ll;
@@ -124,14 +124,11 @@ public:
 	PeriodValue(int32_t time_period_ms=1000) 
 		: m_time_period(time_period_ms)
 		, m_valueQueue(0) //not fixed size
-		, m_lock(nullptr)
 	{
-		m_lock = sys_api::mutex_create();
 	}
 
 	~PeriodValue()
 	{
-		sys_api::mutex_destroy(m_lock);
 	}
 
 private:
@@ -170,7 +167,152 @@ public:
 private:
 	int32_t m_time_period; //millisecond
 	mutable ValueQueue m_valueQueue;
-	sys_api::mutex_t m_lock;
+	mutable sys_api::spin_mutex m_lock;
+};
+
+// WindowValue:
+// Sum and counts of a variable in a sliding time window(in millisecond), with fixed memory.
+// The window is split into buckets, push() is O(1) and lock-free, the query is O(buckets).
+// The window slides bucket by bucket, the result covers the full buckets in window and the
+// current bucket. A value may be counted into a newer bucket if the writer thread is
+// preempted while another thread recycles the bucket, single writer is always exact.
+class WindowValue : noncopyable
+{
+public:
+	void push(int64_t value, int64_t cur_performance_time = 0)
+	{
+		if (cur_performance_time == 0) {
+			cur_performance_time = sys_api::performance_time_now() / 1000ll;
+		}
+
+		int64_t epoch = cur_performance_time / m_bucket_time;
+		Bucket& bucket = m_buckets[epoch % m_bucket_counts];
+
+		//recycle the expired bucket, the other threads wait until it's done
+		int64_t bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+		while (bucket_epoch != epoch) {
+			if (bucket_epoch == kRecycling) {
+				sys_api::thread_yield();
+				bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+				continue;
+			}
+			if (bucket_epoch > epoch) return;	//too old
+
+			if (bucket.epoch.compare_exchange_weak(bucket_epoch, kRecycling, std::memory_order_acquire)) {
+				bucket.sum.store(0, std::memory_order_relaxed);
+				bucket.counts.store(0, std::memory_order_relaxed);
+				bucket.epoch.store(epoch, std::memory_order_release);
+				break;
+			}
+		}
+
+		bucket.sum.fetch_add(value, std::memory_order_relaxed);
+		bucket.counts.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::pair<int64_t, int32_t> sum_and_counts(int64_t cur_performance_time = 0) const
+	{
+		if (cur_performance_time == 0) {
+			cur_performance_time = sys_api::performance_time_now() / 1000ll;
+		}
+
+		int64_t epoch = cur_performance_time / m_bucket_time;
+		int64_t sum = 0;
+		int32_t counts = 0;
+		for (int32_t i = 0; i < m_bucket_counts; i++) {
+			const Bucket& bucket = m_buckets[i];
+			int64_t bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+			if (bucket_epoch > epoch - m_bucket_counts && bucket_epoch <= epoch) {
+				sum += bucket.sum.load(std::memory_order_relaxed);
+				counts += bucket.counts.load(std::memory_order_relaxed);
+			}
+		}
+		return std::make_pair(sum, counts);
+	}
+
+	/// sum of values per second in the window
+	double rate(int64_t cur_performance_time = 0) const
+	{
+		if (cur_performance_time == 0) {
+			cur_performance_time = sys_api::performance_time_now() / 1000ll;
+		}
+
+		//the time covered by window, the current bucket is not full
+		int64_t covered = (int64_t)(m_bucket_counts - 1) * m_bucket_time + cur_performance_time % m_bucket_time + 1;
+		return (double)sum_and_counts(cur_performance_time).first * 1000.0 / (double)covered;
+	}
+
+	/// exponentially weighted moving average of the rate(per second) of the buckets in window,
+	/// the newer bucket has the bigger weight, `alpha` is the weight of the newest full bucket
+	double ewma_rate(double alpha = 0.3, int64_t cur_performance_time = 0) const
+	{
+		if (cur_performance_time == 0) {
+			cur_performance_time = sys_api::performance_time_now() / 1000ll;
+		}
+
+		//from the oldest full bucket to the newest full bucket
+		int64_t epoch = cur_performance_time / m_bucket_time;
+		double ewma = 0.0;
+		bool first = true;
+		for (int64_t e = epoch - m_bucket_counts + 1; e < epoch; e++) {
+			int64_t sum = 0;
+			if (e >= 0) {
+				const Bucket& bucket = m_buckets[e % m_bucket_counts];
+				if (bucket.epoch.load(std::memory_order_acquire) == e) sum = bucket.sum.load(std::memory_order_relaxed);
+			}
+			double bucket_rate = (double)sum * 1000.0 / (double)m_bucket_time;
+
+			ewma = first ? bucket_rate : (alpha * bucket_rate + (1.0 - alpha) * ewma);
+			first = false;
+		}
+		return ewma;
+	}
+
+	int32_t get_time_period(void) const {
+		return m_bucket_time * m_bucket_counts;
+	}
+
+	int32_t get_bucket_time(void) const {
+		return m_bucket_time;
+	}
+
+	/// memory of the object and its buckets, in bytes
+	size_t get_memory_usage(void) const {
+		return sizeof(WindowValue) + sizeof(Bucket) * (size_t)m_bucket_counts;
+	}
+
+public:
+	/// the window is split into `bucket_counts` buckets
+	WindowValue(int32_t time_period_ms = 1000, int32_t bucket_counts = 10)
+	{
+		if (bucket_counts < 2) bucket_counts = 2;
+		m_bucket_time = time_period_ms / bucket_counts;
+		if (m_bucket_time < 1) m_bucket_time = 1;
+		m_bucket_counts = bucket_counts;
+
+		m_buckets = new Bucket[(size_t)m_bucket_counts];
+	}
+
+	~WindowValue()
+	{
+		delete[] m_buckets;
+	}
+
+private:
+	enum { kRecycling = -2 };
+
+	struct Bucket
+	{
+		std::atomic<int64_t> epoch;		//time / bucket_time, -1: not used
+		std::atomic<int64_t> sum;
+		std::atomic<int32_t> counts;
+
+		Bucket() : epoch(-1), sum(0), counts(0) {}
+	};
+
+	int32_t m_bucket_time;	//millisecond
+	int32_t m_bucket_counts;
+	Bucket* m_buckets;
 };
 
 }
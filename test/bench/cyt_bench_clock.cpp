@@ -0,0 +1,71 @@
+#include <cy_core.h>
+#include <cy_event.h>
+
+#include <chrono>
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+const int32_t LOOP_COUNTS = 10000000;
+
+//-------------------------------------------------------------------------------------
+// call the time function LOOP_COUNTS times, return nanoseconds per call
+template<typename FUNC>
+double bench_clock(FUNC func)
+{
+	int64_t sum = 0;
+	auto begin = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < LOOP_COUNTS; i++) {
+		sum += func();
+	}
+	auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+	//keep the result
+	if (sum == 42) printf(" ");
+	return (double)cost / (double)LOOP_COUNTS;
+}
+
+//-------------------------------------------------------------------------------------
+void print_result(const char* name, double ns_per_call)
+{
+	printf("%-28s %8.2f ns/call\n", name, ns_per_call);
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	//wait the calibration of TSC
+	sys_api::fast_now_ns();
+	sys_api::thread_sleep(100);
+	sys_api::fast_now_ns();
+	printf("fast_now_ns use %s\n", sys_api::fast_now_is_tsc() ? "TSC" : "system clock");
+
+	Looper* looper = Looper::create_looper();
+
+	print_result("fast_now_ns", bench_clock([]() { return sys_api::fast_now_ns(); }));
+	print_result("performance_time_now", bench_clock([]() { return sys_api::performance_time_now(); }));
+	print_result("utc_time_now", bench_clock([]() { return sys_api::utc_time_now(); }));
+#ifndef CY_SYS_WINDOWS
+	print_result("clock_gettime(MONOTONIC)", bench_clock([]() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (int64_t)ts.tv_nsec;
+	}));
+#endif
+	print_result("std::chrono::steady_clock", bench_clock([]() {
+		return (int64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	}));
+	//read the looper pointer every time, otherwise the loop is optimized away
+	Looper* volatile looper_ref = looper;
+	print_result("Looper::get_cached_time", bench_clock([&looper_ref]() { return looper_ref->get_cached_time(); }));
+
+	Looper::destroy_looper(looper);
+	return 0;
+}
@@ -0,0 +1,495 @@
+#include <cy_core.h>
+#include <cy_crypt.h>
+#include <utility/cyu_simple_opt.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+enum { OPT_JSON, OPT_FILTER, OPT_TOTAL_MB, OPT_GHZ, OPT_HELP };
+
+CSimpleOptA::SOption g_rgOptions[] = {
+	{ OPT_JSON, "-j",     SO_REQ_SEP },	// "-j JSON_FILE"
+	{ OPT_FILTER, "-f",   SO_REQ_SEP },	// "-f PRIMITIVE"
+	{ OPT_TOTAL_MB, "-m", SO_REQ_SEP },	// "-m TOTAL_MB"
+	{ OPT_GHZ, "-g",      SO_REQ_SEP },	// "-g CPU_GHZ"
+	{ OPT_HELP, "-?",     SO_NONE },	// "-?"
+	{ OPT_HELP, "--help", SO_NONE },	// "--help"
+	SO_END_OF_OPTIONS
+};
+
+//-------------------------------------------------------------------------------------
+const size_t BUF_SIZES[] = { 64, 1024, 16384, 1024 * 1024 };
+const size_t MAX_BUF_SIZE = 1024 * 1024;
+
+size_t g_total_bytes = 256 * 1024 * 1024;
+std::string g_filter;
+double g_cpu_ghz = 0.0;
+FILE* g_report = stdout;	//human readable report
+
+//-------------------------------------------------------------------------------------
+// one line of the report, throughput results have buffer size, rate results(DH) don't
+struct BenchResult
+{
+	std::string primitive;
+	std::string impl;
+	std::string op;
+	size_t size;
+	double mb_per_sec;
+	double cycles_per_byte;	//<0 if no cycle counter
+	double per_sec;
+};
+std::vector<BenchResult> g_results;
+
+//-------------------------------------------------------------------------------------
+bool is_selected(const char* primitive)
+{
+	return g_filter.empty() || strstr(primitive, g_filter.c_str()) != nullptr;
+}
+
+//-------------------------------------------------------------------------------------
+const char* cycle_source(void)
+{
+#ifdef BENCH_HAVE_TSC
+	if (g_cpu_ghz <= 0.0) return "tsc";
+#endif
+	return (g_cpu_ghz > 0.0) ? "ghz" : "none";
+}
+
+//-------------------------------------------------------------------------------------
+// wall time and cycles of a piece of code. The TSC counts reference cycles, which equal
+// the core cycles only if the cpu runs at its base frequency, pass "-g" to use a fixed one
+class Stopwatch
+{
+public:
+	Stopwatch() : m_begin(std::chrono::steady_clock::now())
+#ifdef BENCH_HAVE_TSC
+		, m_begin_tsc(__rdtsc())
+#endif
+	{
+	}
+
+	double seconds(void) const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_begin).count();
+	}
+
+	//<0 if unknown
+	double cycles(double seconds) const {
+		if (g_cpu_ghz > 0.0) return seconds * g_cpu_ghz * 1e9;
+#ifdef BENCH_HAVE_TSC
+		return (double)(__rdtsc() - m_begin_tsc);
+#else
+		return -1.0;
+#endif
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_begin;
+#ifdef BENCH_HAVE_TSC
+	uint64_t m_begin_tsc;
+#endif
+};
+
+//-------------------------------------------------------------------------------------
+void print_result(const BenchResult& r)
+{
+	if (r.size == 0) {
+		fprintf(g_report, "%-12s %-10s %-12s %14s %12.1f /s\n", r.primitive.c_str(), r.impl.c_str(), r.op.c_str(), "", r.per_sec);
+		return;
+	}
+	if (r.cycles_per_byte < 0.0) {
+		fprintf(g_report, "%-12s %-10s %-12s size=%8zu %10.1f MB/s\n", r.primitive.c_str(), r.impl.c_str(), r.op.c_str(), r.size, r.mb_per_sec);
+	}
+	else {
+		fprintf(g_report, "%-12s %-10s %-12s size=%8zu %10.1f MB/s %8.2f cycles/byte\n",
+			r.primitive.c_str(), r.impl.c_str(), r.op.c_str(), r.size, r.mb_per_sec, r.cycles_per_byte);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+// run the function on the buffer until g_total_bytes are processed, and record the result
+template<typename FUNC>
+void bench_throughput(const char* primitive, const char* impl, const char* op, size_t buf_size, FUNC func)
+{
+	//warm up, the first call may initialize tables or page in the buffer
+	func();
+
+	size_t loop_counts = g_total_bytes / buf_size;
+	if (loop_counts == 0) loop_counts = 1;
+
+	Stopwatch watch;
+	for (size_t i = 0; i < loop_counts; i++) {
+		func();
+	}
+	double cost = watch.seconds();
+	double cycles = watch.cycles(cost);
+
+	double bytes = (double)(loop_counts * buf_size);
+	BenchResult r;
+	r.primitive = primitive;
+	r.impl = impl;
+	r.op = op;
+	r.size = buf_size;
+	r.mb_per_sec = bytes / (1024.0 * 1024.0) / cost;
+	r.cycles_per_byte = (cycles < 0.0) ? -1.0 : cycles / bytes;
+	r.per_sec = (double)loop_counts / cost;
+	g_results.push_back(r);
+	print_result(r);
+}
+
+//-------------------------------------------------------------------------------------
+// record a rate(calls per second) result
+void report_rate(const char* primitive, const char* impl, const char* op, double per_sec)
+{
+	BenchResult r;
+	r.primitive = primitive;
+	r.impl = impl;
+	r.op = op;
+	r.size = 0;
+	r.mb_per_sec = 0.0;
+	r.cycles_per_byte = -1.0;
+	r.per_sec = per_sec;
+	g_results.push_back(r);
+	print_result(r);
+}
+
+//-------------------------------------------------------------------------------------
+// run the function for a while, return calls per second
+template<typename FUNC>
+double bench_rate(FUNC func)
+{
+	const double BENCH_SECONDS = 1.0;
+	size_t counts = 0;
+	auto begin = std::chrono::steady_clock::now();
+	double cost = 0.0;
+	do {
+		for (int i = 0; i < 100; i++) func();
+		counts += 100;
+		cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	} while (cost < BENCH_SECONDS);
+	return (double)counts / cost;
+}
+
+//-------------------------------------------------------------------------------------
+void bench_checksum(uint8_t* buf)
+{
+	volatile uint32_t sink = 0;
+
+	if (is_selected("adler32")) {
+		const Adler32Implementation impls[] = { ADLER32_SCALAR, ADLER32_SSSE3, ADLER32_AVX2 };
+		for (Adler32Implementation impl : impls) {
+			const char* name = adler32_implementation_name(impl);
+			if (!adler32_is_supported(impl)) {
+				fprintf(g_report, "adler32(%s) not supported\n", name);
+				continue;
+			}
+			for (size_t buf_size : BUF_SIZES) {
+				bench_throughput("adler32", name, "checksum", buf_size, [&]() { sink = adler32(INITIAL_ADLER, buf, buf_size, impl); });
+			}
+		}
+	}
+
+	if (is_selected("crc32c")) {
+		const Crc32cImplementation impls[] = { CRC32C_SCALAR, CRC32C_SSE42 };
+		for (Crc32cImplementation impl : impls) {
+			const char* name = crc32c_implementation_name(impl);
+			if (!crc32c_is_supported(impl)) {
+				fprintf(g_report, "crc32c(%s) not supported\n", name);
+				continue;
+			}
+			for (size_t buf_size : BUF_SIZES) {
+				bench_throughput("crc32c", name, "checksum", buf_size, [&]() { sink = crc32c(INITIAL_CRC32C, buf, buf_size, impl); });
+			}
+		}
+	}
+	(void)sink;
+}
+
+//-------------------------------------------------------------------------------------
+void bench_xorshift128(uint8_t* buf)
+{
+	if (!is_selected("xorshift128")) return;
+
+	XorShift128 seed;
+	seed.make();
+
+	for (size_t buf_size : BUF_SIZES) {
+		XorShift128 s = seed;
+		bench_throughput("xorshift128", "function", "update", buf_size, [&]() { xorshift128(buf, buf_size, s); });
+	}
+
+	const XorShift128Stream::Implementation impls[] = {
+		XorShift128Stream::IMPL_COMPAT, XorShift128Stream::IMPL_PORTABLE, XorShift128Stream::IMPL_SSE2, XorShift128Stream::IMPL_AVX2 };
+	for (XorShift128Stream::Implementation impl : impls) {
+		const char* name = XorShift128Stream::get_implementation_name(impl);
+		if (!XorShift128Stream::is_supported(impl)) {
+			fprintf(g_report, "xorshift128(%s) not supported\n", name);
+			continue;
+		}
+		XorShift128Stream stream(seed, impl);
+		for (size_t buf_size : BUF_SIZES) {
+			bench_throughput("xorshift128", name, "update", buf_size, [&]() { stream.update(buf, buf, buf_size); });
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void bench_dhexchange(void)
+{
+	if (!is_selected("dhexchange")) return;
+
+	dhkey_t peer_public, peer_private;
+	DH_generate_key_pair(peer_public, peer_private);
+
+	//server side of one handshake, make a key pair and the secret key
+	double inplace = bench_rate([&]() {
+		dhkey_t public_key, private_key, secret_key;
+		DH_generate_key_pair(public_key, private_key);
+		DH_generate_key_secret(secret_key, private_key, peer_public);
+	});
+	report_rate("dhexchange", "inplace", "handshake", inplace);
+
+	//burst of handshakes, the key pairs are taken from a full pool
+	const size_t POOL_SIZE = 4096;
+	DHKeyPairPool pool(POOL_SIZE);
+	pool.wait_full(60 * 1000);
+
+	auto begin = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < POOL_SIZE; i++) {
+		dhkey_t public_key, private_key, secret_key;
+		pool.take(public_key, private_key);
+		DH_generate_key_secret(secret_key, private_key, peer_public);
+	}
+	double cost = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report_rate("dhexchange", "pool", "handshake", (double)POOL_SIZE / cost);
+}
+
+//-------------------------------------------------------------------------------------
+void bench_rijndael(uint8_t* buf)
+{
+	if (!is_selected("rijndael")) return;
+
+	Rijndael::BLOCK key;
+	for (size_t i = 0; i < Rijndael::BLOCK_SIZE; i++) key[i] = (uint8_t)(rand() & 0xFF);
+
+	const Rijndael::Implementation impls[] = { Rijndael::IMPL_TABLE, Rijndael::IMPL_AESNI, Rijndael::IMPL_ARMV8 };
+	for (Rijndael::Implementation impl : impls) {
+		const char* name = Rijndael::get_implementation_name(impl);
+		if (!Rijndael::is_supported(impl)) {
+			fprintf(g_report, "rijndael(%s) not supported\n", name);
+			continue;
+		}
+
+		Rijndael aes(key, impl);
+		for (size_t buf_size : BUF_SIZES) {
+			bench_throughput("rijndael", name, "ecb-encrypt", buf_size, [&]() {
+				for (size_t off = 0; off < buf_size; off += Rijndael::BLOCK_SIZE) aes.encrypt_block(buf + off, buf + off);
+			});
+		}
+		for (size_t buf_size : BUF_SIZES) {
+			Rijndael::BLOCK iv = { 0 };
+			bench_throughput("rijndael", name, "cbc-encrypt", buf_size, [&]() { aes.encrypt(buf, buf, buf_size, iv); });
+		}
+		for (size_t buf_size : BUF_SIZES) {
+			Rijndael::BLOCK iv = { 0 };
+			bench_throughput("rijndael", name, "cbc-decrypt", buf_size, [&]() { aes.decrypt(buf, buf, buf_size, iv); });
+		}
+
+		Rijndael::BLOCK counter = { 0 };
+		RijndaelCTR ctr(key, counter, impl);
+		for (size_t buf_size : BUF_SIZES) {
+			bench_throughput("rijndael", name, "ctr", buf_size, [&]() { ctr.update(buf, buf, buf_size); });
+		}
+
+		RijndaelGCM gcm(key, impl);
+		uint8_t gcm_iv[RijndaelGCM::IV_SIZE] = { 0 };
+		for (size_t buf_size : BUF_SIZES) {
+			bench_throughput("rijndael", name, "gcm-encrypt", buf_size, [&]() {
+				uint8_t tag[RijndaelGCM::TAG_SIZE];
+				gcm.start(gcm_iv);
+				gcm.encrypt(buf, buf, buf_size);
+				gcm.finish(tag);
+			});
+		}
+		//the tag is wrong, but the cost of verify doesn't depend on it
+		for (size_t buf_size : BUF_SIZES) {
+			volatile bool sink = false;
+			bench_throughput("rijndael", name, "gcm-decrypt", buf_size, [&]() {
+				uint8_t tag[RijndaelGCM::TAG_SIZE] = { 0 };
+				gcm.start(gcm_iv);
+				gcm.decrypt(buf, buf, buf_size);
+				sink = gcm.verify(tag);
+			});
+			(void)sink;
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+void bench_chacha20(uint8_t* buf)
+{
+	if (!is_selected("chacha20")) return;
+
+	uint8_t key[ChaCha20::KEY_SIZE], nonce[ChaCha20::NONCE_SIZE] = { 0 };
+	for (size_t i = 0; i < ChaCha20::KEY_SIZE; i++) key[i] = (uint8_t)(rand() & 0xFF);
+
+	const ChaCha20::Implementation impls[] = { ChaCha20::IMPL_PORTABLE, ChaCha20::IMPL_SSE2, ChaCha20::IMPL_AVX2 };
+	for (ChaCha20::Implementation impl : impls) {
+		const char* name = ChaCha20::get_implementation_name(impl);
+		if (!ChaCha20::is_supported(impl)) {
+			fprintf(g_report, "chacha20(%s) not supported\n", name);
+			continue;
+		}
+
+		ChaCha20 chacha(key, nonce, 0, impl);
+		for (size_t buf_size : BUF_SIZES) {
+			bench_throughput("chacha20", name, "stream", buf_size, [&]() { chacha.update(buf, buf, buf_size); });
+		}
+
+		ChaCha20Poly1305 aead(key, impl);
+		for (size_t buf_size : BUF_SIZES) {
+			bench_throughput("chacha20", name, "aead-encrypt", buf_size, [&]() {
+				uint8_t tag[ChaCha20Poly1305::TAG_SIZE];
+				aead.start(nonce);
+				aead.encrypt(buf, buf, buf_size);
+				aead.finish(tag);
+			});
+		}
+		for (size_t buf_size : BUF_SIZES) {
+			volatile bool sink = false;
+			bench_throughput("chacha20", name, "aead-decrypt", buf_size, [&]() {
+				uint8_t tag[ChaCha20Poly1305::TAG_SIZE] = { 0 };
+				aead.start(nonce);
+				aead.decrypt(buf, buf, buf_size);
+				sink = aead.verify(tag);
+			});
+			(void)sink;
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+bool write_json(const char* file_name)
+{
+	FILE* fp = (strcmp(file_name, "stdout") == 0) ? stdout : fopen(file_name, "w");
+	if (fp == nullptr) {
+		fprintf(stderr, "Can't open file %s\n", file_name);
+		return false;
+	}
+
+	const CpuFeatures& cpu = get_cpu_features();
+	const struct { const char* name; bool has; } features[] = {
+		{ "sse2", cpu.sse2 }, { "ssse3", cpu.ssse3 }, { "sse4.1", cpu.sse41 }, { "sse4.2", cpu.sse42 },
+		{ "avx2", cpu.avx2 }, { "aesni", cpu.aesni }, { "pclmul", cpu.pclmul },
+		{ "neon", cpu.neon }, { "aes", cpu.arm_aes }, { "pmull", cpu.arm_pmull }, { "crc32", cpu.arm_crc32 },
+	};
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"version\": \"%d.%d.%d\",\n", CYCLONE_VERSION / 10000, CYCLONE_VERSION / 100 % 100, CYCLONE_VERSION % 100);
+	fprintf(fp, "\t\"timestamp\": %lld,\n", (long long)(sys_api::utc_time_now() / (1000 * 1000)));
+	fprintf(fp, "\t\"cycle_source\": \"%s\",\n", cycle_source());
+	fprintf(fp, "\t\"total_bytes\": %zu,\n", g_total_bytes);
+
+	fprintf(fp, "\t\"cpu_features\": [");
+	bool first = true;
+	for (const auto& f : features) {
+		if (!f.has) continue;
+		fprintf(fp, "%s\"%s\"", first ? "" : ", ", f.name);
+		first = false;
+	}
+	fprintf(fp, "],\n");
+
+	fprintf(fp, "\t\"results\": [\n");
+	for (size_t i = 0; i < g_results.size(); i++) {
+		const BenchResult& r = g_results[i];
+		fprintf(fp, "\t\t{ \"primitive\": \"%s\", \"impl\": \"%s\", \"op\": \"%s\", ", r.primitive.c_str(), r.impl.c_str(), r.op.c_str());
+		if (r.size == 0) {
+			fprintf(fp, "\"per_sec\": %.1f }", r.per_sec);
+		}
+		else {
+			fprintf(fp, "\"size\": %zu, \"mb_per_sec\": %.2f, ", r.size, r.mb_per_sec);
+			if (r.cycles_per_byte < 0.0) fprintf(fp, "\"cycles_per_byte\": null }");
+			else fprintf(fp, "\"cycles_per_byte\": %.3f }", r.cycles_per_byte);
+		}
+		fprintf(fp, "%s\n", (i + 1 < g_results.size()) ? "," : "");
+	}
+	fprintf(fp, "\t]\n");
+	fprintf(fp, "}\n");
+
+	if (fp != stdout) fclose(fp);
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+void print_usage(const char* moduleName)
+{
+	printf("===== Crypt Benchmark(Powerd by Cyclone) =====\n");
+	printf("Usage: %s [OPTIONS]\n\n", moduleName);
+	printf("\t -j JSON_FILE\tWrite the results as json, 'stdout' for standard output\n");
+	printf("\t -f PRIMITIVE\tOnly run the primitives whose name contains PRIMITIVE(adler32, crc32c, xorshift128, dhexchange, rijndael, chacha20)\n");
+	printf("\t -m TOTAL_MB\tMegabytes processed by each measurement, Default 256\n");
+	printf("\t -g CPU_GHZ\tCount cycles with the fixed cpu frequency instead of TSC\n");
+	printf("\t --help -?\tShow this help\n");
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	CSimpleOptA args(argc, argv, g_rgOptions);
+	std::string json_file;
+
+	while (args.Next()) {
+		if (args.LastError() == SO_SUCCESS) {
+			if (args.OptionId() == OPT_HELP) {
+				print_usage(argv[0]);
+				return 0;
+			}
+			else if (args.OptionId() == OPT_JSON) {
+				json_file = args.OptionArg();
+			}
+			else if (args.OptionId() == OPT_FILTER) {
+				g_filter = args.OptionArg();
+			}
+			else if (args.OptionId() == OPT_TOTAL_MB) {
+				g_total_bytes = (size_t)atoi(args.OptionArg()) * 1024 * 1024;
+			}
+			else if (args.OptionId() == OPT_GHZ) {
+				g_cpu_ghz = atof(args.OptionArg());
+			}
+		}
+		else {
+			printf("Invalid argument: %s\n", args.OptionText());
+			return 1;
+		}
+	}
+	if (g_total_bytes == 0) g_total_bytes = MAX_BUF_SIZE;
+
+	//the human readable report goes to stderr when json is written to stdout
+	if (json_file == "stdout") g_report = stderr;
+
+	uint8_t* buf = new uint8_t[MAX_BUF_SIZE];
+	memset(buf, 0x5a, MAX_BUF_SIZE);
+
+	bench_checksum(buf);
+	bench_xorshift128(buf);
+	bench_dhexchange();
+	bench_rijndael(buf);
+	bench_chacha20(buf);
+
+	delete[] buf;
+
+	if (!json_file.empty() && !write_json(json_file.c_str())) return 1;
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include <cy_core.h>
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+const uint64_t VALUE_COUNTS = 4000000;
+const int32_t QUEUE_SIZE = 4096;
+const size_t BULK_SIZE = 32;
+
+//-------------------------------------------------------------------------------------
+// push VALUE_COUNTS values by producers and pop them by consumers, return values per second
+template<typename QUEUE>
+double bench_queue(int32_t producer_counts, int32_t consumer_counts, bool bulk)
+{
+	QUEUE* queue = new QUEUE();
+	atomic_int32_t ready(0);
+	atomic_bool_t start(false);
+	atomic_uint64_t popped(0);
+
+	uint64_t values_per_producer = VALUE_COUNTS / (uint64_t)producer_counts;
+	uint64_t total = values_per_producer * (uint64_t)producer_counts;
+
+	std::vector<thread_t> threads;
+	for (int32_t i = 0; i < producer_counts; i++) {
+		threads.push_back(sys_api::thread_create([&, queue](void*) {
+			uint64_t buf[BULK_SIZE];
+			for (size_t j = 0; j < BULK_SIZE; j++) buf[j] = j;
+
+			ready++;
+			while (!start.load()) sys_api::thread_yield();
+
+			uint64_t pushed = 0;
+			while (pushed < values_per_producer) {
+				size_t n;
+				if (bulk) {
+					n = queue->push_bulk(buf, (size_t)std::min((uint64_t)BULK_SIZE, values_per_producer - pushed));
+				}
+				else {
+					n = queue->push(pushed) ? 1 : 0;
+				}
+				if (n == 0) sys_api::thread_yield();
+				pushed += n;
+			}
+		}, nullptr, "producer"));
+	}
+
+	for (int32_t i = 0; i < consumer_counts; i++) {
+		threads.push_back(sys_api::thread_create([&, queue](void*) {
+			uint64_t buf[BULK_SIZE];
+
+			ready++;
+			while (!start.load()) sys_api::thread_yield();
+
+			while (popped.load(std::memory_order_relaxed) < total) {
+				size_t n;
+				if (bulk) {
+					n = queue->pop_bulk(buf, BULK_SIZE);
+				}
+				else {
+					n = queue->pop(buf[0]) ? 1 : 0;
+				}
+				if (n == 0) {
+					sys_api::thread_yield();
+					continue;
+				}
+				popped.fetch_add(n, std::memory_order_relaxed);
+			}
+		}, nullptr, "consumer"));
+	}
+
+	while (ready.load() < producer_counts + consumer_counts) sys_api::thread_yield();
+
+	int64_t begin_time = sys_api::performance_time_now();
+	start = true;
+	for (auto t : threads) {
+		sys_api::thread_join(t);
+	}
+	int64_t cost = sys_api::performance_time_now() - begin_time;
+	if (cost <= 0) cost = 1;
+
+	delete queue;
+	return (double)total * 1000000.0 / (double)cost;
+}
+
+//-------------------------------------------------------------------------------------
+typedef LockFreeQueue<uint64_t, QUEUE_SIZE, kLFQueueMPMC> MPMCQueue;
+typedef LockFreeQueue<uint64_t, QUEUE_SIZE, kLFQueueMPSC> MPSCQueue;
+typedef LockFreeQueue<uint64_t, QUEUE_SIZE, kLFQueueSPSC> SPSCQueue;
+
+//-------------------------------------------------------------------------------------
+void print_result(const char* name, int32_t producer_counts, int32_t consumer_counts, double single, double bulk)
+{
+	printf("%-6s %dP%dC single=%12.0f/s bulk=%12.0f/s\n", name, producer_counts, consumer_counts, single, bulk);
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	//1 producer 1 consumer, all modes
+	print_result("MPMC", 1, 1, bench_queue<MPMCQueue>(1, 1, false), bench_queue<MPMCQueue>(1, 1, true));
+	print_result("MPSC", 1, 1, bench_queue<MPSCQueue>(1, 1, false), bench_queue<MPSCQueue>(1, 1, true));
+	print_result("SPSC", 1, 1, bench_queue<SPSCQueue>(1, 1, false), bench_queue<SPSCQueue>(1, 1, true));
+
+	//many producers 1 consumer
+	const int32_t PRODUCER_COUNTS[] = { 2, 4, 8 };
+	for (int32_t producer_counts : PRODUCER_COUNTS) {
+		print_result("MPMC", producer_counts, 1, bench_queue<MPMCQueue>(producer_counts, 1, false), bench_queue<MPMCQueue>(producer_counts, 1, true));
+		print_result("MPSC", producer_counts, 1, bench_queue<MPSCQueue>(producer_counts, 1, false), bench_queue<MPSCQueue>(producer_counts, 1, true));
+	}
+
+	//many producers many consumers
+	print_result("MPMC", 4, 4, bench_queue<MPMCQueue>(4, 4, false), bench_queue<MPMCQueue>(4, 4, true));
+	return 0;
+}
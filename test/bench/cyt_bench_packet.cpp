@@ -0,0 +1,177 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include <utility/cyu_histogram.h>
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+const int32_t LOOP_COUNTS = 1000000;
+const uint16_t PACKET_SIZES[] = { 16, 200, 1000, 4000, 16000 };	//at least 8 bytes(the time of alloc)
+const size_t HEAD_SIZE = 4;
+
+char s_content[0x10000] = { 0 };
+
+//-------------------------------------------------------------------------------------
+double _per_second(int64_t counts, int64_t begin_time)
+{
+	int64_t cost = sys_api::performance_time_now() - begin_time;
+	if (cost <= 0) cost = 1;
+	return (double)counts * 1000000.0 / (double)cost;
+}
+
+//-------------------------------------------------------------------------------------
+// alloc, build and free packet in one thread
+void bench_single_thread(uint16_t packet_size)
+{
+	//warm up the pool
+	Packet::free_packet(Packet::alloc_packet());
+
+	int64_t begin_time = sys_api::performance_time_now();
+	for (int32_t i = 0; i < LOOP_COUNTS; i++) {
+		Packet* packet = Packet::alloc_packet();
+		packet->build_from_memory(HEAD_SIZE, 1, packet_size, s_content);
+		Packet::free_packet(packet);
+	}
+	double packet_rate = _per_second(LOOP_COUNTS, begin_time);
+
+	//baseline: alloc/free the same memory from the allocator directly
+	begin_time = sys_api::performance_time_now();
+	for (int32_t i = 0; i < LOOP_COUNTS; i++) {
+		char* buf = (char*)CY_MALLOC_TAG(HEAD_SIZE + packet_size, memory::kTagPacket);
+		memcpy(buf + HEAD_SIZE, s_content, packet_size);
+		CY_FREE(buf);
+	}
+	double malloc_rate = _per_second(LOOP_COUNTS, begin_time);
+
+	printf("single thread   size=%5d packet=%12.0f/s malloc=%12.0f/s\n", packet_size, packet_rate, malloc_rate);
+}
+
+//-------------------------------------------------------------------------------------
+// alloc in one thread and free in another thread
+void bench_cross_thread(uint16_t packet_size)
+{
+	typedef LockFreeQueue<Packet*, 1024> PacketQueue;
+	PacketQueue* queue = new PacketQueue();
+	atomic_bool_t done(false);
+
+	//latency from alloc to free(nanoseconds), the alloc time is written in the packet
+	LatencyHistogram* latency = new LatencyHistogram();
+
+	thread_t consumer = sys_api::thread_create([queue, &done, latency](void*) {
+		Packet* packet = nullptr;
+		for (;;) {
+			if (queue->pop(packet)) {
+				int64_t alloc_time;
+				memcpy(&alloc_time, packet->get_packet_content(), sizeof(alloc_time));
+				latency->record(sys_api::fast_now_ns() - alloc_time);
+				Packet::free_packet(packet);
+			}
+			else if (done.load()) {
+				break;
+			}
+			else {
+				sys_api::thread_yield();
+			}
+		}
+	}, nullptr, "consumer");
+
+	int64_t begin_time = sys_api::performance_time_now();
+	for (int32_t i = 0; i < LOOP_COUNTS; i++) {
+		Packet* packet = Packet::alloc_packet();
+		packet->build_from_memory(HEAD_SIZE, 1, packet_size, s_content);
+		int64_t alloc_time = sys_api::fast_now_ns();
+		memcpy(packet->get_packet_content(), &alloc_time, sizeof(alloc_time));
+		while (!queue->push(packet)) {
+			sys_api::thread_yield();
+		}
+	}
+	done = true;
+	sys_api::thread_join(consumer);
+	double rate = _per_second(LOOP_COUNTS, begin_time);
+
+	delete queue;
+	printf("cross thread    size=%5d packet=%12.0f/s latency(ns) p50=%" PRId64 " p99=%" PRId64 " p999=%" PRId64 "\n", packet_size, rate,
+		latency->value_at_percentile(50.0), latency->value_at_percentile(99.0), latency->value_at_percentile(99.9));
+	delete latency;
+}
+
+//-------------------------------------------------------------------------------------
+// deliver one message to many work threads, shared packet vs copy
+void bench_broadcast(uint16_t packet_size)
+{
+	const int32_t THREAD_COUNTS = 4;
+	const int32_t MESSAGE_COUNTS = LOOP_COUNTS / 10;
+	const uint16_t STOP_ID = 0xFFFF;
+
+	atomic_int32_t received(0);
+	std::vector<WorkThread*> threads;
+	for (int32_t i = 0; i < THREAD_COUNTS; i++) {
+		WorkThread* thread = new WorkThread();
+		thread->set_on_message([thread, &received](Packet* message) {
+			if (message->get_packet_id() == STOP_ID) {
+				thread->get_looper()->push_stop_request();
+				return;
+			}
+			received++;
+		});
+		thread->start("bench");
+		threads.push_back(thread);
+	}
+
+	Packet packet;
+	packet.build_from_memory(HEAD_SIZE, 1, packet_size, s_content);
+
+	//copy to every thread
+	int64_t begin_time = sys_api::performance_time_now();
+	for (int32_t i = 0; i < MESSAGE_COUNTS; i++) {
+		for (auto thread : threads) {
+			thread->send_message(&packet);
+		}
+		while (i - received.load() / THREAD_COUNTS > 512) sys_api::thread_yield();
+	}
+	while (received.load() < MESSAGE_COUNTS * THREAD_COUNTS) sys_api::thread_yield();
+	double copy_rate = _per_second(MESSAGE_COUNTS, begin_time);
+
+	//share one packet
+	received = 0;
+	begin_time = sys_api::performance_time_now();
+	for (int32_t i = 0; i < MESSAGE_COUNTS; i++) {
+		PacketPtr shared = Packet::alloc_shared_packet(&packet);
+		for (auto thread : threads) {
+			thread->send_message(shared);
+		}
+		while (i - received.load() / THREAD_COUNTS > 512) sys_api::thread_yield();
+	}
+	while (received.load() < MESSAGE_COUNTS * THREAD_COUNTS) sys_api::thread_yield();
+	double share_rate = _per_second(MESSAGE_COUNTS, begin_time);
+
+	for (auto thread : threads) {
+		thread->send_message(STOP_ID, 0, nullptr);
+		thread->join();
+		delete thread;
+	}
+
+	printf("broadcast(x%d)  size=%5d copy=%12.0f/s shared=%12.0f/s\n", THREAD_COUNTS, packet_size, copy_rate, share_rate);
+}
+
+}
+
+//-------------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	(void)argc;
+	(void)argv;
+
+	for (uint16_t size : PACKET_SIZES) {
+		bench_single_thread(size);
+	}
+	for (uint16_t size : PACKET_SIZES) {
+		bench_cross_thread(size);
+	}
+	for (uint16_t size : PACKET_SIZES) {
+		bench_broadcast(size);
+	}
+	return 0;
+}
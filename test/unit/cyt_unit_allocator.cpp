@@ -0,0 +1,168 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Allocator tag statistics test", "[Allocator][Tag]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//too late to change allocator
+	REQUIRE_FALSE(memory::set_allocator(nullptr));
+	REQUIRE_TRUE(memory::get_allocator() != nullptr);
+
+	memory::TagStats begin = memory::get_tag_stats(memory::kTagDefault);
+
+	void* p1 = CY_MALLOC(100);
+	void* p2 = CY_MALLOC(200);
+	REQUIRE_EQ(0u, ((uintptr_t)p1) % 16);
+
+	memory::TagStats stats = memory::get_tag_stats(memory::kTagDefault);
+	REQUIRE_EQ(begin.alloc_counts + 2, stats.alloc_counts);
+	REQUIRE_EQ(begin.bytes + 300, stats.bytes);
+
+	//free in other thread
+	thread_t t = sys_api::thread_create([](void* p) {
+		CY_FREE(p);
+	}, p2, "free");
+	sys_api::thread_join(t);
+	CY_FREE(p1);
+
+	stats = memory::get_tag_stats(memory::kTagDefault);
+	REQUIRE_EQ(begin.free_counts + 2, stats.free_counts);
+	REQUIRE_EQ(begin.bytes, stats.bytes);
+
+	//move to other tag
+	memory::TagStats logger_begin = memory::get_tag_stats(memory::kTagLogger);
+	void* p3 = CY_MALLOC(300);
+	memory::set_tag(p3, memory::kTagLogger);
+	REQUIRE_EQ(begin.bytes, memory::get_tag_stats(memory::kTagDefault).bytes);
+	REQUIRE_EQ(logger_begin.bytes + 300, memory::get_tag_stats(memory::kTagLogger).bytes);
+	CY_FREE(p3);
+	REQUIRE_EQ(logger_begin.bytes, memory::get_tag_stats(memory::kTagLogger).bytes);
+	REQUIRE_EQ(logger_begin.alloc_counts + 1, memory::get_tag_stats(memory::kTagLogger).alloc_counts);
+	REQUIRE_EQ(logger_begin.free_counts + 1, memory::get_tag_stats(memory::kTagLogger).free_counts);
+
+	//packet(packet memory is pooled by BufPool)
+	BufPool::trim();
+	memory::TagStats packet_begin = memory::get_tag_stats(memory::kTagPacket);
+	std::vector<char> content(2000, 'x');
+	Packet* packet = Packet::alloc_packet();
+	packet->build_from_memory(4, 1, (uint16_t)content.size(), &content[0]);
+	stats = memory::get_tag_stats(memory::kTagPacket);
+	REQUIRE_GE(stats.alloc_counts, packet_begin.alloc_counts + 1);
+	REQUIRE_GT(stats.bytes, packet_begin.bytes);
+	Packet::free_packet(packet);
+	BufPool::trim();
+	REQUIRE_EQ(packet_begin.bytes, memory::get_tag_stats(memory::kTagPacket).bytes);
+
+	REQUIRE_STREQ("ringbuf", memory::get_tag_name(memory::kTagRingBuf));
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ArenaAllocator basic test", "[Allocator][Arena]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	ArenaAllocator allocator;
+	REQUIRE_EQ(0u, allocator.get_chunk_bytes());
+
+	//different size
+	std::vector<std::pair<uint8_t*, size_t>> blocks;
+	for (size_t size = 1; size <= ArenaAllocator::kMaxSmallSize * 2; size = size * 3 + 1) {
+		uint8_t* p = (uint8_t*)allocator.allocate(size);
+		REQUIRE_TRUE(p != nullptr);
+		REQUIRE_EQ(0u, ((uintptr_t)p) % 16);
+		memset(p, (int)(size & 0xFF), size);
+		blocks.push_back(std::make_pair(p, size));
+	}
+	REQUIRE_EQ(1u, allocator.get_arena_counts());
+	REQUIRE_EQ((size_t)ArenaAllocator::kChunkSize, allocator.get_chunk_bytes());
+
+	for (auto& b : blocks) {
+		for (size_t i = 0; i < b.second; i++) {
+			REQUIRE_EQ((uint8_t)(b.second & 0xFF), b.first[i]);
+		}
+	}
+
+	//reuse the freed block
+	for (auto& b : blocks) {
+		allocator.deallocate(b.first, b.second);
+	}
+	void* p1 = allocator.allocate(100);
+	allocator.deallocate(p1, 100);
+	void* p2 = allocator.allocate(100);
+	REQUIRE_TRUE(p1 == p2);
+	allocator.deallocate(p2, 100);
+	REQUIRE_EQ((size_t)ArenaAllocator::kChunkSize, allocator.get_chunk_bytes());
+
+	//huge page
+	ArenaAllocator huge_allocator(true);
+	void* huge = huge_allocator.allocate(64);
+	REQUIRE_TRUE(huge != nullptr);
+	memset(huge, 0, 64);
+	huge_allocator.deallocate(huge, 64);
+	REQUIRE_LE(huge_allocator.get_huge_page_chunks(), 1u);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ArenaAllocator multi thread test", "[Allocator][Arena][MultiThread]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	ArenaAllocator allocator;
+
+	const int32_t BLOCK_COUNTS = 10000;
+	const size_t BLOCK_SIZE = 48;
+
+	struct ThreadParam
+	{
+		ArenaAllocator* allocator;
+		LockFreeQueue<void*, 1024>* queue;
+		atomic_bool_t* done;
+	};
+	LockFreeQueue<void*, 1024> queue;
+	atomic_bool_t done(false);
+	ThreadParam param = { &allocator, &queue, &done };
+
+	//free all blocks in other thread
+	thread_t t = sys_api::thread_create([](void* p) {
+		ThreadParam* tp = (ThreadParam*)p;
+		for (;;) {
+			void* block = nullptr;
+			if (tp->queue->pop(block)) {
+				tp->allocator->deallocate(block, BLOCK_SIZE);
+			}
+			else if (tp->done->load()) {
+				break;
+			}
+			else {
+				sys_api::thread_yield();
+			}
+		}
+	}, &param, "free");
+
+	for (int32_t round = 0; round < 10; round++) {
+		for (int32_t i = 0; i < BLOCK_COUNTS; i++) {
+			void* block = allocator.allocate(BLOCK_SIZE);
+			memset(block, i & 0xFF, BLOCK_SIZE);
+			while (!queue.push(block)) sys_api::thread_yield();
+		}
+	}
+	done = true;
+	sys_api::thread_join(t);
+
+	//blocks come back from remote free list
+	size_t chunk_bytes = allocator.get_chunk_bytes();
+	for (int32_t i = 0; i < BLOCK_COUNTS; i++) {
+		allocator.deallocate(allocator.allocate(BLOCK_SIZE), BLOCK_SIZE);
+	}
+	REQUIRE_EQ(chunk_bytes, allocator.get_chunk_bytes());
+	REQUIRE_LE(chunk_bytes, (size_t)ArenaAllocator::kChunkSize * 2);
+}
+
+}
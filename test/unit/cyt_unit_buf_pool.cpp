@@ -0,0 +1,141 @@
+#include <cy_core.h>
+#include "cyt_unit_utils.h"
+
+#include <algorithm>
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("BufPool basic test", "[BufPool][Basic]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	BufPool::trim();
+	BufPool::Stats begin = BufPool::get_thread_stats();
+	REQUIRE_EQ(0u, begin.pooled);
+
+	//size class
+	size_t block_size = 0;
+	void* p1 = BufPool::allocate(1, &block_size);
+	REQUIRE_EQ((size_t)BufPool::kMinBlockSize, block_size);
+
+	void* p2 = BufPool::allocate(1025, &block_size);
+	REQUIRE_EQ(2048u, block_size);
+	memset(p2, 0xCE, 1025);
+
+	BufPool::Stats stats = BufPool::get_thread_stats();
+	REQUIRE_EQ(begin.in_use + BufPool::kMinBlockSize + 2048, stats.in_use);
+	REQUIRE_GE(stats.high_water, stats.in_use);
+
+	//freed block is pooled and reused
+	BufPool::deallocate(p2);
+	stats = BufPool::get_thread_stats();
+	REQUIRE_EQ(begin.in_use + BufPool::kMinBlockSize, stats.in_use);
+	REQUIRE_EQ(2048u, stats.pooled);
+
+	void* p3 = BufPool::allocate(2000, &block_size);
+	REQUIRE_EQ(p2, p3);
+	REQUIRE_EQ(0u, BufPool::get_thread_stats().pooled);
+
+	//big block is not pooled
+	void* p4 = BufPool::allocate(BufPool::kMaxBlockSize + 1, &block_size);
+	REQUIRE_EQ((size_t)BufPool::kMaxBlockSize + 1, block_size);
+	BufPool::deallocate(p4);
+	REQUIRE_EQ(0u, BufPool::get_thread_stats().pooled);
+
+	BufPool::deallocate(p1);
+	BufPool::deallocate(p3);
+	stats = BufPool::get_thread_stats();
+	REQUIRE_EQ(begin.in_use, stats.in_use);
+	REQUIRE_EQ(BufPool::kMinBlockSize + 2048u, stats.pooled);
+	REQUIRE_GE(stats.high_water, begin.in_use + BufPool::kMaxBlockSize + 1);
+
+	BufPool::trim();
+	REQUIRE_EQ(0u, BufPool::get_thread_stats().pooled);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("BufPool multi thread test", "[BufPool][MultiThread]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const int32_t BLOCK_COUNTS = 100;
+	const size_t BLOCK_SIZE = 4096;
+
+	BufPool::trim();
+	BufPool::Stats begin = BufPool::get_thread_stats();
+
+	//alloc in this thread
+	std::vector<void*> blocks;
+	for (int32_t i = 0; i < BLOCK_COUNTS; i++) {
+		blocks.push_back(BufPool::allocate(BLOCK_SIZE));
+	}
+	REQUIRE_EQ(begin.in_use + BLOCK_COUNTS * BLOCK_SIZE, BufPool::get_thread_stats().in_use);
+
+	//free in other thread
+	struct ThreadParam
+	{
+		std::vector<void*>* blocks;
+		BufPool::Stats stats;
+	};
+	ThreadParam param = { &blocks, { 0, 0, 0 } };
+
+	thread_t t = sys_api::thread_create([](void* p) {
+		ThreadParam* tp = (ThreadParam*)p;
+		for (auto block : *(tp->blocks)) {
+			BufPool::deallocate(block);
+		}
+		tp->stats = BufPool::get_thread_stats();
+	}, &param, "free");
+	sys_api::thread_join(t);
+
+	//counted to the thread which allocated them, and returned to it
+	REQUIRE_EQ(begin.in_use, BufPool::get_thread_stats().in_use);
+	REQUIRE_EQ(0u, param.stats.in_use);
+	REQUIRE_EQ(0u, param.stats.pooled);
+	REQUIRE_EQ(BLOCK_COUNTS * BLOCK_SIZE, BufPool::get_thread_stats().pooled);
+
+	BufPool::Stats total = BufPool::get_total_stats();
+	REQUIRE_GE(total.in_use, begin.in_use);
+	REQUIRE_GE(total.pooled, BLOCK_COUNTS * BLOCK_SIZE);
+
+	//and reused by this thread
+	std::sort(blocks.begin(), blocks.end());
+	for (int32_t i = 0; i < BLOCK_COUNTS; i++) {
+		void* p = BufPool::allocate(BLOCK_SIZE);
+		REQUIRE_TRUE(std::binary_search(blocks.begin(), blocks.end(), p));
+	}
+	REQUIRE_EQ(0u, BufPool::get_thread_stats().pooled);
+	for (auto block : blocks) BufPool::deallocate(block);
+	REQUIRE_EQ(BLOCK_COUNTS * BLOCK_SIZE, BufPool::get_thread_stats().pooled);
+
+	//the blocks beyond the limit are returned to system
+	BufPool::trim();
+	blocks.clear();
+	const size_t BIG_BLOCK_COUNTS = BufPool::kMaxPooledBytes / BufPool::kMaxBlockSize + 2;
+	for (size_t i = 0; i < BIG_BLOCK_COUNTS; i++) {
+		blocks.push_back(BufPool::allocate(BufPool::kMaxBlockSize));
+	}
+	t = sys_api::thread_create([](void* p) {
+		ThreadParam* tp = (ThreadParam*)p;
+		for (auto block : *(tp->blocks)) {
+			BufPool::deallocate(block);
+		}
+		tp->stats = BufPool::get_thread_stats();
+	}, &param, "free");
+	sys_api::thread_join(t);
+	REQUIRE_EQ(0u, param.stats.pooled);
+	REQUIRE_EQ((size_t)BufPool::kMaxPooledBytes, BufPool::get_thread_stats().pooled);
+
+	//a thread collects them when its free list is empty
+	void* p = BufPool::allocate(BufPool::kMaxBlockSize);
+	REQUIRE_LE(BufPool::get_thread_stats().pooled, (size_t)BufPool::kMaxPooledBytes);
+	BufPool::deallocate(p);
+
+	BufPool::trim();
+	REQUIRE_EQ(0u, BufPool::get_thread_stats().pooled);
+}
+
+}
@@ -75,6 +75,91 @@ TEST_CASE("Crypto algorithm(Adler32) random test", "[Crypto][Adler32]")
 	}
 }
 
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(Adler32) implementation test", "[Crypto][Adler32]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t buf_cap = 64 * 1024 + 64;
+	uint8_t* buf = new uint8_t[buf_cap];
+
+	const Adler32Implementation impls[] = { ADLER32_SSSE3, ADLER32_AVX2 };
+
+	//all 0xff is the worst case of the sums
+	memset(buf, 0xff, buf_cap);
+	uint32_t expected = adler32(INITIAL_ADLER, buf, buf_cap, ADLER32_SCALAR);
+	for (Adler32Implementation impl : impls) {
+		if (!adler32_is_supported(impl)) continue;
+		REQUIRE_EQ(expected, adler32(INITIAL_ADLER, buf, buf_cap, impl));
+	}
+
+	_fillRandom(buf, buf_cap);
+	const size_t sizes[] = { 1, 15, 63, 64, 65, 100, 1000, 5551, 5552, 5553, 11104, 40000, 64 * 1024 };
+	for (size_t size : sizes) {
+		for (size_t align = 0; align < 4; align++) {
+			uint32_t start = (uint32_t)rand() % 65521 | ((uint32_t)rand() % 65521) << 16;
+			uint32_t scalar = adler32(start, buf + align, size, ADLER32_SCALAR);
+			REQUIRE_EQ(scalar, adler32(start, buf + align, size));
+
+			for (Adler32Implementation impl : impls) {
+				if (!adler32_is_supported(impl)) continue;
+				REQUIRE_EQ(scalar, adler32(start, buf + align, size, impl));
+			}
+		}
+	}
+	delete[] buf;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(CRC32C) test", "[Crypto][CRC32C]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const Crc32cImplementation impls[] = { CRC32C_SCALAR, CRC32C_SSE42, CRC32C_AUTO };
+
+	//RFC 3720 B.4
+	uint8_t data[32];
+	for (Crc32cImplementation impl : impls) {
+		if (!crc32c_is_supported(impl)) continue;
+
+		REQUIRE_EQ(INITIAL_CRC32C, crc32c(0x12345678ul, nullptr, 0, impl));
+
+		const char* check = "123456789";
+		REQUIRE_EQ(0xe3069283ul, crc32c(INITIAL_CRC32C, (const uint8_t*)check, strlen(check), impl));
+
+		memset(data, 0, sizeof(data));
+		REQUIRE_EQ(0x8a9136aaul, crc32c(INITIAL_CRC32C, data, sizeof(data), impl));
+		memset(data, 0xff, sizeof(data));
+		REQUIRE_EQ(0x62a8ab43ul, crc32c(INITIAL_CRC32C, data, sizeof(data), impl));
+		for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)i;
+		REQUIRE_EQ(0x46dd794eul, crc32c(INITIAL_CRC32C, data, sizeof(data), impl));
+		for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(31 - i);
+		REQUIRE_EQ(0x113fdb5cul, crc32c(INITIAL_CRC32C, data, sizeof(data), impl));
+	}
+
+	//long data, three streams interleaved
+	const size_t buf_cap = 100 * 1024;
+	uint8_t* buf = new uint8_t[buf_cap];
+	_fillRandom(buf, buf_cap);
+
+	const size_t sizes[] = { 1, 7, 8, 9, 255, 768, 769, 8191, 24576, 24577, 50000, 100 * 1024 - 8 };
+	for (size_t size : sizes) {
+		for (size_t align = 0; align < 8; align++) {
+			uint32_t scalar = crc32c(INITIAL_CRC32C, buf + align, size, CRC32C_SCALAR);
+			for (Crc32cImplementation impl : impls) {
+				if (!crc32c_is_supported(impl)) continue;
+				REQUIRE_EQ(scalar, crc32c(INITIAL_CRC32C, buf + align, size, impl));
+
+				//continue
+				size_t first = (size_t)rand() % size;
+				uint32_t crc = crc32c(INITIAL_CRC32C, buf + align, first, impl);
+				REQUIRE_EQ(scalar, crc32c(crc, buf + align + first, size - first, impl));
+			}
+		}
+	}
+	delete[] buf;
+}
+
 //-------------------------------------------------------------------------------------
 TEST_CASE("Crypto algorithm(DHExchange) test", "[Crypto][DHExchange]")
 {
@@ -103,6 +188,63 @@ TEST_CASE("Crypto algorithm(DHExchange) test", "[Crypto][DHExchange]")
 		REQUIRE_EQ(alice_secret.dq.high, bob_secret.dq.high);
 	}
 
+	//known answers
+	{
+		dhkey_t alice_private, bob_private, generator, key;
+		alice_private.dq.high = 0x0123456789abcdefULL; alice_private.dq.low = 0xfedcba9876543210ULL;
+		bob_private.dq.high = 0x0011223344556677ULL; bob_private.dq.low = 0x8899aabbccddeeffULL;
+		generator.dq.high = 0; generator.dq.low = 5;
+
+		dhkey_t alice_public;
+		DH_generate_key_secret(alice_public, alice_private, generator);
+		REQUIRE_EQ(0x8f3123979f828813ULL, alice_public.dq.high);
+		REQUIRE_EQ(0x2453aa87baf2ff3cULL, alice_public.dq.low);
+
+		DH_generate_key_secret(key, bob_private, generator);
+		REQUIRE_EQ(0xed4d537a1362c48dULL, key.dq.high);
+		REQUIRE_EQ(0x76d547c7c8316fe3ULL, key.dq.low);
+
+		DH_generate_key_secret(key, bob_private, alice_public);
+		REQUIRE_EQ(0x9a56b4efb2efc697ULL, key.dq.high);
+		REQUIRE_EQ(0x8883fee7cc281eedULL, key.dq.low);
+
+		//public key greater than P
+		dhkey_t big;
+		big.dq.high = big.dq.low = 0xffffffffffffffffULL;
+		DH_generate_key_secret(key, alice_private, big);
+		REQUIRE_EQ(0x857749aa00dd08faULL, key.dq.high);
+		REQUIRE_EQ(0xe568c6a138d8b48dULL, key.dq.low);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(DHKeyPairPool) test", "[Crypto][DHExchange]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t POOL_SIZE = 16;
+	DHKeyPairPool pool(POOL_SIZE);
+	REQUIRE_TRUE(pool.wait_full(10 * 1000));
+	REQUIRE_EQ(POOL_SIZE, pool.size());
+
+	dhkey_t generator;
+	generator.dq.high = 0; generator.dq.low = 5;
+
+	//take more than the pool size, the pool is refilled or the pair is generated in place
+	std::set<std::pair<uint64_t, uint64_t> > private_keys;
+	for (size_t i = 0; i < POOL_SIZE * 3; i++) {
+		dhkey_t public_key, private_key, expected;
+		pool.take(public_key, private_key);
+		REQUIRE_LE(pool.size(), POOL_SIZE);
+
+		DH_generate_key_secret(expected, private_key, generator);
+		REQUIRE_EQ(expected.dq.low, public_key.dq.low);
+		REQUIRE_EQ(expected.dq.high, public_key.dq.high);
+
+		REQUIRE_TRUE(private_keys.insert(std::make_pair(private_key.dq.low, private_key.dq.high)).second);
+	}
+	REQUIRE_TRUE(pool.wait_full(10 * 1000));
+	REQUIRE_EQ(POOL_SIZE, pool.size());
 }
 
 //-------------------------------------------------------------------------------------
@@ -169,6 +311,105 @@ TEST_CASE("Crypto algorithm(XorShift128) test", "[Crypto][XorShift128]")
 
 }
 
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(XorShift128Stream) test", "[Crypto][XorShift128]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t DATA_SIZE = 2000;
+	uint8_t* data = new uint8_t[DATA_SIZE];
+	uint8_t* expected = new uint8_t[DATA_SIZE];
+	uint8_t* out = new uint8_t[DATA_SIZE];
+	_fillRandom(data, DATA_SIZE);
+
+	XorShift128 seed;
+	seed.make();
+
+	//compat mode is the same as xorshift128() on every call
+	{
+		XorShift128 compat_seed = seed;
+		XorShift128Stream compat(seed, XorShift128Stream::IMPL_COMPAT);
+		REQUIRE_EQ(XorShift128Stream::IMPL_COMPAT, compat.get_implementation());
+
+		memcpy(expected, data, DATA_SIZE);
+		size_t off = 0;
+		while (off < DATA_SIZE) {
+			size_t size = std::min((size_t)(rand() % 100), DATA_SIZE - off);
+			xorshift128(expected + off, size, compat_seed);
+			compat.update(data + off, out + off, size);
+			off += size;
+		}
+		REQUIRE_EQ(0, memcmp(out, expected, DATA_SIZE));
+
+		//ring buf, the data wraps
+		RingBuf rb(1024);
+		rb.memcpy_into(data, 1000);
+		rb.discard(1000);
+		rb.memcpy_into(data, 1000);
+
+		compat.reset(seed);
+		compat_seed = seed;
+		memcpy(expected, data, 1000);
+		xorshift128(expected, 999, compat_seed);
+		xorshift128(expected + 999, 1, compat_seed);
+		REQUIRE_TRUE(compat.update(rb, 0, 999));
+		REQUIRE_TRUE(compat.update(rb, 999, 1));
+		REQUIRE_FALSE(compat.update(rb, 999, 2));
+		REQUIRE_EQ(1000u, rb.memcpy_out(out, 1000));
+		REQUIRE_EQ(0, memcmp(out, expected, 1000));
+	}
+
+	//the first lane is XorShift128::next()
+	XorShift128Stream portable(seed, XorShift128Stream::IMPL_PORTABLE);
+	memset(expected, 0, DATA_SIZE);
+	portable.update(expected, expected, DATA_SIZE);
+	{
+		XorShift128 lane0 = seed;
+		for (size_t off = 0; off + XorShift128Stream::BLOCK_SIZE <= DATA_SIZE; off += XorShift128Stream::BLOCK_SIZE) {
+			uint64_t v = lane0.next();
+			for (size_t i = 0; i < 8; i++) {
+				REQUIRE_EQ((uint8_t)(v >> (i * 8)), expected[off + i]);
+			}
+		}
+	}
+	for (size_t i = 0; i < DATA_SIZE; i++) expected[i] ^= data[i];
+
+	//all implementations make the same keystream, which continues between calls
+	const XorShift128Stream::Implementation impls[] = {
+		XorShift128Stream::IMPL_PORTABLE, XorShift128Stream::IMPL_SSE2, XorShift128Stream::IMPL_AVX2, XorShift128Stream::IMPL_AUTO };
+	for (XorShift128Stream::Implementation impl : impls) {
+		if (!XorShift128Stream::is_supported(impl)) continue;
+
+		XorShift128Stream stream(seed, impl);
+		stream.update(data, out, DATA_SIZE);
+		REQUIRE_EQ(0, memcmp(out, expected, DATA_SIZE));
+
+		stream.reset(seed);
+		size_t off = 0;
+		while (off < DATA_SIZE) {
+			size_t size = std::min((size_t)(rand() % 300), DATA_SIZE - off);
+			stream.update(data + off, out + off, size);
+			off += size;
+		}
+		REQUIRE_EQ(0, memcmp(out, expected, DATA_SIZE));
+
+		//decrypt in place on ring buf, the data wraps
+		RingBuf rb(4096);
+		rb.memcpy_into(data, 3000);
+		rb.discard(3000);
+		rb.memcpy_into(expected, DATA_SIZE);
+
+		stream.reset(seed);
+		REQUIRE_TRUE(stream.update(rb, 0, DATA_SIZE));
+		REQUIRE_EQ(DATA_SIZE, rb.memcpy_out(out, DATA_SIZE));
+		REQUIRE_EQ(0, memcmp(out, data, DATA_SIZE));
+	}
+
+	delete[] data;
+	delete[] expected;
+	delete[] out;
+}
+
 //-------------------------------------------------------------------------------------
 TEST_CASE("Crypto algorithm(Rijndael) test", "[Crypto][Rijndael]")
 {
@@ -247,4 +488,454 @@ TEST_CASE("Crypto algorithm(Rijndael) test", "[Crypto][Rijndael]")
 	}
 }
 
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(Rijndael) implementation test", "[Crypto][Rijndael]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const Rijndael::Implementation impls[] = { Rijndael::IMPL_TABLE, Rijndael::IMPL_AESNI, Rijndael::IMPL_ARMV8 };
+
+	//unsupported implementation fallback to table
+	for (Rijndael::Implementation impl : impls) {
+		Rijndael::BLOCK key = { 0 };
+		Rijndael aes(key, impl);
+		REQUIRE_EQ(aes.get_implementation(), Rijndael::is_supported(impl) ? impl : Rijndael::IMPL_TABLE);
+	}
+
+	//FIPS-197 Appendix C.1(one block with zero iv equals to ECB)
+	{
+		const Rijndael::BLOCK key = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+		const uint8_t plain[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+		const uint8_t cipher[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+
+		for (Rijndael::Implementation impl : impls) {
+			if (!Rijndael::is_supported(impl)) continue;
+			Rijndael aes(key, impl);
+
+			uint8_t buf[16];
+			Rijndael::BLOCK iv = { 0 };
+			aes.encrypt(plain, buf, 16, iv);
+			REQUIRE_EQ(0, memcmp(buf, cipher, 16));
+
+			memset(iv, 0, sizeof(iv));
+			aes.decrypt(cipher, buf, 16, iv);
+			REQUIRE_EQ(0, memcmp(buf, plain, 16));
+		}
+	}
+
+	//all implementations have the same output, with odd block counts and in place
+	const size_t MAX_BLOCKS = 37;
+	uint8_t plain[MAX_BLOCKS * 16], expected[MAX_BLOCKS * 16], buf[MAX_BLOCKS * 16];
+	for (int32_t i = 0; i < 20; i++) {
+		Rijndael::BLOCK key;
+		_fillRandom(key, Rijndael::BLOCK_SIZE);
+		Rijndael::BLOCK iv;
+		_fillRandom(iv, Rijndael::BLOCK_SIZE);
+		size_t size = (size_t)(1 + rand() % (int)MAX_BLOCKS) * Rijndael::BLOCK_SIZE;
+		_fillRandom(plain, size);
+
+		Rijndael table(key, Rijndael::IMPL_TABLE);
+		Rijndael::BLOCK iv_expected;
+		memcpy(iv_expected, iv, Rijndael::BLOCK_SIZE);
+		table.encrypt(plain, expected, size, iv_expected);
+
+		for (Rijndael::Implementation impl : impls) {
+			if (!Rijndael::is_supported(impl)) continue;
+			Rijndael aes(key, impl);
+
+			Rijndael::BLOCK iv_buf;
+			memcpy(iv_buf, iv, Rijndael::BLOCK_SIZE);
+			memcpy(buf, plain, size);
+			aes.encrypt(buf, buf, size, iv_buf);
+			REQUIRE_EQ(0, memcmp(buf, expected, size));
+			REQUIRE_EQ(0, memcmp(iv_buf, iv_expected, Rijndael::BLOCK_SIZE));
+
+			memcpy(iv_buf, iv, Rijndael::BLOCK_SIZE);
+			aes.decrypt(buf, buf, size, iv_buf);
+			REQUIRE_EQ(0, memcmp(buf, plain, size));
+			REQUIRE_EQ(0, memcmp(iv_buf, iv_expected, Rijndael::BLOCK_SIZE));
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------
+void _fromHex(const char* hex, uint8_t* out, size_t& size)
+{
+	size = 0;
+	for (; hex[0] && hex[1]; hex += 2) {
+		unsigned int v;
+		sscanf(hex, "%2x", &v);
+		out[size++] = (uint8_t)v;
+	}
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(Rijndael CTR) test", "[Crypto][Rijndael]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//NIST SP 800-38A F.5.1
+	uint8_t key[16], counter[16], plain[64], cipher[64], buf[64];
+	size_t size;
+	_fromHex("2b7e151628aed2a6abf7158809cf4f3c", key, size);
+	_fromHex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", counter, size);
+	_fromHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+		"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710", plain, size);
+	_fromHex("874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+		"5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee", cipher, size);
+	REQUIRE_EQ(size, 64u);
+
+	const Rijndael::Implementation impls[] = { Rijndael::IMPL_TABLE, Rijndael::IMPL_AESNI, Rijndael::IMPL_ARMV8 };
+	for (Rijndael::Implementation impl : impls) {
+		if (!Rijndael::is_supported(impl)) continue;
+
+		RijndaelCTR ctr(key, counter, impl);
+		ctr.update(plain, buf, 64);
+		REQUIRE_EQ(0, memcmp(buf, cipher, 64));
+
+		//streaming with odd size, in place
+		ctr.reset(counter);
+		memcpy(buf, cipher, 64);
+		ctr.update(buf, buf, 7);
+		ctr.update(buf + 7, buf + 7, 30);
+		ctr.update(buf + 37, buf + 37, 27);
+		REQUIRE_EQ(0, memcmp(buf, plain, 64));
+	}
+
+	//long random data, all implementations are the same
+	const size_t DATA_SIZE = 4000;
+	uint8_t* data = new uint8_t[DATA_SIZE];
+	uint8_t* expected = new uint8_t[DATA_SIZE];
+	uint8_t* out = new uint8_t[DATA_SIZE];
+	_fillRandom(data, DATA_SIZE);
+	_fillRandom(key, 16);
+	_fillRandom(counter, 16);
+	counter[12] = counter[13] = counter[14] = 0xFF;	//the counter wraps
+
+	RijndaelCTR table(key, counter, Rijndael::IMPL_TABLE);
+	table.update(data, expected, DATA_SIZE);
+	for (Rijndael::Implementation impl : impls) {
+		if (!Rijndael::is_supported(impl)) continue;
+		RijndaelCTR ctr(key, counter, impl);
+		size_t off = 0;
+		while (off < DATA_SIZE) {
+			size_t n = std::min(DATA_SIZE - off, (size_t)(rand() % 300));
+			ctr.update(data + off, out + off, n);
+			off += n;
+		}
+		REQUIRE_EQ(0, memcmp(out, expected, DATA_SIZE));
+	}
+
+	//in place on ring buf, the data wraps
+	{
+		RingBuf rb(1024);
+		rb.memcpy_into(data, 700);
+		rb.discard(700);
+		rb.memcpy_into(data, 1000);
+
+		RijndaelCTR ctr(key, counter);
+		REQUIRE_FALSE(ctr.update(rb, 100, 1000));
+		REQUIRE_TRUE(ctr.update(rb, 0, 1000));
+		REQUIRE_EQ(1000u, rb.memcpy_out(out, 1000));
+		REQUIRE_EQ(0, memcmp(out, expected, 1000));
+	}
+
+	delete[] data;
+	delete[] expected;
+	delete[] out;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(Rijndael GCM) test", "[Crypto][Rijndael]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//test vectors of "The Galois/Counter Mode of Operation (GCM)", test case 1~4 and 6
+	struct TestVector {
+		const char* key;
+		const char* iv;
+		const char* plain;
+		const char* aad;
+		const char* cipher;
+		const char* tag;
+	};
+	const TestVector vectors[] = {
+		{ "00000000000000000000000000000000", "000000000000000000000000", "", "", "", "58e2fccefa7e3061367f1d57a4e7455a" },
+		{ "00000000000000000000000000000000", "000000000000000000000000", "00000000000000000000000000000000", "",
+			"0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf" },
+		{ "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+			"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255", "",
+			"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+			"4d5c2af327cd64a62cf35abd2ba6fab4" },
+		{ "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+			"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+			"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+			"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+			"5bc94fbc3221a5db94fae95ae7121a47" },
+		{ "feffe9928665731c6d6a8f9467308308",
+			"9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b",
+			"d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+			"feedfacedeadbeeffeedfacedeadbeefabaddad2",
+			"8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca701e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5",
+			"619cc5aefffe0bfa462af43c1699d050" },
+	};
+
+	const Rijndael::Implementation impls[] = { Rijndael::IMPL_TABLE, Rijndael::IMPL_AUTO };
+	for (const TestVector& v : vectors) {
+		uint8_t key[16], iv[64], plain[64], aad[32], cipher[64], tag[16], buf[64], tag_buf[16];
+		size_t key_size, iv_size, plain_size, aad_size, cipher_size, tag_size;
+		_fromHex(v.key, key, key_size);
+		_fromHex(v.iv, iv, iv_size);
+		_fromHex(v.plain, plain, plain_size);
+		_fromHex(v.aad, aad, aad_size);
+		_fromHex(v.cipher, cipher, cipher_size);
+		_fromHex(v.tag, tag, tag_size);
+		REQUIRE_EQ(plain_size, cipher_size);
+
+		for (Rijndael::Implementation impl : impls) {
+			RijndaelGCM gcm(key, impl);
+
+			//one shot
+			gcm.start(iv, iv_size);
+			gcm.update_aad(aad, aad_size);
+			gcm.encrypt(plain, buf, plain_size);
+			gcm.finish(tag_buf);
+			REQUIRE_EQ(0, memcmp(buf, cipher, cipher_size));
+			REQUIRE_EQ(0, memcmp(tag_buf, tag, 16));
+
+			//streaming in place
+			gcm.start(iv, iv_size);
+			for (size_t i = 0; i < aad_size; i += 3) gcm.update_aad(aad + i, std::min((size_t)3, aad_size - i));
+			memcpy(buf, cipher, cipher_size);
+			for (size_t i = 0; i < cipher_size; i += 5) gcm.decrypt(buf + i, buf + i, std::min((size_t)5, cipher_size - i));
+			REQUIRE_EQ(0, memcmp(buf, plain, plain_size));
+			REQUIRE_TRUE(gcm.verify(tag));
+
+			//bad tag
+			gcm.start(iv, iv_size);
+			gcm.update_aad(aad, aad_size);
+			gcm.decrypt(cipher, buf, cipher_size);
+			tag_buf[0] = (uint8_t)(tag[0] ^ 1);
+			REQUIRE_FALSE(gcm.verify(tag_buf));
+
+			//truncated tag
+			gcm.start(iv, iv_size);
+			gcm.update_aad(aad, aad_size);
+			gcm.decrypt(cipher, buf, cipher_size);
+			REQUIRE_TRUE(gcm.verify(tag, 12));
+
+			//too short tag is easy to forge
+			gcm.start(iv, iv_size);
+			gcm.update_aad(aad, aad_size);
+			gcm.decrypt(cipher, buf, cipher_size);
+			REQUIRE_FALSE(gcm.verify(tag, 11));
+			REQUIRE_FALSE(gcm.verify(tag, 1));
+		}
+	}
+
+	//long random data, table and hardware are the same
+	const size_t DATA_SIZE = 5000;
+	uint8_t* data = new uint8_t[DATA_SIZE];
+	uint8_t* expected = new uint8_t[DATA_SIZE];
+	uint8_t* out = new uint8_t[DATA_SIZE];
+	uint8_t key[16], iv[12], aad[40], tag_expected[16], tag[16];
+	_fillRandom(data, DATA_SIZE);
+	_fillRandom(key, 16);
+	_fillRandom(iv, 12);
+	_fillRandom(aad, 40);
+
+	RijndaelGCM table(key, Rijndael::IMPL_TABLE);
+	table.start(iv);
+	table.update_aad(aad, 40);
+	table.encrypt(data, expected, DATA_SIZE);
+	table.finish(tag_expected);
+
+	RijndaelGCM gcm(key);
+	gcm.start(iv);
+	gcm.update_aad(aad, 40);
+	size_t off = 0;
+	while (off < DATA_SIZE) {
+		size_t n = std::min(DATA_SIZE - off, (size_t)(rand() % 700));
+		gcm.encrypt(data + off, out + off, n);
+		off += n;
+	}
+	gcm.finish(tag);
+	REQUIRE_EQ(0, memcmp(out, expected, DATA_SIZE));
+	REQUIRE_EQ(0, memcmp(tag, tag_expected, 16));
+
+	//in place on ring buf, the data wraps
+	{
+		RingBuf rb(4096);
+		rb.memcpy_into(data, 3000);
+		rb.discard(3000);
+		rb.memcpy_into(expected, DATA_SIZE);
+
+		gcm.start(iv);
+		gcm.update_aad(aad, 40);
+		REQUIRE_TRUE(gcm.decrypt(rb, 0, DATA_SIZE));
+		REQUIRE_TRUE(gcm.verify(tag_expected));
+		REQUIRE_EQ(DATA_SIZE, rb.memcpy_out(out, DATA_SIZE));
+		REQUIRE_EQ(0, memcmp(out, data, DATA_SIZE));
+	}
+
+	delete[] data;
+	delete[] expected;
+	delete[] out;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(ChaCha20) test", "[Crypto][ChaCha20]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const ChaCha20::Implementation impls[] = { ChaCha20::IMPL_PORTABLE, ChaCha20::IMPL_SSE2, ChaCha20::IMPL_AVX2 };
+
+	uint8_t key[32], nonce[12], buf[256], expected[256];
+	size_t size, expected_size;
+	for (int i = 0; i < 32; i++) key[i] = (uint8_t)i;
+
+	//RFC 8439 2.3.2, block function
+	_fromHex("000000090000004a00000000", nonce, size);
+	_fromHex("10f1e7e4d13b5915500fdd1fa32071c4c7d1f4c733c068030422aa9ac3d46c4e"
+		"d2826446079faa0914c2d705d98b02a2b5129cd1de164eb9cbd083e8a2503c4e", expected, expected_size);
+	for (ChaCha20::Implementation impl : impls) {
+		if (!ChaCha20::is_supported(impl)) continue;
+		ChaCha20 chacha(key, nonce, 1, impl);
+		REQUIRE_EQ(chacha.get_implementation(), impl);
+		memset(buf, 0, 64);
+		chacha.update(buf, buf, 64);
+		REQUIRE_EQ(0, memcmp(buf, expected, 64));
+	}
+
+	//RFC 8439 2.4.2, encryption
+	const char* plain = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+	size_t plain_size = strlen(plain);
+	_fromHex("000000000000004a00000000", nonce, size);
+	_fromHex("6e2e359a2568f98041ba0728dd0d6981e97e7aec1d4360c20a27afccfd9fae0b"
+		"f91b65c5524733ab8f593dabcd62b3571639d624e65152ab8f530c359f0861d8"
+		"07ca0dbf500d6a6156a38e088a22b65e52bc514d16ccf806818ce91ab7793736"
+		"5af90bbf74a35be6b40b8eedf2785e42874d", expected, expected_size);
+	REQUIRE_EQ(plain_size, expected_size);
+	for (ChaCha20::Implementation impl : impls) {
+		if (!ChaCha20::is_supported(impl)) continue;
+		ChaCha20 chacha(key, nonce, 1, impl);
+		chacha.update((const uint8_t*)plain, buf, plain_size);
+		REQUIRE_EQ(0, memcmp(buf, expected, plain_size));
+
+		//streaming in place
+		chacha.reset(nonce, 1);
+		for (size_t i = 0; i < plain_size; i += 13) chacha.update(buf + i, buf + i, std::min((size_t)13, plain_size - i));
+		REQUIRE_EQ(0, memcmp(buf, plain, plain_size));
+	}
+
+	//long random data, all implementations are the same
+	const size_t DATA_SIZE = 5000;
+	uint8_t* data = new uint8_t[DATA_SIZE];
+	uint8_t* data_expected = new uint8_t[DATA_SIZE];
+	uint8_t* out = new uint8_t[DATA_SIZE];
+	_fillRandom(data, DATA_SIZE);
+	_fillRandom(key, 32);
+	_fillRandom(nonce, 12);
+
+	ChaCha20 portable(key, nonce, 0xFFFFFFF0u, ChaCha20::IMPL_PORTABLE);	//the counter wraps
+	portable.update(data, data_expected, DATA_SIZE);
+	for (ChaCha20::Implementation impl : impls) {
+		if (!ChaCha20::is_supported(impl)) continue;
+		ChaCha20 chacha(key, nonce, 0xFFFFFFF0u, impl);
+		size_t off = 0;
+		while (off < DATA_SIZE) {
+			size_t n = std::min(DATA_SIZE - off, (size_t)(rand() % 1200));
+			chacha.update(data + off, out + off, n);
+			off += n;
+		}
+		REQUIRE_EQ(0, memcmp(out, data_expected, DATA_SIZE));
+	}
+
+	//in place on ring buf, the data wraps
+	{
+		RingBuf rb(4096);
+		rb.memcpy_into(data, 3000);
+		rb.discard(3000);
+		rb.memcpy_into(data, DATA_SIZE);
+
+		ChaCha20 chacha(key, nonce, 0xFFFFFFF0u);
+		REQUIRE_TRUE(chacha.update(rb, 0, DATA_SIZE));
+		REQUIRE_EQ(DATA_SIZE, rb.memcpy_out(out, DATA_SIZE));
+		REQUIRE_EQ(0, memcmp(out, data_expected, DATA_SIZE));
+	}
+
+	delete[] data;
+	delete[] data_expected;
+	delete[] out;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Crypto algorithm(ChaCha20Poly1305) test", "[Crypto][ChaCha20]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//RFC 8439 2.5.2, poly1305
+	{
+		uint8_t key[32], tag[16], expected[16];
+		size_t size;
+		_fromHex("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b", key, size);
+		_fromHex("a8061dc1305136c6c22b8baf0c0127a9", expected, size);
+
+		const char* msg = "Cryptographic Forum Research Group";
+		Poly1305 poly(key);
+		poly.update((const uint8_t*)msg, strlen(msg));
+		poly.finish(tag);
+		REQUIRE_EQ(0, memcmp(tag, expected, 16));
+
+		//streaming
+		poly.reset(key);
+		for (size_t i = 0; i < strlen(msg); i++) poly.update((const uint8_t*)msg + i, 1);
+		poly.finish(tag);
+		REQUIRE_EQ(0, memcmp(tag, expected, 16));
+	}
+
+	//RFC 8439 2.8.2, aead
+	uint8_t key[32], nonce[12], aad[12], expected[128], expected_tag[16], buf[128], tag[16];
+	size_t size, expected_size;
+	for (int i = 0; i < 32; i++) key[i] = (uint8_t)(0x80 + i);
+	_fromHex("070000004041424344454647", nonce, size);
+	_fromHex("50515253c0c1c2c3c4c5c6c7", aad, size);
+	_fromHex("d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+		"3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+		"92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+		"3ff4def08e4b7a9de576d26586cec64b6116", expected, expected_size);
+	_fromHex("1ae10b594f09e26a7e902ecbd0600691", expected_tag, size);
+
+	const char* plain = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+	size_t plain_size = strlen(plain);
+	REQUIRE_EQ(plain_size, expected_size);
+
+	const ChaCha20::Implementation impls[] = { ChaCha20::IMPL_PORTABLE, ChaCha20::IMPL_AUTO };
+	for (ChaCha20::Implementation impl : impls) {
+		ChaCha20Poly1305 aead(key, impl);
+		aead.start(nonce);
+		aead.update_aad(aad, 12);
+		aead.encrypt((const uint8_t*)plain, buf, plain_size);
+		aead.finish(tag);
+		REQUIRE_EQ(0, memcmp(buf, expected, plain_size));
+		REQUIRE_EQ(0, memcmp(tag, expected_tag, 16));
+
+		//streaming in place
+		aead.start(nonce);
+		aead.update_aad(aad, 5);
+		aead.update_aad(aad + 5, 7);
+		for (size_t i = 0; i < plain_size; i += 17) aead.decrypt(buf + i, buf + i, std::min((size_t)17, plain_size - i));
+		REQUIRE_EQ(0, memcmp(buf, plain, plain_size));
+		REQUIRE_TRUE(aead.verify(expected_tag));
+
+		//bad tag
+		aead.start(nonce);
+		aead.update_aad(aad, 12);
+		aead.decrypt(expected, buf, plain_size);
+		tag[15] ^= 0x80;
+		REQUIRE_FALSE(aead.verify(tag));
+	}
+}
+
 }
@@ -282,5 +282,33 @@ TEST_CASE("EventLooper multi timer test", "[EventLooper][MultiTimer]")
 	sys_api::signal_destroy(data.resume_signal);
 }
 
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("EventLooper cached time test", "[EventLooper][Timer]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	EventLooper_ForTest looper;
+	std::vector<int64_t> cached_times;
+	std::vector<int64_t> real_times;
+
+	looper.register_timer_event(10, nullptr, [&](Looper::event_id_t, void*) {
+		cached_times.push_back(looper.get_cached_time());
+		real_times.push_back(sys_api::performance_time_now());
+		if (cached_times.size() >= 10) looper.push_stop_request();
+	});
+	looper.loop();
+
+	REQUIRE_EQ(10u, cached_times.size());
+	for (size_t i = 0; i < cached_times.size(); i++) {
+		//updated once per step, just before the callback
+		REQUIRE_LE(cached_times[i], real_times[i]);
+		REQUIRE_LT(real_times[i] - cached_times[i], MAX_TIMER_ERROR * 1000ll);
+		if (i > 0) {
+			REQUIRE_GT(cached_times[i], cached_times[i - 1]);
+		}
+	}
+}
+
 }
 
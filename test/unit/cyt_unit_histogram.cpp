@@ -0,0 +1,181 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include <utility/cyu_histogram.h>
+#include "cyt_event_fortest.h"
+
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Histogram basic test", "[Histogram]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//empty
+	{
+		LatencyHistogram h;
+		REQUIRE_EQ(0u, h.total_counts());
+		REQUIRE_EQ(0, h.min());
+		REQUIRE_EQ(0, h.max());
+		REQUIRE_EQ(0.0, h.mean());
+		REQUIRE_EQ(0, h.value_at_percentile(50.0));
+	}
+
+	//small values are counted exactly
+	for (uint64_t v = 0; v < LatencyHistogram::kSubBucketCounts; v++) {
+		REQUIRE_EQ(v, LatencyHistogram::lowest_equivalent_value(v));
+		REQUIRE_EQ(v, LatencyHistogram::highest_equivalent_value(v));
+	}
+
+	//relative error of big values
+	for (uint64_t v = LatencyHistogram::kSubBucketCounts; v < (1ull << 38); v = v * 3 / 2 + 7) {
+		uint64_t low = LatencyHistogram::lowest_equivalent_value(v);
+		uint64_t high = LatencyHistogram::highest_equivalent_value(v);
+		REQUIRE_LE(low, v);
+		REQUIRE_GE(high, v);
+		REQUIRE_LE((double)(high - low), (double)v / LatencyHistogram::kSubBucketCounts);
+
+		//neighbour buckets
+		REQUIRE_EQ(high + 1, LatencyHistogram::lowest_equivalent_value(high + 1));
+		REQUIRE_EQ(low - 1, LatencyHistogram::highest_equivalent_value(low - 1));
+	}
+
+	//min, max and mean
+	{
+		LatencyHistogram h;
+		h.record(10);
+		h.record(20);
+		h.record(30, 2);
+		h.record(-5);	//as zero
+		REQUIRE_EQ(5u, h.total_counts());
+		REQUIRE_EQ(0, h.min());
+		REQUIRE_EQ(30, h.max());
+		REQUIRE_EQ(18.0, h.mean());
+		REQUIRE_EQ(30, h.value_at_percentile(100.0));
+		REQUIRE_EQ(0, h.value_at_percentile(0.0));
+
+		std::string summary = h.summary();
+		REQUIRE_TRUE(summary.find("counts=5 min=0 mean=18.0") == 0);
+		REQUIRE_TRUE(summary.find("max=30") != std::string::npos);
+
+		h.reset();
+		REQUIRE_EQ(0u, h.total_counts());
+		REQUIRE_EQ(0, h.max());
+	}
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Histogram percentile test", "[Histogram]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const int64_t MAX_VALUE = 10000;
+
+	LatencyHistogram h;
+	for (int64_t i = 1; i <= MAX_VALUE; i++) {
+		h.record(i);
+	}
+	REQUIRE_EQ((uint64_t)MAX_VALUE, h.total_counts());
+	REQUIRE_EQ(1, h.min());
+	REQUIRE_EQ(MAX_VALUE, h.max());
+	REQUIRE_EQ((double)(MAX_VALUE + 1) / 2.0, h.mean());
+
+	const double percentiles[] = { 1.0, 10.0, 50.0, 90.0, 99.0, 99.9 };
+	for (double p : percentiles) {
+		double expected = p / 100.0 * (double)MAX_VALUE;
+		double value = (double)h.value_at_percentile(p);
+		REQUIRE_GE(value, expected);
+		REQUIRE_LE(value, expected * (1.0 + 1.0 / LatencyHistogram::kSubBucketCounts));
+	}
+	REQUIRE_EQ(MAX_VALUE, h.value_at_percentile(100.0));
+
+	//overflow values are counted in the last bucket
+	LatencyHistogram big;
+	big.record(std::numeric_limits<int64_t>::max());
+	REQUIRE_EQ(1u, big.total_counts());
+	REQUIRE_EQ(std::numeric_limits<int64_t>::max(), big.value_at_percentile(50.0));
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Histogram merge and snapshot test", "[Histogram]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	LatencyHistogram a, b;
+	for (int64_t i = 1; i <= 100; i++) a.record(i);
+	for (int64_t i = 101; i <= 200; i++) b.record(i);
+
+	LatencyHistogram total;
+	total.merge(a);
+	total.merge(b);
+	REQUIRE_EQ(200u, total.total_counts());
+	REQUIRE_EQ(1, total.min());
+	REQUIRE_EQ(200, total.max());
+	REQUIRE_EQ(100.5, total.mean());
+	REQUIRE_EQ(100u, a.total_counts());
+
+	//snapshot moves the counts
+	LatencyHistogram interval;
+	a.snapshot(interval);
+	REQUIRE_EQ(0u, a.total_counts());
+	REQUIRE_EQ(0, a.value_at_percentile(50.0));
+	REQUIRE_EQ(100u, interval.total_counts());
+	REQUIRE_EQ(1, interval.min());
+	REQUIRE_EQ(100, interval.max());
+
+	a.record(1000);
+	LatencyHistogram interval2;
+	a.snapshot(interval2);
+	REQUIRE_EQ(1u, interval2.total_counts());
+	REQUIRE_EQ(1000, interval2.min());
+	REQUIRE_EQ(1000, interval2.max());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Histogram multi thread test", "[Histogram]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const int32_t THREAD_COUNTS = 4;
+	const int32_t RECORD_COUNTS = 100000;
+
+	LatencyHistogram h;
+	std::vector<thread_t> threads;
+	for (int32_t i = 0; i < THREAD_COUNTS; i++) {
+		threads.push_back(sys_api::thread_create([&h](void*) {
+			for (int32_t j = 1; j <= RECORD_COUNTS; j++) {
+				h.record(j);
+			}
+		}, nullptr, nullptr));
+	}
+	for (thread_t t : threads) {
+		sys_api::thread_join(t);
+	}
+
+	REQUIRE_EQ((uint64_t)(THREAD_COUNTS * RECORD_COUNTS), h.total_counts());
+	REQUIRE_EQ(1, h.min());
+	REQUIRE_EQ(RECORD_COUNTS, h.max());
+	REQUIRE_EQ((double)(RECORD_COUNTS + 1) / 2.0, h.mean());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("EventLooper step statistics test", "[EventLooper][Histogram]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	EventLooper_ForTest looper;
+	REQUIRE_TRUE(looper.get_step_statistics() == nullptr);
+	looper.start_step_statistics();
+	REQUIRE_TRUE(looper.get_step_statistics() != nullptr);
+
+	int32_t counts = 0;
+	looper.register_timer_event(1, nullptr, [&](Looper::event_id_t, void*) {
+		if (++counts >= 10) looper.push_stop_request();
+	});
+	looper.loop();
+
+	const LatencyHistogram* h = looper.get_step_statistics();
+	REQUIRE_GE(h->total_counts(), 10u);
+	REQUIRE_LE(h->value_at_percentile(50.0), h->max());
+}
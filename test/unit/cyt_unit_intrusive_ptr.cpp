@@ -0,0 +1,120 @@
+﻿#include <cy_core.h>
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+class TestObject : public RefCounted<TestObject>
+{
+public:
+	TestObject(int32_t* alive) : m_alive(alive) { (*m_alive)++; }
+	~TestObject() { (*m_alive)--; }
+private:
+	int32_t* m_alive;
+};
+typedef IntrusivePtr<TestObject> TestObjectPtr;
+typedef LocalPtr<TestObject> TestObjectLocalPtr;
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("IntrusivePtr basic test", "[IntrusivePtr][Basic]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	int32_t alive = 0;
+	{
+		TestObjectPtr p1(new TestObject(&alive));
+		REQUIRE_EQ(1, alive);
+		REQUIRE_EQ(1, p1->get_ref_counts());
+
+		TestObjectPtr p2 = p1;
+		REQUIRE_EQ(2, p1->get_ref_counts());
+		REQUIRE_TRUE(p1 == p2);
+
+		TestObjectPtr p3(std::move(p2));
+		REQUIRE_EQ(2, p1->get_ref_counts());
+		REQUIRE_TRUE(p2 == nullptr);
+
+		p3.reset();
+		REQUIRE_EQ(1, p1->get_ref_counts());
+
+		p1 = nullptr;
+		REQUIRE_EQ(0, alive);
+	}
+
+	//local reference
+	{
+		TestObjectLocalPtr l1(new TestObject(&alive));
+		REQUIRE_EQ(1, alive);
+		REQUIRE_EQ(1, l1->get_ref_counts());
+		REQUIRE_EQ(1, l1->get_local_ref_counts());
+
+		{
+			//copy local handle, no atomic counting
+			TestObjectLocalPtr l2 = l1;
+			TestObjectLocalPtr l3(l2);
+			REQUIRE_EQ(1, l1->get_ref_counts());
+			REQUIRE_EQ(3, l1->get_local_ref_counts());
+		}
+		REQUIRE_EQ(1, l1->get_local_ref_counts());
+
+		//escape
+		TestObjectPtr p1 = l1;
+		REQUIRE_EQ(2, p1->get_ref_counts());
+
+		l1.reset();
+		REQUIRE_EQ(1, alive);
+		REQUIRE_EQ(1, p1->get_ref_counts());
+		REQUIRE_EQ(0, p1->get_local_ref_counts());
+
+		//back to local
+		TestObjectLocalPtr l4(p1);
+		REQUIRE_EQ(2, p1->get_ref_counts());
+		p1.reset();
+		REQUIRE_EQ(1, alive);
+		REQUIRE_EQ(1, l4->get_ref_counts());
+	}
+	REQUIRE_EQ(0, alive);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("IntrusivePtr multi thread test", "[IntrusivePtr][MultiThread]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	int32_t alive = 0;
+	TestObjectLocalPtr owner(new TestObject(&alive));
+
+	const int32_t THREAD_COUNTS = 4;
+	const int32_t COPY_COUNTS = 100000;
+
+	TestObjectPtr shared = owner;
+	std::vector<thread_t> threads;
+	for (int32_t i = 0; i < THREAD_COUNTS; i++) {
+		threads.push_back(sys_api::thread_create([&shared](void*) {
+			for (int32_t j = 0; j < COPY_COUNTS; j++) {
+				TestObjectPtr p = shared;
+				(void)p;
+			}
+		}, nullptr, "copy"));
+	}
+
+	//owner thread copy local handle at the same time
+	for (int32_t j = 0; j < COPY_COUNTS; j++) {
+		TestObjectLocalPtr l = owner;
+		(void)l;
+	}
+
+	for (auto t : threads) {
+		sys_api::thread_join(t);
+	}
+	REQUIRE_EQ(2, owner->get_ref_counts());
+	REQUIRE_EQ(1, owner->get_local_ref_counts());
+
+	shared.reset();
+	owner.reset();
+	REQUIRE_EQ(0, alive);
+}
+
+}
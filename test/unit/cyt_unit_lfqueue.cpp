@@ -54,11 +54,11 @@ TEST_CASE("LockFreeQueue basic test", "[LockFreeQueue][Basic]")
 }
 
 //-------------------------------------------------------------------------------------
-template<int32_t PUSH_THREADS, int32_t POP_THREADS, int32_t TOP_VALUE>
+template<int32_t PUSH_THREADS, int32_t POP_THREADS, int32_t TOP_VALUE, typename QUEUE = LockFreeQueue<uint32_t, 1024>>
 class MultiThreadPushPop
 {
 public:
-	typedef LockFreeQueue<uint32_t, 1024> UIntQueue;
+	typedef QUEUE UIntQueue;
 
 	struct ThreadData
 	{
@@ -206,6 +206,145 @@ TEST_CASE("LockFreeQueue multi thread test", "[LockFreeQueue][MultiThread]")
 	//multi-producer multi-consumer
 	MultiThreadPushPop<3, 5, 100000> test5;
 	test5.pushAndPop();
+
+	//single-producer single-consumer ring
+	MultiThreadPushPop<1, 1, 100000, LockFreeQueue<uint32_t, 1024, kLFQueueSPSC>> test6;
+	test6.pushAndPop();
+
+	//multi-producer single-consumer ring
+	MultiThreadPushPop<5, 1, 100000, LockFreeQueue<uint32_t, 1024, kLFQueueMPSC>> test7;
+	test7.pushAndPop();
+}
+
+//-------------------------------------------------------------------------------------
+template<int32_t Q_MODE>
+void _testRingQueueBasic(void)
+{
+	const int32_t QUEUE_SIZE = 32;
+	typedef LockFreeQueue<int32_t, QUEUE_SIZE, Q_MODE> IntQueue;
+	IntQueue queue;
+
+	int32_t value;
+	REQUIRE_FALSE(queue.pop(value));
+	REQUIRE_EQ(0u, queue.size());
+
+	for (int32_t t = 0; t < 10; t++)
+	{
+		//ring queue holds Q_SIZE elements
+		for (int32_t i = 0; i < QUEUE_SIZE; i++) {
+			REQUIRE_TRUE(queue.push(i));
+		}
+		REQUIRE_EQ((size_t)QUEUE_SIZE, queue.size());
+		REQUIRE_FALSE(queue.push(QUEUE_SIZE));
+
+		for (int32_t i = 0; i < QUEUE_SIZE; i++) {
+			REQUIRE_TRUE(queue.pop(value));
+			REQUIRE_EQ(i, value);
+		}
+		REQUIRE_FALSE(queue.pop(value));
+		REQUIRE_EQ(0u, queue.size());
+	}
+
+	//bulk
+	int32_t input[QUEUE_SIZE + 8];
+	int32_t output[QUEUE_SIZE + 8];
+	for (int32_t i = 0; i < QUEUE_SIZE + 8; i++) input[i] = i;
+
+	REQUIRE_EQ(10u, queue.push_bulk(input, 10));
+	REQUIRE_EQ((size_t)QUEUE_SIZE - 10, queue.push_bulk(input + 10, QUEUE_SIZE + 8 - 10));
+	REQUIRE_EQ(0u, queue.push_bulk(input, 1));
+
+	REQUIRE_EQ(5u, queue.pop_bulk(output, 5));
+	REQUIRE_EQ((size_t)QUEUE_SIZE - 5, queue.pop_bulk(output + 5, QUEUE_SIZE + 8));
+	for (int32_t i = 0; i < QUEUE_SIZE; i++) {
+		REQUIRE_EQ(i, output[i]);
+	}
+	REQUIRE_EQ(0u, queue.pop_bulk(output, 1));
+
+	//wrap around
+	for (int32_t t = 0; t < 10; t++) {
+		REQUIRE_EQ(20u, queue.push_bulk(input, 20));
+		REQUIRE_EQ(20u, queue.pop_bulk(output, QUEUE_SIZE));
+		REQUIRE_EQ(0, memcmp(input, output, 20 * sizeof(int32_t)));
+	}
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("LockFreeQueue ring basic test", "[LockFreeQueue][Basic]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	_testRingQueueBasic<kLFQueueMPSC>();
+	_testRingQueueBasic<kLFQueueSPSC>();
+
+	//bulk operation of node pool queue
+	LockFreeQueue<int32_t, 32> queue;
+	int32_t input[40] = { 0 };
+	int32_t output[40] = { 0 };
+	for (int32_t i = 0; i < 40; i++) input[i] = i;
+	REQUIRE_EQ(31u, queue.push_bulk(input, 40));
+	REQUIRE_EQ(31u, queue.pop_bulk(output, 40));
+	REQUIRE_EQ(0, memcmp(input, output, 31 * sizeof(int32_t)));
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("LockFreeQueue bulk multi thread test", "[LockFreeQueue][MultiThread]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	static const int32_t PRODUCER_COUNTS = 4;
+	static const uint32_t VALUE_COUNTS = 100000;
+	static const size_t BULK_SIZE = 16;
+	typedef LockFreeQueue<uint64_t, 256, kLFQueueMPSC> Queue;
+	Queue* queue = new Queue();
+
+	std::vector<thread_t> producers;
+	for (int32_t i = 0; i < PRODUCER_COUNTS; i++) {
+		producers.push_back(sys_api::thread_create([queue](void* param) {
+			uint64_t producer = (uint64_t)(intptr_t)param;
+			uint64_t buf[BULK_SIZE];
+			uint32_t next = 0;
+			while (next < VALUE_COUNTS) {
+				size_t counts = std::min(BULK_SIZE, (size_t)(VALUE_COUNTS - next));
+				for (size_t j = 0; j < counts; j++) buf[j] = (producer << 32) | (next + j);
+
+				size_t pushed = 0;
+				while (pushed < counts) {
+					size_t n = queue->push_bulk(buf + pushed, counts - pushed);
+					if (n == 0) sys_api::thread_yield();
+					pushed += n;
+				}
+				next += (uint32_t)counts;
+			}
+		}, (void*)(intptr_t)i, "producer"));
+	}
+
+	//values of every producer must be in order
+	std::vector<uint32_t> expected((size_t)PRODUCER_COUNTS, 0);
+	uint64_t total = 0;
+	bool in_order = true;
+	uint64_t buf[BULK_SIZE * 2];
+	while (total < (uint64_t)PRODUCER_COUNTS * VALUE_COUNTS) {
+		size_t n = queue->pop_bulk(buf, BULK_SIZE * 2);
+		if (n == 0) {
+			sys_api::thread_yield();
+			continue;
+		}
+		for (size_t j = 0; j < n; j++) {
+			size_t producer = (size_t)(buf[j] >> 32);
+			uint32_t value = (uint32_t)(buf[j] & 0xFFFFFFFFu);
+			if (expected[producer] != value) in_order = false;
+			expected[producer] = value + 1;
+		}
+		total += n;
+	}
+
+	for (auto t : producers) {
+		sys_api::thread_join(t);
+	}
+	REQUIRE_TRUE(in_order);
+	REQUIRE_EQ(0u, queue->size());
+	delete queue;
 }
 
 TEST_CASE("LockFreeQueue high contention stress test", "[LockFreeQueue][Stress]")
@@ -0,0 +1,249 @@
+#include <cy_core.h>
+#include "cyt_unit_utils.h"
+
+#include <fstream>
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+struct LogFileForTest
+{
+	std::string old_path;
+	std::string old_name;
+	std::string file_name;
+
+	LogFileForTest(const char* name)
+	{
+		std::string old_file = get_log_filename();
+		size_t pos = old_file.find_last_of("/\\");
+		old_path = old_file.substr(0, pos + 1);
+		old_name = old_file.substr(pos + 1);
+
+		char temp[128];
+		std::snprintf(temp, 128, "%s.%d.log", name, sys_api::process_get_id());
+		set_log_filename("./logs/", temp);
+		file_name = get_log_filename();
+		::remove(file_name.c_str());
+		set_log_console(false);
+	}
+
+	~LogFileForTest()
+	{
+		log_flush();
+		set_log_console(true);
+		set_log_filename(old_path.c_str(), old_name.c_str());
+		::remove(file_name.c_str());
+	}
+
+	static std::vector<std::string> read_lines(const std::string& file_name)
+	{
+		std::vector<std::string> lines;
+		std::ifstream file(file_name.c_str());
+		std::string line;
+		while (std::getline(file, line)) lines.push_back(line);
+		return lines;
+	}
+};
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Logger multi thread test", "[Logger]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	LogFileForTest test_file("cyt_unit_logger");
+
+	const int32_t THREAD_COUNTS = 4;
+	const int32_t LINE_COUNTS = 1000;
+	int64_t drop_begin = get_log_drop_counts();
+	set_log_rate_limit(0);
+
+	std::vector<thread_t> threads;
+	for (int32_t i = 0; i < THREAD_COUNTS; i++) {
+		threads.push_back(sys_api::thread_create([](void* param) {
+			int32_t index = (int32_t)(intptr_t)param;
+			for (int32_t j = 0; j < LINE_COUNTS; j++) {
+				CY_LOG(L_INFO, "logger test %d %d", index, j);
+			}
+		}, (void*)(intptr_t)i, "logger_test"));
+	}
+	for (auto t : threads) {
+		sys_api::thread_join(t);
+	}
+	log_flush();
+	set_log_rate_limit(1000);
+	int64_t dropped = get_log_drop_counts() - drop_begin;
+
+	//lines of every thread are in order
+	std::vector<int32_t> next_line((size_t)THREAD_COUNTS, 0);
+	int32_t total = 0;
+	bool in_order = true;
+	for (auto& line : LogFileForTest::read_lines(test_file.file_name)) {
+		size_t pos = line.find("[I] [logger_test] logger test ");
+		if (pos == std::string::npos) continue;
+
+		int32_t index = 0, value = 0;
+		REQUIRE_EQ(2, sscanf(line.c_str() + pos, "[I] [logger_test] logger test %d %d", &index, &value));
+		REQUIRE_RANGE(index, 0, THREAD_COUNTS - 1);
+		if (value < next_line[(size_t)index]) in_order = false;
+		next_line[(size_t)index] = value + 1;
+		total++;
+	}
+	REQUIRE_TRUE(in_order);
+	REQUIRE_EQ(THREAD_COUNTS * LINE_COUNTS, total + dropped);
+
+	//level threshold
+	set_log_threshold(L_WARN);
+	CY_LOG(L_INFO, "logger test hidden");
+	CY_LOG(L_WARN, "logger test visible");
+	set_log_threshold(L_DEBUG);
+	log_flush();
+
+	std::vector<std::string> lines = LogFileForTest::read_lines(test_file.file_name);
+	REQUIRE_FALSE(lines.empty());
+	REQUIRE_TRUE(lines.back().find("[W] [") != std::string::npos);
+	REQUIRE_TRUE(lines.back().find("logger test visible") != std::string::npos);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Logger rotation test", "[Logger]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	LogFileForTest test_file("cyt_unit_logger_rotation");
+	std::string rotated_file = test_file.file_name + ".1";
+	::remove(rotated_file.c_str());
+
+	set_log_rotation(1024, 0);
+	for (int32_t i = 0; i < 100; i++) {
+		CY_LOG(L_DEBUG, "logger rotation test %d", i);
+		if (i % 10 == 9) log_flush();
+	}
+	log_flush();
+	set_log_rotation(0, 0);
+
+	std::vector<std::string> rotated_lines = LogFileForTest::read_lines(rotated_file);
+	REQUIRE_FALSE(rotated_lines.empty());
+	REQUIRE_TRUE(rotated_lines.front().find("logger rotation test 0") != std::string::npos);
+
+	std::vector<std::string> lines = LogFileForTest::read_lines(test_file.file_name);
+	REQUIRE_FALSE(lines.empty());
+	REQUIRE_TRUE(lines.back().find("logger rotation test 99") != std::string::npos);
+
+	for (int32_t i = 1; i < 10; i++) {
+		char name[512];
+		std::snprintf(name, 512, "%s.%d", test_file.file_name.c_str(), i);
+		::remove(name);
+	}
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Logger deferred format test", "[Logger]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	LogFileForTest test_file("cyt_unit_logger_format");
+
+	int32_t value = -12;
+	uint16_t port = 8080;
+	std::string text = "hello";
+	CY_LOG(L_INFO, "format %d|%5u|%x|%-6s|%.3f|%c|%%|%*d|%s", value, port, 255u, text.c_str(), 3.14159, 'A', 4, 7, (const char*)nullptr);
+	CY_LOG(L_INFO, "format missing %d %s", 1);
+	CY_LOG(L_INFO, "format int64 %lld %llu", (long long)-5000000000ll, (unsigned long long)5000000000ull);
+	CY_LOG(L_INFO, "format length %x|%u|%hx|%hhu|%hd|%lx|%zu", -1, -2, 0x12345, 257, 40000, -1l, (size_t)7);
+	log_flush();
+
+	//same as snprintf
+	char expect[128];
+	std::snprintf(expect, sizeof(expect), "format length %x|%u|%hx|%hhu|%hd|%lx|%zu", 0xFFFFFFFFu, 0xFFFFFFFEu,
+		(unsigned short)0x2345, (unsigned char)1, (short)-25536, (unsigned long)-1l, (size_t)7);
+
+	std::vector<std::string> lines = LogFileForTest::read_lines(test_file.file_name);
+	REQUIRE_EQ(4u, lines.size());
+	REQUIRE_TRUE(lines[0].find("format -12| 8080|ff|hello |3.142|A|%|   7|(null)") != std::string::npos);
+	REQUIRE_TRUE(lines[1].find("format missing 1 <?>") != std::string::npos);
+	REQUIRE_TRUE(lines[2].find("format int64 -5000000000 5000000000") != std::string::npos);
+	REQUIRE_TRUE(lines[3].find(expect) != std::string::npos);
+	REQUIRE_TRUE(lines[3].find("format length ffffffff|4294967294|2345|1|-25536|") != std::string::npos);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Logger binary test", "[Logger]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	LogFileForTest test_file("cyt_unit_logger_binary");
+	std::string binary_file = test_file.file_name + ".bin";
+	std::string decode_file = test_file.file_name + ".txt";
+	::remove(binary_file.c_str());
+
+	set_log_binary(true);
+	for (int32_t i = 0; i < 10; i++) {
+		CY_LOG(L_INFO, "logger binary test %d %s %.1f", i, "abc", 0.5);
+	}
+	disk_log(L_WARN, "logger binary text %d", 99);
+	set_log_binary(false);
+
+	//the text file is not touched
+	REQUIRE_TRUE(LogFileForTest::read_lines(test_file.file_name).empty());
+
+	FILE* fp = fopen(decode_file.c_str(), "wb");
+	REQUIRE_TRUE(fp != nullptr);
+	REQUIRE_TRUE(log_decode_file(binary_file.c_str(), fp));
+	fclose(fp);
+
+	std::vector<std::string> lines = LogFileForTest::read_lines(decode_file);
+	REQUIRE_EQ(11u, lines.size());
+	for (int32_t i = 0; i < 10; i++) {
+		char expected[64];
+		std::snprintf(expected, 64, "[I] [%s] logger binary test %d abc 0.5", sys_api::thread_get_current_name(), i);
+		REQUIRE_TRUE(lines[(size_t)i].find(expected) != std::string::npos);
+	}
+	REQUIRE_TRUE(lines[10].find("[W] [") != std::string::npos);
+	REQUIRE_TRUE(lines[10].find("logger binary text 99") != std::string::npos);
+
+	//not a binary log
+	REQUIRE_FALSE(log_decode_file(decode_file.c_str(), stdout));
+
+	::remove(binary_file.c_str());
+	::remove(decode_file.c_str());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Logger rate limit test", "[Logger]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	LogFileForTest test_file("cyt_unit_logger_rate");
+
+	const int32_t LIMIT = 10;
+	set_log_rate_limit(LIMIT);
+
+	//make sure all lines are in the same second
+	while (sys_api::utc_time_now() % (1000ll * 1000ll) > 500ll * 1000ll) sys_api::thread_sleep(10);
+	for (int32_t i = 0; i <= 100; i++) {
+		//next window reports the suppressed lines
+		if (i == 100) sys_api::thread_sleep(1000);
+		CY_LOG(L_INFO, "logger rate test %d", i);
+	}
+	set_log_rate_limit(1000);
+	log_flush();
+
+	int32_t counts = 0;
+	int32_t suppressed = 0;
+	for (auto& line : LogFileForTest::read_lines(test_file.file_name)) {
+		if (line.find("logger rate test") != std::string::npos) counts++;
+
+		size_t pos = line.find(" similar log lines suppressed at ");
+		if (pos != std::string::npos) {
+			REQUIRE_TRUE(line.find("cyt_unit_logger.cpp") != std::string::npos);
+			size_t begin = line.find_last_of(' ', pos - 1) + 1;
+			suppressed = atoi(line.c_str() + begin);
+		}
+	}
+	REQUIRE_EQ(LIMIT + 1, counts);
+	REQUIRE_EQ(100 - LIMIT, suppressed);
+}
+
+}
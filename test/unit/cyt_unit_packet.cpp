@@ -141,4 +141,66 @@ TEST_CASE("Packet basic test", "[Packet]")
 	PACKET_CHECK_ZERO();
 }
 
+//-------------------------------------------------------------------------------------
+TEST_CASE("Packet shared test", "[Packet]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t HEAD_SIZE = 4;
+	const uint16_t PACKET_ID = 0x1234;
+	const char* content = "Hello,World!";
+	const uint16_t content_size = (uint16_t)strlen(content);
+
+	//alloc and free in the pool
+	{
+		Packet* packet = Packet::alloc_packet();
+		REQUIRE_EQ(1, packet->get_ref_counts());
+		packet->build_from_memory(HEAD_SIZE, PACKET_ID, content_size, content);
+		REQUIRE_GT(memory::get_tag_stats(memory::kTagPacket).alloc_counts, 0);
+		Packet::free_packet(packet);
+	}
+
+	//shared packet
+	{
+		Packet source;
+		source.build_from_memory(HEAD_SIZE, PACKET_ID, content_size, content);
+
+		PacketPtr shared = Packet::alloc_shared_packet(&source);
+		REQUIRE_EQ(1, shared->get_ref_counts());
+		REQUIRE_EQ(PACKET_ID, shared->get_packet_id());
+		REQUIRE_EQ(0, memcmp(shared->get_packet_content(), content, content_size));
+
+		//deliver to work threads without copy
+		const int32_t THREAD_COUNTS = 4;
+		atomic_int32_t received(0);
+		std::vector<WorkThread*> threads;
+		for (int32_t i = 0; i < THREAD_COUNTS; i++) {
+			WorkThread* thread = new WorkThread();
+			thread->set_on_message([thread, &received, &shared](Packet* message) {
+				if (message->get_packet_id() == PACKET_ID) {
+					REQUIRE_TRUE(message == shared.get());
+					received++;
+				}
+				else {
+					thread->get_looper()->push_stop_request();
+				}
+			});
+			thread->start("packet");
+			threads.push_back(thread);
+		}
+
+		for (auto thread : threads) {
+			thread->send_message(shared);
+		}
+		while (received.load() < THREAD_COUNTS) sys_api::thread_yield();
+
+		for (auto thread : threads) {
+			thread->send_message(0, 0, nullptr);
+			thread->join();
+			delete thread;
+		}
+		REQUIRE_EQ(1, shared->get_ref_counts());
+	}
+}
+
 }
@@ -0,0 +1,132 @@
+﻿#include <cy_core.h>
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("RcuHashMap basic test", "[Rcu][Basic]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	typedef RcuHashMap<int32_t> IntMap;
+	IntMap map(4);
+
+	REQUIRE_EQ(0u, map.size());
+	REQUIRE_EQ(4u, map.bucket_counts());
+
+	int32_t value = 0;
+	REQUIRE_FALSE(map.find(1, value));
+	REQUIRE_FALSE(map.erase(1));
+
+	REQUIRE_TRUE(map.insert(1, 100));
+	REQUIRE_FALSE(map.insert(1, 200));
+	REQUIRE_EQ(1u, map.size());
+	REQUIRE_TRUE(map.find(1, value));
+	REQUIRE_EQ(100, value);
+
+	//auto grow
+	const int32_t COUNTS = 1000;
+	for (int32_t i = 2; i <= COUNTS; i++) {
+		REQUIRE_TRUE(map.insert(i, i * 100));
+	}
+	REQUIRE_EQ((size_t)COUNTS, map.size());
+	REQUIRE_GE(map.bucket_counts() * 2, (size_t)COUNTS);
+
+	for (int32_t i = 1; i <= COUNTS; i++) {
+		REQUIRE_TRUE(map.find(i, value));
+		REQUIRE_EQ(i * 100, value);
+	}
+
+	//erase odd key
+	for (int32_t i = 1; i <= COUNTS; i += 2) {
+		REQUIRE_TRUE(map.erase(i));
+	}
+	REQUIRE_EQ((size_t)COUNTS / 2, map.size());
+
+	for (int32_t i = 1; i <= COUNTS; i++) {
+		REQUIRE_EQ((i % 2) == 0, map.find(i, value));
+		if (i % 2 == 0) {
+			REQUIRE_EQ(i * 100, value);
+		}
+	}
+
+	map.clear();
+	REQUIRE_EQ(0u, map.size());
+	REQUIRE_FALSE(map.find(2, value));
+
+	//all retired object should be released
+	rcu::synchronize();
+	REQUIRE_EQ(0u, rcu::get_retired_counts());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("RcuHashMap multi thread test", "[Rcu][MultiThread]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	typedef std::shared_ptr<int32_t> ValuePtr;
+	typedef RcuHashMap<ValuePtr> ValueMap;
+
+	const int32_t KEY_COUNTS = 512;
+	const int32_t WRITE_ROUNDS = 20;
+
+	ValueMap map;
+	atomic_bool_t writer_done(false);
+	std::atomic<int64_t> found_counts(0);
+	std::atomic<int64_t> error_counts(0);
+
+	struct ReaderParam
+	{
+		ValueMap* map;
+		atomic_bool_t* done;
+		std::atomic<int64_t>* found;
+		std::atomic<int64_t>* error;
+	};
+	ReaderParam param = { &map, &writer_done, &found_counts, &error_counts };
+
+	int32_t reader_counts = sys_api::get_cpu_counts();
+	if (reader_counts < 2) reader_counts = 2;
+
+	std::vector<thread_t> readers;
+	for (int32_t i = 0; i < reader_counts; i++) {
+		readers.push_back(sys_api::thread_create([](void* p) {
+			ReaderParam* rp = (ReaderParam*)p;
+			int32_t key = 0;
+			while (!rp->done->load()) {
+				key = (key + 7) % KEY_COUNTS;
+
+				ValuePtr value;
+				if (rp->map->find(key, value)) {
+					//value must be alive and match the key
+					if (value == nullptr || *value != key) (*(rp->error))++;
+					else (*(rp->found))++;
+				}
+			}
+		}, &param, "reader"));
+	}
+
+	//writer: insert and erase all keys again and again
+	for (int32_t round = 0; round < WRITE_ROUNDS; round++) {
+		for (int32_t key = 0; key < KEY_COUNTS; key++) {
+			REQUIRE_TRUE(map.insert(key, std::make_shared<int32_t>(key)));
+		}
+		for (int32_t key = 0; key < KEY_COUNTS; key++) {
+			REQUIRE_TRUE(map.erase(key));
+		}
+	}
+	writer_done = true;
+
+	for (auto t : readers) {
+		sys_api::thread_join(t);
+	}
+
+	REQUIRE_EQ(0, error_counts.load());
+	REQUIRE_EQ(0u, map.size());
+
+	rcu::synchronize();
+	REQUIRE_EQ(0u, rcu::get_retired_counts());
+}
+
+}
@@ -0,0 +1,83 @@
+#include <cy_core.h>
+#include <cy_crypt.h>
+#include "cyt_unit_utils.h"
+
+//the cipher of relay sample
+#include "../../samples/relay/relay_protocol.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("RelayCipher rekey test", "[Crypto][Relay]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	dhkey_t secret;
+	for (size_t i = 0; i < DH_KEY_LENGTH; i++) secret.bytes[i] = (uint8_t)(i * 13 + 7);
+
+	uint8_t key[ChaCha20::KEY_SIZE];
+	for (size_t i = 0; i < DH_KEY_LENGTH; i++) {
+		key[i] = secret.bytes[i];
+		key[i + DH_KEY_LENGTH] = (uint8_t)(~secret.bytes[i]);
+	}
+
+	//rekey every 2 blocks
+	const uint64_t REKEY_BYTES = ChaCha20::BLOCK_SIZE * 2;
+	const size_t DATA_SIZE = (size_t)REKEY_BYTES * 3 + 17;
+
+	//keystream of every epoch starts from block 0 with its own nonce
+	{
+		RelayCipher local(RELAY_CIPHER_CHACHA20, secret, true, REKEY_BYTES);
+		uint8_t stream[DATA_SIZE] = { 0 };
+		local.encrypt(stream, DATA_SIZE);
+
+		for (uint64_t epoch = 0; epoch * REKEY_BYTES < DATA_SIZE; epoch++) {
+			uint8_t nonce[ChaCha20::NONCE_SIZE];
+			RelayCipher::make_nonce(nonce, 0, epoch);
+			ChaCha20 expect(key, nonce);
+
+			size_t off = (size_t)(epoch * REKEY_BYTES);
+			size_t size = std::min((size_t)REKEY_BYTES, DATA_SIZE - off);
+			uint8_t buf[REKEY_BYTES] = { 0 };
+			expect.update(buf, buf, size);
+			REQUIRE_EQ(0, memcmp(buf, stream + off, size));
+		}
+
+		//the first epoch is the original keystream, the next one doesn't continue the block counter
+		uint8_t nonce[ChaCha20::NONCE_SIZE] = { 0 };
+		ChaCha20 continued(key, nonce);
+		uint8_t buf[REKEY_BYTES * 2] = { 0 };
+		continued.update(buf, buf, sizeof(buf));
+		REQUIRE_EQ(0, memcmp(buf, stream, (size_t)REKEY_BYTES));
+		REQUIRE_NE(0, memcmp(buf + REKEY_BYTES, stream + REKEY_BYTES, (size_t)REKEY_BYTES));
+	}
+
+	//both sides cross the boundary at the same position, whatever the message sizes are
+	{
+		RelayCipher local(RELAY_CIPHER_CHACHA20, secret, true, REKEY_BYTES);
+		RelayCipher server(RELAY_CIPHER_CHACHA20, secret, false, REKEY_BYTES);
+
+		uint8_t plain[DATA_SIZE], buf[DATA_SIZE];
+		for (size_t i = 0; i < DATA_SIZE; i++) plain[i] = (uint8_t)(i * 7);
+
+		for (int32_t direction = 0; direction < 2; direction++) {
+			RelayCipher& sender = direction == 0 ? local : server;
+			RelayCipher& receiver = direction == 0 ? server : local;
+
+			memcpy(buf, plain, DATA_SIZE);
+			for (size_t off = 0, n = 1; off < DATA_SIZE; off += n, n = n * 3 % 100 + 1) {
+				sender.encrypt(buf + off, std::min(n, DATA_SIZE - off));
+			}
+			REQUIRE_NE(0, memcmp(buf, plain, DATA_SIZE));
+
+			for (size_t off = 0, n = 5; off < DATA_SIZE; off += n, n = n * 7 % 150 + 1) {
+				receiver.decrypt(buf + off, std::min(n, DATA_SIZE - off));
+			}
+			REQUIRE_EQ(0, memcmp(buf, plain, DATA_SIZE));
+		}
+	}
+}
+
+}
@@ -0,0 +1,513 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+
+#include "cyt_unit_utils.h"
+
+#include <deque>
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+static uint32_t _next_random(uint32_t& seed)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) & 0x7FFF;
+}
+
+//-------------------------------------------------------------------------------------
+static uint8_t _stream_byte(size_t pos)
+{
+	return (uint8_t)((pos * 7) ^ (pos >> 8));
+}
+
+//-------------------------------------------------------------------------------------
+//one direction of a simulated link with loss, delay and jitter(datagrams are reordered), in virtual time
+struct SimulatedLink
+{
+	struct Item
+	{
+		uint32_t time;
+		std::vector<uint8_t> data;
+	};
+
+	uint32_t loss_percent;
+	uint32_t delay;
+	uint32_t jitter;
+	uint32_t seed;
+	int64_t dropped;
+	std::vector<Item> items;
+
+	SimulatedLink(uint32_t _loss_percent, uint32_t _delay, uint32_t _jitter, uint32_t _seed)
+		: loss_percent(_loss_percent), delay(_delay), jitter(_jitter), seed(_seed), dropped(0) {}
+
+	void push(const uint8_t* data, size_t size, uint32_t now) {
+		if (_next_random(seed) % 100 < loss_percent) {
+			dropped++;
+			return;
+		}
+
+		Item item;
+		item.time = now + delay + (jitter > 0 ? _next_random(seed) % jitter : 0);
+		item.data.assign(data, data + size);
+		items.push_back(item);
+	}
+
+	void deliver(uint32_t now, ReliableChannel& to) {
+		for (size_t i = 0; i < items.size();) {
+			if (items[i].time > now) {
+				i++;
+				continue;
+			}
+
+			Item item = items[i];
+			items.erase(items.begin() + (ptrdiff_t)i);
+			REQUIRE_TRUE(to.input(item.data.data(), item.data.size(), now));
+			//ack at once, as UdpConnection
+			to.update(now);
+		}
+	}
+};
+
+//-------------------------------------------------------------------------------------
+struct ReceivedStream
+{
+	size_t size;
+	bool content_ok;
+	bool closed;
+	bool data_after_close;
+
+	ReceivedStream() : size(0), content_ok(true), closed(false), data_after_close(false) {}
+
+	void on_deliver(uint8_t cmd, const uint8_t* data, size_t len) {
+		if (cmd == ReliableChannel::kCmdClose) {
+			closed = true;
+			return;
+		}
+		if (closed) data_after_close = true;
+
+		for (size_t i = 0; i < len; i++) {
+			if (data[i] != _stream_byte(size + i)) content_ok = false;
+		}
+		size += len;
+	}
+};
+
+//-------------------------------------------------------------------------------------
+//send `total` bytes from a to b on simulated links, return the virtual time used
+static uint32_t _transfer(ReliableChannel::Config config, SimulatedLink& a_to_b, SimulatedLink& b_to_a, size_t total, ReceivedStream& received,
+	ReliableChannel::Stats& sender_stats, uint32_t& sender_srtt)
+{
+	uint32_t now = 1000;
+	const uint32_t MAX_TIME = 120 * 1000;
+
+	ReliableChannel a(1, config, now,
+		[&](const uint8_t* datagram, size_t size) { a_to_b.push(datagram, size, now); },
+		nullptr);
+	ReliableChannel b(1, config, now,
+		[&](const uint8_t* datagram, size_t size) { b_to_a.push(datagram, size, now); },
+		[&](uint8_t cmd, const uint8_t* data, size_t size) { received.on_deliver(cmd, data, size); });
+
+	//written in chunks of different size
+	std::vector<uint8_t> buf;
+	size_t pos = 0;
+	for (size_t chunk = 1; pos < total; chunk = chunk * 3 % 3001 + 1) {
+		size_t len = std::min(chunk, total - pos);
+		buf.resize(len);
+		for (size_t i = 0; i < len; i++) buf[i] = _stream_byte(pos + i);
+		a.send(buf.data(), len);
+		pos += len;
+	}
+	a.send_control(ReliableChannel::kCmdClose);
+
+	uint32_t start = now;
+	while (now - start < MAX_TIME && !(received.closed && a.is_idle())) {
+		now++;
+		a_to_b.deliver(now, b);
+		b_to_a.deliver(now, a);
+		if (now % config.interval == 0) {
+			a.update(now);
+			b.update(now);
+		}
+	}
+
+	sender_stats = a.get_stats();
+	sender_srtt = a.get_srtt();
+	return now - start;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ReliableChannel basic test", "[ReliableUdp][Channel]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	ReliableChannel::Config config;
+	const size_t TOTAL = 200 * 1024;
+
+	//no loss, the round trip time is 40ms
+	{
+		SimulatedLink a_to_b(0, 20, 0, 1), b_to_a(0, 20, 0, 2);
+		ReceivedStream received;
+		ReliableChannel::Stats stats;
+		uint32_t srtt;
+		uint32_t time_used = _transfer(config, a_to_b, b_to_a, TOTAL, received, stats, srtt);
+
+		REQUIRE_EQ(TOTAL, received.size);
+		REQUIRE_TRUE(received.content_ok);
+		REQUIRE_TRUE(received.closed);
+		REQUIRE_FALSE(received.data_after_close);
+		REQUIRE_EQ(0, stats.retransmits);
+		REQUIRE_EQ(0, stats.fast_retransmits);
+		REQUIRE_GE(srtt, 40u);
+		REQUIRE_LE(srtt, 50u);
+		//slow start opens the window in a few round trips
+		REQUIRE_LT(time_used, 2000u);
+	}
+
+	//the peer is gone
+	{
+		ReliableChannel::Config dead_config;
+		dead_config.idle_timeout = 0;
+
+		uint32_t now = 1000;
+		ReliableChannel a(1, dead_config, now, nullptr, nullptr);
+		a.send((const uint8_t*)"hello", 5);
+		while (!a.is_dead(now) && now < 1000 + 600 * 1000) {
+			now += config.interval;
+			a.update(now);
+		}
+		REQUIRE_TRUE(a.is_dead(now));
+		REQUIRE_EQ((int64_t)config.dead_link, a.get_stats().retransmits);
+	}
+
+	//not a datagram of this channel
+	{
+		uint8_t datagram[ReliableChannel::kHeadSize] = { 0 };
+		ReliableChannel a(1, config, 0, nullptr, nullptr);
+		REQUIRE_FALSE(a.input(datagram, sizeof(datagram), 0));
+		REQUIRE_FALSE(a.input(datagram, 10, 0));
+	}
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ReliableChannel lossy link test", "[ReliableUdp][Channel]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t TOTAL = 200 * 1024;
+	const uint32_t LOSS_PERCENT[] = { 5, 20 };
+
+	for (uint32_t loss : LOSS_PERCENT) {
+		for (int32_t cc = 0; cc < 2; cc++) {
+			ReliableChannel::Config config;
+			config.congestion_control = (cc != 0);
+
+			//reordered by jitter
+			SimulatedLink a_to_b(loss, 20, 15, 100 + loss), b_to_a(loss, 20, 15, 200 + loss);
+			ReceivedStream received;
+			ReliableChannel::Stats stats;
+			uint32_t srtt;
+			_transfer(config, a_to_b, b_to_a, TOTAL, received, stats, srtt);
+
+			REQUIRE_EQ(TOTAL, received.size);
+			REQUIRE_TRUE(received.content_ok);
+			REQUIRE_TRUE(received.closed);
+			REQUIRE_FALSE(received.data_after_close);
+			REQUIRE_GT(a_to_b.dropped, 0);
+			//most losses are repaired by selective acks, without waiting the timeout
+			REQUIRE_GT(stats.fast_retransmits, 0);
+			REQUIRE_GE(srtt, 40u);
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------------
+//udp proxy on loopback, drops and delays the datagrams between one client and the server
+class LossyProxy
+{
+public:
+	bool open(const Address& server_addr) {
+		m_server_addr = server_addr;
+		if (!m_socket.open(Address(0, true))) return false;
+		m_socket.set_on_message([this](UdpSocket*, const UdpSocket::Datagram* datagrams, size_t counts) {
+			int64_t now = sys_api::performance_time_now();
+			for (size_t i = 0; i < counts; i++) {
+				const UdpSocket::Datagram& datagram = datagrams[i];
+				bool to_server = !(Address(datagram.peer_addr) == m_server_addr);
+				if (to_server) m_client_addr = datagram.peer_addr;
+
+				if (_next_random(m_seed) % 100 < m_loss_percent) {
+					m_dropped++;
+					continue;
+				}
+
+				Item item;
+				item.time = now + m_delay * 1000;
+				item.to_server = to_server;
+				item.data.assign(datagram.data, datagram.data + datagram.size);
+				m_queue.push_back(item);
+			}
+		});
+		m_timer_id = m_socket.get_looper()->register_timer_event(1, nullptr, [this](Looper::event_id_t, void*) {
+			_forward();
+		});
+		return true;
+	}
+
+	void close(void) {
+		m_socket.get_looper()->delete_event(m_timer_id);
+		m_socket.close();
+	}
+
+	Address get_address(void) const { return Address("127.0.0.1", m_socket.get_local_addr().get_port()); }
+	int64_t get_dropped(void) const { return m_dropped; }
+
+private:
+	void _forward(void) {
+		int64_t now = sys_api::performance_time_now();
+		while (!m_queue.empty() && m_queue.front().time <= now) {
+			const Item& item = m_queue.front();
+			if (item.to_server) {
+				m_socket.send(item.data.data(), item.data.size(), m_server_addr);
+			}
+			else {
+				m_socket.send(item.data.data(), item.data.size(), m_client_addr);
+			}
+			m_queue.pop_front();
+		}
+		m_socket.flush();
+	}
+
+	struct Item
+	{
+		int64_t time;
+		bool to_server;
+		std::vector<uint8_t> data;
+	};
+
+	UdpSocket m_socket;
+	Address m_server_addr;
+	struct sockaddr_in m_client_addr;
+	uint32_t m_loss_percent;
+	uint32_t m_delay;	//ms
+	uint32_t m_seed;
+	int64_t m_dropped;
+	std::deque<Item> m_queue;
+	Looper::event_id_t m_timer_id;
+
+public:
+	LossyProxy(Looper* looper, uint32_t loss_percent, uint32_t delay)
+		: m_socket(looper)
+		, m_loss_percent(loss_percent)
+		, m_delay(delay)
+		, m_seed(12345)
+		, m_dropped(0)
+		, m_timer_id(Looper::INVALID_EVENT_ID)
+	{
+		memset(&m_client_addr, 0, sizeof(m_client_addr));
+	}
+};
+
+//-------------------------------------------------------------------------------------
+static bool _step_until(Looper* looper, std::function<bool(void)> cond, int32_t timeout_ms)
+{
+	int64_t end_time = sys_api::performance_time_now() + (int64_t)timeout_ms * 1000;
+	while (sys_api::performance_time_now() < end_time) {
+		looper->step();
+		if (cond()) return true;
+	}
+	return false;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ReliableUdpServer lossy loopback test", "[ReliableUdp][Server]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//echo server
+	atomic_int32_t server_connected(0), server_closed(0);
+	ReliableUdpServer server;
+	server.m_listener.on_connected = [&](ReliableUdpServer*, int32_t, const UdpConnectionPtr&) {
+		server_connected++;
+	};
+	server.m_listener.on_message = [](ReliableUdpServer*, int32_t, const UdpConnectionPtr& conn) {
+		RingBuf& input = conn->get_input_buf();
+		char buf[1024];
+		while (!input.empty()) {
+			size_t len = input.memcpy_out(buf, sizeof(buf));
+			conn->send(buf, len);
+		}
+	};
+	server.m_listener.on_close = [&](ReliableUdpServer*, int32_t, const UdpConnectionPtr&) {
+		server_closed++;
+	};
+	REQUIRE_TRUE(server.bind(Address(0, true), true));
+	REQUIRE_TRUE(server.start(2));
+	Address server_addr("127.0.0.1", server.get_bind_address().get_port());
+
+	const size_t TOTAL = 128 * 1024;
+	const uint32_t LOSS_PERCENT = 10;
+	const uint32_t DELAY = 10;
+
+	Looper* looper = Looper::create_looper();
+	{
+		LossyProxy proxy(looper, LOSS_PERCENT, DELAY);
+		REQUIRE_TRUE(proxy.open(server_addr));
+
+		bool connected = false, closed = false;
+		ReceivedStream received;
+
+		ReliableUdpClient client(looper);
+		client.m_listener.on_connected = [&](ReliableUdpClient*, const UdpConnectionPtr&, bool success) {
+			connected = success;
+		};
+		client.m_listener.on_message = [&](ReliableUdpClient*, const UdpConnectionPtr& conn) {
+			RingBuf& input = conn->get_input_buf();
+			uint8_t buf[1024];
+			while (!input.empty()) {
+				size_t len = input.memcpy_out(buf, sizeof(buf));
+				received.on_deliver(ReliableChannel::kCmdPush, buf, len);
+			}
+		};
+		client.m_listener.on_close = [&](ReliableUdpClient*, const UdpConnectionPtr&) {
+			closed = true;
+		};
+		REQUIRE_TRUE(client.connect(proxy.get_address()));
+		REQUIRE_FALSE(client.connect(proxy.get_address()));
+
+		//data sent in connecting is queued after the connect segment
+		char buf[1000];
+		for (size_t pos = 0; pos < TOTAL; pos += sizeof(buf)) {
+			size_t len = std::min(sizeof(buf), TOTAL - pos);
+			for (size_t i = 0; i < len; i++) buf[i] = (char)_stream_byte(pos + i);
+			client.send(buf, len);
+		}
+
+		REQUIRE_TRUE(_step_until(looper, [&]() { return connected && received.size >= TOTAL; }, 20000));
+		REQUIRE_EQ(TOTAL, received.size);
+		REQUIRE_TRUE(received.content_ok);
+		REQUIRE_EQ(1, server_connected.load());
+		REQUIRE_EQ(1, server.get_connection_counts());
+		REQUIRE_GT(proxy.get_dropped(), 0);
+
+		UdpConnectionPtr conn = client.get_connection();
+		REQUIRE_EQ(UdpConnection::kConnected, conn->get_state());
+		REQUIRE_GT(conn->get_channel().get_stats().fast_retransmits + conn->get_channel().get_stats().retransmits, 0);
+		REQUIRE_GE(conn->get_channel().get_srtt(), DELAY * 2);
+
+		//graceful close, the close segment is acked by server
+		client.disconnect();
+		REQUIRE_EQ(UdpConnection::kDisconnecting, conn->get_state());
+		REQUIRE_TRUE(_step_until(looper, [&]() { return closed && server_closed.load() == 1; }, 20000));
+		REQUIRE_EQ(UdpConnection::kDisconnected, conn->get_state());
+		REQUIRE_EQ(0, server.get_connection_counts());
+
+		//reconnect from the same address is a new conversation
+		connected = false;
+		REQUIRE_TRUE(client.connect(proxy.get_address()));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return connected; }, 20000));
+		REQUIRE_NE(conn->get_conv(), client.get_connection()->get_conv());
+		REQUIRE_TRUE(_step_until(looper, [&]() { return server_connected.load() == 2; }, 1000));
+
+		proxy.close();
+	}
+	Looper::destroy_looper(looper);
+
+	server.stop();
+	server.join();
+	REQUIRE_EQ(2, server_closed.load());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ReliableUdpServer max connections test", "[ReliableUdp][Server]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	atomic_int32_t server_connected(0), server_closed(0);
+	ReliableUdpServer server;
+	server.m_listener.on_connected = [&](ReliableUdpServer*, int32_t, const UdpConnectionPtr&) {
+		server_connected++;
+	};
+	server.m_listener.on_close = [&](ReliableUdpServer*, int32_t, const UdpConnectionPtr&) {
+		server_closed++;
+	};
+	server.set_max_connections(1);
+	REQUIRE_TRUE(server.bind(Address(0, true), true));
+	REQUIRE_TRUE(server.start(1));
+	Address server_addr("127.0.0.1", server.get_bind_address().get_port());
+
+	ReliableChannel::Config config;
+	config.dead_link = 3;
+	config.initial_rto = 20;
+
+	Looper* looper = Looper::create_looper();
+	{
+		int32_t first_result = -1, second_result = -1;
+		ReliableUdpClient first(looper, config), second(looper, config);
+		first.m_listener.on_connected = [&](ReliableUdpClient*, const UdpConnectionPtr&, bool success) {
+			first_result = success ? 1 : 0;
+		};
+		second.m_listener.on_connected = [&](ReliableUdpClient*, const UdpConnectionPtr&, bool success) {
+			second_result = success ? 1 : 0;
+		};
+
+		REQUIRE_TRUE(first.connect(server_addr));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return first_result >= 0; }, 5000));
+		REQUIRE_EQ(1, first_result);
+
+		//the connect segments beyond the limit are dropped
+		REQUIRE_TRUE(second.connect(server_addr));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return second_result >= 0; }, 5000));
+		REQUIRE_EQ(0, second_result);
+		REQUIRE_EQ(1, server_connected.load());
+		REQUIRE_EQ(1, server.get_connection_counts());
+
+		//accepted again after the first one closed
+		first.disconnect();
+		REQUIRE_TRUE(_step_until(looper, [&]() { return server_closed.load() == 1; }, 5000));
+
+		second_result = -1;
+		REQUIRE_TRUE(second.connect(server_addr));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return second_result >= 0; }, 5000));
+		REQUIRE_EQ(1, second_result);
+		REQUIRE_EQ(2, server_connected.load());
+	}
+	Looper::destroy_looper(looper);
+
+	server.stop();
+	server.join();
+	REQUIRE_EQ(2, server_closed.load());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("ReliableUdpClient connect failed test", "[ReliableUdp][Client]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	ReliableChannel::Config config;
+	config.dead_link = 3;
+	config.initial_rto = 20;
+
+	Looper* looper = Looper::create_looper();
+	{
+		//a port nobody listens
+		UdpSocket silent(looper);
+		REQUIRE_TRUE(silent.open(Address(0, true)));
+
+		int32_t result = -1;
+		ReliableUdpClient client(looper, config);
+		client.m_listener.on_connected = [&](ReliableUdpClient*, const UdpConnectionPtr&, bool success) {
+			result = success ? 1 : 0;
+		};
+		REQUIRE_TRUE(client.connect(Address("127.0.0.1", silent.get_local_addr().get_port())));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return result >= 0; }, 5000));
+		REQUIRE_EQ(0, result);
+
+		silent.close();
+	}
+	Looper::destroy_looper(looper);
+}
+
+}
@@ -381,6 +381,12 @@ TEST_CASE("RingBuf basic test", "[RingBuf][Basic]")
 		REQUIRE_EQ(0x0d0c02e7ul, rb1.checksum(0, 8));
 		REQUIRE_EQ(0x0ddc0311ul, rb1.checksum(1, 8));
 
+		REQUIRE_EQ(INITIAL_CRC32C, rb1.checksum_crc32c(text_length, 1));
+		REQUIRE_EQ(INITIAL_CRC32C, rb1.checksum_crc32c(0, text_length + 1));
+		REQUIRE_EQ(INITIAL_CRC32C, rb1.checksum_crc32c(0, 0));
+		REQUIRE_EQ(crc32c(INITIAL_CRC32C, (const uint8_t*)text_pattern, text_length), rb1.checksum_crc32c(0, text_length));
+		REQUIRE_EQ(crc32c(INITIAL_CRC32C, (const uint8_t*)text_pattern + 1, 8), rb1.checksum_crc32c(1, 8));
+
 		CHECK_RINGBUF_SIZE(rb1, text_length, RingBuf::kDefaultCapacity);
 	}
 
@@ -398,6 +404,9 @@ TEST_CASE("RingBuf basic test", "[RingBuf][Basic]")
 		REQUIRE_EQ(adler32(INITIAL_ADLER, buffer1 + RingBuf::kDefaultCapacity - TEST_WRAP_SIZE * 2, TEST_WRAP_SIZE*3), rb1.checksum(0, TEST_WRAP_SIZE*3));
 		REQUIRE_EQ(adler32(INITIAL_ADLER, buffer1 + RingBuf::kDefaultCapacity, TEST_WRAP_SIZE), rb1.checksum(TEST_WRAP_SIZE*2, TEST_WRAP_SIZE));
 		REQUIRE_EQ(adler32(INITIAL_ADLER, buffer1 + RingBuf::kDefaultCapacity+ TEST_WRAP_SIZE, TEST_WRAP_SIZE), rb1.checksum(TEST_WRAP_SIZE * 3, TEST_WRAP_SIZE));
+
+		REQUIRE_EQ(crc32c(INITIAL_CRC32C, buffer1 + RingBuf::kDefaultCapacity - TEST_WRAP_SIZE * 2, TEST_WRAP_SIZE * 3), rb1.checksum_crc32c(0, TEST_WRAP_SIZE * 3));
+		REQUIRE_EQ(crc32c(INITIAL_CRC32C, buffer1 + RingBuf::kDefaultCapacity - TEST_WRAP_SIZE, TEST_WRAP_SIZE * 2), rb1.checksum_crc32c(TEST_WRAP_SIZE, TEST_WRAP_SIZE * 2));
 	}
 
 	//normalize
@@ -624,6 +633,184 @@ TEST_CASE("RingBuf socket test", "[RingBuf][Socket]")
 		REQUIRE_EQ(0, memcmp(rb_rcv.normalize(), buffer1 + RingBuf::kDefaultCapacity - TEST_WRAP_SIZE * 2, TEST_WRAP_SIZE * 4));
 	}
 }
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("RingBuf shrink test", "[RingBuf][Shrink]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t burst_size = RingBuf::kDefaultCapacity * 16;
+	uint8_t* buffer = new uint8_t[burst_size];
+	_fillRandom(buffer, burst_size);
+
+	//lazy buffer
+	{
+		RingBuf rb(0);
+		CHECK_RINGBUF_EMPTY(rb, 0);
+		rb.memcpy_into(buffer, 10);
+		REQUIRE_EQ(10u, rb.size());
+		REQUIRE_FALSE(rb.release_memory());
+		rb.discard(10);
+		REQUIRE_TRUE(rb.release_memory());
+		CHECK_RINGBUF_EMPTY(rb, 0);
+	}
+
+	//shrink at once
+	RingBuf::set_shrink_policy(0, 25);
+	{
+		RingBuf rb;
+		rb.memcpy_into(buffer, burst_size);
+		REQUIRE_GE(rb.capacity(), burst_size);
+
+		//usage still high
+		size_t burst_capacity = rb.capacity();
+		rb.discard(burst_size / 4);
+		REQUIRE_EQ(burst_capacity, rb.capacity());
+
+		//usage low, shrink and keep the data
+		rb.discard(burst_size - burst_size / 4 - 100);
+		REQUIRE_EQ(100u, rb.size());
+		REQUIRE_EQ((size_t)RingBuf::kDefaultCapacity, rb.capacity());
+		uint8_t temp[100];
+		REQUIRE_EQ(100u, rb.memcpy_out(temp, 100));
+		REQUIRE_EQ(0, memcmp(temp, buffer + burst_size - 100, 100));
+	}
+
+	//shrink after idle time
+	RingBuf::set_shrink_policy(20, 25);
+	{
+		RingBuf rb;
+		rb.memcpy_into(buffer, burst_size);
+		size_t burst_capacity = rb.capacity();
+		rb.discard(burst_size - RingBuf::kDefaultCapacity);
+		REQUIRE_EQ(burst_capacity, rb.capacity());
+
+		sys_api::thread_sleep(30);
+		rb.discard(1);
+		REQUIRE_LT(rb.capacity(), burst_capacity);
+		REQUIRE_GE(rb.capacity(), rb.size() * 2);
+	}
+
+	//bursts keep the memory, a drained buffer shrinks by the idle check without more consume
+	RingBuf::set_shrink_policy(20, 25);
+	{
+		RingBuf rb;
+		rb.memcpy_into(buffer, burst_size);
+		size_t burst_capacity = rb.capacity();
+		rb.discard(burst_size);
+		REQUIRE_EQ(burst_capacity, rb.capacity());
+		rb.memcpy_into(buffer, burst_size);
+		rb.discard(burst_size);
+		REQUIRE_EQ(burst_capacity, rb.capacity());
+		REQUIRE_FALSE(rb.shrink_if_idle());
+
+		//burst after the buffer stays low for a while
+		sys_api::thread_sleep(30);
+		rb.memcpy_into(buffer, burst_size);
+		rb.discard(burst_size);
+		REQUIRE_EQ(burst_capacity, rb.capacity());
+
+		sys_api::thread_sleep(30);
+		REQUIRE_TRUE(rb.shrink_if_idle());
+		CHECK_RINGBUF_EMPTY(rb, RingBuf::kDefaultCapacity);
+		REQUIRE_FALSE(rb.shrink_if_idle());
+	}
+
+	//disabled
+	RingBuf::set_shrink_policy(0, 0);
+	{
+		RingBuf rb;
+		rb.memcpy_into(buffer, burst_size);
+		size_t burst_capacity = rb.capacity();
+		rb.discard(burst_size);
+		REQUIRE_EQ(burst_capacity, rb.capacity());
+	}
+
+	RingBuf::set_shrink_policy(RingBuf::kDefaultShrinkIdleMs, RingBuf::kDefaultShrinkUsagePercent);
+	delete[] buffer;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("RingBuf mirrored test", "[RingBuf][Mirrored]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const size_t buffer_size = RingBuf::kDefaultCapacity * 16;
+	uint8_t* buffer = new uint8_t[buffer_size];
+	_fillRandom(buffer, buffer_size);
+
+	RingBuf rb(RingBuf::kDefaultCapacity, true);
+#ifndef CY_HAVE_MEMFD_CREATE
+	REQUIRE_FALSE(rb.is_mirrored());
+#else
+	REQUIRE_TRUE(rb.is_mirrored());
+#endif
+	REQUIRE_GE(rb.capacity(), (size_t)RingBuf::kDefaultCapacity);
+	const size_t capacity = rb.capacity();
+
+	//make wrap condition
+	const size_t TEST_WRAP_SIZE = 32;
+	RingBuf rb_normal(capacity);
+	rb.memcpy_into(buffer, capacity - TEST_WRAP_SIZE);
+	rb.discard(capacity - TEST_WRAP_SIZE * 2);
+	rb.memcpy_into(buffer + capacity - TEST_WRAP_SIZE, TEST_WRAP_SIZE * 3);
+	rb_normal.memcpy_into(buffer, capacity - TEST_WRAP_SIZE);
+	rb_normal.discard(capacity - TEST_WRAP_SIZE * 2);
+	rb_normal.memcpy_into(buffer + capacity - TEST_WRAP_SIZE, TEST_WRAP_SIZE * 3);
+	CHECK_RINGBUF_SIZE(rb, TEST_WRAP_SIZE * 4, capacity);
+
+	const uint8_t* expect = buffer + capacity - TEST_WRAP_SIZE * 2;
+
+	//view without copy
+	size_t view_size = 0;
+	const uint8_t* view = rb.peek_view(0, view_size);
+	if (rb.is_mirrored()) {
+		REQUIRE_EQ(TEST_WRAP_SIZE * 4, view_size);
+	}
+	REQUIRE_EQ(0, memcmp(view, expect, view_size));
+	view = rb.peek_view(TEST_WRAP_SIZE, view_size);
+	REQUIRE_EQ(0, memcmp(view, expect + TEST_WRAP_SIZE, view_size));
+	REQUIRE_TRUE(rb.peek_view(TEST_WRAP_SIZE * 4, view_size) == nullptr);
+	REQUIRE_EQ(0u, view_size);
+
+	//same result as normal buffer
+	REQUIRE_EQ(rb_normal.checksum(3, TEST_WRAP_SIZE * 3), rb.checksum(3, TEST_WRAP_SIZE * 3));
+	uint8_t search_byte = expect[TEST_WRAP_SIZE * 3];
+	REQUIRE_EQ(rb_normal.search(TEST_WRAP_SIZE, search_byte), rb.search(TEST_WRAP_SIZE, search_byte));
+
+	//normalize doesn't move memory
+	if (rb.is_mirrored()) {
+		REQUIRE_TRUE(rb.normalize() == rb.peek_view(0, view_size));
+	}
+	REQUIRE_EQ(0, memcmp(rb.normalize(), expect, TEST_WRAP_SIZE * 4));
+
+	//socket read/write
+	{
+		Pipe pipe;
+		REQUIRE_EQ(TEST_WRAP_SIZE * 4, (size_t)rb.write_socket(pipe.get_write_port()));
+		CHECK_RINGBUF_EMPTY(rb, capacity);
+
+		RingBuf rb_rcv(RingBuf::kDefaultCapacity, true);
+		REQUIRE_EQ(TEST_WRAP_SIZE * 4, (size_t)rb_rcv.read_socket(pipe.get_read_port()));
+		REQUIRE_EQ(0, memcmp(rb_rcv.normalize(), expect, TEST_WRAP_SIZE * 4));
+	}
+
+	//grow
+	rb.memcpy_into(buffer, buffer_size);
+	REQUIRE_GE(rb.capacity(), buffer_size);
+	REQUIRE_EQ(0, memcmp(rb.normalize(), buffer, buffer_size));
+
+	//lazy
+	{
+		RingBuf rb_lazy(0, true);
+		REQUIRE_EQ(0u, rb_lazy.capacity());
+		rb_lazy.memcpy_into(buffer, 10);
+		REQUIRE_EQ(rb.is_mirrored(), rb_lazy.is_mirrored());
+		REQUIRE_EQ(0, memcmp(rb_lazy.normalize(), buffer, 10));
+	}
+
+	delete[] buffer;
+}
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
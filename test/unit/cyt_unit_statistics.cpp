@@ -160,3 +160,86 @@ TEST_CASE("Statistics PeriodValue test", "[Statistics][PeriodValue]")
 		REQUIRE_EQ(v.total_counts(), 0);
 	}
 }
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("Statistics WindowValue test", "[Statistics][WindowValue]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	{
+		WindowValue v;
+		REQUIRE_EQ(v.get_time_period(), 1000);
+		REQUIRE_EQ(v.get_bucket_time(), 100);
+		REQUIRE_EQ(v.sum_and_counts(), std::make_pair((int64_t)0, 0));
+		REQUIRE_EQ(v.rate(), 0.0);
+	}
+
+	{
+		//10 buckets, 100ms per bucket
+		WindowValue v(1000, 10);
+
+		// 0-100, 1-200, 2-300, 3-400, ... ,39-4000
+		for (int32_t i = 0; i < 40; i++) {
+			v.push(i, (int64_t)(i + 1) * 100ll);
+		}
+
+		//buckets 31..40 in window, 30-3100, 31-3200, ..., 39-4000
+		REQUIRE_EQ(v.sum_and_counts(4000), std::make_pair((int64_t)345, 10)); //345 = (30 + 39) * 10 / 2
+		REQUIRE_EQ(v.sum_and_counts(4050), std::make_pair((int64_t)345, 10));
+
+		//slide one bucket
+		REQUIRE_EQ(v.sum_and_counts(4100), std::make_pair((int64_t)315, 9));
+
+		//39-4000 only
+		REQUIRE_EQ(v.sum_and_counts(4999), std::make_pair((int64_t)39, 1));
+
+		//all expired
+		REQUIRE_EQ(v.sum_and_counts(5000), std::make_pair((int64_t)0, 0));
+
+		//the old value is ignored
+		v.push(100, 100);
+		REQUIRE_EQ(v.sum_and_counts(4000), std::make_pair((int64_t)345, 10));
+	}
+
+	{
+		WindowValue v(1000, 10);
+
+		//100 per 10ms, 10000 per second
+		for (int64_t t = 1000; t < 3000; t += 10) {
+			v.push(100, t);
+		}
+		double rate = v.rate(2999);
+		REQUIRE_GT(rate, 9900.0);
+		REQUIRE_LT(rate, 10100.0);
+
+		double ewma = v.ewma_rate(0.3, 2999);
+		REQUIRE_GT(ewma, 9900.0);
+		REQUIRE_LT(ewma, 10100.0);
+
+		//speed up, ewma follows the newer buckets
+		for (int64_t t = 3000; t < 3500; t += 10) {
+			v.push(200, t);
+		}
+		REQUIRE_GT(v.ewma_rate(0.3, 3500), v.rate(3500));
+	}
+
+	//multi thread
+	{
+		WindowValue v(100000, 10);
+		const int32_t k_thread_counts = 4;
+		const int32_t k_push_counts = 100000;
+
+		std::vector<thread_t> threads;
+		for (int32_t i = 0; i < k_thread_counts; i++) {
+			threads.push_back(sys_api::thread_create([&v](void*) {
+				for (int32_t j = 0; j < k_push_counts; j++) {
+					v.push(2, 5000);
+				}
+			}, nullptr, nullptr));
+		}
+		for (auto t : threads) {
+			sys_api::thread_join(t);
+		}
+		REQUIRE_EQ(v.sum_and_counts(5000), std::make_pair((int64_t)k_thread_counts * k_push_counts * 2, k_thread_counts * k_push_counts));
+	}
+}
@@ -91,3 +91,32 @@ TEST_CASE("System atomic stress test", "[System][Atomic][Stress]")
 	delete[] fetchAddThread;
 	delete[] fetchSubThread;
 }
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("System time test", "[System][Time]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	//monotonic
+	int64_t last = sys_api::fast_now_ns();
+	for (int32_t i = 0; i < 100000; i++) {
+		int64_t now = sys_api::fast_now_ns();
+		REQUIRE_GE(now, last);
+		last = now;
+	}
+
+	//wait calibration done
+	sys_api::thread_sleep(100);
+	sys_api::fast_now_ns();
+
+	//same speed as performance time
+	int64_t begin_fast = sys_api::fast_now_ns();
+	int64_t begin_performance = sys_api::performance_time_now();
+	sys_api::thread_sleep(200);
+	int64_t fast_cost = (sys_api::fast_now_ns() - begin_fast) / 1000ll;
+	int64_t performance_cost = sys_api::performance_time_now() - begin_performance;
+
+	REQUIRE_GE(performance_cost, 200ll * 1000ll);
+	REQUIRE_RANGE(fast_cost, performance_cost - 1000ll, performance_cost + 1000ll);
+	printf("fast_now_ns use %s\n", sys_api::fast_now_is_tsc() ? "TSC" : "system clock");
+}
@@ -0,0 +1,169 @@
+#include <cy_core.h>
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+template<typename LOCK>
+void _test_lock_basic(void)
+{
+	LOCK lock;
+
+	REQUIRE_TRUE(lock.try_lock());
+	REQUIRE_FALSE(lock.try_lock());
+
+	//try lock in other thread
+	atomic_bool_t other_thread_got_lock(false);
+	thread_t t = sys_api::thread_create([&lock, &other_thread_got_lock](void*) {
+		other_thread_got_lock = lock.try_lock();
+	}, nullptr, nullptr);
+	sys_api::thread_join(t);
+	REQUIRE_FALSE(other_thread_got_lock.load());
+
+	//lock in other thread, blocked until unlock
+	atomic_int32_t status(0);
+	t = sys_api::thread_create([&lock, &status](void*) {
+		status = 1;
+		lock.lock();
+		status = 2;
+		lock.unlock();
+	}, nullptr, nullptr);
+	sys_api::thread_sleep(100);
+	REQUIRE_EQ(1, status.load());
+	lock.unlock();
+	sys_api::thread_join(t);
+	REQUIRE_EQ(2, status.load());
+
+	{
+		sys_api::auto_lock<LOCK> guard(lock);
+		REQUIRE_FALSE(lock.try_lock());
+	}
+	REQUIRE_TRUE(lock.try_lock());
+	lock.unlock();
+}
+
+//-------------------------------------------------------------------------------------
+template<typename LOCK>
+void _test_lock_stress(void)
+{
+	LOCK lock;
+	const int32_t k_thread_counts = sys_api::get_cpu_counts() < 8 ? 8 : sys_api::get_cpu_counts();
+	const int32_t k_test_counts = 20000;
+	int32_t counter = 0;	//protected by lock
+
+	std::vector<thread_t> threads;
+	for (int32_t i = 0; i < k_thread_counts; i++) {
+		threads.push_back(sys_api::thread_create([&lock, &counter, k_test_counts](void*) {
+			for (int32_t j = 0; j < k_test_counts; j++) {
+				sys_api::auto_lock<LOCK> guard(lock);
+				int32_t old_val = counter;
+				if ((j & 0xFF) == 0) sys_api::thread_yield();
+				counter = old_val + 1;
+			}
+		}, nullptr, nullptr));
+	}
+	for (auto t : threads) {
+		sys_api::thread_join(t);
+	}
+	REQUIRE_EQ(k_thread_counts * k_test_counts, counter);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("System futex mutex test", "[System][Lock][Futex]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	_test_lock_basic<sys_api::futex_mutex>();
+	_test_lock_stress<sys_api::futex_mutex>();
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("System spin mutex test", "[System][Lock][Spin]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	_test_lock_basic<sys_api::spin_mutex>();
+	_test_lock_stress<sys_api::spin_mutex>();
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("System rw mutex test", "[System][Lock][RW]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	sys_api::rw_mutex lock;
+
+	//many readers at the same time
+	{
+		const int32_t k_reader_counts = 4;
+		atomic_int32_t readers(0);
+		atomic_int32_t max_readers(0);
+		std::vector<thread_t> threads;
+		for (int32_t i = 0; i < k_reader_counts; i++) {
+			threads.push_back(sys_api::thread_create([&](void*) {
+				sys_api::auto_read_lock guard(lock);
+				int32_t now = ++readers;
+				while (max_readers.load() < now) max_readers = now;
+				sys_api::thread_sleep(100);
+				readers--;
+			}, nullptr, nullptr));
+		}
+		for (auto t : threads) {
+			sys_api::thread_join(t);
+		}
+		REQUIRE_GT(max_readers.load(), 1);
+	}
+
+	//writer blocks reader
+	{
+		atomic_int32_t status(0);
+		lock.lock();
+		thread_t t = sys_api::thread_create([&lock, &status](void*) {
+			status = 1;
+			sys_api::auto_read_lock guard(lock);
+			status = 2;
+		}, nullptr, nullptr);
+		sys_api::thread_sleep(100);
+		REQUIRE_EQ(1, status.load());
+		lock.unlock();
+		sys_api::thread_join(t);
+		REQUIRE_EQ(2, status.load());
+	}
+
+	//readers and writers, the writer keeps the two values equal
+	{
+		const int32_t k_thread_counts = 8;
+		const int32_t k_test_counts = 20000;
+		int64_t a = 0, b = 0;
+		atomic_bool_t error(false);
+
+		std::vector<thread_t> threads;
+		for (int32_t i = 0; i < k_thread_counts; i++) {
+			bool writer = (i % 4 == 0);
+			threads.push_back(sys_api::thread_create([&, writer](void*) {
+				for (int32_t j = 0; j < k_test_counts; j++) {
+					if (writer) {
+						sys_api::auto_lock<sys_api::rw_mutex> guard(lock);
+						a++;
+						if ((j & 0xFF) == 0) sys_api::thread_yield();
+						b++;
+					}
+					else {
+						sys_api::auto_read_lock guard(lock);
+						if (a != b) error = true;
+					}
+				}
+			}, nullptr, nullptr));
+		}
+		for (auto t : threads) {
+			sys_api::thread_join(t);
+		}
+		REQUIRE_FALSE(error.load());
+		REQUIRE_EQ(a, (int64_t)(k_thread_counts / 4) * k_test_counts);
+		REQUIRE_EQ(a, b);
+	}
+}
+
+}
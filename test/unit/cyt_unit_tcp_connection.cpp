@@ -0,0 +1,240 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+static bool _step_until(Looper* looper, std::function<bool(void)> cond)
+{
+	for (int32_t i = 0; i < 1000; i++) {
+		looper->step();
+		if (cond()) return true;
+		sys_api::thread_sleep(1);
+	}
+	return false;
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("TcpConnection compact memory test", "[TcpConnection][Compact]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	Looper* looper = Looper::create_looper();
+
+	//normal connection, buffers are allocated at once
+	{
+		socket_t fd[2];
+		REQUIRE_TRUE(Pipe::construct_socket_pipe(fd));
+
+		TcpConnectionPtr conn(new TcpConnection(1, fd[0], looper, nullptr));
+		REQUIRE_FALSE(conn->is_compact());
+		REQUIRE_GT(conn->get_memory_usage(), (size_t)TcpConnection::kCompactMemoryBudget);
+
+		//the buckets of statistics are counted
+		size_t usage = conn->get_memory_usage();
+		conn->start_read_statistics(1000);
+		WindowValue window(1000);
+		REQUIRE_GT(window.get_memory_usage(), sizeof(WindowValue));
+		REQUIRE_EQ(usage + window.get_memory_usage(), conn->get_memory_usage());
+
+		conn->shutdown();
+		REQUIRE_EQ(TcpConnection::kDisconnected, conn->get_state());
+		socket_api::close_socket(fd[1]);
+	}
+
+	socket_t fd[2];
+	REQUIRE_TRUE(Pipe::construct_socket_pipe(fd));
+
+	Address client_addr(false, fd[1]);
+	TcpConnectionPtr conn(new TcpConnection(2, fd[0], looper, nullptr, true));
+	REQUIRE_TRUE(conn->is_compact());
+	size_t pooled_counts = TcpConnection::get_pooled_counts();
+
+	//idle connection
+	REQUIRE_EQ(0u, conn->get_input_buf().capacity());
+	REQUIRE_LE(conn->get_memory_usage(), (size_t)TcpConnection::kCompactMemoryBudget);
+
+	//receive message
+	int32_t message_counts = 0;
+	size_t message_size = 0;
+	conn->set_on_message([&](const TcpConnectionLocalPtr& c) {
+		RingBuf& buf = c->get_input_buf();
+		REQUIRE_GT(buf.capacity(), 0u);
+		message_counts++;
+		message_size += buf.size();
+		buf.discard(buf.size());
+	});
+
+	const char* hello = "hello";
+	REQUIRE_EQ(5, socket_api::write(fd[1], hello, 5));
+	REQUIRE_TRUE(_step_until(looper, [&]() { return message_size == 5; }));
+	REQUIRE_GE(message_counts, 1);
+
+	//the read buf has been drained
+	REQUIRE_EQ(0u, conn->get_input_buf().capacity());
+	REQUIRE_LE(conn->get_memory_usage(), (size_t)TcpConnection::kCompactMemoryBudget);
+
+	//send message
+	conn->send("world", 5);
+	char temp[16] = { 0 };
+	ssize_t read_size = 0;
+	for (int32_t i = 0; i < 1000 && read_size < 5; i++) {
+		looper->step();
+		ssize_t len = socket_api::read(fd[1], temp + read_size, sizeof(temp) - (size_t)read_size);
+		if (len > 0) read_size += len;
+		else sys_api::thread_sleep(1);
+	}
+	REQUIRE_EQ(5, read_size);
+	REQUIRE_EQ(0, memcmp(temp, "world", 5));
+	REQUIRE_LE(conn->get_memory_usage(), (size_t)TcpConnection::kCompactMemoryBudget);
+
+	//lazy name and address
+	REQUIRE_STREQ("connection_2", conn->get_name());
+	REQUIRE_EQ(client_addr.get_port(), conn->get_peer_addr().get_port());
+	REQUIRE_LE(conn->get_memory_usage(), (size_t)TcpConnection::kCompactMemoryBudget);
+
+	//close by peer
+	bool closed = false;
+	conn->set_on_close([&](const TcpConnectionLocalPtr&) {
+		closed = true;
+	});
+	socket_api::close_socket(fd[1]);
+	REQUIRE_TRUE(_step_until(looper, [&]() { return closed; }));
+	REQUIRE_EQ(TcpConnection::kDisconnected, conn->get_state());
+
+	//address still valid after socket closed
+	REQUIRE_EQ(client_addr.get_port(), conn->get_peer_addr().get_port());
+
+	//send from other thread is refused after closed
+	thread_t t = sys_api::thread_create([](void* c) {
+		((TcpConnection*)c)->send("late", 4);
+	}, conn.get(), "send");
+	sys_api::thread_join(t);
+	REQUIRE_LE(conn->get_memory_usage(), (size_t)TcpConnection::kCompactMemoryBudget);
+
+	//the object should be recycled
+	conn->set_on_message(nullptr);
+	conn->set_on_close(nullptr);
+	TcpConnection* p = conn.get();
+	int64_t connection_bytes = memory::get_tag_stats(memory::kTagConnection).bytes;
+	conn.reset();
+	REQUIRE_EQ(pooled_counts + 1, TcpConnection::get_pooled_counts());
+
+	//the pooled object is not in use
+	REQUIRE_GE(connection_bytes - memory::get_tag_stats(memory::kTagConnection).bytes, (int64_t)sizeof(TcpConnection));
+
+	//and reused by next connection
+	REQUIRE_TRUE(Pipe::construct_socket_pipe(fd));
+	conn = TcpConnectionPtr(new TcpConnection(3, fd[0], looper, nullptr, true));
+	REQUIRE_EQ(p, conn.get());
+	REQUIRE_EQ(pooled_counts, TcpConnection::get_pooled_counts());
+	REQUIRE_EQ(connection_bytes, memory::get_tag_stats(memory::kTagConnection).bytes);
+
+	//released by other thread, it goes back to this thread
+	conn->shutdown();
+	socket_api::close_socket(fd[1]);
+	TcpConnectionPtr* last_ref = new TcpConnectionPtr(conn);
+	conn.reset();
+	t = sys_api::thread_create([](void* c) {
+		delete (TcpConnectionPtr*)c;
+	}, last_ref, "release");
+	sys_api::thread_join(t);
+	REQUIRE_EQ(pooled_counts + 1, TcpConnection::get_pooled_counts());
+
+	REQUIRE_TRUE(Pipe::construct_socket_pipe(fd));
+	conn = TcpConnectionPtr(new TcpConnection(4, fd[0], looper, nullptr, true));
+	REQUIRE_EQ(p, conn.get());
+	REQUIRE_EQ(pooled_counts, TcpConnection::get_pooled_counts());
+
+	conn->shutdown();
+	conn.reset();
+	socket_api::close_socket(fd[1]);
+
+	Looper::destroy_looper(looper);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("TcpConnection message statistics test", "[TcpConnection][Statistics]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	Looper* looper = Looper::create_looper();
+
+	socket_t fd[2];
+	REQUIRE_TRUE(Pipe::construct_socket_pipe(fd));
+
+	TcpConnectionPtr conn(new TcpConnection(1, fd[0], looper, nullptr));
+	REQUIRE_TRUE(conn->get_message_statistics() == nullptr);
+
+	size_t usage = conn->get_memory_usage();
+	conn->start_message_statistics();
+	const LatencyHistogram* histogram = conn->get_message_statistics();
+	REQUIRE_TRUE(histogram != nullptr);
+	REQUIRE_EQ((uint64_t)0, histogram->total_counts());
+	REQUIRE_EQ(usage + sizeof(LatencyHistogram), conn->get_memory_usage());
+
+	//start again is ignored
+	conn->start_message_statistics();
+	REQUIRE_EQ(histogram, conn->get_message_statistics());
+
+	//every on_message callback is recorded
+	int32_t message_counts = 0;
+	conn->set_on_message([&](const TcpConnectionLocalPtr& c) {
+		RingBuf& buf = c->get_input_buf();
+		buf.discard(buf.size());
+		message_counts++;
+		sys_api::thread_sleep(2);
+	});
+
+	for (int32_t i = 0; i < 3; i++) {
+		int32_t counts = message_counts;
+		REQUIRE_EQ(5, socket_api::write(fd[1], "hello", 5));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return message_counts > counts; }));
+	}
+	REQUIRE_EQ((uint64_t)message_counts, histogram->total_counts());
+	REQUIRE_GE(histogram->min(), 2000);
+	REQUIRE_GE(histogram->value_at_percentile(99.0), histogram->value_at_percentile(50.0));
+
+	conn->set_on_message(nullptr);
+	conn->shutdown();
+	conn.reset();
+	socket_api::close_socket(fd[1]);
+
+	Looper::destroy_looper(looper);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("TcpServer idle reclaim test", "[TcpServer][Rcu]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	TcpServer server;
+	REQUIRE_TRUE(server.bind(Address(0, true), true));
+	REQUIRE_TRUE(server.start(1));
+	Address server_addr("127.0.0.1", server.get_bind_address(0).get_port());
+
+	socket_t sfd = socket_api::create_socket();
+	REQUIRE_TRUE(socket_api::connect(sfd, server_addr.get_sockaddr_in()));
+	for (int32_t i = 0; i < 1000 && server.get_connection_counts() == 0; i++) sys_api::thread_sleep(1);
+	REQUIRE_EQ(1u, server.get_connection_counts());
+
+	//the closed connection is retired by directory, far below the retire threshold
+	socket_api::close_socket(sfd);
+	for (int32_t i = 0; i < 1000 && server.get_connection_counts() > 0; i++) sys_api::thread_sleep(1);
+	REQUIRE_EQ(0u, server.get_connection_counts());
+
+	//no more connection comes, the reclaim timer of master thread still releases it
+	for (int32_t i = 0; i < 3000 && rcu::get_retired_counts() > 0; i++) sys_api::thread_sleep(1);
+	size_t retired_counts = rcu::get_retired_counts();
+
+	server.stop();
+	server.join();
+	REQUIRE_EQ(0u, retired_counts);
+}
+
+}
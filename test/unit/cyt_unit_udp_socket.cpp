@@ -0,0 +1,293 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include <cy_network.h>
+
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+static bool _step_until(Looper* looper, std::function<bool(void)> cond)
+{
+	for (int32_t i = 0; i < 1000; i++) {
+		looper->step();
+		if (cond()) return true;
+		sys_api::thread_sleep(1);
+	}
+	return false;
+}
+
+//-------------------------------------------------------------------------------------
+static void _fill_datagram(uint8_t* buf, size_t size, uint32_t index)
+{
+	for (size_t i = 0; i < size; i++) buf[i] = (uint8_t)(index * 31 + i);
+}
+
+//-------------------------------------------------------------------------------------
+static bool _check_datagram(const uint8_t* buf, size_t size, uint32_t index)
+{
+	for (size_t i = 0; i < size; i++) {
+		if (buf[i] != (uint8_t)(index * 31 + i)) return false;
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------------
+struct Received
+{
+	std::vector<size_t> sizes;
+	std::vector<bool> contents;
+};
+
+//-------------------------------------------------------------------------------------
+static void _receive_into(UdpSocket& socket, Received& received)
+{
+	socket.set_on_message([&received](UdpSocket*, const UdpSocket::Datagram* datagrams, size_t counts) {
+		for (size_t i = 0; i < counts; i++) {
+			uint32_t index = (uint32_t)received.sizes.size();
+			received.sizes.push_back(datagrams[i].size);
+			received.contents.push_back(_check_datagram(datagrams[i].data, datagrams[i].size, index));
+		}
+	});
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("UdpSocket batch send and receive test", "[UdpSocket][Basic]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	Looper* looper = Looper::create_looper();
+	{
+		UdpSocket sender(looper, 1), receiver(looper, 2);
+		REQUIRE_TRUE(sender.open(Address(0, true)));
+		REQUIRE_TRUE(receiver.open(Address(0, true)));
+		Address receiver_addr("127.0.0.1", receiver.get_local_addr().get_port());
+
+		Received received;
+		_receive_into(receiver, received);
+
+		//datagrams of different size, the last one is empty
+		const uint32_t DATAGRAM_COUNTS = 64;
+		uint8_t buf[UdpSocket::kDefaultMaxDatagramSize];
+		for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+			size_t size = (i + 1 == DATAGRAM_COUNTS) ? 0 : (size_t)(i * 17 + 1);
+			_fill_datagram(buf, size, i);
+			REQUIRE_TRUE(sender.send(buf, size, receiver_addr));
+		}
+		REQUIRE_EQ((size_t)DATAGRAM_COUNTS, sender.get_queued_counts());
+		REQUIRE_TRUE(sender.flush());
+		REQUIRE_EQ(0u, sender.get_queued_counts());
+		REQUIRE_EQ((int64_t)DATAGRAM_COUNTS, sender.get_stats().send_datagrams);
+
+		REQUIRE_TRUE(_step_until(looper, [&]() { return received.sizes.size() == DATAGRAM_COUNTS; }));
+		for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+			REQUIRE_EQ((i + 1 == DATAGRAM_COUNTS) ? 0u : (size_t)(i * 17 + 1), received.sizes[i]);
+			REQUIRE_TRUE(received.contents[i]);
+		}
+		REQUIRE_EQ((int64_t)DATAGRAM_COUNTS, receiver.get_stats().recv_datagrams);
+#ifdef CY_HAVE_SENDMMSG
+		REQUIRE_EQ(1, sender.get_stats().send_calls);
+#endif
+#ifdef CY_HAVE_RECVMMSG
+		REQUIRE_LT(receiver.get_stats().recv_calls, (int64_t)DATAGRAM_COUNTS);
+#endif
+
+		//queued datagram is sent in next looper step
+		_fill_datagram(buf, 100, DATAGRAM_COUNTS);
+		REQUIRE_TRUE(sender.send(buf, 100, receiver_addr));
+		REQUIRE_EQ(1u, sender.get_queued_counts());
+		REQUIRE_TRUE(_step_until(looper, [&]() { return received.sizes.size() == DATAGRAM_COUNTS + 1; }));
+		REQUIRE_EQ(0u, sender.get_queued_counts());
+		REQUIRE_TRUE(received.contents[DATAGRAM_COUNTS]);
+
+		//too big
+		REQUIRE_FALSE(sender.send(buf, UdpSocket::kDefaultMaxDatagramSize + 1, receiver_addr));
+		REQUIRE_EQ(1, sender.get_stats().dropped_datagrams);
+
+		//reply in callback
+		bool replied = false;
+		sender.set_on_message([&](UdpSocket*, const UdpSocket::Datagram* datagrams, size_t counts) {
+			REQUIRE_EQ(1u, counts);
+			REQUIRE_EQ(0, memcmp(datagrams[0].data, "pong", 4));
+			replied = true;
+		});
+		receiver.set_on_message([&](UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts) {
+			REQUIRE_EQ(1u, counts);
+			socket->send("pong", 4, datagrams[0].peer_addr);
+		});
+		REQUIRE_TRUE(sender.send("ping", 4, receiver_addr));
+		REQUIRE_TRUE(_step_until(looper, [&]() { return replied; }));
+
+		sender.close();
+		receiver.close();
+	}
+	Looper::destroy_looper(looper);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("UdpSocket segmentation offload test", "[UdpSocket][Offload]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	Looper* looper = Looper::create_looper();
+	for (int32_t gro = 0; gro < 2; gro++) {
+		UdpSocket::Options options;
+		options.enable_gro = (gro != 0);
+
+		UdpSocket sender(looper, 1), receiver(looper, 2);
+		REQUIRE_TRUE(sender.open(Address(0, true)));
+		REQUIRE_TRUE(receiver.open(Address(0, true), false, options));
+		if (!options.enable_gro) REQUIRE_FALSE(receiver.is_gro_enabled());
+		Address receiver_addr("127.0.0.1", receiver.get_local_addr().get_port());
+
+		Received received;
+		_receive_into(receiver, received);
+
+		//same size datagrams to same peer, the last one is shorter
+		const uint32_t DATAGRAM_COUNTS = 41;
+		const size_t DATAGRAM_SIZE = 1000;
+		uint8_t buf[DATAGRAM_SIZE];
+		for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+			size_t size = (i + 1 == DATAGRAM_COUNTS) ? DATAGRAM_SIZE / 2 : DATAGRAM_SIZE;
+			_fill_datagram(buf, size, i);
+			REQUIRE_TRUE(sender.send(buf, size, receiver_addr));
+		}
+		REQUIRE_TRUE(sender.flush());
+		if (sender.is_gso_enabled()) {
+			REQUIRE_EQ(1, sender.get_stats().send_calls);
+		}
+
+		//split into the original datagrams
+		REQUIRE_TRUE(_step_until(looper, [&]() { return received.sizes.size() == DATAGRAM_COUNTS; }));
+		for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+			REQUIRE_EQ((i + 1 == DATAGRAM_COUNTS) ? DATAGRAM_SIZE / 2 : DATAGRAM_SIZE, received.sizes[i]);
+			REQUIRE_TRUE(received.contents[i]);
+		}
+		REQUIRE_EQ(0, receiver.get_stats().dropped_datagrams);
+	}
+	Looper::destroy_looper(looper);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("UdpSocket send error test", "[UdpSocket][Offload]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	Looper* looper = Looper::create_looper();
+	for (int32_t gso = 0; gso < 2; gso++) {
+		UdpSocket::Options options;
+		options.enable_gso = (gso != 0);
+
+		UdpSocket sender(looper, 1), receiver(looper, 2);
+		REQUIRE_TRUE(sender.open(Address(0, true), false, options));
+		REQUIRE_TRUE(receiver.open(Address(0, true)));
+		bool gso_enabled = sender.is_gso_enabled();
+		Address receiver_addr("127.0.0.1", receiver.get_local_addr().get_port());
+		//broadcast without SO_BROADCAST is refused by the kernel
+		Address refused_addr("255.255.255.255", receiver.get_local_addr().get_port());
+
+		Received received;
+		_receive_into(receiver, received);
+
+		//the datagrams to the refused peer are queued between the good ones
+		const uint32_t DATAGRAM_COUNTS = 8;
+		const uint32_t REFUSED_COUNTS = 4;
+		const size_t DATAGRAM_SIZE = 100;
+		uint8_t buf[DATAGRAM_SIZE];
+		for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+			_fill_datagram(buf, DATAGRAM_SIZE, i);
+			REQUIRE_TRUE(sender.send(buf, DATAGRAM_SIZE, receiver_addr));
+			if (i == DATAGRAM_COUNTS / 2) {
+				for (uint32_t j = 0; j < REFUSED_COUNTS; j++) {
+					REQUIRE_TRUE(sender.send(buf, DATAGRAM_SIZE, refused_addr));
+				}
+			}
+		}
+		REQUIRE_TRUE(sender.flush());
+
+		//only the failed ones are dropped, and the error of one peer doesn't disable gso
+		REQUIRE_EQ((int64_t)REFUSED_COUNTS, sender.get_stats().dropped_datagrams);
+		REQUIRE_EQ((int64_t)DATAGRAM_COUNTS, sender.get_stats().send_datagrams);
+		REQUIRE_EQ(gso_enabled, sender.is_gso_enabled());
+
+		REQUIRE_TRUE(_step_until(looper, [&]() { return received.sizes.size() == DATAGRAM_COUNTS; }));
+		for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+			REQUIRE_EQ(DATAGRAM_SIZE, received.sizes[i]);
+			REQUIRE_TRUE(received.contents[i]);
+		}
+
+		sender.close();
+		receiver.close();
+	}
+	Looper::destroy_looper(looper);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("UdpServer echo test", "[UdpServer][Echo]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const int32_t WORK_THREAD_COUNTS = 2;
+	atomic_int32_t started(0);
+
+	UdpServer server;
+	server.m_listener.on_work_thread_start = [&](UdpServer*, int32_t, Looper*) {
+		started++;
+	};
+	server.m_listener.on_message = [](UdpServer*, int32_t, UdpSocket* socket, const UdpSocket::Datagram* datagrams, size_t counts) {
+		for (size_t i = 0; i < counts; i++) {
+			socket->send(datagrams[i].data, datagrams[i].size, datagrams[i].peer_addr);
+		}
+	};
+	REQUIRE_TRUE(server.bind(Address(0, true), true));
+	REQUIRE_TRUE(server.start(WORK_THREAD_COUNTS));
+	REQUIRE_NE(0, server.get_bind_address().get_port());
+	REQUIRE_GE(server.get_socket_counts(), 1);
+	while (started.load() < WORK_THREAD_COUNTS) sys_api::thread_sleep(1);
+
+	Address server_addr("127.0.0.1", server.get_bind_address().get_port());
+
+	//clients of different port are fanned out to work threads
+	const int32_t CLIENT_COUNTS = 4;
+	const uint32_t DATAGRAM_COUNTS = 50;
+	Looper* looper = Looper::create_looper();
+	{
+		std::vector<std::unique_ptr<UdpSocket>> clients;
+		std::vector<Received> received((size_t)CLIENT_COUNTS);
+		for (int32_t c = 0; c < CLIENT_COUNTS; c++) {
+			clients.emplace_back(new UdpSocket(looper, c));
+			REQUIRE_TRUE(clients.back()->open(Address(0, true)));
+			_receive_into(*clients.back(), received[(size_t)c]);
+
+			uint8_t buf[256];
+			for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+				size_t size = (size_t)(i * 5 + 1);
+				_fill_datagram(buf, size, i);
+				REQUIRE_TRUE(clients.back()->send(buf, size, server_addr));
+			}
+		}
+
+		REQUIRE_TRUE(_step_until(looper, [&]() {
+			for (const Received& r : received) {
+				if (r.sizes.size() < DATAGRAM_COUNTS) return false;
+			}
+			return true;
+		}));
+		for (const Received& r : received) {
+			REQUIRE_EQ((size_t)DATAGRAM_COUNTS, r.sizes.size());
+			for (uint32_t i = 0; i < DATAGRAM_COUNTS; i++) {
+				REQUIRE_EQ((size_t)(i * 5 + 1), r.sizes[i]);
+				REQUIRE_TRUE(r.contents[i]);
+			}
+		}
+		for (auto& client : clients) client->close();
+	}
+	Looper::destroy_looper(looper);
+
+	server.stop();
+	server.join();
+}
+
+}
@@ -0,0 +1,172 @@
+#include <cy_core.h>
+#include <cy_event.h>
+#include "cyt_unit_utils.h"
+
+using namespace cyclone;
+
+namespace {
+
+//-------------------------------------------------------------------------------------
+const uint16_t STOP_ID = 0xFFFF;
+const uint16_t HOLD_ID = 0xFFFE;
+
+//-------------------------------------------------------------------------------------
+struct MailboxTest
+{
+	WorkThread thread;
+	atomic_bool_t gate;			//first message waits the gate, so the mailbox is filled
+	atomic_bool_t held;			//the work thread is waiting the gate in hold message
+	atomic_int32_t received;
+	atomic_int32_t out_of_order;
+	std::vector<int32_t> last_value;	//last value of every producer
+
+	MailboxTest(int32_t producer_counts) : gate(false), held(false), received(0), out_of_order(0), last_value((size_t)producer_counts, -1)
+	{
+		thread.set_on_message([this](Packet* message) {
+			if (message->get_packet_id() == STOP_ID) {
+				thread.get_looper()->push_stop_request();
+				return;
+			}
+			if (message->get_packet_id() == HOLD_ID) held = true;
+			while (!gate.load()) sys_api::thread_yield();
+			if (message->get_packet_id() == HOLD_ID) return;
+
+			int32_t value;
+			memcpy(&value, message->get_packet_content(), sizeof(value));
+			int32_t& last = last_value[message->get_packet_id()];
+			if (value != last + 1) out_of_order++;
+			last = value;
+			received++;
+		});
+		thread.start("mailbox");
+	}
+
+	//the work thread must quit even if the test case failed
+	~MailboxTest() {
+		stop();
+	}
+
+	//block the work thread in a message callback, nothing is popped from the mailbox until the gate opens
+	void hold(void) {
+		thread.send_message(HOLD_ID, 0, nullptr);
+		while (!held.load()) sys_api::thread_yield();
+	}
+
+	bool send(uint16_t producer, int32_t value) {
+		return thread.send_message(producer, (uint16_t)sizeof(value), (const char*)&value);
+	}
+
+	void stop(void) {
+		if (!thread.is_running()) return;
+
+		gate = true;
+		//the stop message is never rejected
+		thread.set_overflow_policy(WorkThread::kSpill);
+		thread.send_message(STOP_ID, 0, nullptr);
+		thread.join();
+	}
+};
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("WorkThread mailbox spill test", "[WorkThread][Mailbox]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const int32_t MESSAGE_COUNTS = WorkThread::kQueueSize * 4;
+
+	MailboxTest test(1);
+	for (int32_t i = 0; i < MESSAGE_COUNTS; i++) {
+		REQUIRE_TRUE(test.send(0, i));
+	}
+
+	WorkThread::MailboxStats stats = test.thread.get_mailbox_stats();
+	REQUIRE_EQ(MESSAGE_COUNTS, stats.posted_counts);
+	REQUIRE_GT(stats.spilled_counts, 0);
+	REQUIRE_EQ(0, stats.rejected_counts);
+	REQUIRE_GE(stats.max_depth, MESSAGE_COUNTS - 1);
+
+	test.gate = true;
+	while (test.received.load() < MESSAGE_COUNTS) sys_api::thread_yield();
+	test.stop();
+
+	REQUIRE_EQ(0, test.out_of_order.load());
+
+	stats = test.thread.get_mailbox_stats();
+	REQUIRE_EQ(0, stats.depth);
+	REQUIRE_EQ(MESSAGE_COUNTS + 1, stats.processed_counts);
+	REQUIRE_GT(stats.max_latency, 0);
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("WorkThread mailbox try test", "[WorkThread][Mailbox]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	MailboxTest test(1);
+	test.thread.set_overflow_policy(WorkThread::kTry);
+	test.hold();
+
+	int32_t sent = 0;
+	while (test.send(0, sent)) sent++;
+	REQUIRE_EQ(WorkThread::kQueueSize, sent);
+
+	//ownership is not transferred when it's rejected
+	Packet* packet = Packet::alloc_packet();
+	packet->build_from_memory(WorkThread::MESSAGE_HEAD_SIZE, 0, (uint16_t)sizeof(sent), (const char*)&sent);
+	REQUIRE_FALSE(test.thread.post_message(packet));
+	REQUIRE_EQ(1, packet->get_ref_counts());
+
+	WorkThread::MailboxStats stats = test.thread.get_mailbox_stats();
+	REQUIRE_EQ(2, stats.rejected_counts);
+	REQUIRE_EQ(0, stats.spilled_counts);
+
+	//release the work thread, the packet can be posted again
+	test.gate = true;
+	while (!test.thread.post_message(packet)) sys_api::thread_yield();
+	sent++;
+
+	while (test.received.load() < sent) sys_api::thread_yield();
+	test.stop();
+	REQUIRE_EQ(0, test.out_of_order.load());
+}
+
+//-------------------------------------------------------------------------------------
+TEST_CASE("WorkThread mailbox block test", "[WorkThread][Mailbox]")
+{
+	PRINT_CURRENT_TEST_NAME();
+
+	const int32_t PRODUCER_COUNTS = 4;
+	const int32_t MESSAGE_COUNTS = WorkThread::kQueueSize * 2;
+
+	MailboxTest test(PRODUCER_COUNTS);
+	test.thread.set_overflow_policy(WorkThread::kBlock);
+	test.thread.set_batch_size(16);
+	test.gate = true;
+
+	std::vector<thread_t> producers;
+	for (int32_t i = 0; i < PRODUCER_COUNTS; i++) {
+		producers.push_back(sys_api::thread_create([&test](void* param) {
+			uint16_t producer = (uint16_t)(intptr_t)param;
+			for (int32_t j = 0; j < MESSAGE_COUNTS; j++) {
+				test.send(producer, j);
+			}
+		}, (void*)(intptr_t)i, "producer"));
+	}
+	for (auto t : producers) {
+		sys_api::thread_join(t);
+	}
+
+	while (test.received.load() < MESSAGE_COUNTS * PRODUCER_COUNTS) sys_api::thread_yield();
+	test.stop();
+
+	REQUIRE_EQ(0, test.out_of_order.load());
+	WorkThread::MailboxStats stats = test.thread.get_mailbox_stats();
+	REQUIRE_EQ(MESSAGE_COUNTS * PRODUCER_COUNTS + 1, stats.posted_counts);
+	REQUIRE_EQ(0, stats.spilled_counts);
+	REQUIRE_EQ(0, stats.rejected_counts);
+	//the messages popped by one bulk are counted until they are processed, and every blocked
+	//producer has counted its message
+	REQUIRE_LE(stats.max_depth, WorkThread::kQueueSize + WorkThread::kPopBulkSize + PRODUCER_COUNTS);
+}
+
+}
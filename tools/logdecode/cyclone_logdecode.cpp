@@ -0,0 +1,31 @@
+﻿#include <cy_core.h>
+
+using namespace cyclone;
+
+//-------------------------------------------------------------------------------------
+// convert the binary log(written after set_log_binary(true)) to text
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argc > 3) {
+		printf("Usage: %s <binary_log_file> [output_file]\n", argv[0]);
+		return 1;
+	}
+
+	FILE* output = stdout;
+	if (argc == 3) {
+		output = fopen(argv[2], "wb");
+		if (output == nullptr) {
+			fprintf(stderr, "Open output file %s failed!\n", argv[2]);
+			return 1;
+		}
+	}
+
+	bool success = log_decode_file(argv[1], output);
+	if (output != stdout) fclose(output);
+
+	if (!success) {
+		fprintf(stderr, "%s is not a binary log file!\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}